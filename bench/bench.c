@@ -0,0 +1,670 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "neural_network.h"
+#include "autodiff.h"
+#include "optimizer.h"
+#include "training.h"
+#include "thread_pool.h"
+#include "pde.h"
+#include "checkpoint.h"
+#include "inference.h"
+#include "ensemble.h"
+
+// Every benchmark is timed as warmup runs followed by measured repetitions; each
+// repetition loops the body enough times to last at least MIN_SAMPLE_NS so short kernels
+// are not dominated by clock overhead. Reported times are per iteration.
+#define MIN_SAMPLE_NS 2e6
+#define MAX_RESULTS 512
+
+typedef struct {
+    char name[96];
+    double median_ns;
+    double p95_ns;
+    double items_per_second;            // Points, samples or parameters per second (0 if not meaningful)
+    int repetitions;
+    int has_error;                      // Reduced-precision runs also record their deviation from fp64
+    double jet_error;                   // Max absolute error of the output jets
+    double gradient_error;              // Max gradient error relative to the largest gradient
+} BenchResult;
+
+typedef struct {
+    int warmups;
+    int repetitions;
+    int quick;
+    const char *filter;
+    BenchResult results[MAX_RESULTS];
+    int num_results;
+} Bench;
+
+typedef void (*BenchBody)(void *context);
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted sample
+static double percentile(const double *sorted, int count, double p) {
+    int rank = (int)ceil(p * count) - 1;
+    return sorted[rank < 0 ? 0 : (rank >= count ? count - 1 : rank)];
+}
+
+// Returns the new result, or NULL when the benchmark was filtered out
+static BenchResult *run_benchmark(Bench *bench, const char *name, BenchBody body, void *context, double items) {
+    if ((bench->filter && strstr(name, bench->filter) == NULL) || bench->num_results >= MAX_RESULTS) {
+        return NULL;
+    }
+
+    // Calibrate the inner loop count on the first warmup, then finish warming up
+    long iterations = 1;
+    for (;;) {
+        double start = now_ns();
+        for (long i = 0; i < iterations; i++) body(context);
+        double elapsed = now_ns() - start;
+        if (elapsed >= MIN_SAMPLE_NS || iterations >= (1L << 30)) break;
+        iterations *= elapsed > 0 ? (long)fmin(1000.0, fmax(2.0, 1.5 * MIN_SAMPLE_NS / elapsed)) : 1000;
+    }
+    for (int w = 1; w < bench->warmups; w++) {
+        for (long i = 0; i < iterations; i++) body(context);
+    }
+
+    double samples[256];
+    int repetitions = bench->repetitions < 256 ? bench->repetitions : 256;
+    for (int r = 0; r < repetitions; r++) {
+        double start = now_ns();
+        for (long i = 0; i < iterations; i++) body(context);
+        samples[r] = (now_ns() - start) / iterations;
+    }
+    qsort(samples, repetitions, sizeof(double), compare_doubles);
+
+    BenchResult *result = &bench->results[bench->num_results++];
+    memset(result, 0, sizeof(*result));
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->median_ns = percentile(samples, repetitions, 0.5);
+    result->p95_ns = percentile(samples, repetitions, 0.95);
+    result->items_per_second = items > 0 ? items * 1e9 / result->median_ns : 0.0;
+    result->repetitions = repetitions;
+    printf("%-48s median %12.0f ns  p95 %12.0f ns", result->name, result->median_ns, result->p95_ns);
+    if (items > 0) printf("  %12.4g items/s", result->items_per_second);
+    printf("\n");
+    fflush(stdout);
+    return result;
+}
+
+// Kernel benchmarks share one network, batch and set of workspaces
+typedef struct {
+    NeuralNetwork nn;
+    BatchWorkspace batch_ws;
+    JetWorkspace jet_ws;
+    const PdeOperator *op;
+    LossParameters params;
+    Optimizer optimizer;
+    double *inputs;
+    double *outputs;
+    int batch;
+} KernelContext;
+
+static void body_forward_pass(void *context) {
+    KernelContext *k = context;
+    int in = nn_input_size(&k->nn);
+    for (int s = 0; s < k->batch; s++) {
+        forward_pass(&k->nn, k->inputs + (size_t)s * in, k->outputs, TANH);
+    }
+}
+
+static void body_forward_pass_batch(void *context) {
+    KernelContext *k = context;
+    forward_pass_batch(&k->nn, &k->batch_ws, k->inputs, k->batch, k->outputs, TANH);
+}
+
+static void body_forward_pass_jet(void *context) {
+    KernelContext *k = context;
+    forward_pass_jet(&k->nn, &k->jet_ws, k->inputs, k->batch, TANH);
+}
+
+static void body_backward_pass_jet(void *context) {
+    KernelContext *k = context;
+    backward_pass_jet(&k->nn, &k->jet_ws, k->batch, TANH, k->nn.gradients);
+}
+
+static void body_residual(void *context) {
+    KernelContext *k = context;
+    JetBatch jets;
+    clear_jet_adjoints(&k->nn, &k->jet_ws, k->batch);
+    jet_output_batch(&k->nn, &k->jet_ws, 1, &jets);
+    k->op->residual(&jets, 0, k->batch, &k->params, 1.0 / k->batch, NULL);
+}
+
+// One training step's worth of jet work: sweep, residual and reverse sweep
+static void body_jet_step(void *context) {
+    KernelContext *k = context;
+    body_forward_pass_jet(k);
+    body_residual(k);
+    body_backward_pass_jet(k);
+}
+
+static void body_optimizer_step(void *context) {
+    KernelContext *k = context;
+    double loss = 0.0;
+    optimizer_step(&k->optimizer, k->nn.parameters, k->nn.gradients, &loss, 1e-9, NULL, NULL);
+}
+
+// encoding NULL: the plain network (layers[0] is then the input count)
+static int init_kernel_context(KernelContext *k, const int *layers, int num_layers, int batch, int derivative_order, Precision precision, const EncodingConfig *encoding) {
+    memset(k, 0, sizeof(*k));
+    k->batch = batch;
+    k->params = (LossParameters){.potential = 0.3, .charge_density = 1.0, .current_density = 0.5, .thermal_conductivity = 0.5, .wave_speed = 1.0, .viscosity = 0.01};
+    if (encoding) {
+        if (!allocate_encoded_network(&k->nn, layers, num_layers, encoding, NULL)) return 0;
+        init_parameters(&k->nn, INIT_XAVIER, RNG_DEFAULT_SEED, 0);
+    } else if (!initialize_neural_network(&k->nn, layers, num_layers)) {
+        return 0;
+    }
+    if (!init_batch_workspace(&k->batch_ws, &k->nn, batch) ||
+        !init_jet_workspace(&k->jet_ws, &k->nn, batch, derivative_order, precision)) {
+        return 0;
+    }
+    int in = nn_input_size(&k->nn);
+    k->inputs = malloc((size_t)batch * in * sizeof(double));
+    k->outputs = malloc((size_t)batch * nn_output_size(&k->nn) * sizeof(double));
+    if (!k->inputs || !k->outputs) return 0;
+    for (int i = 0; i < batch * in; i++) {
+        k->inputs[i] = 0.5 + 0.5 * sin(0.37 * i);
+    }
+    for (size_t p = 0; p < k->nn.num_parameters; p++) {
+        k->nn.gradients[p] = 1e-3 * cos((double)p);
+    }
+    return 1;
+}
+
+static void free_kernel_context(KernelContext *k) {
+    free(k->inputs);
+    free(k->outputs);
+    free_jet_workspace(&k->jet_ws);
+    free_batch_workspace(&k->batch_ws);
+    free_neural_network(&k->nn);
+}
+
+static void kernel_benchmarks(Bench *bench) {
+    const int widths[3] = {32, 64, 128};
+    const int batches[2] = {256, 1024};
+    const int num_widths = bench->quick ? 2 : 3;
+    char name[96];
+
+    for (int w = 0; w < num_widths; w++) {
+        for (int b = 0; b < 2; b++) {
+            int width = widths[w], batch = batches[b];
+            int layers[4] = {2, width, width, 3};
+            KernelContext k;
+            if (!init_kernel_context(&k, layers, 4, batch, 2, PRECISION_FP64, NULL)) {
+                free_kernel_context(&k);
+                continue;
+            }
+            snprintf(name, sizeof(name), "forward_pass/w%d/b%d", width, batch);
+            run_benchmark(bench, name, body_forward_pass, &k, batch);
+            snprintf(name, sizeof(name), "forward_pass_batch/w%d/b%d", width, batch);
+            run_benchmark(bench, name, body_forward_pass_batch, &k, batch);
+            snprintf(name, sizeof(name), "forward_pass_jet/w%d/b%d", width, batch);
+            run_benchmark(bench, name, body_forward_pass_jet, &k, batch);
+            snprintf(name, sizeof(name), "backward_pass_jet/w%d/b%d", width, batch);
+            run_benchmark(bench, name, body_backward_pass_jet, &k, batch);
+            free_kernel_context(&k);
+        }
+    }
+
+    // Residual kernels on the output jets of a 64-wide network
+    for (int i = 0; i < pde_operator_count(); i++) {
+        const PdeOperator *op = pde_operator_at(i);
+        for (int b = 0; b < 2; b++) {
+            int layers[4] = {op->min_inputs, 64, 64, op->num_outputs};
+            KernelContext k;
+            if (!init_kernel_context(&k, layers, 4, batches[b], op->derivative_order, PRECISION_FP64, NULL)) {
+                free_kernel_context(&k);
+                continue;
+            }
+            k.op = op;
+            forward_pass_jet(&k.nn, &k.jet_ws, k.inputs, k.batch, TANH);
+            snprintf(name, sizeof(name), "residual/%s/b%d", op->name, batches[b]);
+            run_benchmark(bench, name, body_residual, &k, batches[b]);
+            free_kernel_context(&k);
+        }
+    }
+
+    // Parameter updates over the flat buffer
+    for (int w = 0; w < num_widths; w++) {
+        int layers[5] = {2, widths[w], widths[w], widths[w], 3};
+        for (OptimizerType type = OPTIMIZER_SGD; type <= OPTIMIZER_ADAMW; type++) {
+            KernelContext k;
+            OptimizerConfig config;
+            default_optimizer_config(&config, type);
+            if (!init_kernel_context(&k, layers, 5, 1, 1, PRECISION_FP64, NULL) || !optimizer_init(&k.optimizer, &config, k.nn.num_parameters)) {
+                free_kernel_context(&k);
+                continue;
+            }
+            snprintf(name, sizeof(name), "update/%s/w%d", k.optimizer.method->name, widths[w]);
+            run_benchmark(bench, name, body_optimizer_step, &k, (double)k.nn.num_parameters);
+            optimizer_free(&k.optimizer);
+            free_kernel_context(&k);
+        }
+    }
+}
+
+// Gradients of the heat residual loss left in nn.gradients by one body_jet_step
+static void jet_step_gradients(KernelContext *k) {
+    memset(k->nn.gradients, 0, k->nn.num_parameters * sizeof(double));
+    body_jet_step(k);
+}
+
+// The fp64 jet step against the mixed (float) one on identical weights and points; the error
+// columns say what the speedup costs
+static void precision_kernel_benchmarks(Bench *bench) {
+    const int widths[3] = {32, 64, 128};
+    const Precision precisions[2] = {PRECISION_FP64, PRECISION_MIXED};
+    const char *labels[2] = {"fp64", "mixed"};
+    const PdeOperator *op = find_pde_operator("heat");
+    const int batch = 1024;
+    char name[96];
+
+    for (int w = 0; w < (bench->quick ? 2 : 3); w++) {
+        int layers[4] = {op->min_inputs, widths[w], widths[w], op->num_outputs};
+        KernelContext k[2];
+        int ok = 1;
+        for (int p = 0; p < 2; p++) {
+            ok = init_kernel_context(&k[p], layers, 4, batch, op->derivative_order, precisions[p], NULL) && ok;
+            k[p].op = op;
+        }
+        if (ok) {
+            memcpy(k[1].nn.parameters, k[0].nn.parameters, k[0].nn.num_parameters * sizeof(double));
+            jet_step_gradients(&k[0]);
+            jet_step_gradients(&k[1]);
+            double jet_error = 0.0, gradient_error = 0.0, scale = 0.0;
+            size_t count = (size_t)batch * k[0].jet_ws.channels * op->num_outputs;
+            for (size_t i = 0; i < count; i++) {
+                jet_error = fmax(jet_error, fabs(k[0].jet_ws.jets[3][i] - k[1].jet_ws.jets[3][i]));
+            }
+            for (size_t i = 0; i < k[0].nn.num_parameters; i++) {
+                gradient_error = fmax(gradient_error, fabs(k[0].nn.gradients[i] - k[1].nn.gradients[i]));
+                scale = fmax(scale, fabs(k[0].nn.gradients[i]));
+            }
+            for (int p = 0; p < 2; p++) {
+                snprintf(name, sizeof(name), "precision/%s/jet_step/w%d/b%d", labels[p], widths[w], batch);
+                BenchResult *result = run_benchmark(bench, name, body_jet_step, &k[p], batch);
+                if (result && p > 0) {
+                    result->has_error = 1;
+                    result->jet_error = jet_error;
+                    result->gradient_error = scale > 0 ? gradient_error / scale : 0.0;
+                    printf("%-48s jet error %.3e  gradient error %.3e\n", "", result->jet_error, result->gradient_error);
+                }
+            }
+        }
+        free_kernel_context(&k[0]);
+        free_kernel_context(&k[1]);
+    }
+}
+
+// End-to-end training runs; each call includes setup, so epochs are kept large enough
+// to dominate it
+typedef struct {
+    const char *loss_type;
+    int layers[MAX_LAYERS];
+    int num_layers;
+    LossParameters params;
+    TrainingConfig config;
+} TrainingContext;
+
+static void body_training(void *context) {
+    TrainingContext *t = context;
+    NeuralNetwork nn;
+    if (initialize_neural_network(&nn, t->layers, t->num_layers)) {
+        train_neural_network(&nn, t->loss_type, &t->params, &t->config);
+        free_neural_network(&nn);
+    }
+}
+
+static void init_training_context(TrainingContext *t, const PdeOperator *op, int epochs, int threads) {
+    memset(t, 0, sizeof(*t));
+    t->loss_type = op->name;
+    t->num_layers = 4;
+    t->layers[0] = op->min_inputs;
+    t->layers[1] = 64;
+    t->layers[2] = 64;
+    t->layers[3] = op->num_outputs;
+    t->params = (LossParameters){.potential = 0.3, .charge_density = 1.0, .current_density = 0.5, .thermal_conductivity = 0.5, .wave_speed = 1.0, .viscosity = 0.01};
+    default_training_config(&t->config);
+    t->config.epochs = epochs;
+    t->config.log_every = epochs;
+    t->config.threads = threads;
+    t->config.interior_points = 1024;
+    t->config.boundary_points = 256;
+    t->config.initial_points = 256;
+}
+
+static void training_benchmarks(Bench *bench) {
+    int epochs = bench->quick ? 10 : 50;
+    char name[96];
+    for (int i = 0; i < pde_operator_count(); i++) {
+        TrainingContext t;
+        init_training_context(&t, pde_operator_at(i), epochs, 1);
+        int points = t.config.interior_points + t.config.boundary_points + t.config.initial_points;
+        snprintf(name, sizeof(name), "epochs/%s/%d", t.loss_type, epochs);
+        run_benchmark(bench, name, body_training, &t, (double)epochs * points);
+    }
+}
+
+// End-to-end heat runs in each precision mode
+static void precision_training_benchmarks(Bench *bench) {
+    const Precision precisions[3] = {PRECISION_FP64, PRECISION_MIXED, PRECISION_ROUNDED};
+    const char *labels[3] = {"fp64", "mixed", "rounded"};
+    int epochs = bench->quick ? 10 : 50;
+    char name[96];
+    for (int p = 0; p < 3; p++) {
+        TrainingContext t;
+        init_training_context(&t, find_pde_operator("heat"), epochs, 1);
+        t.config.precision = precisions[p];
+        int points = t.config.interior_points + t.config.boundary_points + t.config.initial_points;
+        snprintf(name, sizeof(name), "precision/%s/epochs/heat/%d", labels[p], epochs);
+        run_benchmark(bench, name, body_training, &t, (double)epochs * points);
+    }
+}
+
+static void body_inference(void *context) {
+    run_inference(context);
+}
+
+// `pinn infer` on a 2-D grid through a saved 64-wide model, result file included
+static void inference_benchmarks(Bench *bench) {
+    const int layers[4] = {2, 64, 64, 3};
+    int rows = bench->quick ? 256 : 1024;
+    char name[96];
+    NeuralNetwork nn;
+    if (!initialize_neural_network(&nn, layers, 4)) {
+        return;
+    }
+    int saved = save_model(&nn, "heat", TANH, "bench_model.ckpt");
+    free_neural_network(&nn);
+    if (!saved) {
+        return;
+    }
+
+    InferenceConfig config;
+    default_inference_config(&config);
+    config.model_path = "bench_model.ckpt";
+    config.output_path = "bench_inference.bin";
+    config.threads = 1;
+    config.resolution[0] = rows;
+    config.resolution[1] = 1024;
+    snprintf(name, sizeof(name), "infer/grid/w64/%dx1024", rows);
+    run_benchmark(bench, name, body_inference, &config, (double)rows * 1024);
+}
+
+// Eight heat models of one width: one lane-packed loss and gradient pass against the same
+// networks run one after another through the single-network jet path
+typedef struct {
+    EnsembleMember members[ENSEMBLE_LANES];
+    int num_members;
+    Ensemble ensemble;
+    JetWorkspace ws;
+    const PdeOperator *op;
+    CollocationBatch batch;
+    double *points;
+} EnsembleContext;
+
+static const double ensemble_weights[TERM_COUNT] = {1.0, 1.0, 1.0, 1.0};
+
+static void body_ensemble_packed(void *context) {
+    EnsembleContext *e = context;
+    ensemble_composite_loss(&e->ensemble, &e->batch, 1);
+}
+
+static void body_ensemble_sequential(void *context) {
+    EnsembleContext *e = context;
+    int n = collocation_batch_size(&e->batch);
+    for (int k = 0; k < e->num_members; k++) {
+        EnsembleMember *member = &e->members[k];
+        double sums[TERM_COUNT] = {0.0};
+        JetBatch jets;
+        forward_pass_jet(&member->nn, &e->ws, e->points, n, member->activation);
+        clear_jet_adjoints(&member->nn, &e->ws, n);
+        jet_output_batch(&member->nn, &e->ws, 1, &jets);
+        composite_loss_terms(&jets, &e->batch, 0, n, e->op, &member->params, ensemble_weights, sums);
+        memset(member->nn.gradients, 0, member->nn.num_parameters * sizeof(double));
+        backward_pass_jet(&member->nn, &e->ws, n, member->activation, member->nn.gradients);
+        member->loss = combine_loss_terms(sums, &e->batch, ensemble_weights, NULL);
+    }
+}
+
+static void ensemble_benchmarks(Bench *bench) {
+    const int widths[2] = {16, 32};
+    char name[96];
+    for (int w = 0; w < 2; w++) {
+        EnsembleContext e;
+        memset(&e, 0, sizeof(e));
+        e.op = find_pde_operator("heat");
+        e.batch = (CollocationBatch){NULL, 1024, 128, 128};
+        int n = collocation_batch_size(&e.batch);
+        int layers[4] = {2, widths[w], widths[w], 1};
+        e.points = malloc((size_t)n * 2 * sizeof(double));
+        int ready = e.points != NULL;
+        for (int i = 0; ready && i < 2 * n; i++) {
+            e.points[i] = 0.5 + 0.5 * sin(0.37 * i);
+        }
+        e.batch.points = e.points;
+        for (; ready && e.num_members < ENSEMBLE_LANES; e.num_members++) {
+            EnsembleMember *member = &e.members[e.num_members];
+            member->activation = TANH;
+            member->params.thermal_conductivity = 0.5;
+            if (!initialize_neural_network(&member->nn, layers, 4)) {
+                ready = 0;
+                break;
+            }
+        }
+        if (ready && ensemble_init(&e.ensemble, e.members, e.num_members, e.op, ensemble_weights, e.op->derivative_order, 1) &&
+            init_jet_workspace(&e.ws, &e.members[0].nn, n, e.op->derivative_order, PRECISION_FP64)) {
+            snprintf(name, sizeof(name), "ensemble/heat/w%d/packed%d", widths[w], ENSEMBLE_LANES);
+            run_benchmark(bench, name, body_ensemble_packed, &e, (double)ENSEMBLE_LANES * n);
+            snprintf(name, sizeof(name), "ensemble/heat/w%d/sequential%d", widths[w], ENSEMBLE_LANES);
+            run_benchmark(bench, name, body_ensemble_sequential, &e, (double)ENSEMBLE_LANES * n);
+        }
+        free_jet_workspace(&e.ws);
+        ensemble_free(&e.ensemble);
+        for (int k = 0; k < e.num_members; k++) free_neural_network(&e.members[k].nn);
+        free(e.points);
+    }
+}
+
+// Jet steps of a small heat network behind each input encoding, at the encodings' defaults
+static void encoding_benchmarks(Bench *bench) {
+    const EncodingType types[3] = {ENCODING_NONE, ENCODING_FOURIER, ENCODING_HASH_GRID};
+    const PdeOperator *op = find_pde_operator("heat");
+    int batch = 1024;
+    char name[96];
+    for (int e = 0; e < 3; e++) {
+        EncodingConfig config;
+        Encoding layout;
+        default_encoding_config(&config);
+        config.type = types[e];
+        config.input_dim = 2;
+        encoding_layout(&layout, &config);
+        int layers[4] = {layout.output_dim, 32, 32, 1};
+        KernelContext k;
+        if (init_kernel_context(&k, layers, 4, batch, op->derivative_order, PRECISION_FP64, &config)) {
+            k.op = op;
+            snprintf(name, sizeof(name), "encoding/heat/%s/jet_step", encoding_type_name(types[e]));
+            run_benchmark(bench, name, body_jet_step, &k, batch);
+        }
+        free_kernel_context(&k);
+    }
+}
+
+// Thread scaling of one end-to-end run: 1, 2, 4, ... up to the online cores
+static void scaling_benchmarks(Bench *bench) {
+    int epochs = bench->quick ? 10 : 50;
+    int cores = available_cores();
+    char name[96];
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > cores) threads = cores;
+        TrainingContext t;
+        init_training_context(&t, find_pde_operator("heat"), epochs, threads);
+        t.config.interior_points = 8192;
+        int points = t.config.interior_points + t.config.boundary_points + t.config.initial_points;
+        snprintf(name, sizeof(name), "scaling/heat/threads%d", threads);
+        run_benchmark(bench, name, body_training, &t, (double)epochs * points);
+        if (threads >= cores) break;
+    }
+}
+
+static int write_json(const Bench *bench, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot write %s\n", filename);
+        return 0;
+    }
+    fprintf(file, "{\n  \"cores\": %d,\n  \"warmups\": %d,\n  \"repetitions\": %d,\n  \"benchmarks\": [\n", available_cores(), bench->warmups, bench->repetitions);
+    for (int i = 0; i < bench->num_results; i++) {
+        const BenchResult *r = &bench->results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"median_ns\": %.1f, \"p95_ns\": %.1f, \"items_per_second\": %.6g, \"repetitions\": %d",
+                r->name, r->median_ns, r->p95_ns, r->items_per_second, r->repetitions);
+        if (r->has_error) {
+            fprintf(file, ", \"jet_error\": %.3e, \"gradient_error\": %.3e", r->jet_error, r->gradient_error);
+        }
+        fprintf(file, "}%s\n", i + 1 < bench->num_results ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    printf("Results written to %s\n", filename);
+    return 1;
+}
+
+// Reads the name/median pairs back out of a file written by write_json. Returns the
+// number of benchmarks that got slower than the threshold allows, or -1 on error.
+static int compare_baseline(const Bench *bench, const char *filename, double threshold) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot read baseline %s\n", filename);
+        return -1;
+    }
+    int regressions = 0, matched = 0;
+    char line[512];
+    printf("\nComparison against %s (threshold +%.0f%%):\n", filename, threshold * 100);
+    while (fgets(line, sizeof(line), file)) {
+        char name[96];
+        double median;
+        const char *field = strstr(line, "\"name\": \"");
+        const char *value = strstr(line, "\"median_ns\": ");
+        if (!field || !value || sscanf(field + 9, "%95[^\"]", name) != 1 || sscanf(value + 13, "%lf", &median) != 1) {
+            continue;
+        }
+        for (int i = 0; i < bench->num_results; i++) {
+            if (strcmp(bench->results[i].name, name) != 0) continue;
+            double change = bench->results[i].median_ns / median - 1.0;
+            int regressed = change > threshold;
+            printf("%-48s %+7.1f%%%s\n", name, 100 * change, regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+            matched++;
+        }
+    }
+    fclose(file);
+    printf("%d of %d benchmarks compared, %d regressions\n", matched, bench->num_results, regressions);
+    return regressions;
+}
+
+// Remove the scratch directory and the logs the training runs left in it
+static void remove_scratch(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        char file[4200];
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+            remove(file);
+        }
+        closedir(dir);
+    }
+    if (rmdir(path) != 0) {
+        fprintf(stderr, "Warning: Could not remove %s\n", path);
+    }
+}
+
+static void print_usage(void) {
+    printf("Usage: pinn_bench [--quick] [--filter substring] [--warmups N] [--repetitions N]\n");
+    printf("                  [--json results.json] [--baseline baseline.json] [--threshold 0.10]\n");
+    printf("Groups: forward_pass*, backward_pass_jet, residual/<pde>, update/<optimizer>, precision/<mode>,\n");
+    printf("        epochs/<pde>, infer/grid, scaling/heat\n");
+}
+
+int main(int argc, char *argv[]) {
+    Bench bench = {.warmups = 3, .repetitions = 15};
+    const char *json = NULL;
+    const char *baseline = NULL;
+    double threshold = 0.10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            bench.quick = 1;
+            bench.warmups = 1;
+            bench.repetitions = 5;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            bench.filter = argv[++i];
+        } else if (strcmp(argv[i], "--warmups") == 0 && i + 1 < argc) {
+            bench.warmups = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            bench.repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (bench.warmups < 1) bench.warmups = 1;
+    if (bench.repetitions < 1) bench.repetitions = 1;
+
+    // Training runs write their logs to the working directory; keep those out of the tree
+    char cwd[4096], scratch[] = "/tmp/pinn_bench_XXXXXX";
+    if (getcwd(cwd, sizeof(cwd)) == NULL || mkdtemp(scratch) == NULL || chdir(scratch) != 0) {
+        fprintf(stderr, "Error: Cannot create a scratch directory for training runs\n");
+        return EXIT_FAILURE;
+    }
+
+    kernel_benchmarks(&bench);
+    precision_kernel_benchmarks(&bench);
+    training_benchmarks(&bench);
+    precision_training_benchmarks(&bench);
+    inference_benchmarks(&bench);
+    ensemble_benchmarks(&bench);
+    encoding_benchmarks(&bench);
+    scaling_benchmarks(&bench);
+
+    if (chdir(cwd) != 0) {
+        fprintf(stderr, "Error: Cannot return to %s\n", cwd);
+        return EXIT_FAILURE;
+    }
+    remove_scratch(scratch);
+
+    if (json && !write_json(&bench, json)) {
+        return EXIT_FAILURE;
+    }
+    if (baseline) {
+        int regressions = compare_baseline(&bench, baseline, threshold);
+        if (regressions != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
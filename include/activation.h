@@ -0,0 +1,45 @@
+#ifndef ACTIVATION_H
+#define ACTIVATION_H
+
+#include <stddef.h>
+
+typedef enum {
+    RELU,
+    SIGMOID,
+    TANH,
+    LEAKY_RELU,
+    SIN,
+    SILU
+} ActivationFunction;
+
+// Accuracy of the transcendental kernels (exp, tanh, sigmoid, sin, SiLU). Both modes are
+// branch-free polynomial kernels that the compiler vectorizes; they differ in degree.
+//   ACTIVATION_ACCURATE: max abs error 4e-16 for tanh, sigmoid and SiLU / |x|, and
+//                        5e-16 for sin/cos with |x| <= 1e5 (double-precision training)
+//   ACTIVATION_FAST:     max abs error 2e-9 on the same ranges (ample for fp32 data)
+typedef enum {
+    ACTIVATION_ACCURATE,
+    ACTIVATION_FAST
+} ActivationMode;
+
+// Leakiness factor for LEAKY_RELU
+#define LEAKY_RELU_ALPHA 0.01
+
+int parse_activation_function(const char *name, ActivationFunction *function);
+const char *activation_function_name(ActivationFunction function);
+int parse_activation_mode(const char *name, ActivationMode *mode);
+void set_activation_mode(ActivationMode mode);
+ActivationMode get_activation_mode(void);
+
+double activate(double x, ActivationFunction function);
+void activation_derivatives(double z, ActivationFunction function, double *d1, double *d2, double *d3);
+
+// a[i] = f(z[i]) over a whole layer
+void activate_batch(const double *z, double *a, size_t count, ActivationFunction function);
+
+// One pass over the pre-activations producing f(z) and its first three derivatives;
+// any output may be NULL
+void activate_fused(const double *z, double *a, double *d1, double *d2, double *d3, size_t count, ActivationFunction function);
+void activate_fused_f32(const float *z, float *a, float *d1, float *d2, float *d3, size_t count, ActivationFunction function);
+
+#endif // ACTIVATION_H
@@ -0,0 +1,21 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h> // For size_t
+
+// Every allocation is rounded up to a whole cache line
+#define ARENA_ALIGNMENT 64
+
+typedef struct {
+    unsigned char *base;
+    size_t capacity;
+    size_t used;
+} Arena;
+
+size_t arena_aligned_size(size_t size);
+int arena_init(Arena *arena, size_t capacity);
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif // ARENA_H
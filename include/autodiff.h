@@ -0,0 +1,55 @@
+#ifndef AUTODIFF_H
+#define AUTODIFF_H
+
+#include "neural_network.h"
+#include "loss_functions.h"
+
+// Forward-mode (truncated Taylor) propagation of input derivatives through the network.
+// Every point carries 1 + 2 * input_dim channels per layer: the value, the first
+// derivative along each input and the diagonal second derivative along each input.
+// Operators that only need first derivatives use order 1 and skip the last input_dim rows.
+// All channels of a batch are stacked as rows, so each layer is still a single GEMM.
+// The workspace doubles as the reverse-mode tape: it keeps the pre-activation jets
+// and the adjoint buffers, all allocated once for the largest batch of the run.
+//
+// With a reduced precision the sweep itself runs in float on a float copy of the weights
+// (the *32 buffers); only the output-layer jets and adjoints also exist in double, so the
+// residual kernels and the gradients they feed are unchanged.
+typedef struct {
+    int capacity;                    // Maximum number of points per call
+    int input_dim;                   // Number of network inputs (D)
+    int derivative_order;            // 1 or 2
+    int channels;                    // 1 + order * D rows per point
+    Precision precision;
+    double *jets[MAX_LAYERS];        // [capacity][channels][layer_size] per layer, post-activation
+    double *pre[MAX_LAYERS];         // Pre-activation jets of the hidden layers
+    double *adjoints[MAX_LAYERS];    // d(loss)/d(jets[l]), same shapes
+    double *scratch;                 // Activation derivatives of one row of the widest layer
+    float *jets32[MAX_LAYERS];       // Reduced precision: float versions of the three above
+    float *pre32[MAX_LAYERS];
+    float *adjoints32[MAX_LAYERS];
+    float *scratch32;
+    float *weights32;                // Parameters rounded to float by every forward sweep, unless shared
+    int shared_weights32;            // weights32 is kept current by its owner (share_jet_weights)
+    float *gradients32;              // Weight gradients of one connection before widening
+    RowSet *touched;                 // Hash-grid rows the reverse sweeps wrote, if the owner tracks them
+    Arena arena;
+} JetWorkspace;
+
+int init_jet_workspace(JetWorkspace *ws, const NeuralNetwork *nn, int capacity, int derivative_order, Precision precision);
+void free_jet_workspace(JetWorkspace *ws);
+// Point the float sweeps of ws at a float copy of the parameters that the caller refreshes
+// with narrow_jet_weights whenever they change; forward_pass_jet then skips its own copy
+void share_jet_weights(JetWorkspace *ws, float *weights32);
+void narrow_jet_weights(const NeuralNetwork *nn, float *weights32);
+void forward_pass_jet(const NeuralNetwork *nn, JetWorkspace *ws, const double *inputs, int num_points, ActivationFunction activation_function);
+void jet_point_derivatives(const NeuralNetwork *nn, const JetWorkspace *ws, int point, PointDerivatives *pd);
+void clear_jet_adjoints(const NeuralNetwork *nn, JetWorkspace *ws, int num_points);
+void jet_point_adjoint(const NeuralNetwork *nn, JetWorkspace *ws, int point, double weight, PointAdjoint *adjoint);
+void jet_output_batch(const NeuralNetwork *nn, JetWorkspace *ws, int with_adjoints, JetBatch *batch);
+// fp64 chain rule through a hidden activation; ws->scratch must hold 3 * width values
+void activate_jets(JetWorkspace *ws, const double *pre, double *post, int num_points, int width, ActivationFunction activation_function);
+void activate_jets_adjoint(JetWorkspace *ws, const double *pre, double *adjoint, int num_points, int width, ActivationFunction activation_function);
+void backward_pass_jet(const NeuralNetwork *nn, JetWorkspace *ws, int num_points, ActivationFunction activation_function, double *gradients);
+
+#endif // AUTODIFF_H
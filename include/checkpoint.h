@@ -0,0 +1,60 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "neural_network.h"
+#include "sampler.h"
+
+// Binary checkpoint: a CheckpointHeader padded to 64 bytes, then the parameter buffer
+// exactly as it sits in memory (padded layer blocks), then the optimizer state, then the
+// refinement pool of the sampler. Every blob starts on a 64-byte boundary so the file can
+// be mapped and used in place. Numbers are stored in host byte order.
+#define CHECKPOINT_MAGIC "PINNCKPT"
+#define CHECKPOINT_VERSION 6
+#define CHECKPOINT_DTYPE_FP64 1
+
+// Training state carried across a restart alongside the parameters
+typedef struct {
+    int epoch;                          // Epochs already completed
+    ActivationFunction activation;
+    char loss_type[32];
+    SamplerState sampler;
+    uint32_t optimizer;                 // 0 = plain SGD, which keeps no state
+    const double *optimizer_state;      // optimizer_state_size doubles, or NULL
+    size_t optimizer_state_size;
+    const double *refinement_pool;      // sampler.pool_size points of the sampler's dims, or NULL
+    size_t refinement_pool_size;        // In values
+} CheckpointState;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;               // Offset of the first blob
+    uint32_t dtype;
+    uint32_t activation;
+    int32_t num_layers;
+    int32_t layer_sizes[MAX_LAYERS];
+    int32_t epoch;
+    char loss_type[32];
+    uint32_t optimizer;
+    uint32_t reserved;
+    uint64_t num_parameters;            // Padded length of the parameter blob, in values
+    uint64_t parameters_offset;
+    uint64_t optimizer_offset;
+    uint64_t optimizer_size;            // In values
+    uint64_t pool_offset;
+    uint64_t pool_size;                 // In values
+    uint64_t file_size;
+    SamplerState sampler;
+    EncodingConfig encoding;            // Input encoding; layer_sizes[0] is its output width
+    ParameterInputs parameter_inputs;   // Trailing inputs that are equation parameters (count 0: none)
+    uint64_t checksum;                  // FNV-1a over the header (with checksum zero) and every blob
+} CheckpointHeader;
+
+int save_checkpoint(const NeuralNetwork *nn, const CheckpointState *state, const char *filename);
+int load_checkpoint(NeuralNetwork *nn, const char *filename, CheckpointState *state);
+int save_model(const NeuralNetwork *nn, const char *loss_type, ActivationFunction activation, const char *filename);
+int load_model(NeuralNetwork *nn, const char *filename, ActivationFunction *activation);
+
+#endif // CHECKPOINT_H
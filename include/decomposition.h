@@ -0,0 +1,60 @@
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+#include "neural_network.h"
+#include "autodiff.h"
+#include "training.h"
+
+#define DECOMPOSITION_MAX_SUBDOMAINS 64
+#define DECOMPOSITION_MAX_INTERFACES 256
+
+// Continuity and flux mismatches of the interface terms
+typedef enum {
+    INTERFACE_CONTINUITY,
+    INTERFACE_FLUX,
+    INTERFACE_TERM_COUNT
+} InterfaceTerm;
+
+// Subdomain layout read from a --decomposition file. The boxes tile the training domain
+// without overlapping; overlap only widens where each subdomain samples its interior.
+typedef struct {
+    int num_subdomains;
+    Domain boxes[DECOMPOSITION_MAX_SUBDOMAINS];
+    int layer_sizes[DECOMPOSITION_MAX_SUBDOMAINS][MAX_LAYERS];
+    int num_layers[DECOMPOSITION_MAX_SUBDOMAINS];   // 0 = the --layers spec
+    double overlap;                     // Fraction of a box's width sampled inside each neighbour
+    int exchange_every;                 // Epochs trained between interface exchanges
+    int interface_points;               // Points per interface, redrawn at every exchange
+    double weights[INTERFACE_TERM_COUNT];
+} DecompositionConfig;
+
+// A face shared by two boxes: box a lies below it along axis, box b above it.
+// face spans the shared part of the other axes and is flat along axis.
+typedef struct {
+    int a;
+    int b;
+    int axis;
+    Domain face;
+} InterfaceFace;
+
+void default_decomposition_config(DecompositionConfig *config);
+// Reads "subdomain lo:hi,... [layers]", "overlap f", "exchange_every n",
+// "interface_points n", "interface_weight w" and "flux_weight w" lines ('#' starts a comment)
+int parse_decomposition(const char *path, DecompositionConfig *config);
+// Checks that the boxes tile domain exactly; returns 0 with a message otherwise
+int validate_decomposition(const DecompositionConfig *config, const Domain *domain);
+// Every pair of boxes sharing a face of positive area; returns the count or -1 if more than capacity
+int find_interfaces(const DecompositionConfig *config, InterfaceFace *faces, int capacity);
+
+// Interface terms of one side, added to sums (indexed by InterfaceTerm): squared distance of
+// the first `outputs` values, and of their derivatives along axis, from targets laid out as
+// [point][values..., derivatives...]. With jets->adjoints set, weights[t] * d(term)/d(jets)
+// is accumulated.
+void interface_loss_terms(const JetBatch *jets, int count, const double *targets, int axis, int outputs, const double *weights, double *sums);
+
+// Train one network per box, concurrently, coupled through interface terms whose targets
+// (the average of both sides) are refreshed every exchange_every epochs. nets[k] belongs to
+// box k. Returns 0 if training could not start.
+int train_decomposition(NeuralNetwork *nets, const DecompositionConfig *decomposition, const char *loss_type, const LossParameters *params, const TrainingConfig *config);
+
+#endif // DECOMPOSITION_H
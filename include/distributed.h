@@ -0,0 +1,60 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Multi-process data parallelism on one machine: `pinn --ranks N` forks N training
+// processes, each pinned to its own slice of the CPUs, that sweep their shard of every
+// batch and sum their results with an allreduce. The trainer only talks to a Communicator;
+// the transport behind it is a CommTransport, so a socket transport can be added later
+// without touching the trainer. POSIX shared memory is the one transport so far.
+#define DISTRIBUTED_MAX_RANKS 64
+
+typedef struct Communicator Communicator;
+
+typedef struct {
+    const char *name;
+    // Sum count doubles of data across the ranks, in place. Every rank must call it with the
+    // same count, and every rank ends with the same bits.
+    void (*allreduce)(Communicator *comm, double *data, size_t count);
+    void (*barrier)(Communicator *comm);
+    void (*free)(Communicator *comm);
+} CommTransport;
+
+// What one rank did, kept where the launcher can read it after the rank has exited
+typedef struct {
+    int node;                           // NUMA node of the rank's CPUs (-1 when unknown)
+    char cpus[48];                      // The CPU list it was pinned to, e.g. "0-15"
+    double train_seconds;
+    double allreduce_seconds;           // Includes waiting for the slowest rank
+    uint64_t allreduce_calls;
+    uint64_t allreduce_bytes;           // Ring traffic: 2 (N - 1) / N of each message, per rank
+} RankStats;
+
+struct Communicator {
+    const CommTransport *transport;
+    int rank;
+    int num_ranks;
+    size_t capacity;                    // Largest allreduce, in doubles
+    RankStats totals;                   // This rank's numbers, published to stats[rank] when it finishes
+    RankStats *stats;                   // [num_ranks], visible to every process
+    void *shared;                       // Transport state
+    size_t shared_size;
+};
+
+// Create the shared-memory transport for num_ranks ranks and messages of up to capacity
+// doubles. Call before forking; every rank then calls comm_attach with its index.
+int comm_init_shared_memory(Communicator *comm, int num_ranks, size_t capacity);
+void comm_attach(Communicator *comm, int rank);
+void comm_allreduce(Communicator *comm, double *data, size_t count);
+void comm_barrier(Communicator *comm);
+void comm_free(Communicator *comm);
+
+// Fork comm->num_ranks processes that each pin themselves, attach and run rank_main, then
+// wait for all of them and print the per-rank timing and allreduce bandwidth. A rank that
+// fails takes the others down with it. Returns 1 when every rank_main returned 1.
+typedef int (*RankMain)(Communicator *comm, void *context);
+int launch_ranks(Communicator *comm, RankMain rank_main, void *context);
+
+#endif // DISTRIBUTED_H
@@ -0,0 +1,78 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rng.h"
+#include "row_set.h"
+
+// Highest raw input dimension an encoding accepts (matches SAMPLER_MAX_DIMS)
+#define ENCODING_MAX_INPUTS 10
+// Interpolation touches 2^input_dim vertices, so the hash grid is kept to low dimensions
+#define HASH_GRID_MAX_INPUTS 4
+#define HASH_GRID_MAX_LEVELS 24
+#define HASH_GRID_MAX_FEATURES 8
+
+typedef enum {
+    ENCODING_NONE,
+    ENCODING_FOURIER,                   // Random Fourier features, fixed frequencies
+    ENCODING_HASH_GRID                  // Multiresolution hash grid, trainable feature tables
+} EncodingType;
+
+// Input encoding in front of the first dense layer. Coordinates are first mapped from
+// [lower, upper] to the unit cube; the encoded vector is those unit coordinates followed
+// by the features. Stored as is in checkpoints, so every field has a fixed width.
+typedef struct {
+    int32_t type;                       // EncodingType
+    int32_t input_dim;                  // Raw coordinates (space..., time)
+    int32_t frequencies;                // Fourier: sin/cos pairs
+    int32_t levels;                     // Hash grid: resolutions
+    int32_t features;                   // Hash grid: features per level
+    int32_t log2_table_size;            // Hash grid: entries per level are at most 2^this
+    int32_t base_resolution;            // Hash grid: cells per axis of the coarsest level
+    int32_t reserved;
+    double scale;                       // Fourier: standard deviation of the frequencies, in cycles per unit
+    double growth;                      // Hash grid: resolution factor between levels
+    uint64_t seed;                      // Fourier: frequency draw
+    double lower[ENCODING_MAX_INPUTS];
+    double upper[ENCODING_MAX_INPUTS];
+} EncodingConfig;
+
+// A laid-out encoding. Hash tables are [level][entry][feature] and live in the network's
+// parameter buffer; coarse levels with at most 2^log2_table_size vertices are stored densely
+// and only the finer ones are hashed.
+typedef struct {
+    EncodingConfig config;
+    int output_dim;                     // input_dim + encoded features
+    double inverse_width[ENCODING_MAX_INPUTS];
+    double *frequencies;                // Fourier: [frequencies][input_dim] in radians per input unit
+    size_t num_constants;               // Doubles behind frequencies
+    int resolution[HASH_GRID_MAX_LEVELS];
+    int dense[HASH_GRID_MAX_LEVELS];
+    size_t level_offset[HASH_GRID_MAX_LEVELS]; // First entry of each level
+    size_t level_entries[HASH_GRID_MAX_LEVELS];
+    size_t num_parameters;              // Trainable doubles (the hash tables)
+} Encoding;
+
+void default_encoding_config(EncodingConfig *config);
+int parse_encoding_type(const char *name, EncodingType *type);
+const char *encoding_type_name(EncodingType type);
+
+// Work out widths and table sizes; returns 0 with a message for an invalid config
+int encoding_layout(Encoding *encoding, const EncodingConfig *config);
+// Fill the fixed data (num_constants doubles at constants) from the config's seed
+void encoding_bind(Encoding *encoding, double *constants);
+// Table entries from U(-1e-4, 1e-4), words [position, position + num_parameters) of rng
+void encoding_init_tables(const Encoding *encoding, double *tables, const Rng *rng, uint64_t position);
+
+// Encoded values only: out[num_points][output_dim]
+void encode_points(const Encoding *encoding, const double *tables, const double *inputs, int num_points, double *out);
+// Encoded jets: value, d/dx_i and (order 2) d2/dx_i^2 of every feature, laid out like
+// layer jets: [point][1 + order * input_dim][output_dim]
+void encode_jets(const Encoding *encoding, const double *tables, const double *inputs, int num_points, int order, double *jets);
+// Add d(loss)/d(tables) given d(loss)/d(jets). The coordinates are read back from the unit
+// coordinates at the front of every value row of jets. touched, if non-NULL, gets every row
+// ([level][entry], features wide) that received a gradient.
+void encode_jets_adjoint(const Encoding *encoding, const double *jets, const double *adjoints, int num_points, int order, double *table_gradients, RowSet *touched);
+
+#endif // ENCODING_H
@@ -0,0 +1,77 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "neural_network.h"
+#include "autodiff.h"
+#include "thread_pool.h"
+#include "training.h"
+
+// Models advanced together by one vector instruction: 8 doubles fill an AVX-512 register
+// (two AVX2 ones). Members are packed into lane groups of this many.
+#define ENSEMBLE_LANES 8
+#define ENSEMBLE_MAX_MEMBERS 64
+#define ENSEMBLE_MAX_SWEEPS 8
+
+// Points per packed sweep. Lanes make every tape row 8x wider, so chunks are kept small
+// enough for a layer of widened jets to stay in L2.
+#define ENSEMBLE_CHUNK 64
+
+// One independently trained network of the ensemble. Every member has the same layer
+// sizes; its parameters stay in the usual NeuralNetwork layout between epochs.
+typedef struct {
+    NeuralNetwork nn;
+    LossParameters params;
+    double learning_rate;
+    ActivationFunction activation;
+    double terms[TERM_COUNT];           // Term sums of the last pass (see combine_loss_terms)
+    double loss;                        // Composite loss of the last pass
+    double validation_loss;
+} EnsembleMember;
+
+// Members [first, first + count) packed lane by lane: parameter p of lane m sits at
+// packed[p * ENSEMBLE_LANES + m], and the jets are [point][channel][unit][lane]. Unused
+// lanes hold zero weights. A group shares one activation function.
+typedef struct {
+    int first;
+    int count;
+    ActivationFunction activation;
+    double *packed;
+    double *packed_gradients;
+    JetWorkspace ws;                    // Widened tape; only the fp64 fields are used
+    double *lane_jets;                  // One member's output jets of a chunk, unpacked
+    double *lane_adjoints;
+} LaneGroup;
+
+typedef struct {
+    EnsembleMember *members;
+    int num_members;
+    const NeuralNetwork *shape;         // Layer sizes and offsets shared by every member
+    const PdeOperator *op;
+    double weights[TERM_COUNT];
+    LaneGroup *groups;
+    int num_groups;
+    ThreadPool pool;
+    int num_workers;
+    Arena arena;
+
+    const CollocationBatch *batch;      // Current job
+    int with_gradients;
+} Ensemble;
+
+// Lane groups are formed greedily in member order, so members sharing an activation
+// should be adjacent
+int ensemble_init(Ensemble *ensemble, EnsembleMember *members, int num_members, const PdeOperator *op, const double *weights, int derivative_order, int threads);
+void ensemble_free(Ensemble *ensemble);
+// Composite loss of every member on one shared batch; with_gradients also fills each
+// member's nn.gradients
+void ensemble_composite_loss(Ensemble *ensemble, const CollocationBatch *batch, int with_gradients);
+
+// Members for the cartesian product of sweeps ("name=v1,v2,..." over learning_rate,
+// activation or a LossParameters field), each repeated `replicas` times; the first sweep
+// varies slowest. Copies base for everything not swept (nn is left for the caller).
+// Returns the member count or -1.
+int expand_ensemble_sweeps(const char **specs, int num_specs, int replicas, const EnsembleMember *base, EnsembleMember *members);
+// Returns 0 if training could not start
+int train_ensemble(EnsembleMember *members, int num_members, const char *loss_type, const TrainingConfig *config);
+
+#endif // ENSEMBLE_H
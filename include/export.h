@@ -0,0 +1,31 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include "neural_network.h"
+#include "sampler.h"
+
+// `pinn export-c`: a trained model as standalone C. <base>.h declares
+// <name>_forward(input, output) and a batch wrapper; <base>.c holds the weights as
+// static const 64-byte-aligned arrays and one function with every layer size, the input
+// stage and the activation compiled in. <base>_test.c compares the kernel against
+// forward_pass outputs recorded at export time and reports its latency.
+typedef struct {
+    const char *model_path;             // Checkpoint or saved model
+    const char *output_base;            // Path prefix of the generated files
+    const char *name;                   // Symbol prefix (NULL: the file name of output_base)
+    int unroll_limit;                   // Layers with at most this many weights become straight-line code
+    int test_points;                    // Points recorded for the self-test
+    double tolerance;                   // Self-test bound on |out - ref| / (1 + |ref|)
+    Domain domain;                      // Self-test coordinates (dims == 0: the unit box)
+} ExportConfig;
+
+void default_export_config(ExportConfig *config);
+// Generate the three files for a loaded network; returns 0 with a message on failure
+int export_c_network(NeuralNetwork *nn, ActivationFunction activation, const ExportConfig *config);
+// Load config->model_path and export it
+int export_c_model(const ExportConfig *config);
+// The activate(x) definition written into <base>.c, with the activation.c kernels it calls
+void export_activation_source(FILE *file, ActivationFunction activation);
+
+#endif // EXPORT_H
@@ -0,0 +1,24 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+// Dense row-major matrix kernels used by the batched forward/backward passes.
+// When accumulate is 0 the destination is overwritten, otherwise it is added to.
+
+// C[m][n] (+)= A[m][k] * B[k][n]
+void gemm_nn(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc, int accumulate);
+
+// C[m][n] (+)= A[m][k] * B[n][k]^T
+void gemm_nt(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc, int accumulate);
+
+// C[m][n] (+)= A[k][m]^T * B[k][n]
+void gemm_tn(int m, int n, int k, const double *A, int lda, const double *B, int ldb, double *C, int ldc, int accumulate);
+
+// Single-precision versions of the same kernels, for the mixed and rounded precision modes
+void gemm_nn_f32(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc, int accumulate);
+void gemm_nt_f32(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc, int accumulate);
+void gemm_tn_f32(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc, int accumulate);
+
+// Name of the instruction set the kernels were compiled for ("avx512", "avx2" or "scalar")
+const char *gemm_isa(void);
+
+#endif // GEMM_H
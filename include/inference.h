@@ -0,0 +1,52 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include <stdint.h>
+#include "neural_network.h"
+#include "sampler.h"
+#include "parametric.h"
+
+// Result file written by `pinn infer`: an InferenceHeader padded to 64 bytes, then the
+// network outputs as a row-major [num_points][output_dim] array of dtype values. Grid
+// results are stored with the last axis varying fastest. Numbers are in host byte order,
+// so the data can be mapped directly (e.g. numpy.memmap at data_offset).
+#define INFERENCE_MAGIC "PINNINFR"
+#define INFERENCE_VERSION 1
+#define INFERENCE_DTYPE_FP64 1
+#define INFERENCE_DTYPE_FP32 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;               // Offset of the data
+    uint32_t dtype;
+    uint32_t input_dim;
+    uint32_t output_dim;
+    uint32_t grid_dims;                 // 0 when the points came from a file
+    uint64_t num_points;
+    uint64_t data_offset;
+    uint64_t resolution[SAMPLER_MAX_DIMS]; // Grid points per axis, endpoints included
+    double lower[SAMPLER_MAX_DIMS];
+    double upper[SAMPLER_MAX_DIMS];
+} InferenceHeader;
+
+typedef struct {
+    const char *model_path;             // Checkpoint or saved model
+    const char *output_path;
+    const char *points_path;            // Raw float64 [N][input_dim] points, or NULL for the grid
+    Domain grid;                        // dims == 0 selects the unit box (and the trained parameter ranges)
+    int resolution[SAMPLER_MAX_DIMS];   // Grid points per axis
+    int threads;                        // 0 = every online core
+    int tile;                           // Points per batched forward pass
+    uint32_t dtype;                     // INFERENCE_DTYPE_FP64 or INFERENCE_DTYPE_FP32
+    int num_fixed;                      // Parameter axes of the grid pinned to a single value
+    LossParameterField fixed_fields[PARAMETRIC_MAX_INPUTS];
+    double fixed_values[PARAMETRIC_MAX_INPUTS];
+} InferenceConfig;
+
+void default_inference_config(InferenceConfig *config);
+// "N" or "N1,N2,..." (one count per axis); returns the number of counts or -1
+int parse_grid_resolution(const char *spec, int resolution[SAMPLER_MAX_DIMS]);
+int run_inference(const InferenceConfig *config);
+
+#endif // INFERENCE_H
@@ -0,0 +1,74 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Records the ring holds before the trainer has to wait for the writer (power of two)
+#define LOG_RING_CAPACITY 4096
+
+// Binary logs start with this magic and a LogFileHeader, followed by raw LogRecords
+#define LOG_MAGIC "PINNLOG1"
+
+typedef enum {
+    LOG_TEXT,       // "Epoch %d: Loss:  %.5f, Validation Loss: %.5f", read by visualization.py
+    LOG_CSV,
+    LOG_BINARY
+} LogFormat;
+
+typedef struct {
+    int32_t epoch;
+    int32_t validation_epoch;           // Epoch the validation loss was measured at (-1 before the first pass)
+    double loss;
+    double validation_loss;
+    double learning_rate;
+} LogRecord;
+
+typedef struct {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+} LogFileHeader;
+
+// Single-producer/single-consumer ring: the training thread appends records without
+// locking and a background writer drains them into a large stdio buffer. head and tail
+// live on separate cache lines so the two threads never share one. A writer that finds
+// the ring empty sleeps on wake; the trainer only takes the lock to signal it when it
+// has announced that it is asleep. A group of logs (one per ensemble member or subdomain)
+// shares the writer thread of its first log, which drains every ring in the group.
+typedef struct TrainingLogger TrainingLogger;
+struct TrainingLogger {
+    _Alignas(64) atomic_size_t head;    // Next slot the trainer fills
+    _Alignas(64) atomic_size_t tail;    // Next slot the writer drains
+    _Alignas(64) atomic_int stop;       // The fields up to group_size are used in the writer's log only
+    atomic_int sleeping;                // The writer is waiting (or about to wait) on wake
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    TrainingLogger *group;              // The logs this writer drains
+    int group_size;
+    TrainingLogger *writer;             // The log whose thread drains this one
+    LogRecord *records;                 // LOG_RING_CAPACITY slots
+    LogFormat format;
+    int every;                          // Log every N-th epoch (the last one is always logged)
+    FILE *file;
+    char *buffer;
+    pthread_t thread;
+    char run[192];                      // <loss>[_N], which also names the run's profile report
+    char path[256];
+};
+
+int parse_log_format(const char *name, LogFormat *format);
+int next_run_number(const char *directory, const char *loss_type);
+int logger_open(TrainingLogger *logger, const char *loss_type, LogFormat format, int every);
+// Opens count logs with consecutive run numbers, drained by a single writer thread
+int logger_open_group(TrainingLogger *loggers, int count, const char *loss_type, LogFormat format, int every);
+int logger_wants_epoch(const TrainingLogger *logger, int epoch, int num_epochs);
+void logger_record(TrainingLogger *logger, int epoch, double loss, double validation_loss, int validation_epoch, double learning_rate);
+void logger_close(TrainingLogger *logger);
+void logger_close_group(TrainingLogger *loggers, int count);
+// Profiling builds write profile_<loss>[_N].json for the run of an opened log (nothing otherwise)
+void logger_write_profile(const TrainingLogger *logger, int trace);
+
+#endif // LOGGER_H
@@ -0,0 +1,53 @@
+#ifndef LOSS_BALANCE_H
+#define LOSS_BALANCE_H
+
+// Weights of the composite-loss terms. The trainer minimises sum_i w_i * mean_i over the
+// terms below; adaptive methods re-derive the weights from per-term gradient statistics
+// every update_every epochs, so their cost is one extra sweep per term every K epochs.
+typedef enum {
+    TERM_RESIDUAL,                      // PDE residual at the interior points
+    TERM_BOUNDARY,                      // Dirichlet mismatch on the spatial boundary
+    TERM_INITIAL,                       // Mismatch at t = 0 (and du/dt for second order in time)
+    TERM_CONSERVATION,                  // Conservation-law residual at the interior points
+    TERM_COUNT
+} LossTerm;
+
+typedef enum {
+    WEIGHTING_FIXED,                    // Keep the configured weights
+    WEIGHTING_ANNEALING,                // Learning-rate annealing: match gradient magnitudes to the residual's
+    WEIGHTING_GRADNORM                  // GradNorm: equalise weighted gradient norms, favouring slow terms
+} WeightingMethod;
+
+typedef struct {
+    WeightingMethod method;
+    double weights[TERM_COUNT];         // Fixed weights, and the starting point of adaptive ones
+    int update_every;                   // Epochs between weight updates (K)
+    double smoothing;                   // Share of each new estimate in the running weights
+    double gradnorm_alpha;              // GradNorm's restoring-force exponent
+} LossWeightingConfig;
+
+// Unweighted mean of one term and statistics of its parameter gradient
+typedef struct {
+    double loss;
+    double norm;                        // L2 norm
+    double max_abs;
+    double mean_abs;
+} TermGradientStats;
+
+typedef struct {
+    LossWeightingConfig config;
+    int active[TERM_COUNT];             // Terms present in this problem
+    double weights[TERM_COUNT];         // Current weights; 0 for inactive terms
+    double initial_losses[TERM_COUNT];  // Term losses at the first update (GradNorm's baseline)
+    int updates;
+} LossBalancer;
+
+int parse_loss_weighting(const char *name, WeightingMethod *method);
+const char *loss_term_name(LossTerm term);
+void default_loss_weighting_config(LossWeightingConfig *config);
+void loss_balancer_init(LossBalancer *balancer, const LossWeightingConfig *config, const int active[TERM_COUNT]);
+int loss_balancer_due(const LossBalancer *balancer, int epoch, int first_epoch);
+// New weights from the statistics of every active term; returns 1 if they changed
+int loss_balancer_update(LossBalancer *balancer, const TermGradientStats stats[TERM_COUNT]);
+
+#endif // LOSS_BALANCE_H
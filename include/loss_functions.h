@@ -2,6 +2,7 @@
 #define LOSS_FUNCTIONS_H
 
 #include <math.h>
+#include <stddef.h>
 
 // Constants
 #define ELECTRON_MASS 9.10938356e-31 // Electron mass (kg)
@@ -16,8 +17,65 @@
 #define RHO 1.225 // Density of air at sea level (kg/m^3)
 #define EPSILON 1e-10 // Small value to prevent division by zero
 
-// Normalization factor for losses (can be adjusted per equation for scale)
-#define NORMALIZATION_FACTOR 1.0e-10
+typedef struct {
+    double potential;
+    double charge_density;
+    double current_density;
+    double thermal_conductivity;
+    double wave_speed;
+    double viscosity;
+} LossParameters;
+
+// Exact derivatives of the network outputs at one point, as produced by forward-mode AD.
+// Inputs are ordered (x, [y,] t): the last input is time, the rest are spatial.
+typedef struct {
+    int input_dim;
+    int output_dim;
+    const double *u;    // u[k]
+    const double *du;   // du[i * output_dim + k] = d u_k / d x_i
+    const double *d2u;  // d2u[i * output_dim + k] = d^2 u_k / d x_i^2
+} PointDerivatives;
+
+static inline double pd_value(const PointDerivatives *pd, int k) { return pd->u[k]; }
+static inline double pd_first(const PointDerivatives *pd, int i, int k) { return pd->du[i * pd->output_dim + k]; }
+static inline double pd_second(const PointDerivatives *pd, int i, int k) { return pd->d2u[i * pd->output_dim + k]; }
+
+// Where a loss accumulates weight * d(loss)/d(u, du, d2u); same layouts as PointDerivatives
+typedef struct {
+    double weight;
+    double *u;
+    double *du;
+    double *d2u;
+} PointAdjoint;
+
+// Output jets of a run of consecutive points as left by the forward-mode sweep: point p
+// starts at jets + p * stride with the value row, then input_dim first-derivative rows,
+// then (at derivative order 2) input_dim second-derivative rows
+typedef struct {
+    int input_dim;
+    int output_dim;
+    int derivative_order;
+    size_t stride;
+    const double *jets;
+    double *adjoints;   // Same layout; NULL for a loss-only pass
+} JetBatch;
+
+static inline void jet_batch_point(const JetBatch *batch, int p, PointDerivatives *pd) {
+    const double *jet = batch->jets + p * batch->stride;
+    pd->input_dim = batch->input_dim;
+    pd->output_dim = batch->output_dim;
+    pd->u = jet;
+    pd->du = jet + batch->output_dim;
+    pd->d2u = batch->derivative_order > 1 ? jet + (size_t)(1 + batch->input_dim) * batch->output_dim : NULL;
+}
+
+static inline void jet_batch_adjoint(const JetBatch *batch, int p, double weight, PointAdjoint *adjoint) {
+    double *jet = batch->adjoints + p * batch->stride;
+    adjoint->weight = weight;
+    adjoint->u = jet;
+    adjoint->du = jet + batch->output_dim;
+    adjoint->d2u = batch->derivative_order > 1 ? jet + (size_t)(1 + batch->input_dim) * batch->output_dim : NULL;
+}
 
 // Function declarations
 double schrodinger_equation_loss(double psi, double psi_target, double potential, double time_step);
@@ -30,4 +88,28 @@ double initial_condition_loss(double value, double initial_value);
 double conservation_of_mass_loss(double divergence_velocity, double mass_source);
 double adaptive_normalization(double *losses, int num_losses);
 
+// Squared PDE residuals built from exact network derivatives (nondimensional units).
+// When adjoint is non-NULL, weight * d(loss)/d(derivatives) is added to it.
+double schrodinger_residual_loss(const PointDerivatives *pd, double potential, PointAdjoint *adjoint);
+double maxwell_residual_loss(const PointDerivatives *pd, double charge_density, double current_density, PointAdjoint *adjoint);
+double heat_residual_loss(const PointDerivatives *pd, double thermal_diffusivity, PointAdjoint *adjoint);
+double wave_residual_loss(const PointDerivatives *pd, double wave_speed, PointAdjoint *adjoint);
+double navier_stokes_residual_loss(const PointDerivatives *pd, double viscosity, PointAdjoint *adjoint);
+
+// Squared conservation-law residuals (continuity equations), same conventions
+double navier_stokes_conservation_loss(const PointDerivatives *pd, PointAdjoint *adjoint);
+double schrodinger_conservation_loss(const PointDerivatives *pd, PointAdjoint *adjoint);
+
+// Boundary/initial terms: squared mismatch of the first count outputs (or their time derivatives)
+double dirichlet_residual_loss(const PointDerivatives *pd, const double *target, int count, PointAdjoint *adjoint);
+double initial_velocity_residual_loss(const PointDerivatives *pd, const double *target, int count, PointAdjoint *adjoint);
+
+// Closed-form solutions on the unit box, used for boundary and initial values.
+// u must have room for the 2 (Schrödinger), 3 (Maxwell, Navier-Stokes) or 1 (heat, wave) fields written.
+void schrodinger_reference_solution(const double *x, int input_dim, double potential, double *u);
+void maxwell_reference_solution(const double *x, int input_dim, double charge_density, double current_density, double *u);
+void heat_reference_solution(const double *x, int input_dim, double thermal_diffusivity, double *u);
+void wave_reference_solution(const double *x, int input_dim, double wave_speed, double *u);
+void navier_stokes_reference_solution(const double *x, int input_dim, double viscosity, double *u);
+
 #endif // LOSS_FUNCTIONS_H
\ No newline at end of file
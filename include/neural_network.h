@@ -1,39 +1,104 @@
 #ifndef NEURAL_NETWORK_H
 #define NEURAL_NETWORK_H
 
-// Define sizes
+#include <stddef.h> // For size_t
+#include <stdint.h>
+#include "arena.h"
+#include "activation.h"
+#include "loss_functions.h"
+#include "encoding.h"
+#include "parametric.h"
+
+// Default sizes, used when no --layers spec is given
 #define INPUT_SIZE 2
 #define HIDDEN_SIZE 5
 #define OUTPUT_SIZE 3  // Moved to header for global availability
 
+// Upper bound on the number of layer sizes in a spec (input + hidden + output)
+#define MAX_LAYERS 16
+
+// Arithmetic of the jet sweeps. Master parameters, optimizer state, residuals and the
+// gradient reduction stay double in every mode.
+typedef enum {
+    PRECISION_FP64,
+    PRECISION_MIXED,                    // float matmuls and activations, double everything else
+    PRECISION_ROUNDED                   // As mixed, and the double master copy is rounded to float values after each update
+} Precision;
+
+// Weight initialization. Xavier (Glorot) and He draw U(-a, a) weights with
+// a = sqrt(6 / (fan_in + fan_out)) and sqrt(6 / fan_in) and zero the biases; uniform draws
+// every weight and bias from U(-1, 1).
+typedef enum {
+    INIT_XAVIER,
+    INIT_HE,
+    INIT_UNIFORM
+} InitScheme;
+
 typedef struct {
-    double weights_input_hidden[INPUT_SIZE][HIDDEN_SIZE];
-    double weights_hidden_output[HIDDEN_SIZE][OUTPUT_SIZE];
-    double biases_hidden[HIDDEN_SIZE];
-    double biases_output[OUTPUT_SIZE];
-    double hidden_outputs[HIDDEN_SIZE]; // Add this line to store hidden outputs
+    int num_layers;                     // Number of entries in layer_sizes
+    int layer_sizes[MAX_LAYERS];        // e.g. {3, 128, 128, 128, 1}; [0] is the encoded width
+    Encoding encoding;                  // In front of layer 0 (ENCODING_NONE: the raw inputs)
+    ParameterInputs parameter_inputs;   // Trailing inputs that are equation parameters, not coordinates
+    size_t encoding_offset;             // Offset of the encoding's trainable tables in parameters
+    size_t weight_offsets[MAX_LAYERS];  // Offset of W[l] ([in][out], row-major) in parameters
+    size_t bias_offsets[MAX_LAYERS];    // Offset of b[l] in parameters
+    size_t num_parameters;              // Length of the padded parameter buffer
+    double *parameters;                 // Every weight and bias, contiguous and 64-byte aligned
+    double *gradients;                  // Same layout as parameters
+    double *activations[MAX_LAYERS];    // Per-layer outputs of the last forward_pass
+    Arena arena;                        // Owns all of the buffers above (parameters unless mapped)
+    void *mapping;                      // Checkpoint mapped by load_model, or NULL
+    size_t mapping_size;
 } NeuralNetwork;
 
+// Scratch space for batched passes: one [capacity][layer_size] block per layer
 typedef struct {
-    double potential;
-    double charge_density;
-    double current_density;
-    double thermal_conductivity;
-    double wave_speed;
-    double viscosity;
-} LossParameters;
-
-typedef enum {
-    RELU,
-    SIGMOID,
-    TANH,
-    LEAKY_RELU
-} ActivationFunction;
+    int capacity;                       // Maximum number of rows per batch call
+    double *activations[MAX_LAYERS];    // Layer outputs kept for the backward pass
+    double *deltas[MAX_LAYERS];         // Backward error terms, same shapes
+    double *slopes[MAX_LAYERS];         // f'(z) of the hidden layers, saved by the forward pass
+    Arena arena;
+} BatchWorkspace;
 
-void initialize_neural_network(NeuralNetwork *nn);
+int parse_layer_spec(const char *spec, int layer_sizes[MAX_LAYERS]);
+int parse_precision(const char *name, Precision *precision);
+int parse_init_scheme(const char *name, InitScheme *scheme);
+// He for the ReLU family, Xavier otherwise
+InitScheme default_init_scheme(ActivationFunction activation);
+int allocate_neural_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers, double *parameters);
+// As allocate_neural_network with an input encoding (NULL or ENCODING_NONE: none);
+// layer_sizes[0] must be the encoding's output width
+int allocate_encoded_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers, const EncodingConfig *encoding, double *parameters);
+// Make the last inputs->count inputs of an unencoded network equation parameters; at least
+// one space and the time input must remain
+int set_parameter_inputs(NeuralNetwork *nn, const ParameterInputs *inputs);
+// Every value comes from substream `substream` of the seed's init stream, addressed by its
+// offset in the parameter buffer, so the result does not depend on the order of the draws
+void init_parameters(NeuralNetwork *nn, InitScheme scheme, uint64_t seed, uint32_t substream);
+// allocate_neural_network plus Xavier initialization from the default seed
+int initialize_neural_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers);
+void free_neural_network(NeuralNetwork *nn);
 int validate_neural_network_initialization(const NeuralNetwork *nn);
-void forward_pass(NeuralNetwork *nn, double input[INPUT_SIZE], double output[OUTPUT_SIZE], ActivationFunction activation_function);
-void train_neural_network(NeuralNetwork *nn, const char *loss_type, const LossParameters *params, int epochs, double learning_rate, const char *activation_function);
-void save_model(const NeuralNetwork *nn, const char *filename);
+void forward_pass(NeuralNetwork *nn, const double *input, double *output, ActivationFunction activation_function);
+int init_batch_workspace(BatchWorkspace *ws, const NeuralNetwork *nn, int capacity);
+void free_batch_workspace(BatchWorkspace *ws);
+void forward_pass_batch(const NeuralNetwork *nn, BatchWorkspace *ws, const double *inputs, int num_samples, double *outputs, ActivationFunction activation_function);
+void backward_pass_batch(const NeuralNetwork *nn, BatchWorkspace *ws, const double *output_gradients, int num_samples, ActivationFunction activation_function, double *gradients);
+
+// Accessors into the flat parameter/gradient buffers for connection l (layer l -> l + 1)
+static inline int nn_input_size(const NeuralNetwork *nn) {
+    return nn->encoding.config.type != ENCODING_NONE ? nn->encoding.config.input_dim : nn->layer_sizes[0];
+}
+static inline int nn_encoded(const NeuralNetwork *nn) { return nn->encoding.config.type != ENCODING_NONE; }
+// Inputs that are (space..., time) coordinates, the only directions the jets differentiate along
+static inline int nn_coordinate_inputs(const NeuralNetwork *nn) { return nn_input_size(nn) - nn->parameter_inputs.count; }
+static inline int nn_parametric(const NeuralNetwork *nn) { return nn->parameter_inputs.count > 0; }
+static inline double *nn_encoding_tables(const NeuralNetwork *nn) { return nn->parameters + nn->encoding_offset; }
+static inline double *nn_encoding_gradients(const NeuralNetwork *nn) { return nn->gradients + nn->encoding_offset; }
+static inline int nn_output_size(const NeuralNetwork *nn) { return nn->layer_sizes[nn->num_layers - 1]; }
+static inline double *nn_weights(const NeuralNetwork *nn, int l) { return nn->parameters + nn->weight_offsets[l]; }
+static inline double *nn_biases(const NeuralNetwork *nn, int l) { return nn->parameters + nn->bias_offsets[l]; }
+static inline double *nn_weight_gradients(const NeuralNetwork *nn, int l) { return nn->gradients + nn->weight_offsets[l]; }
+static inline double *nn_bias_gradients(const NeuralNetwork *nn, int l) { return nn->gradients + nn->bias_offsets[l]; }
 
-#endif // NEURAL_NETWORK_H
\ No newline at end of file
+#endif // NEURAL_NETWORK_H
@@ -0,0 +1,104 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "row_set.h"
+
+// Values in checkpoint headers; SGD must stay 0 so older checkpoints resume as SGD
+typedef enum {
+    OPTIMIZER_SGD = 0,
+    OPTIMIZER_ADAM = 1,
+    OPTIMIZER_ADAMW = 2,
+    OPTIMIZER_LBFGS = 3
+} OptimizerType;
+
+typedef enum {
+    SCHEDULE_INVERSE,                   // lr / (1 + decay * epoch), the historical default
+    SCHEDULE_CONSTANT,
+    SCHEDULE_COSINE,                    // Half cosine from lr down to min_rate at the last epoch
+    SCHEDULE_STEP                       // lr * gamma^(epoch / step_size)
+} ScheduleType;
+
+// Learning rate as a function of the epoch; the first warmup_epochs ramp up linearly
+typedef struct {
+    ScheduleType type;
+    double base_rate;
+    double decay;                       // SCHEDULE_INVERSE
+    double min_rate;                    // SCHEDULE_COSINE
+    int step_size;                      // SCHEDULE_STEP
+    double gamma;
+    int warmup_epochs;
+    int total_epochs;
+} LearningRateSchedule;
+
+typedef struct {
+    OptimizerType type;
+    double beta1;                       // Adam moment decay rates
+    double beta2;
+    double epsilon;
+    double weight_decay;                // Coupled L2 for Adam, decoupled for AdamW
+    int history;                        // L-BFGS correction pairs kept
+    int max_line_search;                // Objective evaluations per L-BFGS step
+} OptimizerConfig;
+
+// Re-evaluates the loss at the current parameters and writes its gradient. L-BFGS calls
+// it during the line search, so it must evaluate the same (full) batch every time.
+typedef double (*OptimizerObjective)(void *context, double *gradients);
+
+typedef struct Optimizer Optimizer;
+
+// One optimization method. step starts from the loss and gradient at the current
+// parameters and moves the parameters in place; it returns the step length it took and
+// leaves the loss and gradient at the new parameters in *loss and gradients when it
+// had to evaluate them (full_batch methods).
+typedef struct {
+    const char *name;
+    OptimizerType type;
+    int full_batch;                     // Needs a fixed batch and an objective callback
+    size_t (*state_size)(const OptimizerConfig *config, size_t num_parameters);
+    double (*step)(Optimizer *opt, double *parameters, double *gradients, double *loss, double learning_rate, OptimizerObjective objective, void *context);
+} OptimizerMethod;
+
+// Everything that must survive a restart lives in state[0 .. state_size), a single
+// 64-byte-aligned block saved verbatim in checkpoints. Slot 0 counts steps; the rest of
+// the first cache line is method bookkeeping. Scratch that can be rebuilt is kept apart.
+struct Optimizer {
+    const OptimizerMethod *method;
+    OptimizerConfig config;
+    size_t num_parameters;
+    double *state;
+    size_t state_size;                  // In doubles
+    double *scratch;
+    Arena arena;
+    // Lazy rows: with sparse set, the parameters from sparse_offset on are rows of
+    // sparse_width and only the rows it lists have a gradient. SGD and Adam(W) step just
+    // those; the other rows keep their values, moments and weight decay until touched.
+    // Full-batch methods ignore it and need the whole gradient.
+    const RowSet *sparse;
+    size_t sparse_offset;
+    int sparse_width;
+};
+
+#define OPTIMIZER_HEADER_SLOTS 8
+
+// Strong-Wolfe constants of the L-BFGS line search (sufficient decrease, curvature)
+#define WOLFE_C1 1e-4
+#define WOLFE_C2 0.9
+
+int parse_optimizer(const char *name, OptimizerType *type);
+int parse_schedule(const char *name, ScheduleType *type);
+void default_optimizer_config(OptimizerConfig *config, OptimizerType type);
+void default_learning_rate_schedule(LearningRateSchedule *schedule, double base_rate, int total_epochs);
+double schedule_learning_rate(const LearningRateSchedule *schedule, int epoch);
+
+const OptimizerMethod *find_optimizer_method(OptimizerType type);
+int optimizer_init(Optimizer *opt, const OptimizerConfig *config, size_t num_parameters);
+void optimizer_free(Optimizer *opt);
+void optimizer_reset(Optimizer *opt);
+int optimizer_restore_state(Optimizer *opt, OptimizerType type, const double *state, size_t state_size);
+// Returns the step taken: learning_rate for SGD and Adam(W), and for L-BFGS the accepted
+// line-search step (0 when the search failed). Logs record the scheduled rate instead.
+double optimizer_step(Optimizer *opt, double *parameters, double *gradients, double *loss, double learning_rate, OptimizerObjective objective, void *context);
+
+#endif // OPTIMIZER_H
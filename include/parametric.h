@@ -0,0 +1,57 @@
+#ifndef PARAMETRIC_H
+#define PARAMETRIC_H
+
+#include <stdint.h>
+#include "loss_functions.h"
+#include "rng.h"
+
+// One slot per LossParameters field
+#define PARAMETRIC_MAX_INPUTS 6
+
+typedef enum {
+    LOSS_PARAMETER_POTENTIAL,
+    LOSS_PARAMETER_CHARGE_DENSITY,
+    LOSS_PARAMETER_CURRENT_DENSITY,
+    LOSS_PARAMETER_THERMAL_CONDUCTIVITY,
+    LOSS_PARAMETER_WAVE_SPEED,
+    LOSS_PARAMETER_VISCOSITY
+} LossParameterField;
+
+// Equation parameters taken as extra network inputs after (space..., time), in this order.
+// Training draws them uniformly from [lower, upper]; the network maps each to [-1, 1] before
+// its first layer, so inputs stay raw parameter values everywhere else. Stored as is in
+// checkpoints, so every field has a fixed width.
+typedef struct {
+    int32_t count;
+    int32_t fields[PARAMETRIC_MAX_INPUTS]; // LossParameterField
+    double lower[PARAMETRIC_MAX_INPUTS];
+    double upper[PARAMETRIC_MAX_INPUTS];
+} ParameterInputs;
+
+int parse_loss_parameter(const char *name, LossParameterField *field);
+const char *loss_parameter_name(LossParameterField field);
+double *loss_parameter(LossParameters *params, LossParameterField field);
+
+// "name=value" for one LossParameters field
+int parse_parameter_value(const char *spec, LossParameterField *field, double *value);
+// Append "name=lo:hi"; returns 0 with a message for an unknown, repeated or empty range
+int add_parameter_input(ParameterInputs *inputs, const char *spec);
+// Index of field among the inputs, or -1
+int find_parameter_input(const ParameterInputs *inputs, LossParameterField field);
+
+// The network-side value of raw parameter input k
+static inline double scaled_parameter_input(const ParameterInputs *inputs, int k, double value) {
+    return 2.0 * (value - inputs->lower[k]) / (inputs->upper[k] - inputs->lower[k]) - 1.0;
+}
+
+// Scale the trailing inputs->count columns of rows[count][width] in place
+void scale_parameter_columns(const ParameterInputs *inputs, double *rows, int count, int width);
+
+// base with the fields of the inputs replaced by values[0 .. count)
+void point_loss_parameters(const ParameterInputs *inputs, const LossParameters *base, const double *values, LossParameters *params);
+
+// Copy points[count][dims] to out[count][dims + inputs->count], appending parameter values
+// drawn uniformly from their ranges, words [position, position + count * inputs->count) of rng
+void append_parameter_inputs(const ParameterInputs *inputs, const Rng *rng, uint64_t position, const double *points, int count, int dims, double *out);
+
+#endif // PARAMETRIC_H
@@ -0,0 +1,38 @@
+#ifndef PDE_H
+#define PDE_H
+
+#include "loss_functions.h"
+
+// Room for the registry; the built-in operators take the first few slots
+#define PDE_MAX_OPERATORS 32
+
+// Largest number of fields a reference solution may write
+#define PDE_MAX_OUTPUTS 8
+
+// Sum of squared residuals over points [begin, end) of a jet batch. With jets->adjoints
+// non-NULL, weight * d(residual)/d(jets) is accumulated for every point; with residuals
+// non-NULL, the residual of point p is stored in residuals[p - begin].
+typedef double (*PdeResidualKernel)(const JetBatch *jets, int begin, int end, const LossParameters *params, double weight, double *residuals);
+
+// Closed-form solution used for the boundary and initial values
+typedef void (*PdeReferenceSolution)(const double *x, int input_dim, const LossParameters *params, double *u);
+
+// Everything the trainer needs to know about an equation. Resolved by name once per run.
+typedef struct {
+    const char *name;
+    int num_outputs;                    // Network outputs the residual and boundary terms read
+    int min_inputs;                     // Supported input counts, time included
+    int max_inputs;
+    int derivative_order;               // 1: values and gradients, 2: also d2u/dx_i^2
+    int second_order_in_time;           // Also pin du/dt at t = 0 (to zero)
+    PdeResidualKernel residual;
+    PdeReferenceSolution reference;
+    PdeResidualKernel conservation;     // Conservation-law residual on interior points, or NULL
+} PdeOperator;
+
+const PdeOperator *find_pde_operator(const char *name);
+int register_pde_operator(const PdeOperator *op);
+int pde_operator_count(void);
+const PdeOperator *pde_operator_at(int index);
+
+#endif // PDE_H
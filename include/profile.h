@@ -0,0 +1,83 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// Hot-path instrumentation. Build with `make PROFILE=1` (which defines PINN_PROFILE) to
+// enable it; otherwise every macro below expands to nothing and costs nothing.
+//
+// Timers read the TSC on x86-64 (calibrated against CLOCK_MONOTONIC) and clock_gettime
+// elsewhere. Each thread records into its own slot, found through a thread-local pointer,
+// so instrumented code never takes a lock; slots are only merged when a report is written.
+
+typedef enum {
+    PROF_EPOCH,
+    PROF_SAMPLER,                       // Waiting for the next collocation batch
+    PROF_FORWARD,                       // Forward sweeps (plain and jet)
+    PROF_LOSS,                          // Residual and boundary/initial terms
+    PROF_BACKWARD,                      // Reverse sweeps
+    PROF_REDUCE,                        // Gradient reduction across workers
+    PROF_ALLREDUCE,                     // Gradient exchange between ranks (pinn --ranks)
+    PROF_OPTIMIZER,
+    PROF_VALIDATION,
+    PROF_REFINE,
+    PROF_BALANCE,                       // Per-term gradient sweeps for adaptive loss weights
+    PROF_LOG,                           // Handing records to the log writer
+    PROF_CHECKPOINT,
+    PROF_PHASE_COUNT
+} ProfilePhase;
+
+typedef enum {
+    PROF_FLOPS,                         // Multiply-adds count as two
+    PROF_POINTS,                        // Points pushed through a forward sweep
+    PROF_BYTES_LOGGED,
+    PROF_ALLOCATIONS,
+    PROF_ALLOCATED_BYTES,
+    PROF_COUNTER_COUNT
+} ProfileCounter;
+
+// Forget everything recorded so far; call while no other thread is recording
+void profile_reset(void);
+
+#ifdef PINN_PROFILE
+
+uint64_t profile_begin(void);
+void profile_end(ProfilePhase phase, uint64_t start);
+void profile_count(ProfileCounter counter, uint64_t amount);
+
+typedef struct {
+    ProfilePhase phase;
+    uint64_t start;
+} ProfileScope;
+
+static inline void profile_scope_exit(ProfileScope *scope) {
+    profile_end(scope->phase, scope->start);
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Times the rest of the enclosing block
+#define PROFILE_SCOPE(phase) \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__) __attribute__((cleanup(profile_scope_exit))) = {(phase), profile_begin()}
+
+// Times an explicit region: PROFILE_BEGIN(t); ...; PROFILE_END(PROF_X, t);
+#define PROFILE_BEGIN(name) uint64_t name = profile_begin()
+#define PROFILE_END(phase, name) profile_end((phase), (name))
+#define PROFILE_COUNT(counter, amount) profile_count((counter), (uint64_t)(amount))
+
+#else
+
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END(phase, name) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)sizeof(amount))
+
+#endif
+
+// Writes <base>.json with per-thread and total time and calls per phase plus the counters,
+// and <base>.trace.json (Chrome's trace-event format) when trace is set. Returns 1 if
+// anything was written; without PINN_PROFILE it does nothing and returns 0.
+int profile_write_report(const char *base, int trace);
+
+#endif // PROFILE_H
@@ -0,0 +1,48 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Seed used when no --seed is given
+#define RNG_DEFAULT_SEED 0x5EED5EEDULL
+
+// Counter-based generator (Philox4x32-10). A value is a pure function of (seed, stream,
+// substream, position), so every consumer owns an independent stream, and any thread
+// can produce any range of one without sharing state, taking a lock or stepping through
+// the values before it.
+typedef enum {
+    RNG_STREAM_INIT,                    // Weight initialization
+    RNG_STREAM_SAMPLING,                // Collocation points, strata shuffles and pool draws
+    RNG_STREAM_CANDIDATES,              // Refinement candidates and other uniform draws
+    RNG_STREAM_SCRAMBLE,                // Digital shifts of the Sobol sequences
+    RNG_STREAM_ENCODING,                // Fourier feature frequencies
+    RNG_STREAM_PARAMETERS               // Equation parameters of parametric batches
+} RngStreamId;
+
+// A position in one substream, with the last Philox block kept for the second half of it
+typedef struct {
+    uint32_t key[2];
+    uint32_t stream;
+    uint32_t substream;
+    uint64_t position;                  // Index of the next 64-bit word
+    uint64_t block;                     // Block held in cache (UINT64_MAX: none)
+    uint64_t cache[2];
+} Rng;
+
+void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+
+void rng_init(Rng *rng, uint64_t seed, RngStreamId stream, uint32_t substream);
+// Word `position` of the substream; does not move rng
+uint64_t rng_at(const Rng *rng, uint64_t position);
+// Continue from word `position` (restoring a saved generator)
+void rng_seek(Rng *rng, uint64_t position);
+uint64_t rng_next(Rng *rng);
+// Uniform in [0, 1) with 53 random bits
+double rng_next_uniform(Rng *rng);
+// Uniform integer in [0, bound)
+uint64_t rng_next_below(Rng *rng, uint64_t bound);
+// count uniforms in [lower, upper) from words [position, position + count)
+void rng_fill_uniform(const Rng *rng, uint64_t position, double *out, size_t count, double lower, double upper);
+
+#endif // RNG_H
@@ -0,0 +1,36 @@
+#ifndef ROW_SET_H
+#define ROW_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The rows of a parameter block that a gradient sweep wrote, so the hash-grid tables can be
+// cleared, reduced and stepped row by row instead of in full. marks has one byte per row.
+// The rows are split into num_buckets ranges of bucket_size, and bucket b lists the marked
+// rows of its range (in the order they were first marked) at rows + b * bucket_size, so a
+// reduction can hand each worker one bucket of every set.
+typedef struct {
+    unsigned char *marks;
+    uint32_t *rows;
+    size_t *counts;                     // [num_buckets]
+    size_t bucket_size;
+    int num_buckets;
+} RowSet;
+
+static inline void row_set_add(RowSet *set, size_t row) {
+    if (!set->marks[row]) {
+        size_t bucket = row / set->bucket_size;
+        set->marks[row] = 1;
+        set->rows[bucket * set->bucket_size + set->counts[bucket]++] = (uint32_t)row;
+    }
+}
+
+static inline size_t row_set_count(const RowSet *set) {
+    size_t count = 0;
+    for (int b = 0; b < set->num_buckets; b++) {
+        count += set->counts[b];
+    }
+    return count;
+}
+
+#endif // ROW_SET_H
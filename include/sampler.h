@@ -0,0 +1,113 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "arena.h"
+#include "rng.h"
+
+// Highest input dimension the Sobol direction-number table covers
+#define SAMPLER_MAX_DIMS 10
+
+typedef enum {
+    SAMPLE_UNIFORM,
+    SAMPLE_LATIN_HYPERCUBE,
+    SAMPLE_SOBOL
+} SamplingMethod;
+
+// Axis-aligned space-time box; the last axis is time
+typedef struct {
+    int dims;
+    double lower[SAMPLER_MAX_DIMS];
+    double upper[SAMPLER_MAX_DIMS];
+} Domain;
+
+// One training batch laid out back to back: interior points, then boundary, then initial
+typedef struct {
+    double *points;
+    int num_interior;
+    int num_boundary;
+    int num_initial;
+} CollocationBatch;
+
+// Scrambled Sobol sequence (Gray-code order with a random digital shift). The 32-bit direction
+// numbers give one pass of 2^32 - 1 points; index counts on across passes, and each pass
+// restarts the sequence under its own shift.
+typedef struct {
+    int dims;
+    uint32_t substream;                 // Of the scramble stream, with seed
+    uint64_t seed;
+    uint64_t index;
+    uint32_t state[SAMPLER_MAX_DIMS];
+    uint32_t shift[SAMPLER_MAX_DIMS];
+    uint32_t directions[SAMPLER_MAX_DIMS][32];
+} SobolSequence;
+
+// Seed and generator positions that let a resumed run continue its point streams
+typedef struct {
+    uint64_t seed;
+    uint64_t rng_position;
+    uint64_t candidate_position;
+    uint64_t interior_index;
+    uint64_t surface_index;
+    uint32_t interior_state[SAMPLER_MAX_DIMS];
+    uint32_t surface_state[SAMPLER_MAX_DIMS];
+    uint32_t pool_size;                 // Points in the refinement pool, stored next to the state
+    uint32_t reserved;
+} SamplerState;
+
+typedef struct {
+    Domain domain;
+    SamplingMethod method;
+    int num_interior;
+    int num_boundary;
+    int num_initial;
+    uint64_t seed;
+    Rng rng;                             // Owned by whichever thread fills batches
+    Rng candidate_rng;                   // Owned by the trainer (refinement candidates and pool draws)
+    SobolSequence interior_sequence;
+    SobolSequence surface_sequence;      // Boundary faces and the t = 0 slice share one (dims - 1) sequence
+    int *strata;                         // Latin-hypercube permutation scratch
+    double *scratch;                     // Unit coordinates of boundary/initial points
+
+    // Residual-based adaptive refinement: a pool of high-residual interior points that
+    // replaces refinement_fraction of every fresh interior set
+    pthread_mutex_t pool_lock;
+    double *pool;
+    int pool_size;
+    int pool_capacity;
+    double refinement_fraction;
+
+    // Double-buffered batches; a background thread refills the back buffer while the
+    // trainer consumes the front one
+    Arena arena;
+    CollocationBatch buffers[2];
+    int front;
+    int back_ready;
+    int refill_pending;
+    int stop;
+    int background;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Sampler;
+
+int parse_sampling_method(const char *name, SamplingMethod *method);
+int parse_domain(const char *spec, Domain *domain);
+void unit_domain(Domain *domain, int dims);
+
+int sampler_init(Sampler *sampler, const Domain *domain, SamplingMethod method, int num_interior, int num_boundary, int num_initial, uint64_t seed, int background);
+void sampler_free(Sampler *sampler);
+const CollocationBatch *sampler_next_batch(Sampler *sampler);
+void sampler_fill_batch(Sampler *sampler, CollocationBatch *batch);
+void sampler_uniform_points(Sampler *sampler, double *points, int count);
+void sampler_save_state(Sampler *sampler, SamplerState *state);
+// pool holds state->pool_size points of the refinement pool (NULL: start with an empty pool)
+void sampler_restore_state(Sampler *sampler, const SamplerState *state, const double *pool);
+void sampler_refine(Sampler *sampler, const double *candidates, const double *residuals, int num_candidates);
+
+static inline int collocation_batch_size(const CollocationBatch *batch) {
+    return batch->num_interior + batch->num_boundary + batch->num_initial;
+}
+
+#endif // SAMPLER_H
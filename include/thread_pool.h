@@ -0,0 +1,29 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+// Work item run by every worker; worker is in [0, num_workers)
+typedef void (*ThreadTask)(void *context, int worker, int num_workers);
+
+// Persistent pool of pthreads. The calling thread acts as worker 0, so a pool of
+// num_threads == 1 runs tasks inline without any synchronisation.
+typedef struct {
+    int num_threads;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    ThreadTask task;
+    void *context;
+    unsigned long generation;
+    int pending;
+    int stop;
+} ThreadPool;
+
+int thread_pool_init(ThreadPool *pool, int num_threads);
+void thread_pool_run(ThreadPool *pool, ThreadTask task, void *context);
+void thread_pool_free(ThreadPool *pool);
+int available_cores(void);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,41 @@
+#ifndef TIME_MARCHING_H
+#define TIME_MARCHING_H
+
+#include "neural_network.h"
+#include "autodiff.h"
+#include "training.h"
+
+#define TIME_MARCHING_MAX_WINDOWS 64
+#define CAUSAL_MAX_SLICES 64
+
+// Causal time marching: [t0, T] is cut into windows trained one after another. Window k
+// starts from the weights of window k - 1 and takes its initial condition from that
+// network's prediction at the window start. Inside a window the residual of time slice i
+// is weighted by exp(-epsilon * (residual means of the slices before it)), so late times
+// only count once the early ones fit.
+typedef struct {
+    int num_windows;
+    double tolerance;                   // Advance once the residual and initial means stay below this
+    int patience;                       // ... for this many consecutive epochs
+    int slices;                         // Time slices per window (1 disables the causal weights)
+    double epsilon;                     // Causality strength
+} TimeMarchingConfig;
+
+void default_time_marching_config(TimeMarchingConfig *config);
+
+// weights[i] = exp(-epsilon * sum_{j < i} slice_losses[j])
+void causal_weights(const double *slice_losses, int slices, double epsilon, double *weights);
+
+// Value and time-derivative targets of the initial points of a window, laid out as
+// [point][values..., d/dt...]. previous NULL uses the reference solution with zero
+// velocity (the first window); otherwise previous is evaluated through ws.
+void window_initial_targets(const NeuralNetwork *previous, JetWorkspace *ws, const PdeOperator *op, const LossParameters *params, ActivationFunction activation,
+                            const double *points, int count, double *targets);
+
+// Train nets[k] on window k of the domain's time axis. --epochs is the budget of the whole
+// run: a window stops at the tolerance or after its share of the epochs still left, so
+// windows that converge early leave their epochs to the later ones. Returns 0 if training
+// could not start.
+int train_time_marching(NeuralNetwork *nets, const TimeMarchingConfig *marching, const char *loss_type, const LossParameters *params, const TrainingConfig *config);
+
+#endif // TIME_MARCHING_H
@@ -0,0 +1,99 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+
+#include "neural_network.h"
+#include "loss_functions.h"
+#include "pde.h"
+#include "sampler.h"
+#include "logger.h"
+#include "checkpoint.h"
+#include "optimizer.h"
+#include "loss_balance.h"
+#include "validation.h"
+#include "distributed.h"
+#include "thread_pool.h"
+#include "arena.h"
+
+// Everything train_neural_network needs beyond the network and the PDE
+typedef struct {
+    int epochs;
+    double learning_rate;
+    LearningRateSchedule schedule;      // base_rate and total_epochs come from the fields above
+    OptimizerConfig optimizer;
+    int lbfgs_epochs;                   // Final epochs refined with full-batch L-BFGS (0 disables)
+    LossWeightingConfig loss_weighting; // Weights of the residual, boundary, initial and conservation terms
+    int verbose;                        // Print the adaptive term weights each time they are re-estimated
+    ActivationFunction activation;
+    Precision precision;                // Arithmetic of the forward/backward sweeps
+    Domain domain;                      // dims == 0 selects the unit box
+    SamplingMethod sampling;
+    int interior_points;                // Collocation points per batch
+    int boundary_points;
+    int initial_points;
+    int validation_points;              // Interior points of the fixed validation set
+    ValidationConfig validation;        // Cadence, subsampling and best-model tracking
+    int refine_every;                   // Epochs between residual-based refinements (0 disables)
+    int refine_candidates;              // Uniform candidates scored per refinement
+    int threads;                        // Data-parallel workers (0 = every online core)
+    uint64_t seed;                      // Collocation streams; the validation set is the same for every seed
+    int log_every;                      // Epochs between log records (the last epoch is always logged)
+    LogFormat log_format;
+    int checkpoint_every;               // Epochs between checkpoints (0 disables)
+    const char *checkpoint_path;        // NULL writes checkpoint_<loss>.ckpt
+    const CheckpointState *resume;      // Continue from this state, or NULL for a fresh run
+    int profile_trace;                  // Also write a Chrome trace (profiling builds only)
+    Communicator *comm;                 // Ranks sharing every batch (NULL: this process trains alone)
+} TrainingConfig;
+
+void default_training_config(TrainingConfig *config);
+// Returns 1 once every epoch has run. With config->comm set, every rank calls this with the
+// same network and config; rank 0 alone validates, logs and writes checkpoints.
+int train_neural_network(NeuralNetwork *nn, const char *loss_type, const LossParameters *params, const TrainingConfig *config);
+// Largest allreduce, in doubles, that train_neural_network issues for nn under config
+size_t training_message_capacity(const NeuralNetwork *nn, const TrainingConfig *config);
+
+// Data-parallel sweeps shared by the trainers. Every worker owns a tape, a gradient buffer
+// and sum_width loss sums, all carved out of one arena. A sweep hands each worker one
+// contiguous shard of items [begin, end); the worker gradients are then added by a pairwise
+// tree whose pairing depends only on the worker count, so every bit of the result is fixed
+// for a given --threads.
+typedef void (*ShardSweep)(void *context, const NeuralNetwork *nn, JetWorkspace *ws, int begin, int end, double *gradients, double *sums);
+
+typedef struct {
+    ThreadPool pool;
+    int num_workers;
+    int sum_width;
+    JetWorkspace *workspaces;
+    double **gradients;                 // [num_workers][num_parameters], each 64-byte aligned
+    double **sums;                      // [num_workers][sum_width], each on cache lines of its own
+    float *weights32;                   // Reduced precision: the float weights every tape reads
+    RowSet *touched;                    // [num_workers] Hash-grid rows each worker's gradients hold; NULL without tables
+    int sparse_output;                  // Write only the touched table rows of the output gradients
+    Arena arena;
+
+    // The sweep currently handed to the pool
+    const NeuralNetwork *nn;
+    ShardSweep sweep;
+    void *context;
+    int range_begin;
+    int range_end;
+    double *output_gradients;           // Reduction target, or NULL for a loss-only sweep
+} DataParallel;
+
+// Tapes are sized for the largest shard of max_points items, at most 1024 points per sweep
+int init_data_parallel(DataParallel *dp, const NeuralNetwork *nn, int num_workers, int max_points, int sum_width, int derivative_order, Precision precision);
+void free_data_parallel(DataParallel *dp);
+// Run sweep over items [begin, end) of nn (laid out like the network dp was made for). In
+// reduced precision nn's parameters are narrowed to float once, for all workers. With
+// gradients non-NULL every worker starts from zero gradients and their sum is written
+// there; sums, if non-NULL, receives the sum_width worker sums added in worker order.
+// Hash-grid tables are cleared and reduced only in the rows the workers wrote, and
+// touched[0] lists the rows of the sum. The other table rows of gradients are zeroed, or
+// left as they were when sparse_output is set.
+void data_parallel_sweep(DataParallel *dp, const NeuralNetwork *nn, ShardSweep sweep, void *context, int begin, int end, double *gradients, double *sums);
+
+// Building blocks shared with the ensemble trainer. sums, weights and means are indexed by LossTerm.
+void composite_loss_terms(const JetBatch *jets, const CollocationBatch *batch, int start, int count, const PdeOperator *op, const LossParameters *params, const double *weights, double *sums);
+double combine_loss_terms(const double *sums, const CollocationBatch *batch, const double *weights, double *means);
+
+#endif // TRAINING_H
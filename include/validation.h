@@ -0,0 +1,71 @@
+#ifndef VALIDATION_H
+#define VALIDATION_H
+
+#include <pthread.h>
+#include "neural_network.h"
+#include "autodiff.h"
+#include "sampler.h"
+
+// Loss of a parameter snapshot on one validation set; runs on the validator thread with
+// the validator's own tape, so it must not touch anything the trainer writes
+typedef double (*ValidationFunction)(const NeuralNetwork *snapshot, JetWorkspace *ws, const CollocationBatch *set, void *context);
+
+typedef struct {
+    int every;                          // Epochs between passes (0 = not by epoch)
+    double seconds;                     // Wall-clock seconds between passes (0 = not by time)
+    int subsample;                      // Interior points of cadence passes (0 = the full set)
+    const char *best_model_path;        // Saved on every improvement, or NULL
+} ValidationConfig;
+
+typedef struct {
+    int epoch;                          // Epoch whose parameters were validated
+    double loss;                        // Training loss of that epoch
+    double validation_loss;
+    double learning_rate;
+    int full;                           // Evaluated on the full set rather than the subsample
+} ValidationResult;
+
+// Validation on a background thread. The trainer copies its parameters into the snapshot
+// only while the thread is idle and never waits for a pass: a due pass that finds the
+// thread busy is skipped. Results are picked up with validator_poll.
+typedef struct {
+    ValidationConfig config;
+    NeuralNetwork snapshot;
+    JetWorkspace ws;
+    CollocationBatch full_set;
+    CollocationBatch subset;            // Prefix of every group of the full set (low-discrepancy itself)
+    const CollocationBatch *cadence_set;
+    ValidationFunction evaluate;
+    void *context;
+    char loss_type[32];
+    ActivationFunction activation;
+    Arena arena;                        // Subset points
+    double last_submit;                 // Monotonic seconds
+
+    // Guarded by lock
+    ValidationResult job;
+    ValidationResult result;
+    int pending;
+    int stop;
+    int results;                        // Passes finished
+    int results_seen;                   // Passes handed out by validator_poll
+    int skipped;                        // Due passes dropped because the thread was busy
+    double best_loss;
+    int best_epoch;
+
+    int started;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Validator;
+
+int validator_init(Validator *v, const ValidationConfig *config, const NeuralNetwork *nn, const CollocationBatch *full_set, int capacity, int derivative_order, Precision precision, ValidationFunction evaluate, void *context, const char *loss_type, ActivationFunction activation);
+void validator_free(Validator *v);
+int validator_due(const Validator *v, int epoch);
+// Hand over a snapshot of nn; returns 0 (and counts a skip) if busy and wait is 0
+int validator_submit(Validator *v, const NeuralNetwork *nn, int epoch, double loss, double learning_rate, int full, int wait);
+// Latest finished pass, if there is one the caller has not seen yet
+int validator_poll(Validator *v, ValidationResult *result);
+void validator_wait(Validator *v);
+
+#endif // VALIDATION_H
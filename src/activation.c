@@ -0,0 +1,195 @@
+#include "activation.h"
+#include <stdint.h>
+#include <string.h>
+#include "activation_kernels.h"
+
+// Set once before training; read by every kernel call
+static ActivationMode activation_mode = ACTIVATION_ACCURATE;
+
+int parse_activation_function(const char *name, ActivationFunction *function) {
+    if (strcmp(name, "sigmoid") == 0) {
+        *function = SIGMOID;
+    } else if (strcmp(name, "tanh") == 0) {
+        *function = TANH;
+    } else if (strcmp(name, "relu") == 0) {
+        *function = RELU;
+    } else if (strcmp(name, "leaky_relu") == 0) {
+        *function = LEAKY_RELU;
+    } else if (strcmp(name, "sin") == 0) {
+        *function = SIN;
+    } else if (strcmp(name, "silu") == 0) {
+        *function = SILU;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+const char *activation_function_name(ActivationFunction function) {
+    switch (function) {
+        case RELU: return "relu";
+        case SIGMOID: return "sigmoid";
+        case TANH: return "tanh";
+        case LEAKY_RELU: return "leaky_relu";
+        case SIN: return "sin";
+        case SILU: return "silu";
+    }
+    return "unknown";
+}
+
+int parse_activation_mode(const char *name, ActivationMode *mode) {
+    if (strcmp(name, "accurate") == 0) {
+        *mode = ACTIVATION_ACCURATE;
+    } else if (strcmp(name, "fast") == 0) {
+        *mode = ACTIVATION_FAST;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+void set_activation_mode(ActivationMode mode) {
+    activation_mode = mode;
+}
+
+ActivationMode get_activation_mode(void) {
+    return activation_mode;
+}
+
+// The scalar kernels, shared with the exported model sources
+#define COMPILE_KERNELS(...) __VA_ARGS__
+ACTIVATION_SELECT_SOURCE(COMPILE_KERNELS)
+ACTIVATION_EXP_SOURCE(COMPILE_KERNELS)
+ACTIVATION_TANH_SOURCE(COMPILE_KERNELS)
+ACTIVATION_SIGMOID_SOURCE(COMPILE_KERNELS)
+ACTIVATION_SINCOS_SOURCE(COMPILE_KERNELS)
+
+// The per-function loops below carry no branches the compiler cannot turn into blends, so
+// each one vectorizes to the widest SIMD the build targets. NULL outputs are loop-invariant
+// tests and get hoisted out of the loop.
+static void tanh_kernel(const double *restrict z, double *restrict a, double *restrict d1, double *restrict d2, double *restrict d3, size_t count, int fast) {
+    for (size_t i = 0; i < count; i++) {
+        double value = fast_tanh(z[i], fast);
+        double f1 = 1.0 - value * value;
+        if (a) a[i] = value;
+        if (d1) d1[i] = f1;
+        if (d2) d2[i] = -2.0 * value * f1;
+        if (d3) d3[i] = -2.0 * f1 * f1 + 4.0 * value * value * f1;
+    }
+}
+
+static void sigmoid_kernel(const double *restrict z, double *restrict a, double *restrict d1, double *restrict d2, double *restrict d3, size_t count, int fast) {
+    for (size_t i = 0; i < count; i++) {
+        double value = fast_sigmoid(z[i], fast);
+        double f1 = value * (1.0 - value);
+        double f2 = f1 * (1.0 - 2.0 * value);
+        if (a) a[i] = value;
+        if (d1) d1[i] = f1;
+        if (d2) d2[i] = f2;
+        if (d3) d3[i] = f2 * (1.0 - 2.0 * value) - 2.0 * f1 * f1;
+    }
+}
+
+// f = sin z, f' = cos z, f'' = -sin z, f''' = -cos z
+static void sin_kernel(const double *restrict z, double *restrict a, double *restrict d1, double *restrict d2, double *restrict d3, size_t count, int fast) {
+    for (size_t i = 0; i < count; i++) {
+        double s, c;
+        fast_sincos(z[i], fast, &s, &c);
+        if (a) a[i] = s;
+        if (d1) d1[i] = c;
+        if (d2) d2[i] = -s;
+        if (d3) d3[i] = -c;
+    }
+}
+
+// f = z s with s = sigmoid(z): f' = s + z s', f'' = 2 s' + z s'', f''' = 3 s'' + z s'''
+static void silu_kernel(const double *restrict z, double *restrict a, double *restrict d1, double *restrict d2, double *restrict d3, size_t count, int fast) {
+    for (size_t i = 0; i < count; i++) {
+        double x = z[i];
+        double s = fast_sigmoid(x, fast);
+        double s1 = s * (1.0 - s);
+        double s2 = s1 * (1.0 - 2.0 * s);
+        double s3 = s1 * (1.0 - 6.0 * s + 6.0 * s * s);
+        if (a) a[i] = x * s;
+        if (d1) d1[i] = s + x * s1;
+        if (d2) d2[i] = 2.0 * s1 + x * s2;
+        if (d3) d3[i] = 3.0 * s2 + x * s3;
+    }
+}
+
+static void relu_kernel(const double *restrict z, double *restrict a, double *restrict d1, double *restrict d2, double *restrict d3, size_t count, double slope) {
+    for (size_t i = 0; i < count; i++) {
+        double x = z[i];
+        if (a) a[i] = select_double(x > 0.0, x, slope * x);
+        if (d1) d1[i] = select_double(x > 0.0, 1.0, slope);
+        if (d2) d2[i] = 0.0;
+        if (d3) d3[i] = 0.0;
+    }
+}
+
+void activate_fused(const double *z, double *a, double *d1, double *d2, double *d3, size_t count, ActivationFunction function) {
+    int fast = activation_mode == ACTIVATION_FAST;
+    switch (function) {
+        case RELU:
+            relu_kernel(z, a, d1, d2, d3, count, 0.0);
+            break;
+        case LEAKY_RELU:
+            relu_kernel(z, a, d1, d2, d3, count, LEAKY_RELU_ALPHA);
+            break;
+        case SIGMOID:
+            sigmoid_kernel(z, a, d1, d2, d3, count, fast);
+            break;
+        case TANH:
+            tanh_kernel(z, a, d1, d2, d3, count, fast);
+            break;
+        case SIN:
+            sin_kernel(z, a, d1, d2, d3, count, fast);
+            break;
+        case SILU:
+            silu_kernel(z, a, d1, d2, d3, count, fast);
+            break;
+        default:
+            // Identity if unknown
+            for (size_t i = 0; i < count; i++) {
+                if (a) a[i] = z[i];
+                if (d1) d1[i] = 1.0;
+                if (d2) d2[i] = 0.0;
+                if (d3) d3[i] = 0.0;
+            }
+            break;
+    }
+}
+
+// The polynomial kernels are tuned for double, so single-precision rows are widened a block at
+// a time; the matmuls around them are what the mixed and rounded modes speed up
+void activate_fused_f32(const float *z, float *a, float *d1, float *d2, float *d3, size_t count, ActivationFunction function) {
+    enum { BLOCK = 256 };
+    double zb[BLOCK], ab[BLOCK], d1b[BLOCK], d2b[BLOCK], d3b[BLOCK];
+    for (size_t start = 0; start < count; start += BLOCK) {
+        size_t n = count - start < BLOCK ? count - start : BLOCK;
+        for (size_t i = 0; i < n; i++) zb[i] = z[start + i];
+        activate_fused(zb, a ? ab : NULL, d1 ? d1b : NULL, d2 ? d2b : NULL, d3 ? d3b : NULL, n, function);
+        for (size_t i = 0; i < n; i++) {
+            if (a) a[start + i] = (float)ab[i];
+            if (d1) d1[start + i] = (float)d1b[i];
+            if (d2) d2[start + i] = (float)d2b[i];
+            if (d3) d3[start + i] = (float)d3b[i];
+        }
+    }
+}
+
+void activate_batch(const double *z, double *a, size_t count, ActivationFunction function) {
+    activate_fused(z, a, NULL, NULL, NULL, count, function);
+}
+
+// Function to choose activation function
+double activate(double x, ActivationFunction function) {
+    double a;
+    activate_fused(&x, &a, NULL, NULL, NULL, 1, function);
+    return a;
+}
+
+// First three derivatives of the activation at the pre-activation z
+void activation_derivatives(double z, ActivationFunction function, double *d1, double *d2, double *d3) {
+    activate_fused(&z, NULL, d1, d2, d3, 1, function);
+}
@@ -0,0 +1,127 @@
+#ifndef ACTIVATION_KERNELS_H
+#define ACTIVATION_KERNELS_H
+
+// The scalar kernels behind the transcendental activations, written once. Each macro hands
+// its definitions to DEFINE: activation.c passes them through and compiles them, and
+// export.c stringizes the same tokens into the standalone model source, so an exported
+// activation is the training one by construction. Inside the definitions, comments have to
+// be block comments and constants literals, since the stringized text sees no macros.
+//
+// Adding then subtracting 1.5 * 2^52 (6755399441055744.0, bits 0x4338000000000000) rounds
+// to the nearest integer without a libm call, and leaves that integer in the low mantissa
+// bits of the sum.
+
+#define ACTIVATION_SELECT_SOURCE(DEFINE) DEFINE( \
+static inline double select_double(int condition, double a, double b) { \
+    return condition ? a : b; \
+} \
+)
+
+// e^x = scale * (1 + p) with x = n ln2 + r, |r| <= ln2 / 2, scale = 2^n and p = e^r - 1.
+// Keeping p separate gives expm1 without cancellation when n == 0. The Taylor series of
+// e^r - 1 goes to degree 13 (error < 5e-18), or 8 (error < 2e-10) when fast.
+#define ACTIVATION_EXP_SOURCE(DEFINE) DEFINE( \
+static inline void exp_parts(double x, int fast, double *p, double *scale) { \
+    x = select_double(x < -708.0, -708.0, x); \
+    x = select_double(x > 708.0, 708.0, x); \
+    double shifted = x * 1.4426950408889634 + 6755399441055744.0; \
+    double n = shifted - 6755399441055744.0; \
+    double r = (x - n * 6.93147180369123816490e-01) - n * 1.90821492927058770002e-10; \
+    double q; \
+    if (fast) { \
+        q = 1.0 / 40320; \
+        q = q * r + 1.0 / 5040; \
+        q = q * r + 1.0 / 720; \
+        q = q * r + 1.0 / 120; \
+    } else { \
+        q = 1.0 / 6227020800.0; \
+        q = q * r + 1.0 / 479001600.0; \
+        q = q * r + 1.0 / 39916800.0; \
+        q = q * r + 1.0 / 3628800.0; \
+        q = q * r + 1.0 / 362880.0; \
+        q = q * r + 1.0 / 40320.0; \
+        q = q * r + 1.0 / 5040.0; \
+        q = q * r + 1.0 / 720.0; \
+        q = q * r + 1.0 / 120.0; \
+    } \
+    q = q * r + 1.0 / 24; \
+    q = q * r + 1.0 / 6; \
+    q = q * r + 0.5; \
+    *p = r + r * r * q; \
+    int64_t bits; \
+    memcpy(&bits, &shifted, sizeof(bits)); \
+    int64_t exponent = (bits - 0x4338000000000000LL + 1023) << 52; \
+    memcpy(scale, &exponent, sizeof(*scale)); \
+} \
+static inline double fast_exp(double x, int fast) { \
+    double p, scale; \
+    exp_parts(x, fast, &p, &scale); \
+    return scale + scale * p; \
+} \
+static inline double fast_expm1(double x, int fast) { \
+    double p, scale; \
+    exp_parts(x, fast, &p, &scale); \
+    return (scale - 1.0) + scale * p; \
+} \
+)
+
+// tanh|x| = -e / (2 + e) with e = expm1(-2|x|), accurate down to tiny |x|
+#define ACTIVATION_TANH_SOURCE(DEFINE) DEFINE( \
+static inline double fast_tanh(double x, int fast) { \
+    double magnitude = select_double(x < 0.0, -x, x); \
+    double e = fast_expm1(-2.0 * magnitude, fast); \
+    double t = -e / (2.0 + e); \
+    return select_double(x < 0.0, -t, t); \
+} \
+)
+
+#define ACTIVATION_SIGMOID_SOURCE(DEFINE) DEFINE( \
+static inline double fast_sigmoid(double x, int fast) { \
+    return 1.0 / (1.0 + fast_exp(-x, fast)); \
+} \
+)
+
+// sin and cos together: x = k pi/2 + r with a three-part pi/2, then the quadrant k mod 4
+// picks and signs the two polynomials. The Taylor series on |r| <= pi/4 go to degree 15
+// for sin and 16 for cos, or 9 and 10 when fast.
+#define ACTIVATION_SINCOS_SOURCE(DEFINE) DEFINE( \
+static inline void fast_sincos(double x, int fast, double *s, double *c) { \
+    double shifted = x * 0.63661977236758134308 + 6755399441055744.0; \
+    double k = shifted - 6755399441055744.0; \
+    double r = ((x - k * 1.57079632673412561417e+00) - k * 6.07710050650619224932e-11) - k * 2.02226624879595063154e-21; \
+    double r2 = r * r; \
+    double ps, pc; \
+    if (fast) { \
+        ps = 1.0 / 362880; \
+        pc = -1.0 / 3628800; \
+        pc = pc * r2 + 1.0 / 40320; \
+    } else { \
+        ps = -1.0 / 1307674368000.0; \
+        ps = ps * r2 + 1.0 / 6227020800.0; \
+        ps = ps * r2 - 1.0 / 39916800.0; \
+        ps = ps * r2 + 1.0 / 362880.0; \
+        pc = 1.0 / 20922789888000.0; \
+        pc = pc * r2 - 1.0 / 87178291200.0; \
+        pc = pc * r2 + 1.0 / 479001600.0; \
+        pc = pc * r2 - 1.0 / 3628800.0; \
+        pc = pc * r2 + 1.0 / 40320.0; \
+    } \
+    ps = ps * r2 - 1.0 / 5040; \
+    ps = ps * r2 + 1.0 / 120; \
+    ps = ps * r2 - 1.0 / 6; \
+    double sin_r = r + r * r2 * ps; \
+    pc = pc * r2 - 1.0 / 720; \
+    pc = pc * r2 + 1.0 / 24; \
+    pc = pc * r2 - 0.5; \
+    double cos_r = 1.0 + r2 * pc; \
+    int64_t bits; \
+    memcpy(&bits, &shifted, sizeof(bits)); \
+    int64_t quadrant = bits & 3; \
+    double sin_abs = select_double(quadrant & 1, cos_r, sin_r); \
+    double cos_abs = select_double(quadrant & 1, sin_r, cos_r); \
+    *s = select_double(quadrant & 2, -sin_abs, sin_abs); \
+    *c = select_double((quadrant + 1) & 2, -cos_abs, cos_abs); \
+} \
+)
+
+#endif // ACTIVATION_KERNELS_H
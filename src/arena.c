@@ -0,0 +1,53 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+// Round a byte count up to the next cache-line boundary
+size_t arena_aligned_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// Reserve one aligned block up front; returns 1 on success, 0 on failure
+int arena_init(Arena *arena, size_t capacity) {
+    void *block = NULL;
+    capacity = arena_aligned_size(capacity > 0 ? capacity : ARENA_ALIGNMENT);
+    if (posix_memalign(&block, ARENA_ALIGNMENT, capacity) != 0) {
+        arena->base = NULL;
+        arena->capacity = 0;
+        arena->used = 0;
+        return 0;
+    }
+    memset(block, 0, capacity);
+    PROFILE_COUNT(PROF_ALLOCATIONS, 1);
+    PROFILE_COUNT(PROF_ALLOCATED_BYTES, capacity);
+    arena->base = block;
+    arena->capacity = capacity;
+    arena->used = 0;
+    return 1;
+}
+
+// Bump allocation; the returned memory is zeroed and cache-line aligned
+void *arena_alloc(Arena *arena, size_t size) {
+    size_t aligned = arena_aligned_size(size);
+    if (arena->base == NULL || aligned > arena->capacity - arena->used) {
+        return NULL;
+    }
+    void *ptr = arena->base + arena->used;
+    arena->used += aligned;
+    return ptr;
+}
+
+void arena_reset(Arena *arena) {
+    if (arena->base) {
+        memset(arena->base, 0, arena->used);
+    }
+    arena->used = 0;
+}
+
+void arena_free(Arena *arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,214 @@
+#include "autodiff.h"
+#include <stdio.h>
+#include <string.h>
+#include "gemm.h"
+#include "profile.h"
+
+static size_t jet_bytes(const JetWorkspace *ws, int capacity, int width) {
+    return (size_t)capacity * ws->channels * width * sizeof(double);
+}
+
+static size_t jet_bytes32(const JetWorkspace *ws, int capacity, int width) {
+    return (size_t)capacity * ws->channels * width * sizeof(float);
+}
+
+// derivative_order 1 carries the value and gradient channels only; 2 adds the diagonal second derivatives
+int init_jet_workspace(JetWorkspace *ws, const NeuralNetwork *nn, int capacity, int derivative_order, Precision precision) {
+    memset(ws, 0, sizeof(*ws));
+    ws->input_dim = nn_coordinate_inputs(nn);
+    ws->derivative_order = derivative_order < 2 ? 1 : 2;
+    ws->channels = 1 + ws->derivative_order * ws->input_dim;
+    ws->precision = precision;
+    int reduced = precision != PRECISION_FP64;
+    int last = nn->num_layers - 1;
+
+    size_t total = 0;
+    size_t widest_block = 0;
+    int widest = 0;
+    for (int l = 0; l < nn->num_layers; l++) {
+        if (reduced) {
+            total += 3 * arena_aligned_size(jet_bytes32(ws, capacity, nn->layer_sizes[l]));
+        } else {
+            total += 3 * arena_aligned_size(jet_bytes(ws, capacity, nn->layer_sizes[l]));
+        }
+        widest = nn->layer_sizes[l] > widest ? nn->layer_sizes[l] : widest;
+        if (l < last && (size_t)nn->layer_sizes[l] * nn->layer_sizes[l + 1] > widest_block) {
+            widest_block = (size_t)nn->layer_sizes[l] * nn->layer_sizes[l + 1];
+        }
+    }
+    if (reduced) {
+        total += 2 * arena_aligned_size(jet_bytes(ws, capacity, nn->layer_sizes[last]));
+        if (nn_encoded(nn)) {
+            total += 2 * arena_aligned_size(jet_bytes(ws, capacity, nn->layer_sizes[0]));
+        }
+        total += arena_aligned_size(3 * (size_t)widest * sizeof(float));
+        total += arena_aligned_size(nn->num_parameters * sizeof(float));
+        total += arena_aligned_size(widest_block * sizeof(float));
+    } else {
+        total += arena_aligned_size(3 * (size_t)widest * sizeof(double));
+    }
+    if (capacity <= 0 || !arena_init(&ws->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate a jet workspace for %d points\n", capacity);
+        return 0;
+    }
+
+    ws->capacity = capacity;
+    if (reduced) {
+        ws->scratch32 = arena_alloc(&ws->arena, 3 * (size_t)widest * sizeof(float));
+        ws->weights32 = arena_alloc(&ws->arena, nn->num_parameters * sizeof(float));
+        ws->gradients32 = arena_alloc(&ws->arena, widest_block * sizeof(float));
+        ws->jets[last] = arena_alloc(&ws->arena, jet_bytes(ws, capacity, nn->layer_sizes[last]));
+        ws->adjoints[last] = arena_alloc(&ws->arena, jet_bytes(ws, capacity, nn->layer_sizes[last]));
+        if (nn_encoded(nn)) {
+            // The encoding works in double and is narrowed into the float input jets
+            ws->jets[0] = arena_alloc(&ws->arena, jet_bytes(ws, capacity, nn->layer_sizes[0]));
+            ws->adjoints[0] = arena_alloc(&ws->arena, jet_bytes(ws, capacity, nn->layer_sizes[0]));
+        }
+    } else {
+        ws->scratch = arena_alloc(&ws->arena, 3 * (size_t)widest * sizeof(double));
+    }
+    for (int l = 0; l < nn->num_layers; l++) {
+        int hidden = l > 0 && l < last;
+        if (reduced) {
+            size_t bytes = jet_bytes32(ws, capacity, nn->layer_sizes[l]);
+            ws->jets32[l] = arena_alloc(&ws->arena, bytes);
+            ws->adjoints32[l] = arena_alloc(&ws->arena, bytes);
+            if (hidden) {
+                ws->pre32[l] = arena_alloc(&ws->arena, bytes);
+            }
+        } else {
+            size_t bytes = jet_bytes(ws, capacity, nn->layer_sizes[l]);
+            ws->jets[l] = arena_alloc(&ws->arena, bytes);
+            ws->adjoints[l] = arena_alloc(&ws->arena, bytes);
+            if (hidden) {
+                ws->pre[l] = arena_alloc(&ws->arena, bytes);
+            }
+        }
+    }
+    return 1;
+}
+
+void free_jet_workspace(JetWorkspace *ws) {
+    arena_free(&ws->arena);
+    memset(ws, 0, sizeof(*ws));
+}
+
+void share_jet_weights(JetWorkspace *ws, float *weights32) {
+    ws->weights32 = weights32;
+    ws->shared_weights32 = 1;
+}
+
+// The hash-grid tables behind the layers are read in double by the encoding, so only the layers are narrowed
+void narrow_jet_weights(const NeuralNetwork *nn, float *weights32) {
+    for (size_t p = 0; p < nn->encoding_offset; p++) {
+        weights32[p] = (float)nn->parameters[p];
+    }
+}
+
+#define SCALAR double
+#define JET_FN(name) name##_f64
+#define JETS(ws, l) ((ws)->jets[l])
+#define PRE(ws, l) ((ws)->pre[l])
+#define ADJOINTS(ws, l) ((ws)->adjoints[l])
+#define SCRATCH(ws) ((ws)->scratch)
+#define WEIGHTS(nn, ws) ((nn)->parameters)
+#define ACTIVATE_FUSED activate_fused
+#define GEMM_NN gemm_nn
+#define GEMM_NT gemm_nt
+#define GEMM_TN gemm_tn
+#define REDUCED 0
+#include "autodiff_template.h"
+#undef SCALAR
+#undef JET_FN
+#undef JETS
+#undef PRE
+#undef ADJOINTS
+#undef SCRATCH
+#undef WEIGHTS
+#undef ACTIVATE_FUSED
+#undef GEMM_NN
+#undef GEMM_NT
+#undef GEMM_TN
+#undef REDUCED
+
+#define SCALAR float
+#define JET_FN(name) name##_f32
+#define JETS(ws, l) ((ws)->jets32[l])
+#define PRE(ws, l) ((ws)->pre32[l])
+#define ADJOINTS(ws, l) ((ws)->adjoints32[l])
+#define SCRATCH(ws) ((ws)->scratch32)
+#define WEIGHTS(nn, ws) ((ws)->weights32)
+#define ACTIVATE_FUSED activate_fused_f32
+#define GEMM_NN gemm_nn_f32
+#define GEMM_NT gemm_nt_f32
+#define GEMM_TN gemm_tn_f32
+#define REDUCED 1
+#include "autodiff_template.h"
+
+// Chain rule of a hidden activation over rows of `width` values. The rows need not be one
+// network's layer: the ensemble sweep passes rows of several models' units interleaved.
+void activate_jets(JetWorkspace *ws, const double *pre, double *post, int num_points, int width, ActivationFunction activation_function) {
+    activate_jets_f64(ws, pre, post, num_points, width, activation_function);
+}
+
+void activate_jets_adjoint(JetWorkspace *ws, const double *pre, double *adjoint, int num_points, int width, ActivationFunction activation_function) {
+    activate_jets_adjoint_f64(ws, pre, adjoint, num_points, width, activation_function);
+}
+
+// One sweep computes outputs, du/dx_i and (at order 2) d2u/dx_i^2 for every point in the batch
+void forward_pass_jet(const NeuralNetwork *nn, JetWorkspace *ws, const double *inputs, int num_points, ActivationFunction activation_function) {
+    PROFILE_SCOPE(PROF_FORWARD);
+    PROFILE_COUNT(PROF_POINTS, num_points);
+    if (ws->precision == PRECISION_FP64) {
+        forward_pass_jet_f64(nn, ws, inputs, num_points, activation_function);
+    } else {
+        forward_pass_jet_f32(nn, ws, inputs, num_points, activation_function);
+    }
+}
+
+// View the output-layer jet of one point as a set of derivatives for the residual operators
+void jet_point_derivatives(const NeuralNetwork *nn, const JetWorkspace *ws, int point, PointDerivatives *pd) {
+    int out = nn_output_size(nn);
+    const double *jet = ws->jets[nn->num_layers - 1] + (size_t)point * ws->channels * out;
+    pd->input_dim = ws->input_dim;
+    pd->output_dim = out;
+    pd->u = jet;
+    pd->du = jet + out;
+    pd->d2u = ws->derivative_order > 1 ? jet + (size_t)(1 + ws->input_dim) * out : NULL;
+}
+
+void clear_jet_adjoints(const NeuralNetwork *nn, JetWorkspace *ws, int num_points) {
+    memset(ws->adjoints[nn->num_layers - 1], 0, jet_bytes(ws, num_points, nn_output_size(nn)));
+}
+
+// Where a residual operator accumulates d(loss)/d(u, du, d2u) for one point
+void jet_point_adjoint(const NeuralNetwork *nn, JetWorkspace *ws, int point, double weight, PointAdjoint *adjoint) {
+    int out = nn_output_size(nn);
+    double *jet = ws->adjoints[nn->num_layers - 1] + (size_t)point * ws->channels * out;
+    adjoint->weight = weight;
+    adjoint->u = jet;
+    adjoint->du = jet + out;
+    adjoint->d2u = ws->derivative_order > 1 ? jet + (size_t)(1 + ws->input_dim) * out : NULL;
+}
+
+// The output-layer jets of the last forward_pass_jet as one batch for the residual kernels
+void jet_output_batch(const NeuralNetwork *nn, JetWorkspace *ws, int with_adjoints, JetBatch *batch) {
+    int last = nn->num_layers - 1;
+    batch->input_dim = ws->input_dim;
+    batch->output_dim = nn_output_size(nn);
+    batch->derivative_order = ws->derivative_order;
+    batch->stride = (size_t)ws->channels * batch->output_dim;
+    batch->jets = ws->jets[last];
+    batch->adjoints = with_adjoints ? ws->adjoints[last] : NULL;
+}
+
+// Reverse sweep over the tape left by forward_pass_jet. The output-layer adjoints must
+// already hold d(loss)/d(output jets); parameter gradients are accumulated into gradients.
+void backward_pass_jet(const NeuralNetwork *nn, JetWorkspace *ws, int num_points, ActivationFunction activation_function, double *gradients) {
+    PROFILE_SCOPE(PROF_BACKWARD);
+    if (ws->precision == PRECISION_FP64) {
+        backward_pass_jet_f64(nn, ws, num_points, activation_function, gradients);
+    } else {
+        backward_pass_jet_f32(nn, ws, num_points, activation_function, gradients);
+    }
+}
@@ -0,0 +1,210 @@
+// Forward/backward jet sweeps, instantiated once per scalar type by autodiff.c. The
+// includer defines SCALAR, JET_FN(name), JETS/PRE/ADJOINTS(ws, l), SCRATCH(ws),
+// WEIGHTS(nn, ws), ACTIVATE_FUSED, GEMM_NN/NT/TN and REDUCED. In the reduced (float)
+// instantiation the sweep runs on a float copy of the weights, and the output-layer jets
+// are widened into the double buffers the residual kernels read; their adjoints are
+// narrowed on the way back, and weight gradients are added into the double gradients.
+
+// Seed the input layer: value x, first derivative e_i, second derivative 0. An encoded
+// network starts from the encoding's jets instead, which are always computed in double.
+static void JET_FN(seed_input_jets)(const NeuralNetwork *nn, JetWorkspace *ws, const double *inputs, int num_points) {
+    if (nn_encoded(nn)) {
+        encode_jets(&nn->encoding, nn_encoding_tables(nn), inputs, num_points, ws->derivative_order, ws->jets[0]);
+#if REDUCED
+        size_t count = (size_t)num_points * ws->channels * nn->layer_sizes[0];
+        for (size_t i = 0; i < count; i++) {
+            ws->jets32[0][i] = (float)ws->jets[0][i];
+        }
+#endif
+        return;
+    }
+    // Parameter inputs are constants of the equation: a value but no derivative seed
+    int d = ws->input_dim;
+    int width = nn->layer_sizes[0];
+    const ParameterInputs *parameters = &nn->parameter_inputs;
+    SCALAR *jet = JETS(ws, 0);
+    memset(jet, 0, (size_t)num_points * ws->channels * width * sizeof(SCALAR));
+    for (int s = 0; s < num_points; s++) {
+        SCALAR *point = jet + (size_t)s * ws->channels * width;
+        const double *x = inputs + (size_t)s * width;
+        for (int i = 0; i < d; i++) {
+            point[i] = (SCALAR)x[i];
+            point[(1 + i) * width + i] = 1;
+        }
+        for (int k = 0; k < parameters->count; k++) {
+            point[d + k] = (SCALAR)scaled_parameter_input(parameters, k, x[d + k]);
+        }
+    }
+}
+
+// Chain rule through a = f(z): da = f'(z) dz, d2a = f''(z) dz^2 + f'(z) d2z.
+// f, f' and f'' of a point's value row come from one fused kernel call.
+static void JET_FN(activate_jets)(JetWorkspace *ws, const SCALAR *pre, SCALAR *post, int num_points, int width, ActivationFunction activation_function) {
+    int channels = ws->channels;
+    int input_dim = ws->input_dim;
+    int order = ws->derivative_order;
+    SCALAR *f1 = SCRATCH(ws);
+    SCALAR *f2 = f1 + width;
+    for (int s = 0; s < num_points; s++) {
+        const SCALAR *z = pre + (size_t)s * channels * width;
+        const SCALAR *dz = z + width;
+        const SCALAR *d2z = dz + (size_t)input_dim * width;
+        SCALAR *a = post + (size_t)s * channels * width;
+        SCALAR *da = a + width;
+        SCALAR *d2a = da + (size_t)input_dim * width;
+        ACTIVATE_FUSED(z, a, f1, order < 2 ? NULL : f2, NULL, width, activation_function);
+        for (int i = 0; i < input_dim; i++) {
+            const SCALAR *first = dz + (size_t)i * width;
+            SCALAR *out = da + (size_t)i * width;
+            for (int j = 0; j < width; j++) {
+                out[j] = f1[j] * first[j];
+            }
+            if (order < 2) {
+                continue;
+            }
+            const SCALAR *second = d2z + (size_t)i * width;
+            SCALAR *out2 = d2a + (size_t)i * width;
+            for (int j = 0; j < width; j++) {
+                out2[j] = f2[j] * first[j] * first[j] + f1[j] * second[j];
+            }
+        }
+    }
+}
+
+// Adjoint of activate_jets: maps d(loss)/d(a-jet) to d(loss)/d(z-jet), in place
+static void JET_FN(activate_jets_adjoint)(JetWorkspace *ws, const SCALAR *pre, SCALAR *adjoint, int num_points, int width, ActivationFunction activation_function) {
+    int channels = ws->channels;
+    int input_dim = ws->input_dim;
+    int order = ws->derivative_order;
+    SCALAR *f1 = SCRATCH(ws);
+    SCALAR *f2 = f1 + width;
+    SCALAR *f3 = f2 + width;
+    for (int s = 0; s < num_points; s++) {
+        size_t base = (size_t)s * channels * width;
+        const SCALAR *z = pre + base;
+        const SCALAR *dz = z + width;
+        const SCALAR *d2z = dz + (size_t)input_dim * width;
+        SCALAR *bar = adjoint + base;
+        SCALAR *bar_d = bar + width;
+        SCALAR *bar_d2 = bar_d + (size_t)input_dim * width;
+        ACTIVATE_FUSED(z, NULL, f1, f2, order < 2 ? NULL : f3, width, activation_function);
+        for (int j = 0; j < width; j++) {
+            bar[j] *= f1[j];
+        }
+        for (int i = 0; i < input_dim; i++) {
+            const SCALAR *first = dz + (size_t)i * width;
+            SCALAR *bd = bar_d + (size_t)i * width;
+            if (order < 2) {
+                for (int j = 0; j < width; j++) {
+                    bar[j] += bd[j] * f2[j] * first[j];
+                    bd[j] *= f1[j];
+                }
+                continue;
+            }
+            const SCALAR *second = d2z + (size_t)i * width;
+            SCALAR *bd2 = bar_d2 + (size_t)i * width;
+            for (int j = 0; j < width; j++) {
+                bar[j] += bd[j] * f2[j] * first[j] + bd2[j] * (f3[j] * first[j] * first[j] + f2[j] * second[j]);
+                bd[j] = bd[j] * f1[j] + bd2[j] * 2 * f2[j] * first[j];
+                bd2[j] *= f1[j];
+            }
+        }
+    }
+}
+
+static void JET_FN(forward_pass_jet)(const NeuralNetwork *nn, JetWorkspace *ws, const double *inputs, int num_points, ActivationFunction activation_function) {
+    int last = nn->num_layers - 1;
+    int channels = ws->channels;
+    int rows = num_points * channels;
+#if REDUCED
+    if (!ws->shared_weights32) {
+        narrow_jet_weights(nn, ws->weights32);
+    }
+#endif
+    JET_FN(seed_input_jets)(nn, ws, inputs, num_points);
+
+    for (int l = 0; l < last; l++) {
+        int in = nn->layer_sizes[l];
+        int out = nn->layer_sizes[l + 1];
+        const SCALAR *biases = WEIGHTS(nn, ws) + nn->bias_offsets[l];
+        SCALAR *z = (l + 1 < last) ? PRE(ws, l + 1) : JETS(ws, l + 1);
+
+        // Derivative channels are linear in the previous layer, so only the value row gets the bias
+        GEMM_NN(rows, out, in, JETS(ws, l), in, WEIGHTS(nn, ws) + nn->weight_offsets[l], out, z, out, 0);
+        PROFILE_COUNT(PROF_FLOPS, 2.0 * rows * in * out);
+        for (int s = 0; s < num_points; s++) {
+            SCALAR *value = z + (size_t)s * channels * out;
+            for (int j = 0; j < out; j++) {
+                value[j] += biases[j];
+            }
+        }
+
+        if (l + 1 < last) {
+            JET_FN(activate_jets)(ws, z, JETS(ws, l + 1), num_points, out, activation_function);
+        }
+    }
+
+#if REDUCED
+    size_t count = (size_t)rows * nn_output_size(nn);
+    const float *narrow = JETS(ws, last);
+    for (size_t i = 0; i < count; i++) {
+        ws->jets[last][i] = narrow[i];
+    }
+#endif
+}
+
+static void JET_FN(backward_pass_jet)(const NeuralNetwork *nn, JetWorkspace *ws, int num_points, ActivationFunction activation_function, double *gradients) {
+    int last = nn->num_layers - 1;
+    int channels = ws->channels;
+    int rows = num_points * channels;
+#if REDUCED
+    size_t count = (size_t)rows * nn_output_size(nn);
+    float *narrow = ADJOINTS(ws, last);
+    for (size_t i = 0; i < count; i++) {
+        narrow[i] = (float)ws->adjoints[last][i];
+    }
+#endif
+
+    for (int l = last - 1; l >= 0; l--) {
+        int in = nn->layer_sizes[l];
+        int out = nn->layer_sizes[l + 1];
+        SCALAR *bar = ADJOINTS(ws, l + 1);
+        double *bias_gradients = gradients + nn->bias_offsets[l];
+
+        if (l + 1 < last) {
+            JET_FN(activate_jets_adjoint)(ws, PRE(ws, l + 1), bar, num_points, out, activation_function);
+        }
+
+        // Every channel shares the weights; only the value channel saw the bias
+#if REDUCED
+        GEMM_TN(in, out, rows, JETS(ws, l), in, bar, out, ws->gradients32, out, 0);
+        double *weight_gradients = gradients + nn->weight_offsets[l];
+        for (size_t i = 0; i < (size_t)in * out; i++) {
+            weight_gradients[i] += ws->gradients32[i];
+        }
+#else
+        GEMM_TN(in, out, rows, JETS(ws, l), in, bar, out, gradients + nn->weight_offsets[l], out, 1);
+#endif
+        PROFILE_COUNT(PROF_FLOPS, (l > 0 ? 4.0 : 2.0) * rows * in * out);
+        for (int s = 0; s < num_points; s++) {
+            const SCALAR *value_bar = bar + (size_t)s * channels * out;
+            for (int j = 0; j < out; j++) {
+                bias_gradients[j] += value_bar[j];
+            }
+        }
+
+        if (l > 0) {
+            GEMM_NT(rows, in, out, bar, out, WEIGHTS(nn, ws) + nn->weight_offsets[l], out, ADJOINTS(ws, l), in, 0);
+        } else if (nn->encoding.num_parameters > 0) {
+            // Trainable encoding: one more GEMM for the input adjoints, then the table scatter
+            GEMM_NT(rows, in, out, bar, out, WEIGHTS(nn, ws) + nn->weight_offsets[0], out, ADJOINTS(ws, 0), in, 0);
+#if REDUCED
+            size_t count = (size_t)rows * in;
+            for (size_t i = 0; i < count; i++) {
+                ws->adjoints[0][i] = ws->adjoints32[0][i];
+            }
+#endif
+            encode_jets_adjoint(&nn->encoding, ws->jets[0], ws->adjoints[0], num_points, ws->derivative_order, gradients + nn->encoding_offset, ws->touched);
+        }
+    }
+}
@@ -0,0 +1,203 @@
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+static uint64_t checksum_words(uint64_t hash, const void *data, size_t bytes) {
+    const uint64_t *words = data;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+        hash = (hash ^ words[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Write bytes and zero-pad the file to the next 64-byte boundary, folding both into the checksum
+static int write_blob(FILE *file, const void *data, size_t bytes, uint64_t *hash) {
+    static const char zeros[ARENA_ALIGNMENT];
+    size_t padding = arena_aligned_size(bytes) - bytes;
+    if (bytes > 0 && fwrite(data, 1, bytes, file) != bytes) return 0;
+    if (padding > 0 && fwrite(zeros, 1, padding, file) != padding) return 0;
+    if (hash) {
+        *hash = checksum_words(*hash, data, bytes);
+        *hash = checksum_words(*hash, zeros, padding);
+    }
+    return 1;
+}
+
+// Written to <filename>.tmp, synced, then renamed over filename, so a crash mid-write
+// never leaves a truncated checkpoint behind; returns 1 on success, 0 on failure
+int save_checkpoint(const NeuralNetwork *nn, const CheckpointState *state, const char *filename) {
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = arena_aligned_size(sizeof(header));
+    header.dtype = CHECKPOINT_DTYPE_FP64;
+    header.activation = state->activation;
+    header.num_layers = nn->num_layers;
+    for (int l = 0; l < nn->num_layers; l++) {
+        header.layer_sizes[l] = nn->layer_sizes[l];
+    }
+    header.epoch = state->epoch;
+    snprintf(header.loss_type, sizeof(header.loss_type), "%s", state->loss_type);
+    header.optimizer = state->optimizer;
+    header.num_parameters = nn->num_parameters;
+    header.parameters_offset = header.header_size;
+    header.optimizer_offset = header.parameters_offset + arena_aligned_size(nn->num_parameters * sizeof(double));
+    header.optimizer_size = state->optimizer_state ? state->optimizer_state_size : 0;
+    header.pool_offset = header.optimizer_offset + arena_aligned_size(header.optimizer_size * sizeof(double));
+    header.pool_size = state->refinement_pool ? state->refinement_pool_size : 0;
+    header.file_size = header.pool_offset + arena_aligned_size(header.pool_size * sizeof(double));
+    header.sampler = state->sampler;
+    header.encoding = nn->encoding.config;
+    header.parameter_inputs = nn->parameter_inputs;
+
+    uint64_t hash = checksum_words(FNV_OFFSET, &header, sizeof(header));
+    hash = checksum_words(hash, nn->parameters, nn->num_parameters * sizeof(double));
+    hash = checksum_words(hash, state->optimizer_state, header.optimizer_size * sizeof(double));
+    hash = checksum_words(hash, state->refinement_pool, header.pool_size * sizeof(double));
+    header.checksum = hash;
+
+    char temp_filename[512];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+    FILE *file = fopen(temp_filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file for saving checkpoint: %s\n", temp_filename);
+        return 0;
+    }
+
+    int ok = write_blob(file, &header, sizeof(header), NULL) &&
+             write_blob(file, nn->parameters, nn->num_parameters * sizeof(double), NULL) &&
+             write_blob(file, state->optimizer_state, header.optimizer_size * sizeof(double), NULL) &&
+             write_blob(file, state->refinement_pool, header.pool_size * sizeof(double), NULL) &&
+             fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(temp_filename, filename) != 0) {
+        fprintf(stderr, "Error writing checkpoint: %s\n", filename);
+        unlink(temp_filename);
+        return 0;
+    }
+    return 1;
+}
+
+// Map the checkpoint copy-on-write and point the network's parameters straight at it:
+// inference touches no copy, and training only copies the pages it updates. The optimizer
+// state in *state also points into the mapping, which lives as long as the network.
+int load_checkpoint(NeuralNetwork *nn, const char *filename, CheckpointState *state) {
+    memset(nn, 0, sizeof(*nn));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening checkpoint: %s\n", filename);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader)) {
+        fprintf(stderr, "Error: %s is too small to be a checkpoint\n", filename);
+        close(fd);
+        return 0;
+    }
+    size_t size = (size_t)st.st_size;
+    char *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error mapping checkpoint: %s\n", filename);
+        return 0;
+    }
+
+    const CheckpointHeader *header = (const CheckpointHeader *)mapping;
+    const char *problem = NULL;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a checkpoint";
+    } else if (header->version != CHECKPOINT_VERSION) {
+        problem = "unsupported version";
+    } else if (header->dtype != CHECKPOINT_DTYPE_FP64) {
+        problem = "unsupported dtype";
+    } else if (header->file_size != size || header->header_size % ARENA_ALIGNMENT != 0 ||
+               header->parameters_offset % ARENA_ALIGNMENT != 0 || header->optimizer_offset % ARENA_ALIGNMENT != 0 || header->pool_offset % ARENA_ALIGNMENT != 0 ||
+               header->parameters_offset + header->num_parameters * sizeof(double) > size ||
+               header->optimizer_offset + header->optimizer_size * sizeof(double) > size ||
+               header->pool_offset + header->pool_size * sizeof(double) > size) {
+        problem = "truncated or inconsistent layout";
+    } else if (header->num_layers < 2 || header->num_layers > MAX_LAYERS) {
+        problem = "invalid layer spec";
+    } else {
+        CheckpointHeader unsigned_header = *header;
+        unsigned_header.checksum = 0;
+        uint64_t hash = checksum_words(FNV_OFFSET, &unsigned_header, sizeof(unsigned_header));
+        hash = checksum_words(hash, mapping + header->parameters_offset, header->num_parameters * sizeof(double));
+        hash = checksum_words(hash, mapping + header->optimizer_offset, header->optimizer_size * sizeof(double));
+        hash = checksum_words(hash, mapping + header->pool_offset, header->pool_size * sizeof(double));
+        if (hash != header->checksum) {
+            problem = "checksum mismatch";
+        }
+    }
+
+    int layer_sizes[MAX_LAYERS];
+    if (problem == NULL) {
+        for (int l = 0; l < header->num_layers; l++) {
+            layer_sizes[l] = header->layer_sizes[l];
+        }
+        if (!allocate_encoded_network(nn, layer_sizes, header->num_layers, &header->encoding, (double *)(mapping + header->parameters_offset))) {
+            problem = "invalid layer spec";
+        } else if (nn->num_parameters != header->num_parameters) {
+            free_neural_network(nn);
+            problem = "parameter count does not match the layer spec";
+        } else if (!set_parameter_inputs(nn, &header->parameter_inputs)) {
+            free_neural_network(nn);
+            problem = "invalid parameter inputs";
+        }
+    }
+    if (problem) {
+        fprintf(stderr, "Error loading checkpoint %s: %s\n", filename, problem);
+        munmap(mapping, size);
+        return 0;
+    }
+    nn->mapping = mapping;
+    nn->mapping_size = size;
+
+    if (state) {
+        memset(state, 0, sizeof(*state));
+        state->epoch = header->epoch;
+        state->activation = (ActivationFunction)header->activation;
+        memcpy(state->loss_type, header->loss_type, sizeof(state->loss_type));
+        state->loss_type[sizeof(state->loss_type) - 1] = '\0';
+        state->sampler = header->sampler;
+        state->optimizer = header->optimizer;
+        state->optimizer_state = header->optimizer_size ? (const double *)(mapping + header->optimizer_offset) : NULL;
+        state->optimizer_state_size = header->optimizer_size;
+        state->refinement_pool = header->pool_size ? (const double *)(mapping + header->pool_offset) : NULL;
+        state->refinement_pool_size = header->pool_size;
+    }
+    return 1;
+}
+
+// Parameters only, for inference and export
+int save_model(const NeuralNetwork *nn, const char *loss_type, ActivationFunction activation, const char *filename) {
+    CheckpointState state;
+    memset(&state, 0, sizeof(state));
+    state.activation = activation;
+    snprintf(state.loss_type, sizeof(state.loss_type), "%s", loss_type);
+    if (!save_checkpoint(nn, &state, filename)) {
+        return 0;
+    }
+    printf("Model saved to %s\n", filename);
+    return 1;
+}
+
+int load_model(NeuralNetwork *nn, const char *filename, ActivationFunction *activation) {
+    CheckpointState state;
+    if (!load_checkpoint(nn, filename, &state)) {
+        return 0;
+    }
+    if (activation) {
+        *activation = state.activation;
+    }
+    return 1;
+}
@@ -0,0 +1,703 @@
+#include "decomposition.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+// Points per forward/backward sweep of a subdomain network
+#define SUBDOMAIN_CHUNK 512
+
+// Faces of two boxes closer than this (relative to the domain) are the same plane
+#define FACE_TOLERANCE 1e-9
+
+static const double unit_weights[TERM_COUNT] = {1.0, 1.0, 1.0, 1.0};
+
+// An interface with the points it is currently enforced on
+typedef struct {
+    InterfaceFace face;
+    double *points;                     // [interface_points][dims]
+    double *values[2];                  // Side a and b at the last exchange: [point][values..., derivatives...]
+    double *targets;                    // Their average
+} Interface;
+
+// One box with its own network, sampler, tape and optimizer. During a round only the
+// worker that owns the box touches any of it.
+typedef struct {
+    NeuralNetwork *nn;
+    Domain box;
+    Domain extended;                    // box widened by the overlap, clipped to the domain
+    int external[SAMPLER_MAX_DIMS][2];  // Faces of box that lie on the domain boundary
+    Sampler sampler;
+    CollocationBatch batch;             // Sampler batch without the boundary points on internal faces
+    CollocationBatch validation;        // Validation points inside box
+    JetWorkspace ws;
+    Optimizer optimizer;
+    LearningRateSchedule schedule;
+    int sides[2 * DECOMPOSITION_MAX_INTERFACES]; // 2 * interface + side (0 below the face, 1 above)
+    int num_sides;
+    double *round_losses;               // Loss, learning rate and validation loss (NAN if not
+    double *round_rates;                // validated) of every epoch of the round
+    double *round_validation;
+    double terms[TERM_COUNT];
+    double interface_sums[INTERFACE_TERM_COUNT];
+    double loss;
+    double validation_terms[TERM_COUNT];
+    double validation_loss;
+} Subdomain;
+
+typedef struct {
+    const DecompositionConfig *config;
+    const PdeOperator *op;
+    const LossParameters *params;
+    ActivationFunction activation;
+    int dims;
+    Subdomain *subdomains;
+    int num_subdomains;
+    Interface *interfaces;
+    int num_interfaces;
+    double weights[TERM_COUNT];
+    ThreadPool pool;
+    int num_workers;
+    Arena arena;
+
+    int round_begin;                    // Current round: epochs [round_begin, round_end)
+    int round_end;
+    unsigned char *validate;            // Epochs of the round that are logged, and so validated
+} Decomposition;
+
+void default_decomposition_config(DecompositionConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->exchange_every = 10;
+    config->interface_points = 256;
+    config->weights[INTERFACE_CONTINUITY] = 1.0;
+    config->weights[INTERFACE_FLUX] = 1.0;
+}
+
+int parse_decomposition(const char *path, DecompositionConfig *config) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open decomposition file %s\n", path);
+        return 0;
+    }
+    default_decomposition_config(config);
+    char line[1024];
+    int number = 0, ok = 1;
+    while (ok && fgets(line, sizeof(line), file)) {
+        number++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char key[32], value[512], extra[256];
+        int fields = sscanf(line, "%31s %511s %255s", key, value, extra);
+        if (fields <= 0) continue;
+
+        if (fields >= 2 && strcmp(key, "subdomain") == 0 && config->num_subdomains < DECOMPOSITION_MAX_SUBDOMAINS) {
+            int k = config->num_subdomains++;
+            ok = parse_domain(value, &config->boxes[k]);
+            if (ok && fields == 3) {
+                config->num_layers[k] = parse_layer_spec(extra, config->layer_sizes[k]);
+                ok = config->num_layers[k] > 0;
+            }
+        } else if (fields == 2 && strcmp(key, "overlap") == 0) {
+            config->overlap = atof(value);
+            ok = config->overlap >= 0.0 && config->overlap < 1.0;
+        } else if (fields == 2 && strcmp(key, "exchange_every") == 0) {
+            config->exchange_every = atoi(value);
+            ok = config->exchange_every > 0;
+        } else if (fields == 2 && strcmp(key, "interface_points") == 0) {
+            config->interface_points = atoi(value);
+            ok = config->interface_points > 0;
+        } else if (fields == 2 && strcmp(key, "interface_weight") == 0) {
+            config->weights[INTERFACE_CONTINUITY] = atof(value);
+        } else if (fields == 2 && strcmp(key, "flux_weight") == 0) {
+            config->weights[INTERFACE_FLUX] = atof(value);
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Error: %s:%d: invalid line\n", path, number);
+        return 0;
+    }
+    if (config->num_subdomains == 0) {
+        fprintf(stderr, "Error: %s lists no subdomains\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+static double box_volume(const Domain *box) {
+    double volume = 1.0;
+    for (int j = 0; j < box->dims; j++) {
+        volume *= box->upper[j] - box->lower[j];
+    }
+    return volume;
+}
+
+static double overlap_volume(const Domain *a, const Domain *b) {
+    double volume = 1.0;
+    for (int j = 0; j < a->dims; j++) {
+        double lo = fmax(a->lower[j], b->lower[j]);
+        double hi = fmin(a->upper[j], b->upper[j]);
+        volume *= hi > lo ? hi - lo : 0.0;
+    }
+    return volume;
+}
+
+static double axis_tolerance(const Domain *box, int axis) {
+    return FACE_TOLERANCE * fmax(1.0, fmax(fabs(box->lower[axis]), fabs(box->upper[axis])));
+}
+
+// Pairwise disjoint boxes inside the domain whose volumes add up to it cover it exactly
+int validate_decomposition(const DecompositionConfig *config, const Domain *domain) {
+    double domain_volume = box_volume(domain);
+    double covered = 0.0;
+    for (int k = 0; k < config->num_subdomains; k++) {
+        const Domain *box = &config->boxes[k];
+        if (box->dims != domain->dims) {
+            fprintf(stderr, "Error: Subdomain %d has %d axes but the domain has %d\n", k, box->dims, domain->dims);
+            return 0;
+        }
+        for (int j = 0; j < box->dims; j++) {
+            double tolerance = axis_tolerance(domain, j);
+            if (box->lower[j] < domain->lower[j] - tolerance || box->upper[j] > domain->upper[j] + tolerance) {
+                fprintf(stderr, "Error: Subdomain %d reaches outside the domain along axis %d\n", k, j);
+                return 0;
+            }
+        }
+        for (int m = 0; m < k; m++) {
+            if (overlap_volume(box, &config->boxes[m]) > FACE_TOLERANCE * domain_volume) {
+                fprintf(stderr, "Error: Subdomains %d and %d overlap (use the overlap setting instead)\n", m, k);
+                return 0;
+            }
+        }
+        covered += box_volume(box);
+    }
+    if (fabs(covered - domain_volume) > FACE_TOLERANCE * domain_volume * config->num_subdomains) {
+        fprintf(stderr, "Error: The subdomains cover %g of a domain of volume %g\n", covered, domain_volume);
+        return 0;
+    }
+    return 1;
+}
+
+int find_interfaces(const DecompositionConfig *config, InterfaceFace *faces, int capacity) {
+    int count = 0;
+    for (int a = 0; a < config->num_subdomains; a++) {
+        for (int b = a + 1; b < config->num_subdomains; b++) {
+            const Domain *boxes[2] = {&config->boxes[a], &config->boxes[b]};
+            for (int axis = 0; axis < boxes[0]->dims; axis++) {
+                // Which box, if either, ends where the other starts
+                int below = -1;
+                if (fabs(boxes[0]->upper[axis] - boxes[1]->lower[axis]) <= axis_tolerance(boxes[0], axis)) below = 0;
+                else if (fabs(boxes[1]->upper[axis] - boxes[0]->lower[axis]) <= axis_tolerance(boxes[1], axis)) below = 1;
+                if (below < 0) continue;
+
+                InterfaceFace face;
+                face.a = below == 0 ? a : b;
+                face.b = below == 0 ? b : a;
+                face.axis = axis;
+                face.face.dims = boxes[0]->dims;
+                int shared = 1;
+                for (int j = 0; j < face.face.dims; j++) {
+                    if (j == axis) {
+                        face.face.lower[j] = face.face.upper[j] = boxes[below]->upper[axis];
+                        continue;
+                    }
+                    face.face.lower[j] = fmax(boxes[0]->lower[j], boxes[1]->lower[j]);
+                    face.face.upper[j] = fmin(boxes[0]->upper[j], boxes[1]->upper[j]);
+                    shared &= face.face.upper[j] - face.face.lower[j] > axis_tolerance(boxes[0], j);
+                }
+                if (!shared) continue;
+                if (count == capacity) return -1;
+                faces[count++] = face;
+            }
+        }
+    }
+    return count;
+}
+
+void interface_loss_terms(const JetBatch *jets, int count, const double *targets, int axis, int outputs, const double *weights, double *sums) {
+    PROFILE_SCOPE(PROF_LOSS);
+    for (int p = 0; p < count; p++) {
+        PointDerivatives pd;
+        PointAdjoint adjoint;
+        const double *target = targets + (size_t)p * 2 * outputs;
+        jet_batch_point(jets, p, &pd);
+        if (jets->adjoints) jet_batch_adjoint(jets, p, 1.0, &adjoint);
+        for (int k = 0; k < outputs; k++) {
+            double jump = pd_value(&pd, k) - target[k];
+            double flux_jump = pd_first(&pd, axis, k) - target[outputs + k];
+            sums[INTERFACE_CONTINUITY] += jump * jump;
+            sums[INTERFACE_FLUX] += flux_jump * flux_jump;
+            if (jets->adjoints) {
+                adjoint.u[k] += 2.0 * weights[INTERFACE_CONTINUITY] * jump;
+                adjoint.du[axis * pd.output_dim + k] += 2.0 * weights[INTERFACE_FLUX] * flux_jump;
+            }
+        }
+    }
+}
+
+static int box_contains(const Domain *box, const double *x) {
+    for (int j = 0; j < box->dims; j++) {
+        if (x[j] < box->lower[j] || x[j] > box->upper[j]) return 0;
+    }
+    return 1;
+}
+
+// Owner of a point: the first box containing it, so points on shared faces count once
+static int owner_of(const Decomposition *d, const double *x) {
+    for (int k = 0; k < d->num_subdomains; k++) {
+        if (box_contains(&d->subdomains[k].box, x)) return k;
+    }
+    return -1;
+}
+
+// Split the validation set by owner. With points == NULL only the group sizes are counted.
+static void route_validation(Decomposition *d, const CollocationBatch *set) {
+    int dims = d->dims;
+    int total = collocation_batch_size(set);
+    int filled[DECOMPOSITION_MAX_SUBDOMAINS] = {0};
+    for (int n = 0; n < total; n++) {
+        const double *x = set->points + (size_t)n * dims;
+        int k = owner_of(d, x);
+        if (k < 0) continue;
+        CollocationBatch *share = &d->subdomains[k].validation;
+        if (share->points) {
+            memcpy(share->points + (size_t)filled[k]++ * dims, x, dims * sizeof(double));
+        } else if (n < set->num_interior) {
+            share->num_interior++;
+        } else if (n < set->num_interior + set->num_boundary) {
+            share->num_boundary++;
+        } else {
+            share->num_initial++;
+        }
+    }
+}
+
+// Copy a sampler batch, keeping only the boundary points that lie on the domain boundary.
+// The sampler visits faces round-robin (axis (n % faces) / 2, side n % 2), so a point's
+// face follows from its index.
+static void route_batch(Subdomain *s, const CollocationBatch *raw, int dims) {
+    int faces = 2 * (dims - 1);
+    size_t row = dims * sizeof(double);
+    memcpy(s->batch.points, raw->points, raw->num_interior * row);
+    double *dst = s->batch.points + (size_t)raw->num_interior * dims;
+    const double *boundary = raw->points + (size_t)raw->num_interior * dims;
+    int kept = 0;
+    for (int n = 0; n < raw->num_boundary; n++) {
+        if (s->external[(n % faces) / 2][n % 2]) {
+            memcpy(dst + (size_t)kept++ * dims, boundary + (size_t)n * dims, row);
+        }
+    }
+    memcpy(dst + (size_t)kept * dims, boundary + (size_t)raw->num_boundary * dims, raw->num_initial * row);
+    s->batch.num_interior = raw->num_interior;
+    s->batch.num_boundary = kept;
+    s->batch.num_initial = raw->num_initial;
+}
+
+// Each side's values and derivatives along the interface normal at the current parameters
+static void evaluate_sides(Decomposition *d, Subdomain *s) {
+    int outputs = d->op->num_outputs;
+    int count = d->config->interface_points;
+    for (int i = 0; i < s->num_sides; i++) {
+        Interface *iface = &d->interfaces[s->sides[i] / 2];
+        double *values = iface->values[s->sides[i] % 2];
+        for (int start = 0; start < count; start += s->ws.capacity) {
+            int chunk = count - start < s->ws.capacity ? count - start : s->ws.capacity;
+            JetBatch jets;
+            forward_pass_jet(s->nn, &s->ws, iface->points + (size_t)start * d->dims, chunk, d->activation);
+            jet_output_batch(s->nn, &s->ws, 0, &jets);
+            for (int p = 0; p < chunk; p++) {
+                PointDerivatives pd;
+                double *v = values + (size_t)(start + p) * 2 * outputs;
+                jet_batch_point(&jets, p, &pd);
+                for (int k = 0; k < outputs; k++) {
+                    v[k] = pd_value(&pd, k);
+                    v[outputs + k] = pd_first(&pd, iface->face.axis, k);
+                }
+            }
+        }
+    }
+}
+
+// PDE terms of a whole batch; with_gradients also adds their gradients into s->nn->gradients
+static void batch_terms(Decomposition *d, Subdomain *s, const CollocationBatch *batch, const double *weights, double *sums, int with_gradients) {
+    int n = collocation_batch_size(batch);
+    for (int start = 0; start < n; start += s->ws.capacity) {
+        int chunk = n - start < s->ws.capacity ? n - start : s->ws.capacity;
+        JetBatch jets;
+        forward_pass_jet(s->nn, &s->ws, batch->points + (size_t)start * d->dims, chunk, d->activation);
+        if (with_gradients) clear_jet_adjoints(s->nn, &s->ws, chunk);
+        jet_output_batch(s->nn, &s->ws, with_gradients, &jets);
+        composite_loss_terms(&jets, batch, start, chunk, d->op, d->params, weights, sums);
+        if (with_gradients) backward_pass_jet(s->nn, &s->ws, chunk, d->activation, s->nn->gradients);
+    }
+}
+
+// Interface terms of every side of s, as means over all of its interface points
+static double interface_terms(Decomposition *d, Subdomain *s) {
+    const DecompositionConfig *config = d->config;
+    int outputs = d->op->num_outputs;
+    int count = config->interface_points;
+    int total = s->num_sides * count;
+    memset(s->interface_sums, 0, sizeof(s->interface_sums));
+    if (total == 0) {
+        return 0.0;
+    }
+    double weights[INTERFACE_TERM_COUNT];
+    for (int t = 0; t < INTERFACE_TERM_COUNT; t++) {
+        weights[t] = config->weights[t] / total;
+    }
+    for (int i = 0; i < s->num_sides; i++) {
+        const Interface *iface = &d->interfaces[s->sides[i] / 2];
+        for (int start = 0; start < count; start += s->ws.capacity) {
+            int chunk = count - start < s->ws.capacity ? count - start : s->ws.capacity;
+            JetBatch jets;
+            forward_pass_jet(s->nn, &s->ws, iface->points + (size_t)start * d->dims, chunk, d->activation);
+            clear_jet_adjoints(s->nn, &s->ws, chunk);
+            jet_output_batch(s->nn, &s->ws, 1, &jets);
+            interface_loss_terms(&jets, chunk, iface->targets + (size_t)start * 2 * outputs, iface->face.axis, outputs, weights, s->interface_sums);
+            backward_pass_jet(s->nn, &s->ws, chunk, d->activation, s->nn->gradients);
+        }
+    }
+    double loss = 0.0;
+    for (int t = 0; t < INTERFACE_TERM_COUNT; t++) {
+        loss += weights[t] * s->interface_sums[t];
+    }
+    return loss;
+}
+
+static void train_epoch(Decomposition *d, Subdomain *s, int epoch) {
+    PROFILE_BEGIN(epoch_start);
+    PROFILE_BEGIN(sampler_start);
+    route_batch(s, sampler_next_batch(&s->sampler), d->dims);
+    PROFILE_END(PROF_SAMPLER, sampler_start);
+
+    memset(s->nn->gradients, 0, s->nn->num_parameters * sizeof(double));
+    memset(s->terms, 0, sizeof(s->terms));
+    batch_terms(d, s, &s->batch, d->weights, s->terms, 1);
+    double loss = combine_loss_terms(s->terms, &s->batch, d->weights, NULL) + interface_terms(d, s);
+
+    PROFILE_BEGIN(optimizer_start);
+    double next_loss = loss;
+    double learning_rate = schedule_learning_rate(&s->schedule, epoch);
+    optimizer_step(&s->optimizer, s->nn->parameters, s->nn->gradients, &next_loss, learning_rate, NULL, NULL);
+    s->round_rates[epoch - d->round_begin] = learning_rate;
+    PROFILE_END(PROF_OPTIMIZER, optimizer_start);
+    s->round_losses[epoch - d->round_begin] = loss;
+    s->loss = loss;
+    PROFILE_END(PROF_EPOCH, epoch_start);
+}
+
+// Subdomains stay with one worker for the whole run and never wait on each other within
+// a round; the pool returns once every box has trained its epochs of the round
+static void round_task(void *context, int worker, int num_workers) {
+    Decomposition *d = context;
+    for (int k = worker; k < d->num_subdomains; k += num_workers) {
+        Subdomain *s = &d->subdomains[k];
+        for (int epoch = d->round_begin; epoch < d->round_end; epoch++) {
+            train_epoch(d, s, epoch);
+            s->round_validation[epoch - d->round_begin] = NAN;
+            if (d->validate[epoch - d->round_begin]) {
+                PROFILE_BEGIN(validation_start);
+                memset(s->validation_terms, 0, sizeof(s->validation_terms));
+                batch_terms(d, s, &s->validation, unit_weights, s->validation_terms, 0);
+                s->validation_loss = combine_loss_terms(s->validation_terms, &s->validation, unit_weights, NULL);
+                s->round_validation[epoch - d->round_begin] = s->validation_loss;
+                PROFILE_END(PROF_VALIDATION, validation_start);
+            }
+        }
+    }
+}
+
+static void exchange_task(void *context, int worker, int num_workers) {
+    Decomposition *d = context;
+    for (int k = worker; k < d->num_subdomains; k += num_workers) {
+        evaluate_sides(d, &d->subdomains[k]);
+    }
+}
+
+// Redraw the interface points, evaluate both sides there and aim each at their average
+static void exchange(Decomposition *d, Sampler *unit) {
+    int count = d->config->interface_points;
+    size_t values = (size_t)count * 2 * d->op->num_outputs;
+    for (int i = 0; i < d->num_interfaces; i++) {
+        Interface *iface = &d->interfaces[i];
+        const Domain *face = &iface->face.face;
+        sampler_uniform_points(unit, iface->points, count);
+        for (size_t n = 0; n < (size_t)count * d->dims; n++) {
+            int j = (int)(n % d->dims);
+            iface->points[n] = face->lower[j] + (face->upper[j] - face->lower[j]) * iface->points[n];
+        }
+    }
+    thread_pool_run(&d->pool, exchange_task, d);
+    for (int i = 0; i < d->num_interfaces; i++) {
+        Interface *iface = &d->interfaces[i];
+        for (size_t v = 0; v < values; v++) {
+            iface->targets[v] = 0.5 * (iface->values[0][v] + iface->values[1][v]);
+        }
+    }
+}
+
+// Interior points are shared out by volume, boundary points by the number of faces on
+// the domain boundary and initial points among the boxes that touch t = t0
+static void point_budget(const Decomposition *d, const TrainingConfig *config, const Domain *domain, int k, int *interior, int *boundary, int *initial) {
+    const Subdomain *s = &d->subdomains[k];
+    int time = d->dims - 1, faces = 2 * time;
+    int external = 0, total_external = 0, touching = 0;
+    for (int m = 0; m < d->num_subdomains; m++) {
+        const Subdomain *other = &d->subdomains[m];
+        for (int j = 0; j < time; j++) {
+            int count = other->external[j][0] + other->external[j][1];
+            total_external += count;
+            if (m == k) external += count;
+        }
+        touching += other->external[time][0];
+    }
+    *interior = (int)ceil(config->interior_points * box_volume(&s->box) / box_volume(domain));
+    *boundary = 0;
+    if (external > 0 && config->boundary_points > 0) {
+        // The sampler spreads its points over every face, and only the external ones are kept
+        int kept = (int)ceil((double)config->boundary_points * external / total_external);
+        *boundary = (kept + external - 1) / external * faces;
+    }
+    *initial = s->external[time][0] && config->initial_points > 0 ? (config->initial_points + touching - 1) / touching : 0;
+}
+
+static void free_decomposition(Decomposition *d) {
+    if (d->pool.num_threads > 0) {
+        thread_pool_free(&d->pool);
+    }
+    for (int k = 0; d->subdomains && k < d->num_subdomains; k++) {
+        Subdomain *s = &d->subdomains[k];
+        sampler_free(&s->sampler);
+        free_jet_workspace(&s->ws);
+        optimizer_free(&s->optimizer);
+    }
+    arena_free(&d->arena);
+}
+
+// Boxes, samplers, tapes, optimizers and interfaces; everything except the networks
+static int init_decomposition(Decomposition *d, NeuralNetwork *nets, const InterfaceFace *faces, const Domain *domain, const CollocationBatch *validation_set, const TrainingConfig *config) {
+    const DecompositionConfig *dc = d->config;
+    int dims = d->dims, outputs = d->op->num_outputs;
+    size_t round_bytes = (size_t)dc->exchange_every * sizeof(double);
+    size_t face_bytes = (size_t)dc->interface_points * dims * sizeof(double);
+    size_t value_bytes = (size_t)dc->interface_points * 2 * outputs * sizeof(double);
+
+    // Boxes first: the point budgets and so the buffer sizes depend on which faces are external
+    Subdomain boxes[DECOMPOSITION_MAX_SUBDOMAINS];
+    memset(boxes, 0, sizeof(boxes));
+    d->subdomains = boxes;
+    for (int k = 0; k < d->num_subdomains; k++) {
+        Subdomain *s = &boxes[k];
+        s->box = dc->boxes[k];
+        s->extended = s->box;
+        for (int j = 0; j < dims; j++) {
+            double margin = dc->overlap * (s->box.upper[j] - s->box.lower[j]);
+            s->extended.lower[j] = fmax(domain->lower[j], s->box.lower[j] - margin);
+            s->extended.upper[j] = fmin(domain->upper[j], s->box.upper[j] + margin);
+            s->external[j][0] = s->box.lower[j] <= domain->lower[j] + axis_tolerance(domain, j);
+            s->external[j][1] = s->box.upper[j] >= domain->upper[j] - axis_tolerance(domain, j);
+        }
+    }
+    route_validation(d, validation_set);
+
+    int interior[DECOMPOSITION_MAX_SUBDOMAINS], boundary[DECOMPOSITION_MAX_SUBDOMAINS], initial[DECOMPOSITION_MAX_SUBDOMAINS];
+    size_t total = arena_aligned_size(d->num_subdomains * sizeof(Subdomain)) + arena_aligned_size(d->num_interfaces * sizeof(Interface)) + arena_aligned_size(dc->exchange_every) +
+                   d->num_interfaces * (arena_aligned_size(face_bytes) + 3 * arena_aligned_size(value_bytes));
+    for (int k = 0; k < d->num_subdomains; k++) {
+        point_budget(d, config, domain, k, &interior[k], &boundary[k], &initial[k]);
+        total += arena_aligned_size((size_t)(interior[k] + boundary[k] + initial[k]) * dims * sizeof(double)) +
+                 arena_aligned_size((size_t)collocation_batch_size(&boxes[k].validation) * dims * sizeof(double)) + 3 * arena_aligned_size(round_bytes);
+    }
+    d->subdomains = NULL;
+    if (!arena_init(&d->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate the decomposition buffers\n");
+        return 0;
+    }
+    d->subdomains = arena_alloc(&d->arena, d->num_subdomains * sizeof(Subdomain));
+    memcpy(d->subdomains, boxes, d->num_subdomains * sizeof(Subdomain));
+
+    d->validate = arena_alloc(&d->arena, dc->exchange_every);
+    d->interfaces = arena_alloc(&d->arena, d->num_interfaces * sizeof(Interface));
+    for (int i = 0; i < d->num_interfaces; i++) {
+        Interface *iface = &d->interfaces[i];
+        iface->face = faces[i];
+        iface->points = arena_alloc(&d->arena, face_bytes);
+        iface->values[0] = arena_alloc(&d->arena, value_bytes);
+        iface->values[1] = arena_alloc(&d->arena, value_bytes);
+        iface->targets = arena_alloc(&d->arena, value_bytes);
+        Subdomain *a = &d->subdomains[faces[i].a];
+        Subdomain *b = &d->subdomains[faces[i].b];
+        a->sides[a->num_sides++] = 2 * i;
+        b->sides[b->num_sides++] = 2 * i + 1;
+    }
+
+    for (int k = 0; k < d->num_subdomains; k++) {
+        Subdomain *s = &d->subdomains[k];
+        s->nn = &nets[k];
+        s->batch.points = arena_alloc(&d->arena, (size_t)(interior[k] + boundary[k] + initial[k]) * dims * sizeof(double));
+        s->validation.points = arena_alloc(&d->arena, (size_t)collocation_batch_size(&s->validation) * dims * sizeof(double));
+        s->round_losses = arena_alloc(&d->arena, round_bytes);
+        s->round_rates = arena_alloc(&d->arena, round_bytes);
+        s->round_validation = arena_alloc(&d->arena, round_bytes);
+        s->validation_loss = NAN;
+        s->schedule = config->schedule;
+        s->schedule.base_rate = config->learning_rate;
+        s->schedule.total_epochs = config->epochs;
+        if (!sampler_init(&s->sampler, &s->extended, config->sampling, interior[k], boundary[k], initial[k], config->seed + (uint64_t)k, 0) ||
+            !init_jet_workspace(&s->ws, s->nn, SUBDOMAIN_CHUNK, d->op->derivative_order, PRECISION_FP64) ||
+            !optimizer_init(&s->optimizer, &config->optimizer, s->nn->num_parameters)) {
+            return 0;
+        }
+    }
+    route_validation(d, validation_set);
+
+    d->num_workers = config->threads > 0 ? config->threads : available_cores();
+    if (d->num_workers > d->num_subdomains) d->num_workers = d->num_subdomains;
+    if (!thread_pool_init(&d->pool, d->num_workers)) {
+        fprintf(stderr, "Error: Failed to start %d worker threads\n", d->num_workers);
+        return 0;
+    }
+    return 1;
+}
+
+int train_decomposition(NeuralNetwork *nets, const DecompositionConfig *decomposition, const char *loss_type, const LossParameters *params, const TrainingConfig *config) {
+    int input_size = nn_input_size(&nets[0]);
+    const PdeOperator *op = find_pde_operator(loss_type);
+    if (op == NULL) {
+        fprintf(stderr, "Unknown loss type: %s\n", loss_type);
+        return 0;
+    }
+    for (int k = 0; k < decomposition->num_subdomains; k++) {
+        if (nn_input_size(&nets[k]) != input_size || nn_output_size(&nets[k]) < op->num_outputs || input_size < op->min_inputs || input_size > op->max_inputs) {
+            fprintf(stderr, "Error: The network of subdomain %d (%d inputs, %d outputs) does not fit %s\n", k, nn_input_size(&nets[k]), nn_output_size(&nets[k]), loss_type);
+            return 0;
+        }
+    }
+    if (nn_parametric(&nets[0])) {
+        fprintf(stderr, "Error: Decomposed runs do not support parameter inputs\n");
+        return 0;
+    }
+    if (config->optimizer.type == OPTIMIZER_LBFGS || config->lbfgs_epochs > 0) {
+        fprintf(stderr, "Error: Decomposed runs train with first-order optimizers only (no L-BFGS)\n");
+        return 0;
+    }
+    Domain domain = config->domain;
+    if (domain.dims == 0) {
+        unit_domain(&domain, input_size);
+    }
+    if (domain.dims != input_size) {
+        fprintf(stderr, "Error: The domain has %d axes but the network takes %d inputs (space..., time)\n", domain.dims, input_size);
+        return 0;
+    }
+    if (!validate_decomposition(decomposition, &domain)) {
+        return 0;
+    }
+    InterfaceFace faces[DECOMPOSITION_MAX_INTERFACES];
+    int num_interfaces = find_interfaces(decomposition, faces, DECOMPOSITION_MAX_INTERFACES);
+    if (num_interfaces < 0) {
+        fprintf(stderr, "Error: More than %d interfaces between subdomains\n", DECOMPOSITION_MAX_INTERFACES);
+        return 0;
+    }
+    if (config->precision != PRECISION_FP64 || config->loss_weighting.method != WEIGHTING_FIXED || config->refine_every > 0) {
+        fprintf(stderr, "Error: Decomposed runs train in fp64 with fixed term weights (no --precision, --loss_weighting or --refine_every)\n");
+        return 0;
+    }
+
+    profile_reset();
+    Decomposition d;
+    memset(&d, 0, sizeof(d));
+    d.config = decomposition;
+    d.op = op;
+    d.params = params;
+    d.activation = config->activation;
+    d.dims = domain.dims;
+    d.num_subdomains = decomposition->num_subdomains;
+    d.num_interfaces = num_interfaces;
+    int active_terms[TERM_COUNT] = {1, config->boundary_points > 0, config->initial_points > 0, op->conservation != NULL};
+    for (int i = 0; i < TERM_COUNT; i++) {
+        d.weights[i] = active_terms[i] ? config->loss_weighting.weights[i] : 0.0;
+    }
+
+    Sampler validation_sampler = {0};
+    Sampler interface_sampler = {0};
+    TrainingLogger loggers[DECOMPOSITION_MAX_SUBDOMAINS];
+    int num_loggers = 0, trained = 0;
+
+    // The validation set of a single run, split among the boxes. Box k samples with key
+    // seed + k and the interface points come from the key after the last box.
+    int validation_boundary = config->boundary_points > 0 ? config->validation_points / 4 : 0;
+    int validation_initial = config->initial_points > 0 ? config->validation_points / 4 : 0;
+    Domain unit;
+    unit_domain(&unit, d.dims);
+    if (!sampler_init(&validation_sampler, &domain, SAMPLE_SOBOL, config->validation_points, validation_boundary, validation_initial, 0xC0FFEEULL, 0) ||
+        !sampler_init(&interface_sampler, &unit, SAMPLE_UNIFORM, 1, 0, 0, config->seed + (uint64_t)d.num_subdomains, 0)) {
+        goto cleanup;
+    }
+    CollocationBatch validation_batch = *sampler_next_batch(&validation_sampler);
+    if (!init_decomposition(&d, nets, faces, &domain, &validation_batch, config)) {
+        goto cleanup;
+    }
+    // One writer thread serves the logs of every box
+    if (!logger_open_group(loggers, d.num_subdomains, loss_type, config->log_format, config->log_every)) {
+        goto cleanup;
+    }
+    num_loggers = d.num_subdomains;
+    size_t footprint = 0;
+    for (int k = 0; k < d.num_subdomains; k++) {
+        footprint += nets[k].num_parameters;
+    }
+    printf("Training %d subdomains with %d interface(s) on %d thread(s), %zu parameters in total; logs %s to %s\n", d.num_subdomains, d.num_interfaces,
+           d.num_workers, footprint, loggers[0].path, loggers[d.num_subdomains - 1].path);
+
+    for (d.round_begin = 0; d.round_begin < config->epochs; d.round_begin = d.round_end) {
+        d.round_end = d.round_begin + decomposition->exchange_every;
+        if (d.round_end > config->epochs) d.round_end = config->epochs;
+        for (int epoch = d.round_begin; epoch < d.round_end; epoch++) {
+            d.validate[epoch - d.round_begin] = (unsigned char)logger_wants_epoch(&loggers[0], epoch, config->epochs);
+        }
+
+        exchange(&d, &interface_sampler);
+        thread_pool_run(&d.pool, round_task, &d);
+
+        // Only this thread writes the logs, once the round is over
+        PROFILE_BEGIN(log_start);
+        for (int k = 0; k < d.num_subdomains; k++) {
+            const Subdomain *s = &d.subdomains[k];
+            for (int n = 0; n < d.round_end - d.round_begin; n++) {
+                if (d.validate[n]) {
+                    logger_record(&loggers[k], d.round_begin + n, s->round_losses[n], s->round_validation[n], d.round_begin + n, s->round_rates[n]);
+                }
+            }
+        }
+        PROFILE_END(PROF_LOG, log_start);
+    }
+
+    double stitched[TERM_COUNT] = {0};
+    for (int k = 0; k < d.num_subdomains; k++) {
+        const Subdomain *s = &d.subdomains[k];
+        int interface_count = s->num_sides * decomposition->interface_points;
+        double continuity = interface_count > 0 ? s->interface_sums[INTERFACE_CONTINUITY] / interface_count : 0.0;
+        double flux = interface_count > 0 ? s->interface_sums[INTERFACE_FLUX] / interface_count : 0.0;
+        printf("Subdomain %d (%d interface side(s)): loss %.5f, validation loss %.5f, interface continuity %.3e, flux %.3e -> %s\n", k, s->num_sides, s->loss,
+               s->validation_loss, continuity, flux, loggers[k].path);
+        for (int t = 0; t < TERM_COUNT; t++) {
+            stitched[t] += s->validation_terms[t];
+        }
+    }
+    printf("Stitched validation loss: %.5f\n", combine_loss_terms(stitched, &validation_batch, unit_weights, NULL));
+    trained = 1;
+
+cleanup:
+    if (num_loggers > 0) logger_close_group(loggers, num_loggers);
+    free_decomposition(&d);
+    sampler_free(&validation_sampler);
+    sampler_free(&interface_sampler);
+    if (num_loggers > 0) logger_write_profile(&loggers[0], config->profile_trace);
+    return trained;
+}
@@ -0,0 +1,343 @@
+#define _GNU_SOURCE
+#include "distributed.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "arena.h"
+#include "profile.h"
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+// Shared-memory transport. One mapping holds a process-shared barrier, the RankStats and
+// one message slot per rank; each slot is first touched by its own (pinned) rank, so it
+// lives on that rank's node and only the neighbour reads it remotely.
+typedef struct {
+    pthread_barrier_t barrier;
+    size_t stats_offset;
+    size_t slots_offset;
+    size_t slot_size;                   // Bytes per slot, whole cache lines
+} SharedSegment;
+
+static double *rank_slot(const Communicator *comm, int rank) {
+    const SharedSegment *segment = comm->shared;
+    return (double *)((char *)comm->shared + segment->slots_offset + (size_t)rank * segment->slot_size);
+}
+
+// Cache-line-aligned chunk c of N over count values, as reduce_gradients_task slices parameters
+static void ring_chunk(size_t count, int chunk, int num_ranks, size_t *begin, size_t *end) {
+    const size_t line = ARENA_ALIGNMENT / sizeof(double);
+    size_t lines = (count + line - 1) / line;
+    *begin = lines * chunk / num_ranks * line;
+    *end = lines * (chunk + 1) / num_ranks * line;
+    if (*begin > count) *begin = count;
+    if (*end > count) *end = count;
+}
+
+static void shared_memory_barrier(Communicator *comm) {
+    SharedSegment *segment = comm->shared;
+    pthread_barrier_wait(&segment->barrier);
+}
+
+// Ring allreduce over the slots: N - 1 reduce-scatter steps, after which rank r holds the
+// full sum of chunk r + 1, then N - 1 allgather steps that pass the finished chunks on.
+// Each step only reads the left neighbour's slot, in a chunk that neighbour is not writing.
+// Chunk c is always summed in ring order starting at rank c, and every rank copies the
+// same finished chunk, so the result is bitwise identical on every rank and every run.
+static void shared_memory_allreduce(Communicator *comm, double *data, size_t count) {
+    int n = comm->num_ranks;
+    int r = comm->rank;
+    double *own = rank_slot(comm, r);
+    const double *left = rank_slot(comm, (r + n - 1) % n);
+
+    memcpy(own, data, count * sizeof(double));
+    shared_memory_barrier(comm);
+    for (int step = 0; step < n - 1; step++) {
+        size_t begin, end;
+        ring_chunk(count, ((r - step - 1) % n + n) % n, n, &begin, &end);
+        for (size_t p = begin; p < end; p++) {
+            own[p] += left[p];
+        }
+        shared_memory_barrier(comm);
+    }
+    for (int step = 0; step < n - 1; step++) {
+        size_t begin, end;
+        ring_chunk(count, ((r - step) % n + n) % n, n, &begin, &end);
+        memcpy(own + begin, left + begin, (end - begin) * sizeof(double));
+        shared_memory_barrier(comm);
+    }
+    // Nobody reads this slot again before the next call's first barrier
+    memcpy(data, own, count * sizeof(double));
+}
+
+// The barrier dies with the mapping. pthread_barrier_destroy would wait forever for ranks
+// that were killed halfway through a round.
+static void shared_memory_free(Communicator *comm) {
+    munmap(comm->shared, comm->shared_size);
+}
+
+static const CommTransport shared_memory_transport = {
+    "shared memory", shared_memory_allreduce, shared_memory_barrier, shared_memory_free,
+};
+
+int comm_init_shared_memory(Communicator *comm, int num_ranks, size_t capacity) {
+    memset(comm, 0, sizeof(*comm));
+    if (num_ranks < 1 || num_ranks > DISTRIBUTED_MAX_RANKS) {
+        fprintf(stderr, "Error: The rank count must be between 1 and %d, got %d\n", DISTRIBUTED_MAX_RANKS, num_ranks);
+        return 0;
+    }
+    size_t stats_offset = arena_aligned_size(sizeof(SharedSegment));
+    size_t slots_offset = stats_offset + arena_aligned_size(num_ranks * sizeof(RankStats));
+    size_t slot_size = arena_aligned_size(capacity * sizeof(double));
+    size_t size = slots_offset + num_ranks * slot_size;
+
+    // The name is unlinked as soon as it is mapped: the ranks inherit the mapping across
+    // fork, and nothing is left behind in /dev/shm however the run ends
+    char name[64];
+    snprintf(name, sizeof(name), "/pinn-%ld", (long)getpid());
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to create shared memory %s: %s\n", name, strerror(errno));
+        return 0;
+    }
+    void *shared = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    shm_unlink(name);
+    if (shared == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map %zu bytes of shared memory\n", size);
+        return 0;
+    }
+
+    SharedSegment *segment = shared;
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    int failed = pthread_barrier_init(&segment->barrier, &attr, (unsigned)num_ranks);
+    pthread_barrierattr_destroy(&attr);
+    if (failed) {
+        fprintf(stderr, "Error: Failed to create a process-shared barrier\n");
+        munmap(shared, size);
+        return 0;
+    }
+    segment->stats_offset = stats_offset;
+    segment->slots_offset = slots_offset;
+    segment->slot_size = slot_size;
+
+    comm->transport = &shared_memory_transport;
+    comm->num_ranks = num_ranks;
+    comm->capacity = capacity;
+    comm->stats = (RankStats *)((char *)shared + stats_offset);
+    comm->shared = shared;
+    comm->shared_size = size;
+    return 1;
+}
+
+void comm_attach(Communicator *comm, int rank) {
+    comm->rank = rank;
+    if (comm->transport == &shared_memory_transport) {
+        memset(rank_slot(comm, rank), 0, ((SharedSegment *)comm->shared)->slot_size);
+    }
+}
+
+void comm_allreduce(Communicator *comm, double *data, size_t count) {
+    PROFILE_SCOPE(PROF_ALLREDUCE);
+    double start = monotonic_seconds();
+    if (comm->num_ranks > 1) {
+        comm->transport->allreduce(comm, data, count);
+    }
+    comm->totals.allreduce_seconds += monotonic_seconds() - start;
+    comm->totals.allreduce_calls++;
+    comm->totals.allreduce_bytes += 2 * (uint64_t)(comm->num_ranks - 1) * count * sizeof(double) / comm->num_ranks;
+}
+
+void comm_barrier(Communicator *comm) {
+    comm->transport->barrier(comm);
+}
+
+void comm_free(Communicator *comm) {
+    if (comm->transport) {
+        comm->transport->free(comm);
+    }
+    memset(comm, 0, sizeof(*comm));
+}
+
+// "0-3,8,10-11" for an ascending run of CPU ids
+static void format_cpu_list(const int *cpus, int count, char *out, size_t size) {
+    size_t used = 0;
+    out[0] = '\0';
+    for (int i = 0; i < count && used < size; ) {
+        int j = i;
+        while (j + 1 < count && cpus[j + 1] == cpus[j] + 1) j++;
+        int written = (j > i) ? snprintf(out + used, size - used, "%s%d-%d", used ? "," : "", cpus[i], cpus[j])
+                              : snprintf(out + used, size - used, "%s%d", used ? "," : "", cpus[i]);
+        used += written > 0 ? (size_t)written : 0;
+        i = j + 1;
+    }
+}
+
+// The CPUs this process may run on, grouped by NUMA node in node order; CPUs that sysfs
+// places on no node (or every CPU, without sysfs) come last with node -1
+static int node_ordered_cpus(int *cpus, int *nodes) {
+    cpu_set_t allowed, placed;
+    CPU_ZERO(&placed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        for (int c = 0; c < CPU_SETSIZE && c < sysconf(_SC_NPROCESSORS_ONLN); c++) CPU_SET(c, &allowed);
+    }
+    int count = 0;
+    for (int node = 0; node < 256; node++) {
+        char path[64], list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(path, "r");
+        if (file == NULL) continue;
+        int ok = fgets(list, sizeof(list), file) != NULL;
+        fclose(file);
+        for (char *p = list; ok && *p && *p != '\n'; ) {
+            char *next;
+            long first = strtol(p, &next, 10);
+            long last = first;
+            if (next == p) break;
+            if (*next == '-') last = strtol(next + 1, &next, 10);
+            for (long c = first; c <= last && c < CPU_SETSIZE; c++) {
+                if (CPU_ISSET(c, &allowed) && !CPU_ISSET(c, &placed)) {
+                    CPU_SET(c, &placed);
+                    cpus[count] = (int)c;
+                    nodes[count++] = node;
+                }
+            }
+            p = (*next == ',') ? next + 1 : next;
+        }
+    }
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &allowed) && !CPU_ISSET(c, &placed)) {
+            cpus[count] = c;
+            nodes[count++] = -1;
+        }
+    }
+    return count;
+}
+
+// One NUMA node per rank while there are enough nodes; otherwise an even, contiguous share
+// of the node-ordered CPUs (which still keeps a rank inside one node when the counts divide)
+static void pin_rank(int rank, int num_ranks, RankStats *stats) {
+    static int cpus[CPU_SETSIZE], nodes[CPU_SETSIZE];
+    int count = node_ordered_cpus(cpus, nodes);
+    int num_nodes = 0;
+    int node_begin[CPU_SETSIZE + 1];
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || nodes[i] != nodes[i - 1]) node_begin[num_nodes++] = i;
+    }
+    node_begin[num_nodes] = count;
+
+    int begin, end;
+    if (count == 0) {
+        stats->node = -1;
+        snprintf(stats->cpus, sizeof(stats->cpus), "any");
+        return;
+    } else if (num_ranks <= num_nodes && nodes[0] >= 0) {
+        begin = node_begin[rank];
+        end = node_begin[rank + 1];
+    } else if (count >= num_ranks) {
+        begin = (int)((long long)count * rank / num_ranks);
+        end = (int)((long long)count * (rank + 1) / num_ranks);
+    } else {
+        begin = rank % count;
+        end = begin + 1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = begin; i < end; i++) CPU_SET(cpus[i], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Warning: Rank %d could not be pinned: %s\n", rank, strerror(errno));
+    }
+    stats->node = nodes[begin];
+    format_cpu_list(cpus + begin, end - begin, stats->cpus, sizeof(stats->cpus));
+}
+
+static void print_rank_report(const Communicator *comm) {
+    printf("Ranks over %s:\n", comm->transport->name);
+    for (int r = 0; r < comm->num_ranks; r++) {
+        const RankStats *s = &comm->stats[r];
+        double share = s->train_seconds > 0.0 ? 100.0 * s->allreduce_seconds / s->train_seconds : 0.0;
+        double latency = s->allreduce_calls ? 1e6 * s->allreduce_seconds / s->allreduce_calls : 0.0;
+        double bandwidth = s->allreduce_seconds > 0.0 ? 1e-9 * s->allreduce_bytes / s->allreduce_seconds : 0.0;
+        printf("  rank %d: node %d, cpus %s, %.2f s; allreduce %.3f s (%.1f%%), %llu calls, %.1f us each, %.2f GB/s\n",
+               r, s->node, s->cpus, s->train_seconds, s->allreduce_seconds, share, (unsigned long long)s->allreduce_calls, latency, bandwidth);
+    }
+}
+
+int launch_ranks(Communicator *comm, RankMain rank_main, void *context) {
+    int n = comm->num_ranks;
+    pid_t pids[DISTRIBUTED_MAX_RANKS] = {0};
+    int ok = 1;
+
+    // Anything still buffered would otherwise be printed once per rank
+    fflush(stdout);
+    fflush(stderr);
+    for (int r = 0; r < n; r++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Error: Failed to start rank %d: %s\n", r, strerror(errno));
+            ok = 0;
+            break;
+        }
+        if (pid == 0) {
+            memset(&comm->totals, 0, sizeof(comm->totals));
+            pin_rank(r, n, &comm->totals);
+            comm_attach(comm, r);
+            double start = monotonic_seconds();
+            int trained = rank_main(comm, context);
+            comm->totals.train_seconds = monotonic_seconds() - start;
+            comm->stats[r] = comm->totals;
+            fflush(stdout);
+            _exit(trained ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        pids[r] = pid;
+    }
+
+    // A failed rank never reaches the next allreduce, so the others are stopped rather than
+    // left waiting for it
+    if (!ok) {
+        for (int r = 0; r < n; r++) if (pids[r] > 0) kill(pids[r], SIGKILL);
+    }
+    for (int remaining = n; remaining > 0; ) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int r = 0;
+        while (r < n && pids[r] != pid) r++;
+        if (r == n) continue;
+        pids[r] = 0;
+        remaining--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            if (ok) {
+                fprintf(stderr, "Error: Rank %d failed; stopping the other ranks\n", r);
+                for (int other = 0; other < n; other++) if (pids[other] > 0) kill(pids[other], SIGKILL);
+            }
+            ok = 0;
+        }
+    }
+    if (ok) {
+        print_rank_report(comm);
+    }
+    return ok;
+}
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "encoding.h"
+
+#define HASH_GRID_MAX_CORNERS (1 << HASH_GRID_MAX_INPUTS)
+#define HASH_GRID_INIT_RANGE 1e-4
+
+// Spatial hash primes of instant-NGP (the first axis is left unscrambled)
+static const uint32_t hash_primes[HASH_GRID_MAX_INPUTS] = {1u, 2654435761u, 805459861u, 3674653429u};
+
+void default_encoding_config(EncodingConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->type = ENCODING_NONE;
+    config->frequencies = 32;
+    config->scale = 1.0;
+    config->levels = 8;
+    config->features = 2;
+    config->log2_table_size = 12;
+    config->base_resolution = 4;
+    config->growth = 1.5;
+    config->seed = RNG_DEFAULT_SEED;
+    for (int i = 0; i < ENCODING_MAX_INPUTS; i++) {
+        config->upper[i] = 1.0;
+    }
+}
+
+int parse_encoding_type(const char *name, EncodingType *type) {
+    if (strcmp(name, "none") == 0) {
+        *type = ENCODING_NONE;
+    } else if (strcmp(name, "fourier") == 0) {
+        *type = ENCODING_FOURIER;
+    } else if (strcmp(name, "hashgrid") == 0) {
+        *type = ENCODING_HASH_GRID;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+const char *encoding_type_name(EncodingType type) {
+    switch (type) {
+        case ENCODING_FOURIER: return "fourier";
+        case ENCODING_HASH_GRID: return "hashgrid";
+        default: return "none";
+    }
+}
+
+int encoding_layout(Encoding *encoding, const EncodingConfig *config) {
+    memset(encoding, 0, sizeof(*encoding));
+    encoding->config = *config;
+    int d = config->input_dim;
+    if (d < 1 || d > ENCODING_MAX_INPUTS) {
+        fprintf(stderr, "Error: An encoding takes between 1 and %d inputs\n", ENCODING_MAX_INPUTS);
+        return 0;
+    }
+    for (int i = 0; i < d; i++) {
+        if (!(config->upper[i] > config->lower[i])) {
+            fprintf(stderr, "Error: Encoding bounds of input %d are empty\n", i);
+            return 0;
+        }
+        encoding->inverse_width[i] = 1.0 / (config->upper[i] - config->lower[i]);
+    }
+    encoding->output_dim = d;
+
+    if (config->type == ENCODING_FOURIER) {
+        if (config->frequencies < 1 || config->frequencies > 4096 || !(config->scale > 0.0)) {
+            fprintf(stderr, "Error: Fourier features need 1-4096 frequencies and a positive scale\n");
+            return 0;
+        }
+        encoding->output_dim += 2 * config->frequencies;
+        encoding->num_constants = (size_t)config->frequencies * d;
+    } else if (config->type == ENCODING_HASH_GRID) {
+        if (d > HASH_GRID_MAX_INPUTS) {
+            fprintf(stderr, "Error: The hash grid takes at most %d inputs\n", HASH_GRID_MAX_INPUTS);
+            return 0;
+        }
+        if (config->levels < 1 || config->levels > HASH_GRID_MAX_LEVELS ||
+            config->features < 1 || config->features > HASH_GRID_MAX_FEATURES ||
+            config->log2_table_size < 4 || config->log2_table_size > 24 ||
+            config->base_resolution < 1 || !(config->growth >= 1.0)) {
+            fprintf(stderr, "Error: Invalid hash grid (levels 1-%d, features 1-%d, table 2^4-2^24, growth >= 1)\n",
+                    HASH_GRID_MAX_LEVELS, HASH_GRID_MAX_FEATURES);
+            return 0;
+        }
+        size_t table_size = (size_t)1 << config->log2_table_size;
+        size_t entries = 0;
+        for (int l = 0; l < config->levels; l++) {
+            double resolution = floor(config->base_resolution * pow(config->growth, l));
+            if (resolution > 1 << 20) {
+                fprintf(stderr, "Error: Hash grid level %d is finer than 2^20 cells\n", l);
+                return 0;
+            }
+            encoding->resolution[l] = (int)resolution;
+            double vertices = pow(resolution + 1.0, d);
+            encoding->dense[l] = vertices <= (double)table_size;
+            encoding->level_entries[l] = encoding->dense[l] ? (size_t)vertices : table_size;
+            encoding->level_offset[l] = entries;
+            entries += encoding->level_entries[l];
+        }
+        encoding->output_dim += config->levels * config->features;
+        encoding->num_parameters = entries * config->features;
+    } else if (config->type != ENCODING_NONE) {
+        fprintf(stderr, "Error: Unknown encoding type %d\n", config->type);
+        return 0;
+    }
+    return 1;
+}
+
+// Frequencies are drawn in cycles per unit of the normalised coordinates (Box-Muller) and
+// stored in radians per input unit, so encoding a point is a single dot product per pair
+void encoding_bind(Encoding *encoding, double *constants) {
+    encoding->frequencies = constants;
+    if (encoding->config.type != ENCODING_FOURIER) {
+        return;
+    }
+    const EncodingConfig *config = &encoding->config;
+    Rng rng;
+    rng_init(&rng, config->seed, RNG_STREAM_ENCODING, 0);
+    for (size_t k = 0; k < encoding->num_constants; k++) {
+        double u1 = 1.0 - rng_next_uniform(&rng);
+        double u2 = rng_next_uniform(&rng);
+        double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+        int i = (int)(k % config->input_dim);
+        constants[k] = 2.0 * M_PI * config->scale * normal * encoding->inverse_width[i];
+    }
+}
+
+void encoding_init_tables(const Encoding *encoding, double *tables, const Rng *rng, uint64_t position) {
+    rng_fill_uniform(rng, position, tables, encoding->num_parameters, -HASH_GRID_INIT_RANGE, HASH_GRID_INIT_RANGE);
+}
+
+// The vertices around a point on one level, with their interpolation weights and the
+// first and second derivatives of the weights along each input
+typedef struct {
+    int count;
+    size_t entry[HASH_GRID_MAX_CORNERS];            // Offset of the vertex's features in the tables
+    double weight[HASH_GRID_MAX_CORNERS];
+    double slope[HASH_GRID_MAX_CORNERS][HASH_GRID_MAX_INPUTS];
+    double curvature[HASH_GRID_MAX_CORNERS][HASH_GRID_MAX_INPUTS];
+} GridCorners;
+
+// Smoothstep weights s(t) = t^2 (3 - 2t) instead of linear ones: a trilinear cell has no
+// curvature along any axis, which would hide the grid from second-order residuals. Points
+// outside the unit cube are clamped onto it (and see no derivatives).
+static void grid_corners(const Encoding *encoding, int level, const double *unit, GridCorners *corners) {
+    int d = encoding->config.input_dim;
+    int resolution = encoding->resolution[level];
+    int cell[HASH_GRID_MAX_INPUTS];
+    double s[HASH_GRID_MAX_INPUTS], ds[HASH_GRID_MAX_INPUTS], d2s[HASH_GRID_MAX_INPUTS];
+    for (int i = 0; i < d; i++) {
+        // Rounding can put a point on the domain boundary just outside the cube
+        int inside = unit[i] >= -1e-12 && unit[i] <= 1.0 + 1e-12;
+        double p = (unit[i] < 0.0 ? 0.0 : unit[i] > 1.0 ? 1.0 : unit[i]) * resolution;
+        int c = (int)p;
+        if (c >= resolution) {
+            c = resolution - 1;
+        }
+        double t = p - c;
+        double rate = inside ? resolution * encoding->inverse_width[i] : 0.0;
+        cell[i] = c;
+        s[i] = t * t * (3.0 - 2.0 * t);
+        ds[i] = 6.0 * t * (1.0 - t) * rate;
+        d2s[i] = (6.0 - 12.0 * t) * rate * rate;
+    }
+
+    size_t stride = (size_t)resolution + 1;
+    size_t mask = encoding->level_entries[level] - 1;
+    corners->count = 1 << d;
+    for (int corner = 0; corner < corners->count; corner++) {
+        double factor[HASH_GRID_MAX_INPUTS], dfactor[HASH_GRID_MAX_INPUTS], d2factor[HASH_GRID_MAX_INPUTS];
+        size_t index = 0, scale = 1;
+        uint32_t hash = 0;
+        for (int i = 0; i < d; i++) {
+            int upper = (corner >> i) & 1;
+            uint32_t vertex = (uint32_t)(cell[i] + upper);
+            factor[i] = upper ? s[i] : 1.0 - s[i];
+            dfactor[i] = upper ? ds[i] : -ds[i];
+            d2factor[i] = upper ? d2s[i] : -d2s[i];
+            index += vertex * scale;
+            scale *= stride;
+            hash ^= vertex * hash_primes[i];
+        }
+        if (!encoding->dense[level]) {
+            index = hash & mask;
+        }
+        corners->entry[corner] = (encoding->level_offset[level] + index) * encoding->config.features;
+
+        double weight = 1.0;
+        for (int i = 0; i < d; i++) {
+            double others = 1.0;
+            for (int j = 0; j < d; j++) {
+                if (j != i) {
+                    others *= factor[j];
+                }
+            }
+            corners->slope[corner][i] = dfactor[i] * others;
+            corners->curvature[corner][i] = d2factor[i] * others;
+            weight *= factor[i];
+        }
+        corners->weight[corner] = weight;
+    }
+}
+
+static void unit_coordinates(const Encoding *encoding, const double *x, double *unit) {
+    for (int i = 0; i < encoding->config.input_dim; i++) {
+        unit[i] = (x[i] - encoding->config.lower[i]) * encoding->inverse_width[i];
+    }
+}
+
+void encode_points(const Encoding *encoding, const double *tables, const double *inputs, int num_points, double *out) {
+    const EncodingConfig *config = &encoding->config;
+    int d = config->input_dim, width = encoding->output_dim;
+    for (int p = 0; p < num_points; p++) {
+        const double *x = inputs + (size_t)p * d;
+        double *row = out + (size_t)p * width;
+        unit_coordinates(encoding, x, row);
+        if (config->type == ENCODING_FOURIER) {
+            int m = config->frequencies;
+            for (int k = 0; k < m; k++) {
+                const double *b = encoding->frequencies + (size_t)k * d;
+                double phase = 0.0;
+                for (int i = 0; i < d; i++) {
+                    phase += b[i] * (x[i] - config->lower[i]);
+                }
+                row[d + k] = sin(phase);
+                row[d + m + k] = cos(phase);
+            }
+        } else if (config->type == ENCODING_HASH_GRID) {
+            GridCorners corners;
+            int f = config->features;
+            for (int l = 0; l < config->levels; l++) {
+                grid_corners(encoding, l, row, &corners);
+                double *features = row + d + l * f;
+                memset(features, 0, f * sizeof(double));
+                for (int c = 0; c < corners.count; c++) {
+                    const double *entry = tables + corners.entry[c];
+                    for (int j = 0; j < f; j++) {
+                        features[j] += corners.weight[c] * entry[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void encode_jets(const Encoding *encoding, const double *tables, const double *inputs, int num_points, int order, double *jets) {
+    const EncodingConfig *config = &encoding->config;
+    int d = config->input_dim, width = encoding->output_dim;
+    int channels = 1 + order * d;
+    size_t point_stride = (size_t)channels * width;
+    memset(jets, 0, num_points * point_stride * sizeof(double));
+    for (int p = 0; p < num_points; p++) {
+        const double *x = inputs + (size_t)p * d;
+        double *value = jets + p * point_stride;
+        unit_coordinates(encoding, x, value);
+        for (int i = 0; i < d && order >= 1; i++) {
+            value[(size_t)(1 + i) * width + i] = encoding->inverse_width[i];
+        }
+
+        if (config->type == ENCODING_FOURIER) {
+            int m = config->frequencies;
+            for (int k = 0; k < m; k++) {
+                const double *b = encoding->frequencies + (size_t)k * d;
+                double phase = 0.0;
+                for (int i = 0; i < d; i++) {
+                    phase += b[i] * (x[i] - config->lower[i]);
+                }
+                double sn = sin(phase), cs = cos(phase);
+                value[d + k] = sn;
+                value[d + m + k] = cs;
+                for (int i = 0; i < d && order >= 1; i++) {
+                    double *first = value + (size_t)(1 + i) * width;
+                    first[d + k] = cs * b[i];
+                    first[d + m + k] = -sn * b[i];
+                    if (order >= 2) {
+                        double *second = value + (size_t)(1 + d + i) * width;
+                        second[d + k] = -sn * b[i] * b[i];
+                        second[d + m + k] = -cs * b[i] * b[i];
+                    }
+                }
+            }
+        } else if (config->type == ENCODING_HASH_GRID) {
+            GridCorners corners;
+            int f = config->features;
+            for (int l = 0; l < config->levels; l++) {
+                grid_corners(encoding, l, value, &corners);
+                int column = d + l * f;
+                for (int c = 0; c < corners.count; c++) {
+                    const double *entry = tables + corners.entry[c];
+                    for (int j = 0; j < f; j++) {
+                        value[column + j] += corners.weight[c] * entry[j];
+                        for (int i = 0; i < d && order >= 1; i++) {
+                            value[(size_t)(1 + i) * width + column + j] += corners.slope[c][i] * entry[j];
+                            if (order >= 2) {
+                                value[(size_t)(1 + d + i) * width + column + j] += corners.curvature[c][i] * entry[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Each point only touches 2^input_dim entries per level, so the scatter is sparse. Data
+// parallel workers scatter into their own gradient buffers and record the rows they hit,
+// so the reduction and the optimizer can skip the rest; no two threads write the same entry.
+void encode_jets_adjoint(const Encoding *encoding, const double *jets, const double *adjoints, int num_points, int order, double *table_gradients, RowSet *touched) {
+    const EncodingConfig *config = &encoding->config;
+    if (config->type != ENCODING_HASH_GRID) {
+        return;
+    }
+    int d = config->input_dim, width = encoding->output_dim, f = config->features;
+    int channels = 1 + order * d;
+    size_t point_stride = (size_t)channels * width;
+    GridCorners corners;
+    for (int p = 0; p < num_points; p++) {
+        const double *unit = jets + p * point_stride;
+        const double *adjoint = adjoints + p * point_stride;
+        for (int l = 0; l < config->levels; l++) {
+            grid_corners(encoding, l, unit, &corners);
+            int column = d + l * f;
+            for (int c = 0; c < corners.count; c++) {
+                double *gradient = table_gradients + corners.entry[c];
+                if (touched) {
+                    row_set_add(touched, corners.entry[c] / f);
+                }
+                for (int j = 0; j < f; j++) {
+                    double sum = corners.weight[c] * adjoint[column + j];
+                    for (int i = 0; i < d && order >= 1; i++) {
+                        sum += corners.slope[c][i] * adjoint[(size_t)(1 + i) * width + column + j];
+                        if (order >= 2) {
+                            sum += corners.curvature[c][i] * adjoint[(size_t)(1 + d + i) * width + column + j];
+                        }
+                    }
+                    gradient[j] += sum;
+                }
+            }
+        }
+    }
+}
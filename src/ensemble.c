@@ -0,0 +1,587 @@
+#include "ensemble.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "profile.h"
+
+// One value per lane; GCC lowers arithmetic on it to whole-register SIMD instructions
+typedef double Lanes __attribute__((vector_size(ENSEMBLE_LANES * sizeof(double))));
+
+static const Lanes zero_lanes = {0};
+static const double unit_weights[TERM_COUNT] = {1.0, 1.0, 1.0, 1.0};
+
+// The widened tape: a JetWorkspace whose per-layer rows are width * ENSEMBLE_LANES long,
+// so the jet chain rule of autodiff.c applies to the interleaved units unchanged
+static int init_lane_tape(JetWorkspace *ws, const NeuralNetwork *shape, int capacity, int derivative_order) {
+    memset(ws, 0, sizeof(*ws));
+    ws->input_dim = nn_input_size(shape);
+    ws->derivative_order = derivative_order < 2 ? 1 : 2;
+    ws->channels = 1 + ws->derivative_order * ws->input_dim;
+    ws->precision = PRECISION_FP64;
+    ws->capacity = capacity;
+    int last = shape->num_layers - 1;
+
+    size_t total = 0;
+    int widest = 0;
+    for (int l = 0; l < shape->num_layers; l++) {
+        total += 3 * arena_aligned_size((size_t)capacity * ws->channels * shape->layer_sizes[l] * sizeof(Lanes));
+        widest = shape->layer_sizes[l] > widest ? shape->layer_sizes[l] : widest;
+    }
+    total += arena_aligned_size(3 * (size_t)widest * sizeof(Lanes));
+    if (!arena_init(&ws->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate an ensemble tape for %d points\n", capacity);
+        return 0;
+    }
+    ws->scratch = arena_alloc(&ws->arena, 3 * (size_t)widest * sizeof(Lanes));
+    for (int l = 0; l < shape->num_layers; l++) {
+        size_t bytes = (size_t)capacity * ws->channels * shape->layer_sizes[l] * sizeof(Lanes);
+        ws->jets[l] = arena_alloc(&ws->arena, bytes);
+        ws->adjoints[l] = arena_alloc(&ws->arena, bytes);
+        if (l > 0 && l < last) {
+            ws->pre[l] = arena_alloc(&ws->arena, bytes);
+        }
+    }
+    return 1;
+}
+
+// Interleave the members' parameters; lanes without a member get zero weights
+static void pack_parameters(const Ensemble *ensemble, LaneGroup *group) {
+    size_t count = ensemble->shape->num_parameters;
+    for (int m = 0; m < ENSEMBLE_LANES; m++) {
+        const double *src = m < group->count ? ensemble->members[group->first + m].nn.parameters : NULL;
+        for (size_t p = 0; p < count; p++) {
+            group->packed[p * ENSEMBLE_LANES + m] = src ? src[p] : 0.0;
+        }
+    }
+}
+
+// Rows of jets handled together: each weight loaded serves ROW_TILE rows, and the
+// accumulators of a tile stay in registers
+#define ROW_TILE 8
+
+// Pre-activations of rows [r, r + n), two units at a time. Derivative channels are linear
+// in the previous layer, so only the value rows get the bias.
+static inline void forward_rows(const Lanes *a, Lanes *z, const Lanes *weights, const Lanes *biases, int r, int n, int in, int out, int channels) {
+    for (int j = 0; j < out; j += 2) {
+        int units = j + 1 < out ? 2 : 1;
+        Lanes sums[ROW_TILE][2];
+        for (int k = 0; k < n; k++) {
+            for (int u = 0; u < units; u++) {
+                sums[k][u] = (r + k) % channels == 0 ? biases[j + u] : zero_lanes;
+            }
+        }
+        for (int i = 0; i < in; i++) {
+            const Lanes *w = weights + (size_t)i * out + j;
+            for (int k = 0; k < n; k++) {
+                Lanes ak = a[(size_t)(r + k) * in + i];
+                for (int u = 0; u < units; u++) {
+                    sums[k][u] += ak * w[u];
+                }
+            }
+        }
+        for (int k = 0; k < n; k++) {
+            for (int u = 0; u < units; u++) {
+                z[(size_t)(r + k) * out + j + u] = sums[k][u];
+            }
+        }
+    }
+}
+
+// Weight gradients and previous-layer adjoints of rows [r, r + n)
+static inline void backward_rows(const Lanes *a, const Lanes *bar, Lanes *previous, const Lanes *weights, Lanes *weight_gradients, int r, int n, int in, int out) {
+    const Lanes *ar = a + (size_t)r * in;
+    const Lanes *br = bar + (size_t)r * out;
+    for (int i = 0; i < in; i++) {
+        Lanes *gi = weight_gradients + (size_t)i * out;
+        for (int j = 0; j < out; j++) {
+            Lanes g = gi[j];
+            for (int k = 0; k < n; k++) {
+                g += ar[(size_t)k * in + i] * br[(size_t)k * out + j];
+            }
+            gi[j] = g;
+        }
+    }
+    if (previous == NULL) {
+        return;
+    }
+    for (int i = 0; i < in; i++) {
+        const Lanes *wi = weights + (size_t)i * out;
+        Lanes sums[ROW_TILE];
+        for (int k = 0; k < n; k++) {
+            sums[k] = zero_lanes;
+        }
+        for (int j = 0; j < out; j++) {
+            Lanes w = wi[j];
+            for (int k = 0; k < n; k++) {
+                sums[k] += br[(size_t)k * out + j] * w;
+            }
+        }
+        for (int k = 0; k < n; k++) {
+            previous[(size_t)(r + k) * in + i] = sums[k];
+        }
+    }
+}
+
+static void lane_forward(const Ensemble *ensemble, LaneGroup *group, const double *inputs, int num_points) {
+    PROFILE_SCOPE(PROF_FORWARD);
+    PROFILE_COUNT(PROF_POINTS, (size_t)num_points * group->count);
+    const NeuralNetwork *shape = ensemble->shape;
+    JetWorkspace *ws = &group->ws;
+    int d = ws->input_dim;
+    int channels = ws->channels;
+    int rows = num_points * channels;
+    int last = shape->num_layers - 1;
+
+    // Every lane sees the same point: value x, first derivative e_i, second derivative 0
+    Lanes *seed = (Lanes *)ws->jets[0];
+    memset(seed, 0, (size_t)rows * d * sizeof(Lanes));
+    for (int s = 0; s < num_points; s++) {
+        Lanes *point = seed + (size_t)s * channels * d;
+        for (int i = 0; i < d; i++) {
+            point[i] = zero_lanes + inputs[(size_t)s * d + i];
+            point[(1 + i) * d + i] = zero_lanes + 1.0;
+        }
+    }
+
+    for (int l = 0; l < last; l++) {
+        int in = shape->layer_sizes[l];
+        int out = shape->layer_sizes[l + 1];
+        const Lanes *weights = (const Lanes *)group->packed + shape->weight_offsets[l];
+        const Lanes *biases = (const Lanes *)group->packed + shape->bias_offsets[l];
+        const Lanes *a = (const Lanes *)ws->jets[l];
+        Lanes *z = (Lanes *)(l + 1 < last ? ws->pre[l + 1] : ws->jets[l + 1]);
+
+        int r = 0;
+        for (; r + ROW_TILE <= rows; r += ROW_TILE) {
+            forward_rows(a, z, weights, biases, r, ROW_TILE, in, out, channels);
+        }
+        for (; r < rows; r++) {
+            forward_rows(a, z, weights, biases, r, 1, in, out, channels);
+        }
+        PROFILE_COUNT(PROF_FLOPS, 2.0 * rows * in * out * group->count);
+
+        if (l + 1 < last) {
+            activate_jets(ws, (const double *)z, ws->jets[l + 1], num_points, out * ENSEMBLE_LANES, group->activation);
+        }
+    }
+}
+
+// Reverse sweep; the output-layer adjoints hold every lane's d(loss)/d(output jets)
+static void lane_backward(const Ensemble *ensemble, LaneGroup *group, int num_points) {
+    PROFILE_SCOPE(PROF_BACKWARD);
+    const NeuralNetwork *shape = ensemble->shape;
+    JetWorkspace *ws = &group->ws;
+    int channels = ws->channels;
+    int rows = num_points * channels;
+    int last = shape->num_layers - 1;
+
+    for (int l = last - 1; l >= 0; l--) {
+        int in = shape->layer_sizes[l];
+        int out = shape->layer_sizes[l + 1];
+        const Lanes *weights = (const Lanes *)group->packed + shape->weight_offsets[l];
+        Lanes *weight_gradients = (Lanes *)group->packed_gradients + shape->weight_offsets[l];
+        Lanes *bias_gradients = (Lanes *)group->packed_gradients + shape->bias_offsets[l];
+        const Lanes *a = (const Lanes *)ws->jets[l];
+        Lanes *bar = (Lanes *)ws->adjoints[l + 1];
+        Lanes *previous = l > 0 ? (Lanes *)ws->adjoints[l] : NULL;
+
+        if (l + 1 < last) {
+            activate_jets_adjoint(ws, ws->pre[l + 1], (double *)bar, num_points, out * ENSEMBLE_LANES, group->activation);
+        }
+
+        for (int r = 0; r < rows; r += channels) {
+            for (int j = 0; j < out; j++) {
+                bias_gradients[j] += bar[(size_t)r * out + j];
+            }
+        }
+        int r = 0;
+        for (; r + ROW_TILE <= rows; r += ROW_TILE) {
+            backward_rows(a, bar, previous, weights, weight_gradients, r, ROW_TILE, in, out);
+        }
+        for (; r < rows; r++) {
+            backward_rows(a, bar, previous, weights, weight_gradients, r, 1, in, out);
+        }
+        PROFILE_COUNT(PROF_FLOPS, (l > 0 ? 4.0 : 2.0) * rows * in * out * group->count);
+    }
+}
+
+// The residual kernels read one network's jets, so each member's output lane is unpacked
+// for them and its adjoints packed back. The output layer is a few units wide, so this
+// is cheap next to the hidden layers.
+static void lane_losses(const Ensemble *ensemble, LaneGroup *group, const CollocationBatch *batch, int start, int num_points) {
+    JetWorkspace *ws = &group->ws;
+    int last = ensemble->shape->num_layers - 1;
+    int out = nn_output_size(ensemble->shape);
+    size_t count = (size_t)num_points * ws->channels * out;
+    const double *jets = ws->jets[last];
+    double *adjoints = ws->adjoints[last];
+    if (ensemble->with_gradients) {
+        memset(adjoints, 0, count * sizeof(Lanes));
+    }
+
+    for (int m = 0; m < group->count; m++) {
+        EnsembleMember *member = &ensemble->members[group->first + m];
+        for (size_t k = 0; k < count; k++) {
+            group->lane_jets[k] = jets[k * ENSEMBLE_LANES + m];
+        }
+        if (ensemble->with_gradients) {
+            memset(group->lane_adjoints, 0, count * sizeof(double));
+        }
+        JetBatch lane = {ws->input_dim, out, ws->derivative_order, (size_t)ws->channels * out, group->lane_jets,
+                         ensemble->with_gradients ? group->lane_adjoints : NULL};
+        composite_loss_terms(&lane, batch, start, num_points, ensemble->op, &member->params, ensemble->weights, member->terms);
+        if (ensemble->with_gradients) {
+            for (size_t k = 0; k < count; k++) {
+                adjoints[k * ENSEMBLE_LANES + m] = group->lane_adjoints[k];
+            }
+        }
+    }
+}
+
+static void run_group(Ensemble *ensemble, LaneGroup *group) {
+    const CollocationBatch *batch = ensemble->batch;
+    const NeuralNetwork *shape = ensemble->shape;
+    int input_dim = nn_input_size(shape);
+    int total = collocation_batch_size(batch);
+    size_t num_parameters = shape->num_parameters;
+
+    pack_parameters(ensemble, group);
+    if (ensemble->with_gradients) {
+        memset(group->packed_gradients, 0, num_parameters * sizeof(Lanes));
+    }
+    for (int m = 0; m < group->count; m++) {
+        memset(ensemble->members[group->first + m].terms, 0, sizeof(ensemble->members[0].terms));
+    }
+
+    for (int start = 0; start < total; start += group->ws.capacity) {
+        int chunk = total - start < group->ws.capacity ? total - start : group->ws.capacity;
+        lane_forward(ensemble, group, batch->points + (size_t)start * input_dim, chunk);
+        lane_losses(ensemble, group, batch, start, chunk);
+        if (ensemble->with_gradients) {
+            lane_backward(ensemble, group, chunk);
+        }
+    }
+
+    for (int m = 0; m < group->count; m++) {
+        EnsembleMember *member = &ensemble->members[group->first + m];
+        member->loss = combine_loss_terms(member->terms, batch, ensemble->weights, NULL);
+        if (ensemble->with_gradients) {
+            for (size_t p = 0; p < num_parameters; p++) {
+                member->nn.gradients[p] = group->packed_gradients[p * ENSEMBLE_LANES + m];
+            }
+        }
+    }
+}
+
+// Lane groups are independent, so workers simply take every num_workers-th one
+static void ensemble_task(void *context, int worker, int num_workers) {
+    Ensemble *ensemble = context;
+    for (int g = worker; g < ensemble->num_groups; g += num_workers) {
+        run_group(ensemble, &ensemble->groups[g]);
+    }
+}
+
+void ensemble_composite_loss(Ensemble *ensemble, const CollocationBatch *batch, int with_gradients) {
+    ensemble->batch = batch;
+    ensemble->with_gradients = with_gradients;
+    thread_pool_run(&ensemble->pool, ensemble_task, ensemble);
+}
+
+static int same_shape(const NeuralNetwork *a, const NeuralNetwork *b) {
+    if (a->num_layers != b->num_layers) return 0;
+    for (int l = 0; l < a->num_layers; l++) {
+        if (a->layer_sizes[l] != b->layer_sizes[l]) return 0;
+    }
+    return 1;
+}
+
+int ensemble_init(Ensemble *ensemble, EnsembleMember *members, int num_members, const PdeOperator *op, const double *weights, int derivative_order, int threads) {
+    memset(ensemble, 0, sizeof(*ensemble));
+    if (num_members <= 0 || num_members > ENSEMBLE_MAX_MEMBERS) {
+        fprintf(stderr, "Error: An ensemble has between 1 and %d members, got %d\n", ENSEMBLE_MAX_MEMBERS, num_members);
+        return 0;
+    }
+    if (nn_encoded(&members[0].nn)) {
+        // Lane packing covers the dense layers only
+        fprintf(stderr, "Error: Ensemble members cannot use an input encoding\n");
+        return 0;
+    }
+    if (nn_parametric(&members[0].nn)) {
+        fprintf(stderr, "Error: Ensemble members cannot take parameter inputs\n");
+        return 0;
+    }
+    for (int k = 1; k < num_members; k++) {
+        if (!same_shape(&members[0].nn, &members[k].nn)) {
+            fprintf(stderr, "Error: Ensemble member %d has a different layer layout\n", k);
+            return 0;
+        }
+    }
+    ensemble->members = members;
+    ensemble->num_members = num_members;
+    ensemble->shape = &members[0].nn;
+    ensemble->op = op;
+    memcpy(ensemble->weights, weights, sizeof(ensemble->weights));
+
+    // A group closes when it is full or the next member uses another activation
+    int starts[ENSEMBLE_MAX_MEMBERS];
+    for (int k = 0; k < num_members; k++) {
+        if (k == 0 || k - starts[ensemble->num_groups - 1] == ENSEMBLE_LANES || members[k].activation != members[k - 1].activation) {
+            starts[ensemble->num_groups++] = k;
+        }
+    }
+
+    const NeuralNetwork *shape = ensemble->shape;
+    int channels = 1 + (derivative_order < 2 ? 1 : 2) * nn_input_size(shape);
+    size_t packed_bytes = arena_aligned_size(shape->num_parameters * sizeof(Lanes));
+    size_t lane_bytes = arena_aligned_size((size_t)ENSEMBLE_CHUNK * channels * nn_output_size(shape) * sizeof(double));
+    size_t total = arena_aligned_size(ensemble->num_groups * sizeof(LaneGroup)) + ensemble->num_groups * (2 * packed_bytes + 2 * lane_bytes);
+    if (!arena_init(&ensemble->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate the ensemble buffers\n");
+        return 0;
+    }
+    ensemble->groups = arena_alloc(&ensemble->arena, ensemble->num_groups * sizeof(LaneGroup));
+    memset(ensemble->groups, 0, ensemble->num_groups * sizeof(LaneGroup));
+    for (int g = 0; g < ensemble->num_groups; g++) {
+        LaneGroup *group = &ensemble->groups[g];
+        int end = g + 1 < ensemble->num_groups ? starts[g + 1] : num_members;
+        group->first = starts[g];
+        group->count = end - starts[g];
+        group->activation = members[starts[g]].activation;
+        group->packed = arena_alloc(&ensemble->arena, shape->num_parameters * sizeof(Lanes));
+        group->packed_gradients = arena_alloc(&ensemble->arena, shape->num_parameters * sizeof(Lanes));
+        group->lane_jets = arena_alloc(&ensemble->arena, lane_bytes);
+        group->lane_adjoints = arena_alloc(&ensemble->arena, lane_bytes);
+        if (!init_lane_tape(&group->ws, shape, ENSEMBLE_CHUNK, derivative_order)) {
+            ensemble_free(ensemble);
+            return 0;
+        }
+    }
+
+    ensemble->num_workers = threads > 0 ? threads : available_cores();
+    if (ensemble->num_workers > ensemble->num_groups) ensemble->num_workers = ensemble->num_groups;
+    if (!thread_pool_init(&ensemble->pool, ensemble->num_workers)) {
+        fprintf(stderr, "Error: Failed to start %d worker threads\n", ensemble->num_workers);
+        ensemble_free(ensemble);
+        return 0;
+    }
+    return 1;
+}
+
+void ensemble_free(Ensemble *ensemble) {
+    if (ensemble->pool.num_threads > 0) {
+        thread_pool_free(&ensemble->pool);
+    }
+    for (int g = 0; ensemble->groups && g < ensemble->num_groups; g++) {
+        free_jet_workspace(&ensemble->groups[g].ws);
+    }
+    arena_free(&ensemble->arena);
+    memset(ensemble, 0, sizeof(*ensemble));
+}
+
+// The n-th comma-separated value of a list, copied into value
+static int nth_value(const char *list, int n, char *value, size_t size) {
+    for (int i = 0; i < n; i++) {
+        list = strchr(list, ',');
+        if (list == NULL) return 0;
+        list++;
+    }
+    size_t length = strcspn(list, ",");
+    if (length == 0 || length >= size) return 0;
+    memcpy(value, list, length);
+    value[length] = '\0';
+    return 1;
+}
+
+static int parse_number(const char *text, double *number) {
+    char *end = NULL;
+    *number = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static int apply_sweep_value(EnsembleMember *member, const char *name, const char *value) {
+    if (strcmp(name, "activation") == 0) {
+        return parse_activation_function(value, &member->activation);
+    }
+    double number;
+    if (!parse_number(value, &number)) return 0;
+    LossParameterField field;
+    if (strcmp(name, "learning_rate") == 0) member->learning_rate = number;
+    else if (parse_loss_parameter(name, &field)) *loss_parameter(&member->params, field) = number;
+    else return 0;
+    return 1;
+}
+
+int expand_ensemble_sweeps(const char **specs, int num_specs, int replicas, const EnsembleMember *base, EnsembleMember *members) {
+    char names[ENSEMBLE_MAX_SWEEPS][32];
+    const char *lists[ENSEMBLE_MAX_SWEEPS];
+    int counts[ENSEMBLE_MAX_SWEEPS];
+    int total = replicas > 0 ? replicas : 1;
+    if (total > ENSEMBLE_MAX_MEMBERS) {
+        fprintf(stderr, "Error: An ensemble has at most %d members\n", ENSEMBLE_MAX_MEMBERS);
+        return -1;
+    }
+    if (num_specs > ENSEMBLE_MAX_SWEEPS) {
+        fprintf(stderr, "Error: At most %d sweeps are supported\n", ENSEMBLE_MAX_SWEEPS);
+        return -1;
+    }
+    for (int s = 0; s < num_specs; s++) {
+        const char *equals = strchr(specs[s], '=');
+        size_t length = equals ? (size_t)(equals - specs[s]) : 0;
+        if (length == 0 || length >= sizeof(names[s]) || equals[1] == '\0') {
+            fprintf(stderr, "Error: Invalid sweep %s (expected name=v1,v2,...)\n", specs[s]);
+            return -1;
+        }
+        memcpy(names[s], specs[s], length);
+        names[s][length] = '\0';
+        lists[s] = equals + 1;
+        counts[s] = 1;
+        for (const char *c = lists[s]; *c; c++) {
+            counts[s] += *c == ',';
+        }
+        total *= counts[s];
+        if (total > ENSEMBLE_MAX_MEMBERS) {
+            fprintf(stderr, "Error: The sweeps ask for more than %d members\n", ENSEMBLE_MAX_MEMBERS);
+            return -1;
+        }
+    }
+
+    int per_value = replicas > 0 ? replicas : 1;
+    for (int k = 0; k < total; k++) {
+        members[k] = *base;
+        int rest = k / per_value;
+        for (int s = num_specs - 1; s >= 0; s--) {
+            char value[64];
+            if (!nth_value(lists[s], rest % counts[s], value, sizeof(value)) || !apply_sweep_value(&members[k], names[s], value)) {
+                fprintf(stderr, "Error: Invalid sweep %s\n", specs[s]);
+                return -1;
+            }
+            rest /= counts[s];
+        }
+    }
+    return total;
+}
+
+int train_ensemble(EnsembleMember *members, int num_members, const char *loss_type, const TrainingConfig *config) {
+    const NeuralNetwork *shape = &members[0].nn;
+    int input_size = nn_input_size(shape);
+    const PdeOperator *op = find_pde_operator(loss_type);
+    if (op == NULL) {
+        fprintf(stderr, "Unknown loss type: %s\n", loss_type);
+        return 0;
+    }
+    if (nn_output_size(shape) < op->num_outputs || input_size < op->min_inputs || input_size > op->max_inputs) {
+        fprintf(stderr, "Error: A %d-input, %d-output network does not fit %s\n", input_size, nn_output_size(shape), loss_type);
+        return 0;
+    }
+    OptimizerConfig optimizer_config = config->optimizer;
+    if (optimizer_config.type == OPTIMIZER_LBFGS || config->lbfgs_epochs > 0) {
+        fprintf(stderr, "Error: Ensembles train with first-order optimizers only (no L-BFGS)\n");
+        return 0;
+    }
+    Domain domain = config->domain;
+    if (domain.dims == 0) {
+        unit_domain(&domain, input_size);
+    }
+    if (domain.dims != input_size) {
+        fprintf(stderr, "Error: The domain has %d axes but the network takes %d inputs (space..., time)\n", domain.dims, input_size);
+        return 0;
+    }
+    if (config->precision != PRECISION_FP64 || config->loss_weighting.method != WEIGHTING_FIXED || config->refine_every > 0) {
+        fprintf(stderr, "Error: Ensembles train in fp64 with fixed term weights (no --precision, --loss_weighting or --refine_every)\n");
+        return 0;
+    }
+
+    profile_reset();
+    Sampler sampler = {0};
+    Sampler validation_sampler = {0};
+    Ensemble ensemble = {0};
+    Optimizer optimizers[ENSEMBLE_MAX_MEMBERS];
+    TrainingLogger loggers[ENSEMBLE_MAX_MEMBERS];
+    int num_optimizers = 0, num_loggers = 0;
+    double losses[ENSEMBLE_MAX_MEMBERS], rates[ENSEMBLE_MAX_MEMBERS];
+    int trained = 0;
+
+    // The same batches and validation set as a single run, shared by every member
+    int validation_boundary = config->boundary_points > 0 ? config->validation_points / 4 : 0;
+    int validation_initial = config->initial_points > 0 ? config->validation_points / 4 : 0;
+    if (!sampler_init(&sampler, &domain, config->sampling, config->interior_points, config->boundary_points, config->initial_points, config->seed, 1) ||
+        !sampler_init(&validation_sampler, &domain, SAMPLE_SOBOL, config->validation_points, validation_boundary, validation_initial, 0xC0FFEEULL, 0)) {
+        goto cleanup;
+    }
+    CollocationBatch validation_batch = *sampler_next_batch(&validation_sampler);
+
+    int active_terms[TERM_COUNT] = {1, config->boundary_points > 0, config->initial_points > 0, op->conservation != NULL};
+    double weights[TERM_COUNT];
+    for (int i = 0; i < TERM_COUNT; i++) {
+        weights[i] = active_terms[i] ? config->loss_weighting.weights[i] : 0.0;
+    }
+    if (!ensemble_init(&ensemble, members, num_members, op, weights, op->derivative_order, config->threads)) {
+        goto cleanup;
+    }
+
+    // Every member keeps its own optimizer state, learning rate and log; one thread writes all the logs
+    LearningRateSchedule schedules[ENSEMBLE_MAX_MEMBERS];
+    for (int k = 0; k < num_members; k++) {
+        schedules[k] = config->schedule;
+        schedules[k].base_rate = members[k].learning_rate;
+        schedules[k].total_epochs = config->epochs;
+        if (!optimizer_init(&optimizers[k], &optimizer_config, shape->num_parameters)) {
+            goto cleanup;
+        }
+        num_optimizers++;
+    }
+    if (!logger_open_group(loggers, num_members, loss_type, config->log_format, config->log_every)) {
+        goto cleanup;
+    }
+    num_loggers = num_members;
+    printf("Training %d members in %d lane group(s) of up to %d on %d thread(s); logs %s to %s\n", num_members, ensemble.num_groups, ENSEMBLE_LANES,
+           ensemble.num_workers, loggers[0].path, loggers[num_members - 1].path);
+
+    for (int epoch = 0; epoch < config->epochs; epoch++) {
+        PROFILE_BEGIN(epoch_start);
+        PROFILE_BEGIN(sampler_start);
+        const CollocationBatch *batch = sampler_next_batch(&sampler);
+        PROFILE_END(PROF_SAMPLER, sampler_start);
+
+        ensemble_composite_loss(&ensemble, batch, 1);
+        PROFILE_BEGIN(optimizer_start);
+        for (int k = 0; k < num_members; k++) {
+            losses[k] = members[k].loss;
+            rates[k] = schedule_learning_rate(&schedules[k], epoch);
+            optimizer_step(&optimizers[k], members[k].nn.parameters, members[k].nn.gradients, &members[k].loss, rates[k], NULL, NULL);
+        }
+        PROFILE_END(PROF_OPTIMIZER, optimizer_start);
+
+        // One packed pass validates every member at the log cadence
+        if (logger_wants_epoch(&loggers[0], epoch, config->epochs)) {
+            PROFILE_BEGIN(validation_start);
+            ensemble_composite_loss(&ensemble, &validation_batch, 0);
+            PROFILE_END(PROF_VALIDATION, validation_start);
+            PROFILE_BEGIN(log_start);
+            for (int k = 0; k < num_members; k++) {
+                members[k].validation_loss = combine_loss_terms(members[k].terms, &validation_batch, unit_weights, NULL);
+                logger_record(&loggers[k], epoch, losses[k], members[k].validation_loss, epoch, rates[k]);
+            }
+            PROFILE_END(PROF_LOG, log_start);
+        }
+        PROFILE_END(PROF_EPOCH, epoch_start);
+    }
+
+    for (int k = 0; k < num_members; k++) {
+        members[k].loss = losses[k];
+        printf("Member %d (%s, lr %g): loss %.5f, validation loss %.5f -> %s\n", k, activation_function_name(members[k].activation), members[k].learning_rate,
+               losses[k], members[k].validation_loss, loggers[k].path);
+    }
+    trained = 1;
+
+cleanup:
+    if (num_loggers > 0) logger_close_group(loggers, num_loggers);
+    for (int k = 0; k < num_optimizers; k++) optimizer_free(&optimizers[k]);
+    ensemble_free(&ensemble);
+    sampler_free(&sampler);
+    sampler_free(&validation_sampler);
+    if (num_loggers > 0) logger_write_profile(&loggers[0], config->profile_trace);
+    return trained;
+}
@@ -0,0 +1,380 @@
+#include "export.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "rng.h"
+#include "activation_kernels.h"
+
+// The kernels of activation.c, stringized from the same definitions; the exported
+// activate() calls them in accurate mode. They are branch-free, so the activation loop of
+// a layer vectorizes like the training one.
+#define STRINGIZE_KERNELS(...) #__VA_ARGS__
+static const char select_source[] = ACTIVATION_SELECT_SOURCE(STRINGIZE_KERNELS);
+static const char exp_source[] = ACTIVATION_EXP_SOURCE(STRINGIZE_KERNELS);
+static const char tanh_source[] = ACTIVATION_TANH_SOURCE(STRINGIZE_KERNELS);
+static const char sigmoid_source[] = ACTIVATION_SIGMOID_SOURCE(STRINGIZE_KERNELS);
+static const char sincos_source[] = ACTIVATION_SINCOS_SOURCE(STRINGIZE_KERNELS);
+
+// Lay out a stringized definition, which arrives as one line of tokens, as indented code:
+// a line break after every '{', '}' and statement ';', and a blank line after each function
+static void write_kernel(FILE *file, const char *source) {
+    int depth = 0, parens = 0, line_start = 1;
+    for (const char *c = source; *c; c++) {
+        if (line_start) {
+            if (*c == ' ') continue;
+            for (int i = 0; i < (*c == '}' ? depth - 1 : depth); i++) fputs("    ", file);
+            line_start = 0;
+        }
+        fputc(*c, file);
+        if (*c == '(') {
+            parens++;
+        } else if (*c == ')') {
+            parens--;
+        } else if (*c == '{') {
+            depth++;
+            line_start = 1;
+        } else if (*c == '}') {
+            depth--;
+            line_start = strncmp(c + 1, " else", 5) != 0;
+        } else if (*c == ';' && parens == 0) {
+            line_start = 1;
+        }
+        if (line_start) fputs(*c == '}' && depth == 0 ? "\n\n" : "\n", file);
+    }
+}
+
+void export_activation_source(FILE *file, ActivationFunction activation) {
+    switch (activation) {
+        case RELU:
+            fputs("static inline double activate(double x) { return x > 0.0 ? x : 0.0; }\n\n", file);
+            break;
+        case LEAKY_RELU:
+            fprintf(file, "static inline double activate(double x) { return x > 0.0 ? x : %.17g * x; }\n\n", LEAKY_RELU_ALPHA);
+            break;
+        case SIGMOID:
+            write_kernel(file, select_source);
+            write_kernel(file, exp_source);
+            write_kernel(file, sigmoid_source);
+            fputs("static inline double activate(double x) { return fast_sigmoid(x, 0); }\n\n", file);
+            break;
+        case TANH:
+            write_kernel(file, select_source);
+            write_kernel(file, exp_source);
+            write_kernel(file, tanh_source);
+            fputs("static inline double activate(double x) { return fast_tanh(x, 0); }\n\n", file);
+            break;
+        case SIN:
+            write_kernel(file, select_source);
+            write_kernel(file, sincos_source);
+            fputs("static inline double activate(double x) {\n    double s, c;\n    fast_sincos(x, 0, &s, &c);\n    return s;\n}\n\n", file);
+            break;
+        case SILU:
+            write_kernel(file, select_source);
+            write_kernel(file, exp_source);
+            write_kernel(file, sigmoid_source);
+            fputs("static inline double activate(double x) { return x * fast_sigmoid(x, 0); }\n\n", file);
+            break;
+    }
+}
+
+void default_export_config(ExportConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->output_base = "pinn_model";
+    config->unroll_limit = 256;
+    config->test_points = 64;
+    config->tolerance = 1e-12;
+}
+
+// A C identifier from the file name of base: other characters become '_'
+static void symbol_name(const char *base, char *name, size_t size) {
+    const char *slash = strrchr(base, '/');
+    const char *file = slash ? slash + 1 : base;
+    size_t n = 0;
+    if (!isalpha((unsigned char)file[0]) && file[0] != '_' && n + 1 < size) {
+        name[n++] = '_';
+    }
+    for (const char *c = file; *c && n + 1 < size; c++) {
+        name[n++] = isalnum((unsigned char)*c) ? *c : '_';
+    }
+    name[n] = '\0';
+}
+
+// values as a brace-enclosed initializer, four round-trip-exact literals per line
+static void write_values(FILE *file, const double *values, size_t count) {
+    fputs("{", file);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(file, "%s%.17g", i % 4 == 0 ? "\n    " : " ", values[i]);
+        if (i + 1 < count) fputc(',', file);
+    }
+    fputs("\n}", file);
+}
+
+static void write_array(FILE *file, const char *name, const char *suffix, const double *values, size_t count) {
+    fprintf(file, "static _Alignas(64) const double %s_%s[%zu] = ", name, suffix, count);
+    write_values(file, values, count);
+    fputs(";\n\n", file);
+}
+
+static void write_header(FILE *file, const NeuralNetwork *nn, const char *name, const char *guard) {
+    fprintf(file, "// Generated by `pinn export-c`. Do not edit.\n");
+    fprintf(file, "#ifndef %s_H\n#define %s_H\n\n", guard, guard);
+    fprintf(file, "#define %s_INPUTS %d\n", guard, nn_input_size(nn));
+    fprintf(file, "#define %s_OUTPUTS %d\n\n", guard, nn_output_size(nn));
+    if (nn_parametric(nn)) {
+        fprintf(file, "// Inputs are (space..., time) followed by the equation parameters");
+        for (int k = 0; k < nn->parameter_inputs.count; k++) {
+            fprintf(file, " %s", loss_parameter_name((LossParameterField)nn->parameter_inputs.fields[k]));
+        }
+        fprintf(file, "\n");
+    }
+    fprintf(file, "void %s_forward(const double *input, double *output);\n", name);
+    fprintf(file, "// Row-major inputs[count][%s_INPUTS] -> outputs[count][%s_OUTPUTS]\n", guard, guard);
+    fprintf(file, "void %s_forward_batch(const double *inputs, int count, double *outputs);\n\n", name);
+    fprintf(file, "#endif // %s_H\n", guard);
+}
+
+// One dense layer: straight-line code for small layers, fixed-size loops the compiler
+// vectorizes for the rest. Both sum in forward_pass order (bias, then input 0, 1, ...).
+static void write_layer(FILE *file, const NeuralNetwork *nn, const char *name, int l, int unroll_limit) {
+    int in = nn->layer_sizes[l], out = nn->layer_sizes[l + 1];
+    int hidden = l + 2 < nn->num_layers;
+    char src[16], dst[16];
+    snprintf(src, sizeof(src), "a%d", l);
+    snprintf(dst, sizeof(dst), hidden ? "a%d" : "output", l + 1);
+
+    fprintf(file, "    // Layer %d: %d -> %d%s\n", l, in, out, hidden ? "" : " (linear output)");
+    if (hidden) {
+        fprintf(file, "    _Alignas(64) double a%d[%d];\n", l + 1, out);
+    }
+    if ((long long)in * out <= unroll_limit) {
+        for (int j = 0; j < out; j++) {
+            fprintf(file, "    %s[%d] = %s_b%d[%d]", dst, j, name, l, j);
+            for (int i = 0; i < in; i++) {
+                fprintf(file, " + %s[%d] * %s_w%d[%d]", src, i, name, l, i * out + j);
+            }
+            fprintf(file, ";\n");
+        }
+    } else {
+        fprintf(file, "    for (int j = 0; j < %d; j++) %s[j] = %s_b%d[j];\n", out, dst, name, l);
+        fprintf(file, "    for (int i = 0; i < %d; i++) {\n", in);
+        fprintf(file, "        const double x = %s[i];\n", src);
+        fprintf(file, "        const double *row = %s_w%d + i * %d;\n", name, l, out);
+        fprintf(file, "        for (int j = 0; j < %d; j++) %s[j] += x * row[j];\n", out, dst);
+        fprintf(file, "    }\n");
+    }
+    // The activation stays a loop either way so it vectorizes across the layer
+    if (hidden) {
+        fprintf(file, "    for (int j = 0; j < %d; j++) %s[j] = activate(%s[j]);\n", out, dst, dst);
+    }
+}
+
+// Layer 0 from the raw inputs: as they are, with the parameter columns scaled, or Fourier-encoded
+static void write_input_stage(FILE *file, const NeuralNetwork *nn, const char *name) {
+    int width = nn->layer_sizes[0];
+    if (nn->encoding.config.type == ENCODING_FOURIER) {
+        const EncodingConfig *config = &nn->encoding.config;
+        int d = config->input_dim, m = config->frequencies;
+        fprintf(file, "    // Fourier features: unit coordinates, then sin and cos of %d phases\n", m);
+        fprintf(file, "    _Alignas(64) double a0[%d];\n", width);
+        fprintf(file, "    double shifted[%d];\n", d);
+        for (int i = 0; i < d; i++) {
+            fprintf(file, "    shifted[%d] = input[%d] - %.17g;\n", i, i, config->lower[i]);
+            fprintf(file, "    a0[%d] = shifted[%d] * %.17g;\n", i, i, nn->encoding.inverse_width[i]);
+        }
+        fprintf(file, "    for (int k = 0; k < %d; k++) {\n", m);
+        fprintf(file, "        const double *b = %s_frequencies + k * %d;\n", name, d);
+        fprintf(file, "        double phase = 0.0;\n");
+        fprintf(file, "        for (int i = 0; i < %d; i++) phase += b[i] * shifted[i];\n", d);
+        fprintf(file, "        a0[%d + k] = sin(phase);\n", d);
+        fprintf(file, "        a0[%d + k] = cos(phase);\n", d + m);
+        fprintf(file, "    }\n");
+        return;
+    }
+    if (!nn_parametric(nn)) {
+        fprintf(file, "    const double *a0 = input;\n");
+        return;
+    }
+    const ParameterInputs *inputs = &nn->parameter_inputs;
+    int coordinates = nn_coordinate_inputs(nn);
+    fprintf(file, "    // Coordinates as they are, parameters mapped from their trained ranges to [-1, 1]\n");
+    fprintf(file, "    double a0[%d];\n", width);
+    fprintf(file, "    for (int i = 0; i < %d; i++) a0[i] = input[i];\n", coordinates);
+    for (int k = 0; k < inputs->count; k++) {
+        fprintf(file, "    a0[%d] = 2.0 * (input[%d] - %.17g) / (%.17g - %.17g) - 1.0; // %s\n", coordinates + k, coordinates + k,
+                inputs->lower[k], inputs->upper[k], inputs->lower[k], loss_parameter_name((LossParameterField)inputs->fields[k]));
+    }
+}
+
+static void write_source(FILE *file, const NeuralNetwork *nn, ActivationFunction activation, const char *name, const char *header, const ExportConfig *config) {
+    fprintf(file, "// Generated by `pinn export-c` from %s. Do not edit.\n// Layers", config->model_path ? config->model_path : "a trained network");
+    for (int l = 0; l < nn->num_layers; l++) {
+        fprintf(file, "%s%d", l ? "," : " ", nn->layer_sizes[l]);
+    }
+    fprintf(file, ", %s hidden activation", activation_function_name(activation));
+    if (nn_encoded(nn)) fprintf(file, ", %s encoding of %d inputs", encoding_type_name((EncodingType)nn->encoding.config.type), nn_input_size(nn));
+    fprintf(file, ".\n#include \"%s\"\n#include <stdint.h>\n#include <string.h>\n", header);
+    if (nn_encoded(nn)) fprintf(file, "#include <math.h>\n");
+    fprintf(file, "\n");
+
+    export_activation_source(file, activation);
+    for (int l = 0; l + 1 < nn->num_layers; l++) {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "w%d", l);
+        write_array(file, name, suffix, nn_weights(nn, l), (size_t)nn->layer_sizes[l] * nn->layer_sizes[l + 1]);
+        snprintf(suffix, sizeof(suffix), "b%d", l);
+        write_array(file, name, suffix, nn_biases(nn, l), (size_t)nn->layer_sizes[l + 1]);
+    }
+    if (nn->encoding.config.type == ENCODING_FOURIER) {
+        write_array(file, name, "frequencies", nn->encoding.frequencies, nn->encoding.num_constants);
+    }
+
+    fprintf(file, "void %s_forward(const double *restrict input, double *restrict output) {\n", name);
+    write_input_stage(file, nn, name);
+    for (int l = 0; l + 1 < nn->num_layers; l++) {
+        write_layer(file, nn, name, l, config->unroll_limit);
+    }
+    fprintf(file, "}\n\n");
+    fprintf(file, "void %s_forward_batch(const double *inputs, int count, double *outputs) {\n", name);
+    fprintf(file, "    for (int p = 0; p < count; p++) {\n");
+    fprintf(file, "        %s_forward(inputs + (size_t)p * %d, outputs + (size_t)p * %d);\n", name, nn_input_size(nn), nn_output_size(nn));
+    fprintf(file, "    }\n}\n");
+}
+
+// Self-test points: coordinates uniform over the domain, parameters over their trained ranges
+static void test_inputs(const NeuralNetwork *nn, const ExportConfig *config, double *points) {
+    int width = nn_input_size(nn), coordinates = nn_coordinate_inputs(nn);
+    Domain domain = config->domain;
+    if (domain.dims == 0) {
+        unit_domain(&domain, coordinates);
+    }
+    Rng rng;
+    rng_init(&rng, RNG_DEFAULT_SEED, RNG_STREAM_CANDIDATES, 0);
+    for (int p = 0; p < config->test_points; p++) {
+        double *x = points + (size_t)p * width;
+        for (int i = 0; i < coordinates; i++) {
+            rng_fill_uniform(&rng, (uint64_t)p * width + i, x + i, 1, domain.lower[i], domain.upper[i]);
+        }
+        for (int k = 0; k < nn->parameter_inputs.count; k++) {
+            rng_fill_uniform(&rng, (uint64_t)p * width + coordinates + k, x + coordinates + k, 1, nn->parameter_inputs.lower[k], nn->parameter_inputs.upper[k]);
+        }
+    }
+}
+
+static void write_test(FILE *file, const char *name, const char *guard, const char *header, const double *points, const double *outputs, const ExportConfig *config, int inputs, int outputs_per_point) {
+    fprintf(file, "// Generated by `pinn export-c`: %s_forward against forward_pass outputs recorded at\n", name);
+    fprintf(file, "// export time, then the latency of one call. Exits non-zero on a mismatch.\n");
+    fprintf(file, "#include <math.h>\n#include <stdio.h>\n#include <time.h>\n#include \"%s\"\n\n", header);
+    fprintf(file, "#define TEST_POINTS %d\n#define TOLERANCE %.17g\n\n", config->test_points, config->tolerance);
+    fprintf(file, "static const double test_inputs[TEST_POINTS * %s_INPUTS] = ", guard);
+    write_values(file, points, (size_t)config->test_points * inputs);
+    fprintf(file, ";\n\nstatic const double test_outputs[TEST_POINTS * %s_OUTPUTS] = ", guard);
+    write_values(file, outputs, (size_t)config->test_points * outputs_per_point);
+    fprintf(file, ";\n\n");
+    fprintf(file,
+            "int main(void) {\n"
+            "    double worst = 0.0;\n"
+            "    for (int p = 0; p < TEST_POINTS; p++) {\n"
+            "        double out[%s_OUTPUTS];\n"
+            "        %s_forward(test_inputs + p * %s_INPUTS, out);\n"
+            "        for (int j = 0; j < %s_OUTPUTS; j++) {\n"
+            "            double reference = test_outputs[p * %s_OUTPUTS + j];\n"
+            "            double error = fabs(out[j] - reference) / (1.0 + fabs(reference));\n"
+            "            worst = error > worst ? error : worst;\n"
+            "        }\n"
+            "    }\n\n"
+            "    // Feed each output back into the next input so the calls cannot overlap or be hoisted\n"
+            "    const int calls = 1000000;\n"
+            "    double x[%s_INPUTS], out[%s_OUTPUTS];\n"
+            "    for (int i = 0; i < %s_INPUTS; i++) x[i] = test_inputs[i];\n"
+            "    clock_t start = clock();\n"
+            "    for (int c = 0; c < calls; c++) {\n"
+            "        %s_forward(x, out);\n"
+            "        x[0] = test_inputs[0] + 1e-300 * out[0];\n"
+            "    }\n"
+            "    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;\n\n"
+            "    int ok = worst <= TOLERANCE;\n"
+            "    printf(\"%s: max error %%.3e over %%d points (tolerance %%.1e) %%s, %%.1f ns per call\\n\",\n"
+            "           worst, TEST_POINTS, TOLERANCE, ok ? \"PASS\" : \"FAIL\", 1e9 * seconds / calls);\n"
+            "    return ok ? 0 : 1;\n"
+            "}\n",
+            guard, name, guard, guard, guard, guard, guard, guard, name, name);
+}
+
+static FILE *open_output(const char *base, const char *suffix, char *path, size_t size) {
+    snprintf(path, size, "%s%s", base, suffix);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+    }
+    return file;
+}
+
+int export_c_network(NeuralNetwork *nn, ActivationFunction activation, const ExportConfig *config) {
+    if (nn->encoding.config.type == ENCODING_HASH_GRID) {
+        fprintf(stderr, "Error: export-c supports plain, parametric and Fourier-encoded networks, not hash grids\n");
+        return 0;
+    }
+    if (config->test_points < 1 || !(config->tolerance > 0.0)) {
+        fprintf(stderr, "Error: The self-test needs at least one point and a positive tolerance\n");
+        return 0;
+    }
+    if (config->domain.dims != 0 && config->domain.dims != nn_coordinate_inputs(nn)) {
+        fprintf(stderr, "Error: The domain has %d axes but the network takes %d coordinates\n", config->domain.dims, nn_coordinate_inputs(nn));
+        return 0;
+    }
+    char name[128], guard[128];
+    symbol_name(config->name ? config->name : config->output_base, name, sizeof(name));
+    for (size_t i = 0; i <= strlen(name); i++) {
+        guard[i] = (char)toupper((unsigned char)name[i]);
+    }
+
+    // Reference outputs come from the same forward_pass the rest of the tree uses
+    int inputs = nn_input_size(nn), outputs = nn_output_size(nn);
+    double *points = malloc((size_t)config->test_points * (inputs + outputs) * sizeof(double));
+    if (points == NULL) {
+        fprintf(stderr, "Error: Failed to allocate the self-test points\n");
+        return 0;
+    }
+    double *references = points + (size_t)config->test_points * inputs;
+    test_inputs(nn, config, points);
+    for (int p = 0; p < config->test_points; p++) {
+        forward_pass(nn, points + (size_t)p * inputs, references + (size_t)p * outputs, activation);
+    }
+
+    char header_path[512], source_path[512], test_path[512];
+    FILE *header = open_output(config->output_base, ".h", header_path, sizeof(header_path));
+    FILE *source = header ? open_output(config->output_base, ".c", source_path, sizeof(source_path)) : NULL;
+    FILE *test = source ? open_output(config->output_base, "_test.c", test_path, sizeof(test_path)) : NULL;
+    int ok = test != NULL;
+    if (ok) {
+        // The sources include the header by file name, so they can move together
+        const char *slash = strrchr(header_path, '/');
+        const char *header_name = slash ? slash + 1 : header_path;
+        write_header(header, nn, name, guard);
+        write_source(source, nn, activation, name, header_name, config);
+        write_test(test, name, guard, header_name, points, references, config, inputs, outputs);
+    }
+    ok = (!header || fclose(header) == 0) && ok;
+    ok = (!source || fclose(source) == 0) && ok;
+    ok = (!test || fclose(test) == 0) && ok;
+    free(points);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write the generated sources for %s\n", config->output_base);
+        return 0;
+    }
+    printf("Exported %s_forward to %s, %s and %s\n", name, header_path, source_path, test_path);
+    return 1;
+}
+
+int export_c_model(const ExportConfig *config) {
+    NeuralNetwork nn;
+    ActivationFunction activation;
+    if (!load_model(&nn, config->model_path, &activation)) {
+        return 0;
+    }
+    int ok = export_c_network(&nn, activation, config);
+    free_neural_network(&nn);
+    return ok;
+}
@@ -0,0 +1,109 @@
+#include "gemm.h"
+#include <string.h>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+// Cache blocking: a GEMM_KC x GEMM_NC panel of B stays resident in L2 while
+// GEMM_MR rows of A stream through a register-blocked micro-kernel.
+#define GEMM_MR 4
+#define GEMM_KC 256
+#define GEMM_NC 512
+
+#if defined(__AVX512F__)
+#define GEMM_ISA "avx512"
+#define VEC_F64 __m512d
+#define VLEN_F64 8
+#define VEC_F32 __m512
+#define VLEN_F32 16
+#define vload_f64 _mm512_loadu_pd
+#define vstore_f64 _mm512_storeu_pd
+#define vset1_f64 _mm512_set1_pd
+#define vzero_f64 _mm512_setzero_pd
+#define vfma_f64 _mm512_fmadd_pd
+#define vhsum_f64 _mm512_reduce_add_pd
+#define vload_f32 _mm512_loadu_ps
+#define vstore_f32 _mm512_storeu_ps
+#define vset1_f32 _mm512_set1_ps
+#define vzero_f32 _mm512_setzero_ps
+#define vfma_f32 _mm512_fmadd_ps
+#define vhsum_f32 _mm512_reduce_add_ps
+#elif defined(__AVX2__) && defined(__FMA__)
+#define GEMM_ISA "avx2"
+#define VEC_F64 __m256d
+#define VLEN_F64 4
+#define VEC_F32 __m256
+#define VLEN_F32 8
+#define vload_f64 _mm256_loadu_pd
+#define vstore_f64 _mm256_storeu_pd
+#define vset1_f64 _mm256_set1_pd
+#define vzero_f64 _mm256_setzero_pd
+#define vfma_f64 _mm256_fmadd_pd
+#define vload_f32 _mm256_loadu_ps
+#define vstore_f32 _mm256_storeu_ps
+#define vset1_f32 _mm256_set1_ps
+#define vzero_f32 _mm256_setzero_ps
+#define vfma_f32 _mm256_fmadd_ps
+static inline double vhsum_f64(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+static inline float vhsum_f32(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    return _mm_cvtss_f32(_mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1)));
+}
+#else
+#define GEMM_ISA "scalar"
+#endif
+
+static inline int min_int(int a, int b) {
+    return a < b ? a : b;
+}
+
+const char *gemm_isa(void) {
+    return GEMM_ISA;
+}
+
+// double: gemm_nn, gemm_nt, gemm_tn
+#define SCALAR double
+#define GEMM_FN(name) name
+#ifdef VLEN_F64
+#define VEC VEC_F64
+#define VLEN VLEN_F64
+#define VLOAD vload_f64
+#define VSTORE vstore_f64
+#define VSET1 vset1_f64
+#define VZERO vzero_f64
+#define VFMA vfma_f64
+#define VHSUM vhsum_f64
+#endif
+#include "gemm_template.h"
+#undef SCALAR
+#undef GEMM_FN
+#undef VEC
+#undef VLEN
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VZERO
+#undef VFMA
+#undef VHSUM
+
+// float: gemm_nn_f32, gemm_nt_f32, gemm_tn_f32 (twice the lanes per register)
+#define SCALAR float
+#define GEMM_FN(name) name##_f32
+#ifdef VLEN_F32
+#define VEC VEC_F32
+#define VLEN VLEN_F32
+#define VLOAD vload_f32
+#define VSTORE vstore_f32
+#define VSET1 vset1_f32
+#define VZERO vzero_f32
+#define VFMA vfma_f32
+#define VHSUM vhsum_f32
+#endif
+#include "gemm_template.h"
@@ -0,0 +1,167 @@
+// Blocked GEMM kernels, instantiated once per scalar type by gemm.c. The includer defines
+// SCALAR, GEMM_FN(name) and, when SIMD is available, VEC, VLEN, VLOAD, VSTORE, VSET1,
+// VZERO, VFMA and VHSUM for that type.
+
+// Four rows of C against one KC x NC panel; A(r, p) = A[r * a_rs + p * a_cs]
+static void GEMM_FN(kernel_rows4)(int kc, int nc, const SCALAR *A, int a_rs, int a_cs, const SCALAR *B, int ldb, SCALAR *C, int ldc) {
+    SCALAR *C0 = C;
+    SCALAR *C1 = C + ldc;
+    SCALAR *C2 = C + 2 * (size_t)ldc;
+    SCALAR *C3 = C + 3 * (size_t)ldc;
+    const SCALAR *A0 = A;
+    const SCALAR *A1 = A + a_rs;
+    const SCALAR *A2 = A + 2 * (size_t)a_rs;
+    const SCALAR *A3 = A + 3 * (size_t)a_rs;
+    int j = 0;
+
+#ifdef VLEN
+    for (; j + 2 * VLEN <= nc; j += 2 * VLEN) {
+        VEC c00 = VLOAD(C0 + j), c01 = VLOAD(C0 + j + VLEN);
+        VEC c10 = VLOAD(C1 + j), c11 = VLOAD(C1 + j + VLEN);
+        VEC c20 = VLOAD(C2 + j), c21 = VLOAD(C2 + j + VLEN);
+        VEC c30 = VLOAD(C3 + j), c31 = VLOAD(C3 + j + VLEN);
+        for (int p = 0; p < kc; p++) {
+            const SCALAR *b = B + (size_t)p * ldb + j;
+            size_t ap = (size_t)p * a_cs;
+            VEC b0 = VLOAD(b), b1 = VLOAD(b + VLEN);
+            VEC a0 = VSET1(A0[ap]), a1 = VSET1(A1[ap]), a2 = VSET1(A2[ap]), a3 = VSET1(A3[ap]);
+            c00 = VFMA(a0, b0, c00); c01 = VFMA(a0, b1, c01);
+            c10 = VFMA(a1, b0, c10); c11 = VFMA(a1, b1, c11);
+            c20 = VFMA(a2, b0, c20); c21 = VFMA(a2, b1, c21);
+            c30 = VFMA(a3, b0, c30); c31 = VFMA(a3, b1, c31);
+        }
+        VSTORE(C0 + j, c00); VSTORE(C0 + j + VLEN, c01);
+        VSTORE(C1 + j, c10); VSTORE(C1 + j + VLEN, c11);
+        VSTORE(C2 + j, c20); VSTORE(C2 + j + VLEN, c21);
+        VSTORE(C3 + j, c30); VSTORE(C3 + j + VLEN, c31);
+    }
+    for (; j + VLEN <= nc; j += VLEN) {
+        VEC c0 = VLOAD(C0 + j), c1 = VLOAD(C1 + j), c2 = VLOAD(C2 + j), c3 = VLOAD(C3 + j);
+        for (int p = 0; p < kc; p++) {
+            size_t ap = (size_t)p * a_cs;
+            VEC b = VLOAD(B + (size_t)p * ldb + j);
+            c0 = VFMA(VSET1(A0[ap]), b, c0);
+            c1 = VFMA(VSET1(A1[ap]), b, c1);
+            c2 = VFMA(VSET1(A2[ap]), b, c2);
+            c3 = VFMA(VSET1(A3[ap]), b, c3);
+        }
+        VSTORE(C0 + j, c0); VSTORE(C1 + j, c1); VSTORE(C2 + j, c2); VSTORE(C3 + j, c3);
+    }
+#endif
+    for (; j < nc; j++) {
+        SCALAR c0 = C0[j], c1 = C1[j], c2 = C2[j], c3 = C3[j];
+        for (int p = 0; p < kc; p++) {
+            size_t ap = (size_t)p * a_cs;
+            SCALAR b = B[(size_t)p * ldb + j];
+            c0 += A0[ap] * b;
+            c1 += A1[ap] * b;
+            c2 += A2[ap] * b;
+            c3 += A3[ap] * b;
+        }
+        C0[j] = c0; C1[j] = c1; C2[j] = c2; C3[j] = c3;
+    }
+}
+
+// Leftover single row of C against one panel
+static void GEMM_FN(kernel_row1)(int kc, int nc, const SCALAR *A, int a_cs, const SCALAR *B, int ldb, SCALAR *C) {
+    int j = 0;
+
+#ifdef VLEN
+    for (; j + VLEN <= nc; j += VLEN) {
+        VEC c = VLOAD(C + j);
+        for (int p = 0; p < kc; p++) {
+            c = VFMA(VSET1(A[(size_t)p * a_cs]), VLOAD(B + (size_t)p * ldb + j), c);
+        }
+        VSTORE(C + j, c);
+    }
+#endif
+    for (; j < nc; j++) {
+        SCALAR c = C[j];
+        for (int p = 0; p < kc; p++) {
+            c += A[(size_t)p * a_cs] * B[(size_t)p * ldb + j];
+        }
+        C[j] = c;
+    }
+}
+
+// C[i][j] (+)= sum_p A(i, p) * B[p][j] with A(i, p) = A[i * a_rs + p * a_cs]
+static void GEMM_FN(gemm_strided)(int m, int n, int k, const SCALAR *A, int a_rs, int a_cs, const SCALAR *B, int ldb, SCALAR *C, int ldc, int accumulate) {
+    if (!accumulate) {
+        for (int i = 0; i < m; i++) {
+            memset(C + (size_t)i * ldc, 0, n * sizeof(SCALAR));
+        }
+    }
+
+    for (int jj = 0; jj < n; jj += GEMM_NC) {
+        int nc = min_int(GEMM_NC, n - jj);
+        for (int pp = 0; pp < k; pp += GEMM_KC) {
+            int kc = min_int(GEMM_KC, k - pp);
+            const SCALAR *Bp = B + (size_t)pp * ldb + jj;
+            int i = 0;
+            for (; i + GEMM_MR <= m; i += GEMM_MR) {
+                const SCALAR *Ap = A + (size_t)i * a_rs + (size_t)pp * a_cs;
+                GEMM_FN(kernel_rows4)(kc, nc, Ap, a_rs, a_cs, Bp, ldb, C + (size_t)i * ldc + jj, ldc);
+            }
+            for (; i < m; i++) {
+                const SCALAR *Ap = A + (size_t)i * a_rs + (size_t)pp * a_cs;
+                GEMM_FN(kernel_row1)(kc, nc, Ap, a_cs, Bp, ldb, C + (size_t)i * ldc + jj);
+            }
+        }
+    }
+}
+
+void GEMM_FN(gemm_nn)(int m, int n, int k, const SCALAR *A, int lda, const SCALAR *B, int ldb, SCALAR *C, int ldc, int accumulate) {
+    GEMM_FN(gemm_strided)(m, n, k, A, lda, 1, B, ldb, C, ldc, accumulate);
+}
+
+void GEMM_FN(gemm_tn)(int m, int n, int k, const SCALAR *A, int lda, const SCALAR *B, int ldb, SCALAR *C, int ldc, int accumulate) {
+    GEMM_FN(gemm_strided)(m, n, k, A, 1, lda, B, ldb, C, ldc, accumulate);
+}
+
+// Both operands are walked along contiguous rows, so this is a blocked set of dot products
+void GEMM_FN(gemm_nt)(int m, int n, int k, const SCALAR *A, int lda, const SCALAR *B, int ldb, SCALAR *C, int ldc, int accumulate) {
+    for (int i = 0; i < m; i++) {
+        const SCALAR *a = A + (size_t)i * lda;
+        SCALAR *c = C + (size_t)i * ldc;
+        int j = 0;
+
+        for (; j + 4 <= n; j += 4) {
+            const SCALAR *b0 = B + (size_t)j * ldb;
+            const SCALAR *b1 = b0 + ldb;
+            const SCALAR *b2 = b1 + ldb;
+            const SCALAR *b3 = b2 + ldb;
+            SCALAR s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+            int p = 0;
+#ifdef VLEN
+            VEC v0 = VZERO(), v1 = VZERO(), v2 = VZERO(), v3 = VZERO();
+            for (; p + VLEN <= k; p += VLEN) {
+                VEC av = VLOAD(a + p);
+                v0 = VFMA(av, VLOAD(b0 + p), v0);
+                v1 = VFMA(av, VLOAD(b1 + p), v1);
+                v2 = VFMA(av, VLOAD(b2 + p), v2);
+                v3 = VFMA(av, VLOAD(b3 + p), v3);
+            }
+            s0 = VHSUM(v0); s1 = VHSUM(v1); s2 = VHSUM(v2); s3 = VHSUM(v3);
+#endif
+            for (; p < k; p++) {
+                s0 += a[p] * b0[p];
+                s1 += a[p] * b1[p];
+                s2 += a[p] * b2[p];
+                s3 += a[p] * b3[p];
+            }
+            if (accumulate) {
+                c[j] += s0; c[j + 1] += s1; c[j + 2] += s2; c[j + 3] += s3;
+            } else {
+                c[j] = s0; c[j + 1] = s1; c[j + 2] = s2; c[j + 3] = s3;
+            }
+        }
+        for (; j < n; j++) {
+            const SCALAR *b = B + (size_t)j * ldb;
+            SCALAR s = 0.0;
+            for (int p = 0; p < k; p++) {
+                s += a[p] * b[p];
+            }
+            c[j] = accumulate ? c[j] + s : s;
+        }
+    }
+}
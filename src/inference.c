@@ -0,0 +1,299 @@
+#include "inference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "thread_pool.h"
+
+// Every worker owns a batch workspace and one tile of inputs and outputs
+typedef struct {
+    BatchWorkspace ws;
+    double *inputs;
+    double *outputs;
+} InferenceWorker;
+
+// The job handed to the pool: each worker evaluates a contiguous run of whole tiles
+typedef struct {
+    const NeuralNetwork *nn;
+    ActivationFunction activation;
+    InferenceWorker *workers;
+    const InferenceHeader *header;
+    const double *points;               // Mapped points file, or NULL for the grid
+    unsigned char *data;                // Mapped output array
+    int tile;
+} InferenceJob;
+
+void default_inference_config(InferenceConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->output_path = "inference.bin";
+    config->threads = 0;
+    config->tile = 1024;
+    config->dtype = INFERENCE_DTYPE_FP64;
+}
+
+int parse_grid_resolution(const char *spec, int resolution[SAMPLER_MAX_DIMS]) {
+    int count = 0;
+    const char *p = spec;
+    while (*p != '\0') {
+        char *end = NULL;
+        long n = strtol(p, &end, 10);
+        if (end == p || n <= 0 || n > 1 << 30 || count >= SAMPLER_MAX_DIMS) {
+            return -1;
+        }
+        resolution[count++] = (int)n;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p != '\0') return -1;
+    }
+    return count > 0 ? count : -1;
+}
+
+// Coordinates of grid points [first, first + count), walking the index like an odometer
+static void fill_grid_tile(const InferenceHeader *header, uint64_t first, int count, double *inputs) {
+    int dims = (int)header->grid_dims;
+    uint64_t index[SAMPLER_MAX_DIMS];
+    double step[SAMPLER_MAX_DIMS];
+    uint64_t rest = first;
+    for (int d = dims - 1; d >= 0; d--) {
+        index[d] = rest % header->resolution[d];
+        rest /= header->resolution[d];
+        step[d] = header->resolution[d] > 1 ? (header->upper[d] - header->lower[d]) / (double)(header->resolution[d] - 1) : 0.0;
+    }
+    for (int s = 0; s < count; s++) {
+        for (int d = 0; d < dims; d++) {
+            inputs[(size_t)s * dims + d] = header->lower[d] + step[d] * (double)index[d];
+        }
+        for (int d = dims - 1; d >= 0; d--) {
+            if (++index[d] < header->resolution[d]) break;
+            index[d] = 0;
+        }
+    }
+}
+
+static void inference_task(void *context, int worker, int num_workers) {
+    InferenceJob *job = context;
+    InferenceWorker *w = &job->workers[worker];
+    const InferenceHeader *header = job->header;
+    uint64_t tiles = (header->num_points + job->tile - 1) / job->tile;
+    uint64_t first_tile = tiles * worker / num_workers;
+    uint64_t end_tile = tiles * (worker + 1) / num_workers;
+    size_t in = header->input_dim, out = header->output_dim;
+
+    for (uint64_t t = first_tile; t < end_tile; t++) {
+        uint64_t first = t * job->tile;
+        int count = (int)(header->num_points - first < (uint64_t)job->tile ? header->num_points - first : (uint64_t)job->tile);
+        const double *inputs = w->inputs;
+        if (job->points) {
+            inputs = job->points + first * in;
+        } else {
+            fill_grid_tile(header, first, count, w->inputs);
+        }
+
+        // fp64 results go straight into the mapping; fp32 ones are narrowed from the tile buffer
+        if (header->dtype == INFERENCE_DTYPE_FP64) {
+            forward_pass_batch(job->nn, &w->ws, inputs, count, (double *)job->data + first * out, job->activation);
+        } else {
+            float *dst = (float *)job->data + first * out;
+            forward_pass_batch(job->nn, &w->ws, inputs, count, w->outputs, job->activation);
+            for (size_t i = 0; i < (size_t)count * out; i++) {
+                dst[i] = (float)w->outputs[i];
+            }
+        }
+    }
+}
+
+// Map the points file read-only; it is a bare float64 array of whole points
+static const double *map_points(const char *path, int input_dim, uint64_t *num_points, size_t *mapped_size) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open points file %s\n", path);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    size_t point_bytes = (size_t)input_dim * sizeof(double);
+    if (st.st_size == 0 || (size_t)st.st_size % point_bytes != 0) {
+        fprintf(stderr, "Error: %s does not hold whole %d-dimensional float64 points\n", path, input_dim);
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map points file %s\n", path);
+        return NULL;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    *num_points = (size_t)st.st_size / point_bytes;
+    *mapped_size = (size_t)st.st_size;
+    return map;
+}
+
+// Fill in the point count and either the grid or the mapped points. The grid of a
+// parametric model spans its trained parameter ranges unless --domain covers those axes
+// too; pinned parameters collapse their axis to one value.
+static int describe_points(const InferenceConfig *config, const ParameterInputs *inputs, int input_dim, InferenceHeader *header, const double **points, size_t *points_size) {
+    if (config->points_path && config->num_fixed > 0) {
+        fprintf(stderr, "Error: --parameter only applies to grids; a points file carries its own parameter columns\n");
+        return 0;
+    }
+    if (config->points_path) {
+        uint64_t num_points = 0;
+        *points = map_points(config->points_path, input_dim, &num_points, points_size);
+        header->num_points = num_points;
+        return *points != NULL;
+    }
+
+    int coordinates = input_dim - inputs->count;
+    int resolution[SAMPLER_MAX_DIMS];
+    memcpy(resolution, config->resolution, sizeof(resolution));
+    Domain grid = config->grid;
+    if (grid.dims == 0) {
+        unit_domain(&grid, coordinates);
+    }
+    if (grid.dims == coordinates) {
+        for (int k = 0; k < inputs->count && grid.dims < SAMPLER_MAX_DIMS; k++, grid.dims++) {
+            grid.lower[grid.dims] = inputs->lower[k];
+            grid.upper[grid.dims] = inputs->upper[k];
+        }
+    }
+    if (grid.dims != input_dim) {
+        fprintf(stderr, "Error: The grid has %d axes but the network takes %d inputs\n", grid.dims, input_dim);
+        return 0;
+    }
+    for (int i = 0; i < config->num_fixed; i++) {
+        int k = find_parameter_input(inputs, config->fixed_fields[i]);
+        if (k < 0) {
+            fprintf(stderr, "Error: %s is not a parameter input of this model\n", loss_parameter_name(config->fixed_fields[i]));
+            return 0;
+        }
+        grid.lower[coordinates + k] = grid.upper[coordinates + k] = config->fixed_values[i];
+        resolution[coordinates + k] = 1;
+    }
+    header->grid_dims = (uint32_t)input_dim;
+    header->num_points = 1;
+    for (int d = 0; d < input_dim; d++) {
+        if (resolution[d] <= 0) {
+            fprintf(stderr, "Error: No grid resolution given for axis %d\n", d);
+            return 0;
+        }
+        header->resolution[d] = (uint64_t)resolution[d];
+        header->lower[d] = grid.lower[d];
+        header->upper[d] = grid.upper[d];
+        header->num_points *= header->resolution[d];
+    }
+    return 1;
+}
+
+// Create the result file at its final size and map it for the workers to write into
+static unsigned char *map_output(const char *path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        fprintf(stderr, "Error: Cannot size %s to %zu bytes\n", path, size);
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map %s\n", path);
+        return NULL;
+    }
+    return map;
+}
+
+int run_inference(const InferenceConfig *config) {
+    NeuralNetwork nn;
+    ActivationFunction activation;
+    if (!load_model(&nn, config->model_path, &activation)) {
+        return 0;
+    }
+
+    int ok = 0;
+    int input_dim = nn_input_size(&nn), output_dim = nn_output_size(&nn);
+    int num_workers = config->threads > 0 ? config->threads : available_cores();
+    int tile = config->tile > 0 ? config->tile : 1024;
+    InferenceHeader header;
+    const double *points = NULL;
+    size_t points_size = 0, output_size = 0;
+    unsigned char *output = NULL;
+    InferenceWorker *workers = NULL;
+    Arena arena = {0};
+    ThreadPool pool;
+    int pool_started = 0;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INFERENCE_MAGIC, sizeof(header.magic));
+    header.version = INFERENCE_VERSION;
+    header.header_size = (uint32_t)arena_aligned_size(sizeof(InferenceHeader));
+    header.dtype = config->dtype;
+    header.input_dim = (uint32_t)input_dim;
+    header.output_dim = (uint32_t)output_dim;
+    header.data_offset = header.header_size;
+    if (!describe_points(config, &nn.parameter_inputs, input_dim, &header, &points, &points_size)) {
+        goto cleanup;
+    }
+
+    size_t value_size = header.dtype == INFERENCE_DTYPE_FP32 ? sizeof(float) : sizeof(double);
+    output_size = header.data_offset + header.num_points * output_dim * value_size;
+    output = map_output(config->output_path, output_size);
+    if (output == NULL) {
+        goto cleanup;
+    }
+    memcpy(output, &header, sizeof(header));
+
+    // No point starting more workers than there are tiles
+    uint64_t tiles = (header.num_points + tile - 1) / tile;
+    if ((uint64_t)num_workers > tiles) num_workers = (int)tiles;
+    size_t total = arena_aligned_size(num_workers * sizeof(InferenceWorker)) +
+                   num_workers * (arena_aligned_size((size_t)tile * input_dim * sizeof(double)) +
+                                  arena_aligned_size((size_t)tile * output_dim * sizeof(double)));
+    if (!arena_init(&arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate buffers for %d workers\n", num_workers);
+        goto cleanup;
+    }
+    workers = arena_alloc(&arena, num_workers * sizeof(InferenceWorker));
+    memset(workers, 0, num_workers * sizeof(InferenceWorker));
+    for (int w = 0; w < num_workers; w++) {
+        workers[w].inputs = arena_alloc(&arena, (size_t)tile * input_dim * sizeof(double));
+        workers[w].outputs = arena_alloc(&arena, (size_t)tile * output_dim * sizeof(double));
+        if (!init_batch_workspace(&workers[w].ws, &nn, tile)) {
+            goto cleanup;
+        }
+    }
+    if (!thread_pool_init(&pool, num_workers)) {
+        fprintf(stderr, "Error: Failed to start %d worker threads\n", num_workers);
+        goto cleanup;
+    }
+    pool_started = 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    InferenceJob job = {&nn, activation, workers, &header, points, output + header.data_offset, tile};
+    thread_pool_run(&pool, inference_task, &job);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec);
+    printf("Evaluated %llu points on %d threads in %.3f s (%.4g points/s) -> %s\n", (unsigned long long)header.num_points, num_workers,
+           seconds, seconds > 0 ? (double)header.num_points / seconds : 0.0, config->output_path);
+    ok = 1;
+
+cleanup:
+    if (pool_started) thread_pool_free(&pool);
+    for (int w = 0; workers && w < num_workers; w++) {
+        free_batch_workspace(&workers[w].ws);
+    }
+    arena_free(&arena);
+    if (output) munmap(output, output_size);
+    if (points) munmap((void *)points, points_size);
+    free_neural_network(&nn);
+    return ok;
+}
@@ -0,0 +1,261 @@
+#include "logger.h"
+#include <dirent.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+// Size of the writer's stdio buffer; the file sees one write per this many bytes
+#define LOG_BUFFER_SIZE (1 << 20)
+
+static const char *log_extension(LogFormat format) {
+    switch (format) {
+        case LOG_CSV: return "csv";
+        case LOG_BINARY: return "bin";
+        default: return "txt";
+    }
+}
+
+int parse_log_format(const char *name, LogFormat *format) {
+    if (strcmp(name, "text") == 0) {
+        *format = LOG_TEXT;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = LOG_CSV;
+    } else if (strcmp(name, "binary") == 0) {
+        *format = LOG_BINARY;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// One pass over the directory: run 0 writes log_<loss>.<ext>, run N writes log_<loss>_N.<ext>.
+// Returns one past the highest run already present in any format.
+int next_run_number(const char *directory, const char *loss_type) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    char prefix[128];
+    int prefix_length = snprintf(prefix, sizeof(prefix), "log_%s", loss_type);
+    int next = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (strncmp(name, prefix, prefix_length) != 0) continue;
+        const char *rest = name + prefix_length;
+        int run = 0;
+        if (*rest == '_') {
+            char *end = NULL;
+            long value = strtol(rest + 1, &end, 10);
+            if (end == rest + 1 || value <= 0) continue;
+            run = (int)value;
+            rest = end;
+        }
+        if (*rest != '.') continue;
+        rest++;
+        if (strcmp(rest, "txt") != 0 && strcmp(rest, "csv") != 0 && strcmp(rest, "bin") != 0) continue;
+        if (run + 1 > next) next = run + 1;
+    }
+    closedir(dir);
+    return next;
+}
+
+// Returns the number of bytes written
+static int write_record(TrainingLogger *logger, const LogRecord *record) {
+    switch (logger->format) {
+        case LOG_TEXT:
+            // A validation loss measured at an earlier epoch says which one
+            if (record->validation_epoch >= 0 && record->validation_epoch != record->epoch) {
+                return fprintf(logger->file, "Epoch %d: Loss:  %.5f, Validation Loss: %.5f (epoch %d)\n", record->epoch, record->loss, record->validation_loss,
+                               record->validation_epoch);
+            }
+            return fprintf(logger->file, "Epoch %d: Loss:  %.5f, Validation Loss: %.5f\n", record->epoch, record->loss, record->validation_loss);
+        case LOG_CSV:
+            return fprintf(logger->file, "%d,%.17g,%.17g,%.17g,%d\n", record->epoch, record->loss, record->validation_loss, record->learning_rate,
+                           record->validation_epoch);
+        case LOG_BINARY:
+            return (int)(fwrite(record, sizeof(*record), 1, logger->file) * sizeof(*record));
+    }
+    return 0;
+}
+
+// Write out whatever the trainer has published to one ring
+static void drain(TrainingLogger *logger) {
+    size_t tail = atomic_load_explicit(&logger->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&logger->head, memory_order_acquire);
+    for (; tail != head; tail++) {
+        int bytes = write_record(logger, &logger->records[tail & (LOG_RING_CAPACITY - 1)]);
+        PROFILE_COUNT(PROF_BYTES_LOGGED, bytes > 0 ? bytes : 0);
+    }
+    atomic_store_explicit(&logger->tail, tail, memory_order_release);
+}
+
+// Only the writer moves the tails, so it can read them relaxed
+static int group_idle(TrainingLogger *writer) {
+    for (int k = 0; k < writer->group_size; k++) {
+        TrainingLogger *logger = &writer->group[k];
+        if (atomic_load(&logger->head) != atomic_load_explicit(&logger->tail, memory_order_relaxed)) return 0;
+    }
+    return 1;
+}
+
+// Drain every ring of the group, then sleep until the trainer publishes more; exits once
+// stop is set and the rings are empty
+static void *writer_main(void *arg) {
+    TrainingLogger *writer = arg;
+
+    for (;;) {
+        int stopping = atomic_load_explicit(&writer->stop, memory_order_acquire);
+        for (int k = 0; k < writer->group_size; k++) {
+            drain(&writer->group[k]);
+        }
+        if (stopping) break;
+
+        // Announce the nap before the last look at the heads: either that look sees the
+        // trainer's record, or the trainer sees sleeping and signals under the lock
+        pthread_mutex_lock(&writer->lock);
+        atomic_store(&writer->sleeping, 1);
+        while (group_idle(writer) && !atomic_load(&writer->stop)) {
+            pthread_cond_wait(&writer->wake, &writer->lock);
+        }
+        atomic_store(&writer->sleeping, 0);
+        pthread_mutex_unlock(&writer->lock);
+    }
+    return NULL;
+}
+
+static void wake_writer(TrainingLogger *writer) {
+    pthread_mutex_lock(&writer->lock);
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+static void close_file(TrainingLogger *logger) {
+    fclose(logger->file);
+    free(logger->records);
+    free(logger->buffer);
+    logger->file = NULL;
+    logger->records = NULL;
+    logger->buffer = NULL;
+}
+
+// Pick the run number and open the log; returns 1 on success, 0 on failure
+static int open_file(TrainingLogger *logger, const char *loss_type, LogFormat format, int every) {
+    memset(logger, 0, sizeof(*logger));
+    logger->format = format;
+    logger->every = every > 0 ? every : 1;
+
+    int run_number = next_run_number(".", loss_type);
+    if (run_number == 0) {
+        snprintf(logger->run, sizeof(logger->run), "%s", loss_type);
+    } else {
+        snprintf(logger->run, sizeof(logger->run), "%s_%d", loss_type, run_number);
+    }
+    snprintf(logger->path, sizeof(logger->path), "log_%s.%s", logger->run, log_extension(format));
+
+    logger->file = fopen(logger->path, format == LOG_BINARY ? "wb" : "w");
+    if (logger->file == NULL) {
+        fprintf(stderr, "Failed to open log file: %s\n", logger->path);
+        return 0;
+    }
+    logger->records = malloc(LOG_RING_CAPACITY * sizeof(LogRecord));
+    if (logger->records == NULL) {
+        fclose(logger->file);
+        logger->file = NULL;
+        return 0;
+    }
+    logger->buffer = malloc(LOG_BUFFER_SIZE);
+    if (logger->buffer) {
+        setvbuf(logger->file, logger->buffer, _IOFBF, LOG_BUFFER_SIZE);
+    }
+
+    if (format == LOG_CSV) {
+        fprintf(logger->file, "epoch,loss,validation_loss,learning_rate,validation_epoch\n");
+    } else if (format == LOG_BINARY) {
+        LogFileHeader header = {{0}, sizeof(LogRecord), 0};
+        memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+        fwrite(&header, sizeof(header), 1, logger->file);
+    }
+    return 1;
+}
+
+int logger_open_group(TrainingLogger *loggers, int count, const char *loss_type, LogFormat format, int every) {
+    for (int k = 0; k < count; k++) {
+        if (!open_file(&loggers[k], loss_type, format, every)) {
+            while (k-- > 0) close_file(&loggers[k]);
+            return 0;
+        }
+        loggers[k].writer = &loggers[0];
+    }
+
+    TrainingLogger *writer = &loggers[0];
+    writer->group = loggers;
+    writer->group_size = count;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        fprintf(stderr, "Error: Failed to start the log writer\n");
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->wake);
+        for (int k = 0; k < count; k++) close_file(&loggers[k]);
+        return 0;
+    }
+    return 1;
+}
+
+// Open a log with a writer of its own; returns 1 on success, 0 on failure
+int logger_open(TrainingLogger *logger, const char *loss_type, LogFormat format, int every) {
+    return logger_open_group(logger, 1, loss_type, format, every);
+}
+
+int logger_wants_epoch(const TrainingLogger *logger, int epoch, int num_epochs) {
+    return logger->file != NULL && (epoch % logger->every == 0 || epoch == num_epochs - 1);
+}
+
+// Called from the training thread only; spins if the writer falls a full ring behind, and
+// takes the lock only to wake a writer that has gone to sleep
+void logger_record(TrainingLogger *logger, int epoch, double loss, double validation_loss, int validation_epoch, double learning_rate) {
+    size_t head = atomic_load_explicit(&logger->head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&logger->tail, memory_order_acquire) >= LOG_RING_CAPACITY) {
+        sched_yield();
+    }
+
+    LogRecord *record = &logger->records[head & (LOG_RING_CAPACITY - 1)];
+    record->epoch = epoch;
+    record->validation_epoch = validation_epoch;
+    record->loss = loss;
+    record->validation_loss = validation_loss;
+    record->learning_rate = learning_rate;
+    atomic_store(&logger->head, head + 1);
+    if (atomic_load(&logger->writer->sleeping)) {
+        wake_writer(logger->writer);
+    }
+}
+
+// Flush every pending record and close the files of a group opened by logger_open_group
+void logger_close_group(TrainingLogger *loggers, int count) {
+    TrainingLogger *writer = &loggers[0];
+    if (writer->file == NULL) {
+        return;
+    }
+    atomic_store(&writer->stop, 1);
+    wake_writer(writer);
+    pthread_join(writer->thread, NULL);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->wake);
+    for (int k = 0; k < count; k++) close_file(&loggers[k]);
+}
+
+void logger_close(TrainingLogger *logger) {
+    logger_close_group(logger, 1);
+}
+
+void logger_write_profile(const TrainingLogger *logger, int trace) {
+    if (logger->run[0] != '\0') {
+        char base[256];
+        snprintf(base, sizeof(base), "profile_%s", logger->run);
+        profile_write_report(base, trace);
+    }
+}
@@ -0,0 +1,125 @@
+#include "loss_balance.h"
+#include <math.h>
+#include <string.h>
+
+static const char *term_names[TERM_COUNT] = {"residual", "boundary", "initial", "conservation"};
+
+int parse_loss_weighting(const char *name, WeightingMethod *method) {
+    if (strcmp(name, "fixed") == 0) {
+        *method = WEIGHTING_FIXED;
+    } else if (strcmp(name, "annealing") == 0) {
+        *method = WEIGHTING_ANNEALING;
+    } else if (strcmp(name, "gradnorm") == 0) {
+        *method = WEIGHTING_GRADNORM;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+const char *loss_term_name(LossTerm term) {
+    return term_names[term];
+}
+
+void default_loss_weighting_config(LossWeightingConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->method = WEIGHTING_FIXED;
+    for (int i = 0; i < TERM_COUNT; i++) {
+        config->weights[i] = 1.0;
+    }
+    config->update_every = 100;
+    config->smoothing = 0.9;
+    config->gradnorm_alpha = 1.5;
+}
+
+void loss_balancer_init(LossBalancer *balancer, const LossWeightingConfig *config, const int active[TERM_COUNT]) {
+    memset(balancer, 0, sizeof(*balancer));
+    balancer->config = *config;
+    for (int i = 0; i < TERM_COUNT; i++) {
+        balancer->active[i] = active[i];
+        balancer->weights[i] = active[i] ? config->weights[i] : 0.0;
+    }
+}
+
+// Adaptive weights are refreshed on the first epoch of a run (resumed runs included) and
+// every update_every epochs after that
+int loss_balancer_due(const LossBalancer *balancer, int epoch, int first_epoch) {
+    if (balancer->config.method == WEIGHTING_FIXED || balancer->config.update_every <= 0) {
+        return 0;
+    }
+    return epoch == first_epoch || epoch % balancer->config.update_every == 0;
+}
+
+// Wang, Teng & Perdikaris: w_i = w_r * max|grad L_r| / mean|grad L_i|, so no term's
+// gradient is drowned out by the residual's largest components
+static void annealing_targets(const LossBalancer *balancer, const TermGradientStats *stats, double *targets) {
+    double reference = balancer->weights[TERM_RESIDUAL] * stats[TERM_RESIDUAL].max_abs;
+    for (int i = 0; i < TERM_COUNT; i++) {
+        targets[i] = balancer->weights[i];
+        if (i != TERM_RESIDUAL && balancer->active[i] && stats[i].mean_abs > 0.0 && reference > 0.0) {
+            targets[i] = reference / stats[i].mean_abs;
+        }
+    }
+}
+
+// Chen et al.: aim every weighted gradient norm at the mean norm times (relative inverse
+// training rate)^alpha, solved in closed form for the weights, which then sum to the
+// number of active terms
+static void gradnorm_targets(LossBalancer *balancer, const TermGradientStats *stats, double *targets) {
+    int count = 0;
+    double mean_norm = 0.0, mean_rate = 0.0;
+    double rates[TERM_COUNT] = {0.0};
+    for (int i = 0; i < TERM_COUNT; i++) {
+        targets[i] = balancer->weights[i];
+        if (!balancer->active[i]) continue;
+        if (balancer->updates == 0) {
+            balancer->initial_losses[i] = stats[i].loss;
+        }
+        rates[i] = balancer->initial_losses[i] > 0.0 ? stats[i].loss / balancer->initial_losses[i] : 1.0;
+        mean_norm += balancer->weights[i] * stats[i].norm;
+        mean_rate += rates[i];
+        count++;
+    }
+    if (count == 0 || mean_rate <= 0.0) {
+        return;
+    }
+    mean_norm /= count;
+    mean_rate /= count;
+
+    double sum = 0.0;
+    for (int i = 0; i < TERM_COUNT; i++) {
+        if (!balancer->active[i]) continue;
+        if (stats[i].norm > 0.0) {
+            targets[i] = mean_norm * pow(rates[i] / mean_rate, balancer->config.gradnorm_alpha) / stats[i].norm;
+        }
+        sum += targets[i];
+    }
+    for (int i = 0; i < TERM_COUNT; i++) {
+        if (balancer->active[i] && sum > 0.0) {
+            targets[i] *= count / sum;
+        }
+    }
+}
+
+int loss_balancer_update(LossBalancer *balancer, const TermGradientStats stats[TERM_COUNT]) {
+    double targets[TERM_COUNT];
+    if (balancer->config.method == WEIGHTING_ANNEALING) {
+        annealing_targets(balancer, stats, targets);
+    } else if (balancer->config.method == WEIGHTING_GRADNORM) {
+        gradnorm_targets(balancer, stats, targets);
+    } else {
+        return 0;
+    }
+
+    // Blend into the running weights; a non-finite estimate keeps the old weight
+    int changed = 0;
+    double share = balancer->config.smoothing;
+    for (int i = 0; i < TERM_COUNT; i++) {
+        if (!balancer->active[i] || !isfinite(targets[i])) continue;
+        double weight = (1.0 - share) * balancer->weights[i] + share * targets[i];
+        changed |= weight != balancer->weights[i];
+        balancer->weights[i] = weight;
+    }
+    balancer->updates++;
+    return changed;
+}
@@ -19,8 +19,9 @@ double schrodinger_equation_loss(double psi, double psi_target, double potential
     double kinetic_energy = -(HBAR * HBAR / (2.0 * ELECTRON_MASS)) * (difference / (time_step * time_step));
     double potential_energy = potential * psi;
 
-    // Total loss calculation with higher-order term for stability
-    double loss = (pow(difference, 2) + pow(kinetic_energy, 2) + pow(potential_energy, 2)) / (adaptive_normalization(&loss, 1));
+    // Total loss, scaled by its largest term so the three are comparable
+    double terms[3] = {pow(difference, 2), pow(kinetic_energy, 2), pow(potential_energy, 2)};
+    double loss = (terms[0] + terms[1] + terms[2]) / adaptive_normalization(terms, 3);
 
     // Gradient penalty to smooth the loss landscape
     double gradient_penalty = 0.01 * (pow(psi - psi_target, 2)); // Simple penalty for large gradients
@@ -54,8 +55,7 @@ double heat_equation_loss(double u, double u_target, double dx, double dt) {
     // Second derivative with respect to space
     double second_spatial_derivative = (u - 2 * u_target + (u - u_target)) / (dx * dx);
 
-    // Loss calculation with normalization
-    double loss = pow(thermal_diffusivity * second_spatial_derivative - time_derivative, 2) / (adaptive_normalization(&loss, 1));
+    double loss = pow(thermal_diffusivity * second_spatial_derivative - time_derivative, 2);
 
     return loss;
 }
@@ -66,8 +66,7 @@ double wave_equation_loss(double u, double u_target, double time, double dx, dou
     double spatial_term = (u - u_target) / (dx * dx);
     double temporal_term = (u - u_target) / (dt * dt);
 
-    // Loss calculation with higher-order terms for stability
-    double loss = pow((1.0 / (WAVE_SPEED * WAVE_SPEED)) * spatial_term - temporal_term, 2) / (adaptive_normalization(&loss, 1));
+    double loss = pow((1.0 / (WAVE_SPEED * WAVE_SPEED)) * spatial_term - temporal_term, 2);
 
     return loss;
 }
@@ -92,17 +91,273 @@ double navier_stokes_loss(double u, double v, double pressure, double viscosity,
     return loss;
 }
 
-// Boundary Condition Loss
+// Pointwise squared mismatches of the composite-loss terms. They carry no scale of their
+// own: the trainer weights each term (see include/loss_balance.h).
 double boundary_condition_loss(double value, double boundary_value) {
-    return pow(value - boundary_value, 2) / NORMALIZATION_FACTOR;
+    return (value - boundary_value) * (value - boundary_value);
 }
 
-// Initial Condition Loss
 double initial_condition_loss(double value, double initial_value) {
-    return pow(value - initial_value, 2) / NORMALIZATION_FACTOR;
+    return (value - initial_value) * (value - initial_value);
 }
 
-// Conservation of Mass Loss
+// Continuity equation: divergence of the flux (plus any density rate) against the source
 double conservation_of_mass_loss(double divergence_velocity, double mass_source) {
-    return pow(divergence_velocity - mass_source, 2) / NORMALIZATION_FACTOR;
-}
\ No newline at end of file
+    return (divergence_velocity - mass_source) * (divergence_velocity - mass_source);
+}
+
+// Sum of second derivatives over the spatial inputs (every input but the last, which is time)
+static double laplacian(const PointDerivatives *pd, int k) {
+    double sum = 0.0;
+    for (int i = 0; i + 1 < pd->input_dim; i++) {
+        sum += pd_second(pd, i, k);
+    }
+    return sum;
+}
+
+// Adjoint accumulation helpers; g is d(loss)/d(quantity) before weighting
+static void adjoint_value(PointAdjoint *adjoint, const PointDerivatives *pd, int k, double g) {
+    (void)pd;
+    adjoint->u[k] += adjoint->weight * g;
+}
+
+static void adjoint_first(PointAdjoint *adjoint, const PointDerivatives *pd, int i, int k, double g) {
+    adjoint->du[i * pd->output_dim + k] += adjoint->weight * g;
+}
+
+static void adjoint_laplacian(PointAdjoint *adjoint, const PointDerivatives *pd, int k, double g) {
+    for (int i = 0; i + 1 < pd->input_dim; i++) {
+        adjoint->d2u[i * pd->output_dim + k] += adjoint->weight * g;
+    }
+}
+
+// Schrödinger equation with hbar = m = 1 for psi = u0 + i u1: i psi_t = -1/2 lap(psi) + V psi
+double schrodinger_residual_loss(const PointDerivatives *pd, double potential, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double real = -pd_first(pd, t, 1) + 0.5 * laplacian(pd, 0) - potential * pd_value(pd, 0);
+    double imag = pd_first(pd, t, 0) + 0.5 * laplacian(pd, 1) - potential * pd_value(pd, 1);
+
+    if (adjoint) {
+        adjoint_first(adjoint, pd, t, 1, -2.0 * real);
+        adjoint_laplacian(adjoint, pd, 0, real);
+        adjoint_value(adjoint, pd, 0, -2.0 * potential * real);
+        adjoint_first(adjoint, pd, t, 0, 2.0 * imag);
+        adjoint_laplacian(adjoint, pd, 1, imag);
+        adjoint_value(adjoint, pd, 1, -2.0 * potential * imag);
+    }
+    return real * real + imag * imag;
+}
+
+// 1-D Maxwell equations with c = epsilon_0 = 1 for the transverse pair (E = u0, B = u1):
+// Faraday B_t + E_x = 0 and Ampere-Maxwell E_t + B_x + J = 0. A third output is treated
+// as the longitudinal field and must satisfy Gauss's law dE_l/dx = rho.
+double maxwell_residual_loss(const PointDerivatives *pd, double charge_density, double current_density, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double faraday = pd_first(pd, t, 1) + pd_first(pd, 0, 0);
+    double ampere = pd_first(pd, t, 0) + pd_first(pd, 0, 1) + current_density;
+    double loss = faraday * faraday + ampere * ampere;
+
+    if (adjoint) {
+        adjoint_first(adjoint, pd, t, 1, 2.0 * faraday);
+        adjoint_first(adjoint, pd, 0, 0, 2.0 * faraday);
+        adjoint_first(adjoint, pd, t, 0, 2.0 * ampere);
+        adjoint_first(adjoint, pd, 0, 1, 2.0 * ampere);
+    }
+    if (pd->output_dim >= 3) {
+        double gauss = pd_first(pd, 0, 2) - charge_density;
+        loss += gauss * gauss;
+        if (adjoint) {
+            adjoint_first(adjoint, pd, 0, 2, 2.0 * gauss);
+        }
+    }
+    return loss;
+}
+
+// Heat equation u_t = alpha * lap(u)
+double heat_residual_loss(const PointDerivatives *pd, double thermal_diffusivity, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double residual = pd_first(pd, t, 0) - thermal_diffusivity * laplacian(pd, 0);
+
+    if (adjoint) {
+        adjoint_first(adjoint, pd, t, 0, 2.0 * residual);
+        adjoint_laplacian(adjoint, pd, 0, -2.0 * thermal_diffusivity * residual);
+    }
+    return residual * residual;
+}
+
+// Wave equation u_tt = c^2 * lap(u)
+double wave_residual_loss(const PointDerivatives *pd, double wave_speed, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double c2 = wave_speed * wave_speed;
+    double residual = pd_second(pd, t, 0) - c2 * laplacian(pd, 0);
+
+    if (adjoint) {
+        adjoint->d2u[t * pd->output_dim] += adjoint->weight * 2.0 * residual;
+        adjoint_laplacian(adjoint, pd, 0, -2.0 * c2 * residual);
+    }
+    return residual * residual;
+}
+
+// Incompressible Navier-Stokes for velocity (u0, u1) and pressure u2. With one spatial input
+// only the x-momentum equation applies; with two, both momentum equations are enforced and
+// gravity acts along y. Continuity is the separate conservation term below.
+double navier_stokes_residual_loss(const PointDerivatives *pd, double viscosity, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double u = pd_value(pd, 0);
+
+    if (t < 2) {
+        double u_x = pd_first(pd, 0, 0);
+        double momentum = pd_first(pd, t, 0) + u * u_x + pd_first(pd, 0, 2) / RHO - viscosity * laplacian(pd, 0);
+        if (adjoint) {
+            double g = 2.0 * momentum;
+            adjoint_first(adjoint, pd, t, 0, g);
+            adjoint_value(adjoint, pd, 0, g * u_x);
+            adjoint_first(adjoint, pd, 0, 0, g * u);
+            adjoint_first(adjoint, pd, 0, 2, g / RHO);
+            adjoint_laplacian(adjoint, pd, 0, -g * viscosity);
+        }
+        return momentum * momentum;
+    }
+
+    double v = pd_value(pd, 1);
+    double u_x = pd_first(pd, 0, 0), u_y = pd_first(pd, 1, 0);
+    double v_x = pd_first(pd, 0, 1), v_y = pd_first(pd, 1, 1);
+    double momentum_x = pd_first(pd, t, 0) + u * u_x + v * u_y + pd_first(pd, 0, 2) / RHO - viscosity * laplacian(pd, 0);
+    double momentum_y = pd_first(pd, t, 1) + u * v_x + v * v_y + pd_first(pd, 1, 2) / RHO - viscosity * laplacian(pd, 1) + G;
+
+    if (adjoint) {
+        double gx = 2.0 * momentum_x, gy = 2.0 * momentum_y;
+        adjoint_value(adjoint, pd, 0, gx * u_x + gy * v_x);
+        adjoint_value(adjoint, pd, 1, gx * u_y + gy * v_y);
+        adjoint_first(adjoint, pd, 0, 0, gx * u);
+        adjoint_first(adjoint, pd, 1, 0, gx * v);
+        adjoint_first(adjoint, pd, 0, 1, gy * u);
+        adjoint_first(adjoint, pd, 1, 1, gy * v);
+        adjoint_first(adjoint, pd, t, 0, gx);
+        adjoint_first(adjoint, pd, t, 1, gy);
+        adjoint_first(adjoint, pd, 0, 2, gx / RHO);
+        adjoint_first(adjoint, pd, 1, 2, gy / RHO);
+        adjoint_laplacian(adjoint, pd, 0, -gx * viscosity);
+        adjoint_laplacian(adjoint, pd, 1, -gy * viscosity);
+    }
+    return momentum_x * momentum_x + momentum_y * momentum_y;
+}
+
+// Mass conservation for 2-D incompressible flow: u_x + v_y = 0. A single spatial input
+// carries no incompressibility constraint, so the term vanishes there.
+double navier_stokes_conservation_loss(const PointDerivatives *pd, PointAdjoint *adjoint) {
+    if (pd->input_dim < 3) {
+        return 0.0;
+    }
+    double divergence = pd_first(pd, 0, 0) + pd_first(pd, 1, 1);
+    if (adjoint) {
+        adjoint_first(adjoint, pd, 0, 0, 2.0 * divergence);
+        adjoint_first(adjoint, pd, 1, 1, 2.0 * divergence);
+    }
+    return conservation_of_mass_loss(divergence, 0.0);
+}
+
+// Probability conservation for psi = a + i b: rho_t + div j = 0 with rho = a^2 + b^2 and
+// j = a grad(b) - b grad(a), i.e. 2 (a a_t + b b_t) + a lap(b) - b lap(a) = 0
+double schrodinger_conservation_loss(const PointDerivatives *pd, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double a = pd_value(pd, 0), b = pd_value(pd, 1);
+    double a_t = pd_first(pd, t, 0), b_t = pd_first(pd, t, 1);
+    double lap_a = laplacian(pd, 0), lap_b = laplacian(pd, 1);
+    double continuity = 2.0 * (a * a_t + b * b_t) + a * lap_b - b * lap_a;
+
+    if (adjoint) {
+        double g = 2.0 * continuity;
+        adjoint_value(adjoint, pd, 0, g * (2.0 * a_t + lap_b));
+        adjoint_value(adjoint, pd, 1, g * (2.0 * b_t - lap_a));
+        adjoint_first(adjoint, pd, t, 0, g * 2.0 * a);
+        adjoint_first(adjoint, pd, t, 1, g * 2.0 * b);
+        adjoint_laplacian(adjoint, pd, 1, g * a);
+        adjoint_laplacian(adjoint, pd, 0, -g * b);
+    }
+    return conservation_of_mass_loss(continuity, 0.0);
+}
+
+// Boundary or initial value term: sum over outputs of (u_k - target_k)^2
+double dirichlet_residual_loss(const PointDerivatives *pd, const double *target, int count, PointAdjoint *adjoint) {
+    double loss = 0.0;
+    for (int k = 0; k < count; k++) {
+        double difference = pd_value(pd, k) - target[k];
+        loss += boundary_condition_loss(pd_value(pd, k), target[k]);
+        if (adjoint) {
+            adjoint_value(adjoint, pd, k, 2.0 * difference);
+        }
+    }
+    return loss;
+}
+
+// Initial velocity term for equations that are second order in time: (du_k/dt - target_k)^2
+double initial_velocity_residual_loss(const PointDerivatives *pd, const double *target, int count, PointAdjoint *adjoint) {
+    int t = pd->input_dim - 1;
+    double loss = 0.0;
+    for (int k = 0; k < count; k++) {
+        double difference = pd_first(pd, t, k) - target[k];
+        loss += initial_condition_loss(pd_first(pd, t, k), target[k]);
+        if (adjoint) {
+            adjoint_first(adjoint, pd, t, k, 2.0 * difference);
+        }
+    }
+    return loss;
+}
+
+// Product of sin(pi x_i) over the spatial inputs
+static double spatial_mode(const double *x, int input_dim) {
+    double mode = 1.0;
+    for (int i = 0; i + 1 < input_dim; i++) {
+        mode *= sin(M_PI * x[i]);
+    }
+    return mode;
+}
+
+// psi = sin(pi x) exp(-i omega t) with omega = pi^2 S / 2 + V
+void schrodinger_reference_solution(const double *x, int input_dim, double potential, double *u) {
+    double t = x[input_dim - 1];
+    double omega = 0.5 * M_PI * M_PI * (input_dim - 1) + potential;
+    double mode = spatial_mode(x, input_dim);
+    u[0] = mode * cos(omega * t);
+    u[1] = -mode * sin(omega * t);
+}
+
+// Travelling wave sin(pi (x - t)) in E and B, with the current draining E and a longitudinal field rho x
+void maxwell_reference_solution(const double *x, int input_dim, double charge_density, double current_density, double *u) {
+    double t = x[input_dim - 1];
+    double phase = sin(M_PI * (x[0] - t));
+    u[0] = phase - current_density * t;
+    u[1] = phase;
+    u[2] = charge_density * x[0];
+}
+
+// u = exp(-alpha pi^2 S t) prod sin(pi x_i)
+void heat_reference_solution(const double *x, int input_dim, double thermal_diffusivity, double *u) {
+    double t = x[input_dim - 1];
+    u[0] = exp(-thermal_diffusivity * M_PI * M_PI * (input_dim - 1) * t) * spatial_mode(x, input_dim);
+}
+
+// Standing wave u = cos(c pi sqrt(S) t) prod sin(pi x_i), starting from rest
+void wave_reference_solution(const double *x, int input_dim, double wave_speed, double *u) {
+    double t = x[input_dim - 1];
+    u[0] = cos(wave_speed * M_PI * sqrt((double)(input_dim - 1)) * t) * spatial_mode(x, input_dim);
+}
+
+// 1-D: decaying sine with the pressure p = -rho u^2 / 2 balancing advection.
+// 2-D: Taylor-Green vortex with a hydrostatic pressure term for gravity.
+void navier_stokes_reference_solution(const double *x, int input_dim, double viscosity, double *u) {
+    double t = x[input_dim - 1];
+    if (input_dim < 3) {
+        double velocity = sin(M_PI * x[0]) * exp(-viscosity * M_PI * M_PI * t);
+        u[0] = velocity;
+        u[1] = 0.0;
+        u[2] = -0.5 * RHO * velocity * velocity;
+        return;
+    }
+
+    double decay = exp(-2.0 * viscosity * M_PI * M_PI * t);
+    u[0] = -cos(M_PI * x[0]) * sin(M_PI * x[1]) * decay;
+    u[1] = sin(M_PI * x[0]) * cos(M_PI * x[1]) * decay;
+    u[2] = -0.25 * RHO * (cos(2.0 * M_PI * x[0]) + cos(2.0 * M_PI * x[1])) * decay * decay - RHO * G * x[1];
+}
@@ -2,11 +2,63 @@
 #include <stdlib.h>
 #include <string.h>
 #include "neural_network.h"
+#include "training.h"
+#include "checkpoint.h"
+#include "inference.h"
+#include "ensemble.h"
+#include "decomposition.h"
+#include "time_marching.h"
+#include "parametric.h"
+#include "export.h"
+#include "distributed.h"
 #include "loss_functions.h"
 #include "utils.h"
 
 void print_usage() {
-    printf("Usage: pinn_neural_network --loss [loss_type] [parameters] --activation [activation_function] --epochs [value] --learning_rate [value]\n");
+    printf("Usage: pinn_neural_network --loss [loss_type] [parameters] --activation [activation_function] --epochs [value] --learning_rate [value] [--layers sizes]\n");
+    printf("       pinn_neural_network infer --model path (--grid N[,N...] [--domain lo:hi,...] | --points file) [options]\n");
+    printf("       pinn_neural_network export-c --model path [--output base] [options]\n");
+    printf("Network layout:\n");
+    printf("  --layers in,hidden,...,out (default: %d,%d,%d), e.g. 2,128,128,128,3\n", INPUT_SIZE, HIDDEN_SIZE, OUTPUT_SIZE);
+    printf("  --init xavier|he|uniform (default: he for relu/leaky_relu, xavier otherwise)  --seed N (default: %llu)\n", (unsigned long long)RNG_DEFAULT_SEED);
+    printf("Input encoding (in front of the first layer; --layers still starts with the raw input count):\n");
+    printf("  --encoding none|fourier|hashgrid (default: none)  --fourier_features M (default: 32)  --fourier_scale S (default: 1)\n");
+    printf("  --hash_levels L (default: 8)  --hash_features F (default: 2)  --hash_table_log2 T (default: 12)\n");
+    printf("  --hash_base_resolution N (default: 4)  --hash_growth B (default: 1.5)\n");
+    printf("Collocation sampling:\n");
+    printf("  --domain lo:hi,...,t0:t1 (default: unit box)  --sampling uniform|lhs|sobol (default: sobol)\n");
+    printf("  --interior_points N  --boundary_points N  --initial_points N  --validation_points N\n");
+    printf("  --refine_every K (0 disables residual-based refinement)  --refine_candidates N\n");
+    printf("Optimization:\n");
+    printf("  --optimizer sgd|adam|adamw|lbfgs (default: sgd)  --weight_decay W  --lbfgs_epochs N (finish with N epochs of L-BFGS)\n");
+    printf("  --schedule inverse|constant|cosine|step (default: inverse)  --warmup_epochs N  --step_size K  --step_gamma G\n");
+    printf("Loss weighting:\n");
+    printf("  --loss_weighting fixed|annealing|gradnorm (default: fixed)  --weight_update_every K (default: 100)\n");
+    printf("  --residual_weight W  --boundary_weight W  --initial_weight W  --conservation_weight W (default: 1)\n");
+    printf("  --verbose (print the adaptive weights each time they are re-estimated)\n");
+    printf("Parallelism:\n");
+    printf("  --threads N (default: 1, 0 uses every online core); results are reproducible for a fixed N\n");
+    printf("  --ranks N (fork N training processes, pinned one per NUMA node, that split every batch and\n");
+    printf("            sum gradients with a shared-memory ring allreduce; --threads then applies per rank)\n");
+    printf("Ensembles (members share every batch and train packed %d to a SIMD lane group):\n", ENSEMBLE_LANES);
+    printf("  --ensemble N (replicas per sweep point)  --sweep name=v1,v2,... (repeatable; learning_rate, activation or a loss parameter)\n");
+    printf("Domain decomposition (one network per box, trained concurrently and coupled at the interfaces):\n");
+    printf("  --decomposition file (subdomain boxes with optional per-box layers, overlap, exchange interval; see README)\n");
+    printf("Time marching (one network per time window, each warm-started from and initialized by the previous one):\n");
+    printf("  --time_windows K  --window_tolerance R (default: 1e-3)  --window_patience N (default: 10)\n");
+    printf("  --causal_slices M (default: 16)  --causal_epsilon E (default: 1)\n");
+    printf("Parametric training (equation parameters as extra inputs; --layers still starts with the space-time input count):\n");
+    printf("  --parametric name=lo:hi (repeatable; a loss parameter, drawn uniformly per point and queried with infer --parameter)\n");
+    printf("Validation (on a background thread, against parameter snapshots):\n");
+    printf("  --validate_every K (default: the log cadence)  --validate_seconds T  --validation_subsample N (interior points per pass)\n");
+    printf("  --best_model path (saved whenever the validation loss improves)\n");
+    printf("Logging:\n");
+    printf("  --log_every K (default: 1)  --log_format text|csv|binary (default: text, read by visualization.py)\n");
+    printf("Profiling (builds made with `make PROFILE=1`):\n");
+    printf("  --profile_trace (also write a Chrome trace next to profile_<loss>.json)\n");
+    printf("Checkpoints:\n");
+    printf("  --checkpoint_every K (0 disables)  --checkpoint path (default: checkpoint_<loss>.ckpt)\n");
+    printf("  --resume path (continue a run; layers and activation come from the checkpoint)\n");
     printf("Loss types and their parameters:\n");
     printf("  schrodinger: --potential [value]\n");
     printf("  maxwell: --charge_density [value] --current_density [value]\n");
@@ -18,9 +70,296 @@ void print_usage() {
     printf("  tanh\n");
     printf("  relu\n");
     printf("  leaky_relu\n");
+    printf("  sin\n");
+    printf("  silu\n");
+    printf("  --activation_mode accurate|fast (default: accurate; fast trades ~1e-9 absolute error for speed)\n");
+    printf("Precision:\n");
+    printf("  --precision fp64|mixed|rounded (default: fp64; mixed runs the sweeps in float with double\n");
+    printf("    master weights, residuals and reduction; rounded also rounds the double weights to float values)\n");
+}
+
+void print_infer_usage() {
+    printf("Usage: pinn_neural_network infer --model path (--grid N[,N...] [--domain lo:hi,...] | --points file) [options]\n");
+    printf("  --model path       checkpoint or model_parameters.ckpt to evaluate\n");
+    printf("  --grid N[,N...]    points per axis (endpoints included); one N applies to every axis\n");
+    printf("  --domain lo:hi,... grid bounds, one range per input (default: unit box and the trained parameter ranges)\n");
+    printf("  --parameter name=value  pin a parameter input of a parametric model (repeatable)\n");
+    printf("  --points file      raw float64 [N][inputs] points instead of a grid\n");
+    printf("  --output path      result file (default: inference.bin): a 64-byte-aligned header, then [N][outputs]\n");
+    printf("  --dtype f64|f32    result precision (default: f64)\n");
+    printf("  --threads N (default: 0, every online core)  --tile N (points per batched pass, default: 1024)\n");
+}
+
+// `pinn infer`: evaluate a trained model on a grid or a file of points
+int infer_main(int argc, char *argv[]) {
+    InferenceConfig config;
+    default_inference_config(&config);
+    int grid_axes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            config.model_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            config.output_path = argv[++i];
+        } else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+            config.points_path = argv[++i];
+        } else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+            grid_axes = parse_grid_resolution(argv[++i], config.resolution);
+            if (grid_axes < 0) {
+                fprintf(stderr, "Error: Invalid grid resolution: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--domain") == 0 && i + 1 < argc) {
+            if (!parse_domain(argv[++i], &config.grid)) {
+                fprintf(stderr, "Error: Invalid domain: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--dtype") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "f64") == 0) {
+                config.dtype = INFERENCE_DTYPE_FP64;
+            } else if (strcmp(argv[i], "f32") == 0) {
+                config.dtype = INFERENCE_DTYPE_FP32;
+            } else {
+                fprintf(stderr, "Error: Unsupported dtype: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            config.tile = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--parameter") == 0 && i + 1 < argc) {
+            i++;
+            if (config.num_fixed == PARAMETRIC_MAX_INPUTS ||
+                !parse_parameter_value(argv[i], &config.fixed_fields[config.num_fixed], &config.fixed_values[config.num_fixed])) {
+                fprintf(stderr, "Error: Invalid parameter value: %s (expected name=value)\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            config.num_fixed++;
+        } else {
+            print_infer_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (config.model_path == NULL || (config.points_path == NULL && grid_axes == 0)) {
+        print_infer_usage();
+        return EXIT_FAILURE;
+    }
+    // A single count applies to every axis
+    if (grid_axes == 1) {
+        for (int d = 1; d < SAMPLER_MAX_DIMS; d++) {
+            config.resolution[d] = config.resolution[0];
+        }
+    }
+    return run_inference(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void print_export_usage() {
+    printf("Usage: pinn_neural_network export-c --model path [--output base] [options]\n");
+    printf("  --model path       checkpoint or model_parameters.ckpt to export\n");
+    printf("  --output base      writes base.h, base.c and the self-test base_test.c (default: pinn_model)\n");
+    printf("  --name prefix      symbol prefix of the generated functions (default: the file name of base)\n");
+    printf("  --unroll N         layers with at most N weights become straight-line code (default: 256)\n");
+    printf("  --test_points N    points the self-test checks against forward_pass (default: 64)\n");
+    printf("  --tolerance T      self-test bound on |out - ref| / (1 + |ref|) (default: 1e-12)\n");
+    printf("  --domain lo:hi,... where the self-test coordinates are drawn (default: unit box)\n");
+}
+
+// `pinn export-c`: generate standalone C inference code for a trained model
+int export_main(int argc, char *argv[]) {
+    ExportConfig config;
+    default_export_config(&config);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            config.model_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            config.output_base = argv[++i];
+        } else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            config.name = argv[++i];
+        } else if (strcmp(argv[i], "--unroll") == 0 && i + 1 < argc) {
+            config.unroll_limit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--test_points") == 0 && i + 1 < argc) {
+            config.test_points = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            config.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--domain") == 0 && i + 1 < argc) {
+            if (!parse_domain(argv[++i], &config.domain)) {
+                fprintf(stderr, "Error: Invalid domain: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            print_export_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (config.model_path == NULL) {
+        print_export_usage();
+        return EXIT_FAILURE;
+    }
+    return export_c_model(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Allocate a network and draw its parameters from substream `substream` of the run's seed;
+// init NULL picks the default scheme for the activation. With an encoding, layer_sizes[0]
+// is the raw input count and the first layer is widened to the encoded width.
+static int seeded_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers, const EncodingConfig *encoding, const InitScheme *init, ActivationFunction activation, uint64_t seed, uint32_t substream) {
+    int sizes[MAX_LAYERS];
+    EncodingConfig config = *encoding;
+    memcpy(sizes, layer_sizes, num_layers * sizeof(int));
+    if (config.type != ENCODING_NONE) {
+        Encoding layout;
+        config.input_dim = layer_sizes[0];
+        if (!encoding_layout(&layout, &config)) {
+            return 0;
+        }
+        sizes[0] = layout.output_dim;
+    }
+    if (!allocate_encoded_network(nn, sizes, num_layers, &config, NULL)) {
+        return 0;
+    }
+    init_parameters(nn, init ? *init : default_init_scheme(activation), seed, substream);
+    return 1;
+}
+
+// Train every member of a sweep at once; member k is saved to model_parameters_<k>.ckpt
+// and initialized from substream k
+static int run_ensemble(const char *loss_type, const LossParameters *params, const int *layer_sizes, int num_layers, const InitScheme *init, const char **sweeps, int num_sweeps, int replicas, const TrainingConfig *config) {
+    static EnsembleMember members[ENSEMBLE_MAX_MEMBERS];
+    EncodingConfig no_encoding;
+    default_encoding_config(&no_encoding);
+    EnsembleMember base;
+    memset(&base, 0, sizeof(base));
+    base.params = *params;
+    base.learning_rate = config->learning_rate;
+    base.activation = config->activation;
+    int count = expand_ensemble_sweeps(sweeps, num_sweeps, replicas, &base, members);
+    if (count < 0) {
+        return EXIT_FAILURE;
+    }
+
+    int initialized = 0;
+    for (; initialized < count; initialized++) {
+        if (!seeded_network(&members[initialized].nn, layer_sizes, num_layers, &no_encoding, init, members[initialized].activation, config->seed, (uint32_t)initialized)) {
+            break;
+        }
+    }
+    int trained = initialized == count && train_ensemble(members, count, loss_type, config);
+    if (trained) {
+        for (int k = 0; k < count; k++) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "model_parameters_%d.ckpt", k);
+            save_model(&members[k].nn, loss_type, members[k].activation, filename);
+        }
+    }
+    for (int k = 0; k < initialized; k++) {
+        free_neural_network(&members[k].nn);
+    }
+    return trained ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Train one network per subdomain box; box k is saved to model_parameters_<k>.ckpt and
+// initialized from substream k
+static int run_decomposition(const char *loss_type, const LossParameters *params, const int *layer_sizes, int num_layers, const EncodingConfig *encoding, const InitScheme *init, const char *path, const TrainingConfig *config) {
+    static DecompositionConfig decomposition;
+    static NeuralNetwork nets[DECOMPOSITION_MAX_SUBDOMAINS];
+    if (!parse_decomposition(path, &decomposition)) {
+        return EXIT_FAILURE;
+    }
+    int count = decomposition.num_subdomains;
+    int initialized = 0;
+    for (; initialized < count; initialized++) {
+        int own = decomposition.num_layers[initialized] > 0;
+        if (!seeded_network(&nets[initialized], own ? decomposition.layer_sizes[initialized] : layer_sizes, own ? decomposition.num_layers[initialized] : num_layers,
+                            encoding, init, config->activation, config->seed, (uint32_t)initialized)) {
+            break;
+        }
+    }
+    int trained = initialized == count && train_decomposition(nets, &decomposition, loss_type, params, config);
+    if (trained) {
+        for (int k = 0; k < count; k++) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "model_parameters_%d.ckpt", k);
+            save_model(&nets[k], loss_type, config->activation, filename);
+        }
+    }
+    for (int k = 0; k < initialized; k++) {
+        free_neural_network(&nets[k]);
+    }
+    return trained ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Train one network per time window; window k is saved to model_parameters_<k>.ckpt. Every
+// window starts from the parameters of the one before, so only the first initialization counts.
+static int run_time_marching(const char *loss_type, const LossParameters *params, const int *layer_sizes, int num_layers, const EncodingConfig *encoding, const InitScheme *init, const TimeMarchingConfig *marching, const TrainingConfig *config) {
+    static NeuralNetwork nets[TIME_MARCHING_MAX_WINDOWS];
+    if (marching->num_windows < 1 || marching->num_windows > TIME_MARCHING_MAX_WINDOWS) {
+        fprintf(stderr, "Error: --time_windows takes 1 to %d windows\n", TIME_MARCHING_MAX_WINDOWS);
+        return EXIT_FAILURE;
+    }
+    int count = marching->num_windows;
+    int initialized = 0;
+    for (; initialized < count; initialized++) {
+        if (!seeded_network(&nets[initialized], layer_sizes, num_layers, encoding, init, config->activation, config->seed, 0)) {
+            break;
+        }
+    }
+    int trained = initialized == count && train_time_marching(nets, marching, loss_type, params, config);
+    if (trained) {
+        for (int k = 0; k < count; k++) {
+            char filename[64];
+            snprintf(filename, sizeof(filename), "model_parameters_%d.ckpt", k);
+            save_model(&nets[k], loss_type, config->activation, filename);
+        }
+    }
+    for (int k = 0; k < initialized; k++) {
+        free_neural_network(&nets[k]);
+    }
+    return trained ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+typedef struct {
+    NeuralNetwork *nn;
+    const char *loss_type;
+    const LossParameters *params;
+    const TrainingConfig *config;
+} RankJob;
+
+// Every rank trains its own copy of the network on its share of each batch; the copies stay
+// identical, and rank 0 saves the model
+static int train_rank(Communicator *comm, void *context) {
+    RankJob *job = context;
+    TrainingConfig config = *job->config;
+    config.comm = comm;
+    if (!train_neural_network(job->nn, job->loss_type, job->params, &config)) {
+        return 0;
+    }
+    return comm->rank != 0 || save_model(job->nn, job->loss_type, config.activation, "model_parameters.ckpt");
+}
+
+// The ranks fork once the network is built. Its parameters and gradients are copy-on-write,
+// so a rank's first step copies them into pages it touches first, on its own node, like
+// everything the trainer allocates after the rank is pinned.
+static int run_ranks(NeuralNetwork *nn, const char *loss_type, const LossParameters *params, const TrainingConfig *config, int num_ranks) {
+    Communicator comm;
+    if (!comm_init_shared_memory(&comm, num_ranks, training_message_capacity(nn, config))) {
+        return EXIT_FAILURE;
+    }
+    RankJob job = {nn, loss_type, params, config};
+    int trained = launch_ranks(&comm, train_rank, &job);
+    comm_free(&comm);
+    return trained ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "infer") == 0) {
+        return infer_main(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "export-c") == 0) {
+        return export_main(argc - 1, argv + 1);
+    }
     if (argc < 8) {
         print_usage();
         return EXIT_FAILURE;
@@ -34,14 +373,49 @@ int main(int argc, char *argv[]) {
     double thermal_conductivity = 0.0;
     double wave_speed = 0.0;
     double viscosity = 0.0;
-    int epochs = 1000;
-    double learning_rate = 0.01;
+    TrainingConfig config;
+    default_training_config(&config);
+    int layer_sizes[MAX_LAYERS] = {INPUT_SIZE, HIDDEN_SIZE, OUTPUT_SIZE};
+    int num_layers = 3;
+    const char *resume_path = NULL;
+    double weight_decay = -1.0;
+    const char *sweeps[ENSEMBLE_MAX_SWEEPS];
+    int num_sweeps = 0;
+    int replicas = 1;
+    const char *decomposition_path = NULL;
+    TimeMarchingConfig marching;
+    default_time_marching_config(&marching);
+    int time_marching = 0;
+    InitScheme init_scheme;
+    const InitScheme *init = NULL;
+    EncodingConfig encoding;
+    default_encoding_config(&encoding);
+    ParameterInputs parametric;
+    memset(&parametric, 0, sizeof(parametric));
+    int ranks = 1;
+    int refine_given = 0;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
             loss_type = argv[++i];
         } else if (strcmp(argv[i], "--activation") == 0 && i + 1 < argc) {
             activation_function = argv[++i];
+        } else if (strcmp(argv[i], "--activation_mode") == 0 && i + 1 < argc) {
+            ActivationMode mode;
+            if (!parse_activation_mode(argv[++i], &mode)) {
+                fprintf(stderr, "Error: Unsupported activation mode: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            set_activation_mode(mode);
+        } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            if (strcmp(argv[++i], "fp32") == 0) {
+                fprintf(stderr, "Error: There is no fp32 mode: weights, gradients and optimizer state are kept in double (use mixed or rounded)\n");
+                return EXIT_FAILURE;
+            }
+            if (!parse_precision(argv[i], &config.precision)) {
+                fprintf(stderr, "Error: Unsupported precision: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
         } else if (strcmp(argv[i], "--potential") == 0 && i + 1 < argc) {
             potential = atof(argv[++i]);
         } else if (strcmp(argv[i], "--charge_density") == 0 && i + 1 < argc) {
@@ -55,31 +429,179 @@ int main(int argc, char *argv[]) {
         } else if (strcmp(argv[i], "--viscosity") == 0 && i + 1 < argc) {
             viscosity = atof(argv[++i]);
         } else if (strcmp(argv[i], "--epochs") == 0 && i + 1 < argc) {
-            epochs = atoi(argv[++i]);
+            config.epochs = atoi(argv[++i]);
         } else if (strcmp(argv[i], "--learning_rate") == 0 && i + 1 < argc) {
-            learning_rate = atof(argv[++i]);
+            config.learning_rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--optimizer") == 0 && i + 1 < argc) {
+            OptimizerType type;
+            if (!parse_optimizer(argv[++i], &type)) {
+                fprintf(stderr, "Error: Unsupported optimizer: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            default_optimizer_config(&config.optimizer, type);
+        } else if (strcmp(argv[i], "--weight_decay") == 0 && i + 1 < argc) {
+            weight_decay = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--lbfgs_epochs") == 0 && i + 1 < argc) {
+            config.lbfgs_epochs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--schedule") == 0 && i + 1 < argc) {
+            if (!parse_schedule(argv[++i], &config.schedule.type)) {
+                fprintf(stderr, "Error: Unsupported learning rate schedule: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--warmup_epochs") == 0 && i + 1 < argc) {
+            config.schedule.warmup_epochs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--step_size") == 0 && i + 1 < argc) {
+            config.schedule.step_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--step_gamma") == 0 && i + 1 < argc) {
+            config.schedule.gamma = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--loss_weighting") == 0 && i + 1 < argc) {
+            if (!parse_loss_weighting(argv[++i], &config.loss_weighting.method)) {
+                fprintf(stderr, "Error: Unsupported loss weighting: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--weight_update_every") == 0 && i + 1 < argc) {
+            config.loss_weighting.update_every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--residual_weight") == 0 && i + 1 < argc) {
+            config.loss_weighting.weights[TERM_RESIDUAL] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--boundary_weight") == 0 && i + 1 < argc) {
+            config.loss_weighting.weights[TERM_BOUNDARY] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--initial_weight") == 0 && i + 1 < argc) {
+            config.loss_weighting.weights[TERM_INITIAL] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--conservation_weight") == 0 && i + 1 < argc) {
+            config.loss_weighting.weights[TERM_CONSERVATION] = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--init") == 0 && i + 1 < argc) {
+            if (!parse_init_scheme(argv[++i], &init_scheme)) {
+                fprintf(stderr, "Error: Unsupported initialization: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            init = &init_scheme;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--encoding") == 0 && i + 1 < argc) {
+            EncodingType type;
+            if (!parse_encoding_type(argv[++i], &type)) {
+                fprintf(stderr, "Error: Unsupported encoding: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            encoding.type = type;
+        } else if (strcmp(argv[i], "--fourier_features") == 0 && i + 1 < argc) {
+            encoding.frequencies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fourier_scale") == 0 && i + 1 < argc) {
+            encoding.scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--hash_levels") == 0 && i + 1 < argc) {
+            encoding.levels = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash_features") == 0 && i + 1 < argc) {
+            encoding.features = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash_table_log2") == 0 && i + 1 < argc) {
+            encoding.log2_table_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash_base_resolution") == 0 && i + 1 < argc) {
+            encoding.base_resolution = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash_growth") == 0 && i + 1 < argc) {
+            encoding.growth = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc) {
+            num_layers = parse_layer_spec(argv[++i], layer_sizes);
+            if (num_layers < 0) {
+                fprintf(stderr, "Error: Invalid layer spec: %s\n", argv[i]);
+                print_usage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--domain") == 0 && i + 1 < argc) {
+            if (!parse_domain(argv[++i], &config.domain)) {
+                fprintf(stderr, "Error: Invalid domain: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--sampling") == 0 && i + 1 < argc) {
+            if (!parse_sampling_method(argv[++i], &config.sampling)) {
+                fprintf(stderr, "Error: Unsupported sampling method: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--interior_points") == 0 && i + 1 < argc) {
+            config.interior_points = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--boundary_points") == 0 && i + 1 < argc) {
+            config.boundary_points = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--initial_points") == 0 && i + 1 < argc) {
+            config.initial_points = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--validation_points") == 0 && i + 1 < argc) {
+            config.validation_points = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--validate_every") == 0 && i + 1 < argc) {
+            config.validation.every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--validate_seconds") == 0 && i + 1 < argc) {
+            config.validation.seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--validation_subsample") == 0 && i + 1 < argc) {
+            config.validation.subsample = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--best_model") == 0 && i + 1 < argc) {
+            config.validation.best_model_path = argv[++i];
+        } else if (strcmp(argv[i], "--refine_every") == 0 && i + 1 < argc) {
+            config.refine_every = atoi(argv[++i]);
+            refine_given = 1;
+        } else if (strcmp(argv[i], "--refine_candidates") == 0 && i + 1 < argc) {
+            config.refine_candidates = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.threads = atoi(argv[++i]);
+            if (config.threads < 0) {
+                fprintf(stderr, "Error: Invalid thread count: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--ranks") == 0 && i + 1 < argc) {
+            ranks = atoi(argv[++i]);
+            if (ranks < 1 || ranks > DISTRIBUTED_MAX_RANKS) {
+                fprintf(stderr, "Error: Invalid rank count: %s (1 to %d)\n", argv[i], DISTRIBUTED_MAX_RANKS);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--log_every") == 0 && i + 1 < argc) {
+            config.log_every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log_format") == 0 && i + 1 < argc) {
+            if (!parse_log_format(argv[++i], &config.log_format)) {
+                fprintf(stderr, "Error: Unsupported log format: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--checkpoint_every") == 0 && i + 1 < argc) {
+            config.checkpoint_every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            config.checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile_trace") == 0) {
+            config.profile_trace = 1;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            config.verbose = 1;
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            resume_path = argv[++i];
+        } else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc) {
+            replicas = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            if (num_sweeps == ENSEMBLE_MAX_SWEEPS) {
+                fprintf(stderr, "Error: At most %d --sweep options are supported\n", ENSEMBLE_MAX_SWEEPS);
+                return EXIT_FAILURE;
+            }
+            sweeps[num_sweeps++] = argv[++i];
+        } else if (strcmp(argv[i], "--decomposition") == 0 && i + 1 < argc) {
+            decomposition_path = argv[++i];
+        } else if (strcmp(argv[i], "--time_windows") == 0 && i + 1 < argc) {
+            marching.num_windows = atoi(argv[++i]);
+            time_marching = 1;
+        } else if (strcmp(argv[i], "--window_tolerance") == 0 && i + 1 < argc) {
+            marching.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--window_patience") == 0 && i + 1 < argc) {
+            marching.patience = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--causal_slices") == 0 && i + 1 < argc) {
+            marching.slices = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--causal_epsilon") == 0 && i + 1 < argc) {
+            marching.epsilon = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--parametric") == 0 && i + 1 < argc) {
+            if (!add_parameter_input(&parametric, argv[++i])) {
+                return EXIT_FAILURE;
+            }
         }
     }
 
+    if (weight_decay >= 0.0) {
+        config.optimizer.weight_decay = weight_decay;
+    }
+
     if (loss_type == NULL) {
         fprintf(stderr, "Error: Loss type not specified\n");
         print_usage();
         return EXIT_FAILURE;
     }
-    
-    if (activation_function == NULL) {
-        fprintf(stderr, "Error: Activation function not specified\n");
-        print_usage();
-        return EXIT_FAILURE;
-    }
-
-    // Initialize neural network
-    NeuralNetwork nn;
-    initialize_neural_network(&nn);
-    if (!validate_neural_network_initialization(&nn)) {
-        fprintf(stderr, "Neural network initialization failed!\n");
-        return EXIT_FAILURE;
-    }
 
     // Create a LossParameters struct to pass to train_neural_network
     LossParameters params = {
@@ -91,11 +613,121 @@ int main(int argc, char *argv[]) {
         .viscosity = viscosity
     };
 
+    // The encoding normalises by the training domain and draws its frequencies from the run's seed
+    encoding.seed = config.seed;
+    for (int d = 0; d < config.domain.dims && d < ENCODING_MAX_INPUTS; d++) {
+        encoding.lower[d] = config.domain.lower[d];
+        encoding.upper[d] = config.domain.upper[d];
+    }
+
+    // Parameter inputs are a property of the single-network trainer (a resumed network brings its own)
+    if (parametric.count > 0 && (time_marching || decomposition_path || replicas > 1 || num_sweeps > 0 || resume_path || encoding.type != ENCODING_NONE)) {
+        fprintf(stderr, "Error: --parametric cannot be combined with time marching, decomposition, ensembles, --resume or an input encoding\n");
+        return EXIT_FAILURE;
+    }
+
+    // Ranks split the batches of the single-network trainer
+    if (ranks > 1 && (time_marching || decomposition_path || replicas > 1 || num_sweeps > 0)) {
+        fprintf(stderr, "Error: --ranks cannot be combined with time marching, decomposition or ensembles\n");
+        return EXIT_FAILURE;
+    }
+
+    // Refinement is on by default only for the single-network trainer; the others reject an
+    // explicit --refine_every
+    if ((time_marching || decomposition_path || replicas > 1 || num_sweeps > 0) && !refine_given) {
+        config.refine_every = 0;
+    }
+
+    if (time_marching) {
+        if (resume_path || replicas > 1 || num_sweeps > 0 || decomposition_path) {
+            fprintf(stderr, "Error: Time-marching runs cannot be resumed or combined with ensembles or decomposition\n");
+            return EXIT_FAILURE;
+        }
+        if (activation_function == NULL || !parse_activation_function(activation_function, &config.activation)) {
+            fprintf(stderr, "Error: Unsupported or missing activation function\n");
+            return EXIT_FAILURE;
+        }
+        return run_time_marching(loss_type, &params, layer_sizes, num_layers, &encoding, init, &marching, &config);
+    }
+
+    if (decomposition_path) {
+        if (resume_path || replicas > 1 || num_sweeps > 0) {
+            fprintf(stderr, "Error: Decomposed runs cannot be resumed or combined with ensembles\n");
+            return EXIT_FAILURE;
+        }
+        if (activation_function == NULL || !parse_activation_function(activation_function, &config.activation)) {
+            fprintf(stderr, "Error: Unsupported or missing activation function\n");
+            return EXIT_FAILURE;
+        }
+        return run_decomposition(loss_type, &params, layer_sizes, num_layers, &encoding, init, decomposition_path, &config);
+    }
+
+    if (replicas > 1 || num_sweeps > 0) {
+        if (resume_path) {
+            fprintf(stderr, "Error: Ensembles cannot be resumed from a checkpoint\n");
+            return EXIT_FAILURE;
+        }
+        if (encoding.type != ENCODING_NONE) {
+            fprintf(stderr, "Error: Ensembles do not support input encodings\n");
+            return EXIT_FAILURE;
+        }
+        if (activation_function && !parse_activation_function(activation_function, &config.activation)) {
+            fprintf(stderr, "Error: Unsupported activation function: %s\n", activation_function);
+            return EXIT_FAILURE;
+        }
+        return run_ensemble(loss_type, &params, layer_sizes, num_layers, init, sweeps, num_sweeps, replicas, &config);
+    }
+    
+    // Initialize neural network, either fresh or from a checkpoint
+    NeuralNetwork nn;
+    CheckpointState resume_state;
+    if (resume_path) {
+        if (!load_checkpoint(&nn, resume_path, &resume_state)) {
+            return EXIT_FAILURE;
+        }
+        config.activation = resume_state.activation;
+        config.resume = &resume_state;
+        printf("Resuming %s from epoch %d\n", resume_path, resume_state.epoch);
+    } else {
+        if (activation_function == NULL) {
+            fprintf(stderr, "Error: Activation function not specified\n");
+            print_usage();
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_activation_function(activation_function, &config.activation)) {
+            fprintf(stderr, "Error: Unsupported activation function: %s\n", activation_function);
+            return EXIT_FAILURE;
+        }
+
+        // The parameters follow the coordinates as inputs of the first layer
+        int sizes[MAX_LAYERS];
+        memcpy(sizes, layer_sizes, num_layers * sizeof(int));
+        sizes[0] += parametric.count;
+        if (!seeded_network(&nn, sizes, num_layers, &encoding, init, config.activation, config.seed, 0) || !set_parameter_inputs(&nn, &parametric) ||
+            !validate_neural_network_initialization(&nn)) {
+            fprintf(stderr, "Neural network initialization failed!\n");
+            free_neural_network(&nn);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (ranks > 1) {
+        int status = run_ranks(&nn, loss_type, &params, &config, ranks);
+        free_neural_network(&nn);
+        return status;
+    }
+
     // Train neural network
-    train_neural_network(&nn, loss_type, &params, epochs, learning_rate, activation_function);
+    if (!train_neural_network(&nn, loss_type, &params, &config)) {
+        free_neural_network(&nn);
+        return EXIT_FAILURE;
+    }
 
     // Save trained model
-    save_model(&nn, "model_parameters.txt");
+    save_model(&nn, loss_type, config.activation, "model_parameters.ckpt");
+
+    free_neural_network(&nn);
 
     return EXIT_SUCCESS;
 }
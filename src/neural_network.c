@@ -1,277 +1,348 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
 #include <math.h>
 #include <string.h>
+#include <sys/mman.h>
 #include "neural_network.h"
-#include "loss_functions.h"
-#include "utils.h"
-
-// Function prototypes
-static void log_training_data(const char *loss_type, int epoch, double loss, double validation_loss, int run_number);
-static double calculate_validation_loss(NeuralNetwork *nn, double validation_inputs[][INPUT_SIZE], double validation_targets[], int num_validation_samples, const char *loss_type, const LossParameters *params, ActivationFunction activation_func_type);
-void save_model(const NeuralNetwork *nn, const char *filename);
-
-// Function to choose activation function
-static double activate(double x, ActivationFunction function) {
-    double alpha = 0.01;  // Define the leakiness factor
-    switch (function) {
-        case RELU:
-            return (x < 0) ? 0 : x;
-        case SIGMOID:
-            return 1.0 / (1.0 + exp(-x));
-        case TANH:
-            // Stable calculation for Tanh using exp
-            if (x < -20) return -1.0;
-            else if (x > 20) return 1.0;
-            double exp_pos = exp(x);
-            double exp_neg = exp(-x);
-            return (exp_pos - exp_neg) / (exp_pos + exp_neg);
-        case LEAKY_RELU:
-            return (x > 0) ? x : alpha * x;
-        default:
-            return x; // Default to identity if unknown
+#include "gemm.h"
+#include "profile.h"
+#include "rng.h"
+
+// Parse a comma-separated layer spec such as "3,128,128,128,1"; returns the number of layers or -1
+int parse_layer_spec(const char *spec, int layer_sizes[MAX_LAYERS]) {
+    int count = 0;
+    const char *p = spec;
+
+    while (*p != '\0') {
+        char *end = NULL;
+        long size = strtol(p, &end, 10);
+        if (end == p || size <= 0 || count >= MAX_LAYERS) {
+            return -1;
+        }
+        layer_sizes[count++] = (int)size;
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
     }
-}
 
-// Function to calculate the derivative of Tanh
-static double tanh_derivative(double x) {
-    double t = tanh(x);
-    return 1.0 - t * t; // Derivative of Tanh is 1 - tanh^2(x)
+    return (count >= 2) ? count : -1;
 }
 
-void initialize_neural_network(NeuralNetwork *nn) {
-    for (int i = 0; i < INPUT_SIZE; i++) {
-        for (int j = 0; j < HIDDEN_SIZE; j++) {
-            nn->weights_input_hidden[i][j] = ((double)rand() / RAND_MAX) * 2 - 1;
-        }
+int parse_precision(const char *name, Precision *precision) {
+    if (strcmp(name, "fp64") == 0) {
+        *precision = PRECISION_FP64;
+    } else if (strcmp(name, "mixed") == 0) {
+        *precision = PRECISION_MIXED;
+    } else if (strcmp(name, "rounded") == 0) {
+        *precision = PRECISION_ROUNDED;
+    } else {
+        return 0;
     }
+    return 1;
+}
 
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        for (int k = 0; k < OUTPUT_SIZE; k++) {
-            nn->weights_hidden_output[j][k] = ((double)rand() / RAND_MAX) * 2 - 1;
-        }
-        nn->biases_hidden[j] = ((double)rand() / RAND_MAX) * 2 - 1;
+int parse_init_scheme(const char *name, InitScheme *scheme) {
+    if (strcmp(name, "xavier") == 0) {
+        *scheme = INIT_XAVIER;
+    } else if (strcmp(name, "he") == 0) {
+        *scheme = INIT_HE;
+    } else if (strcmp(name, "uniform") == 0) {
+        *scheme = INIT_UNIFORM;
+    } else {
+        return 0;
     }
+    return 1;
+}
 
-    for (int k = 0; k < OUTPUT_SIZE; k++) {
-        nn->biases_output[k] = ((double)rand() / RAND_MAX) * 2 - 1;
-    }
+InitScheme default_init_scheme(ActivationFunction activation) {
+    return activation == RELU || activation == LEAKY_RELU ? INIT_HE : INIT_XAVIER;
 }
 
-int validate_neural_network_initialization(const NeuralNetwork *nn) {
-    if (nn == NULL) return 0;
+// Round a number of doubles up to a whole cache line
+static size_t padded_count(size_t count) {
+    return arena_aligned_size(count * sizeof(double)) / sizeof(double);
+}
+
+int allocate_neural_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers, double *parameters) {
+    return allocate_encoded_network(nn, layer_sizes, num_layers, NULL, parameters);
+}
 
-    for (int i = 0; i < INPUT_SIZE; i++) {
-        for (int j = 0; j < HIDDEN_SIZE; j++) {
-            if (nn->weights_input_hidden[i][j] == 0) return 0;
+// Lay out the parameter buffer and carve every buffer out of the arena. With parameters
+// non-NULL the network uses that (64-byte aligned) block instead and leaves it uninitialised.
+// Encoding tables follow the last layer, so the layer offsets do not depend on the encoding.
+int allocate_encoded_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers, const EncodingConfig *encoding, double *parameters) {
+    memset(nn, 0, sizeof(*nn));
+    if (num_layers < 2 || num_layers > MAX_LAYERS) {
+        fprintf(stderr, "Error: A network needs between 2 and %d layers\n", MAX_LAYERS);
+        return 0;
+    }
+    if (encoding && encoding->type != ENCODING_NONE) {
+        if (!encoding_layout(&nn->encoding, encoding)) {
+            return 0;
+        }
+        if (nn->encoding.output_dim != layer_sizes[0]) {
+            fprintf(stderr, "Error: The %s encoding is %d wide but the first layer has %d units\n",
+                    encoding_type_name(encoding->type), nn->encoding.output_dim, layer_sizes[0]);
+            return 0;
         }
     }
 
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        for (int k = 0; k < OUTPUT_SIZE; k++) {
-            if (nn->weights_hidden_output[j][k] == 0) return 0;
+    nn->num_layers = num_layers;
+    size_t offset = 0;
+    size_t activation_doubles = 0;
+    for (int l = 0; l < num_layers; l++) {
+        if (layer_sizes[l] <= 0) {
+            fprintf(stderr, "Error: Invalid layer size %d\n", layer_sizes[l]);
+            return 0;
+        }
+        nn->layer_sizes[l] = layer_sizes[l];
+        activation_doubles += padded_count(layer_sizes[l]);
+        if (l + 1 < num_layers) {
+            nn->weight_offsets[l] = offset;
+            offset += padded_count((size_t)layer_sizes[l] * layer_sizes[l + 1]);
+            nn->bias_offsets[l] = offset;
+            offset += padded_count(layer_sizes[l + 1]);
         }
-        if (nn->biases_hidden[j] == 0) return 0;
     }
-
-    for (int k = 0; k < OUTPUT_SIZE; k++) {
-        if (nn->biases_output[k] == 0) return 0;
+    nn->encoding_offset = offset;
+    nn->num_parameters = offset + padded_count(nn->encoding.num_parameters);
+
+    // Parameters, gradients, activations and the encoding constants all come from a single block
+    size_t parameter_doubles = parameters ? 0 : nn->num_parameters;
+    size_t constant_doubles = padded_count(nn->encoding.num_constants);
+    size_t total = (parameter_doubles + nn->num_parameters + activation_doubles + constant_doubles) * sizeof(double);
+    if (!arena_init(&nn->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate %zu bytes for the network\n", total);
+        return 0;
+    }
+    nn->parameters = parameters ? parameters : arena_alloc(&nn->arena, nn->num_parameters * sizeof(double));
+    nn->gradients = arena_alloc(&nn->arena, nn->num_parameters * sizeof(double));
+    for (int l = 0; l < num_layers; l++) {
+        nn->activations[l] = arena_alloc(&nn->arena, layer_sizes[l] * sizeof(double));
+    }
+    if (nn_encoded(nn)) {
+        encoding_bind(&nn->encoding, nn->encoding.num_constants ? arena_alloc(&nn->arena, nn->encoding.num_constants * sizeof(double)) : NULL);
     }
-
     return 1;
 }
 
-void forward_pass(NeuralNetwork *nn, double input[INPUT_SIZE], double output[OUTPUT_SIZE], ActivationFunction activation_function) {
-    double hidden[HIDDEN_SIZE] = {0};
-
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        for (int i = 0; i < INPUT_SIZE; i++) {
-            hidden[j] += input[i] * nn->weights_input_hidden[i][j];
+void init_parameters(NeuralNetwork *nn, InitScheme scheme, uint64_t seed, uint32_t substream) {
+    Rng rng;
+    rng_init(&rng, seed, RNG_STREAM_INIT, substream);
+    for (int l = 0; l + 1 < nn->num_layers; l++) {
+        int in = nn->layer_sizes[l], out = nn->layer_sizes[l + 1];
+        double limit = scheme == INIT_XAVIER ? sqrt(6.0 / (in + out)) : scheme == INIT_HE ? sqrt(6.0 / in) : 1.0;
+        rng_fill_uniform(&rng, nn->weight_offsets[l], nn_weights(nn, l), (size_t)in * out, -limit, limit);
+        if (scheme == INIT_UNIFORM) {
+            rng_fill_uniform(&rng, nn->bias_offsets[l], nn_biases(nn, l), out, -1.0, 1.0);
+        } else {
+            memset(nn_biases(nn, l), 0, out * sizeof(double));
         }
-        hidden[j] += nn->biases_hidden[j];
-        hidden[j] = activate(hidden[j], activation_function);
-        nn->hidden_outputs[j] = hidden[j]; // Store the hidden output in the structure
     }
+    encoding_init_tables(&nn->encoding, nn_encoding_tables(nn), &rng, nn->encoding_offset);
+}
 
-    for (int k = 0; k < OUTPUT_SIZE; k++) {
-        output[k] = 0;
-        for (int j = 0; j < HIDDEN_SIZE; j++) {
-            output[k] += hidden[j] * nn->weights_hidden_output[j][k];
-        }
-        output[k] += nn->biases_output[k];
+int initialize_neural_network(NeuralNetwork *nn, const int *layer_sizes, int num_layers) {
+    if (!allocate_neural_network(nn, layer_sizes, num_layers, NULL)) {
+        return 0;
     }
+    init_parameters(nn, INIT_XAVIER, RNG_DEFAULT_SEED, 0);
+    return 1;
 }
 
-static void update_weights(NeuralNetwork *nn, double learning_rate, double input[INPUT_SIZE], double output[OUTPUT_SIZE], double target) {
-    double output_error[OUTPUT_SIZE];
-    double hidden_error[HIDDEN_SIZE] = {0};
-
-    for (int k = 0; k < OUTPUT_SIZE; k++) {
-        output_error[k] = target - output[k];
+int set_parameter_inputs(NeuralNetwork *nn, const ParameterInputs *inputs) {
+    if (inputs->count < 0 || inputs->count > PARAMETRIC_MAX_INPUTS || (inputs->count > 0 && nn_encoded(nn))) {
+        fprintf(stderr, "Error: Parameter inputs need an unencoded network and at most %d parameters\n", PARAMETRIC_MAX_INPUTS);
+        return 0;
     }
-
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        for (int k = 0; k < OUTPUT_SIZE; k++) {
-            hidden_error[j] += output_error[k] * nn->weights_hidden_output[j][k];
-        }
-        // Use Tanh derivative here with hidden outputs from the structure
-        hidden_error[j] *= tanh_derivative(nn->hidden_outputs[j]); 
+    if (nn->layer_sizes[0] - inputs->count < 2) {
+        fprintf(stderr, "Error: %d parameter inputs leave fewer than 2 of the %d inputs for (space..., time)\n", inputs->count, nn->layer_sizes[0]);
+        return 0;
     }
-
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        for (int k = 0; k < OUTPUT_SIZE; k++) {
-            nn->weights_hidden_output[j][k] += learning_rate * output_error[k] * nn->hidden_outputs[j];
+    for (int k = 0; k < inputs->count; k++) {
+        if (inputs->fields[k] < 0 || inputs->fields[k] >= PARAMETRIC_MAX_INPUTS || !(inputs->upper[k] > inputs->lower[k])) {
+            fprintf(stderr, "Error: Invalid range for parameter input %d\n", k);
+            return 0;
         }
     }
+    nn->parameter_inputs = *inputs;
+    return 1;
+}
 
-    for (int k = 0; k < OUTPUT_SIZE; k++) {
-        nn->biases_output[k] += learning_rate * output_error[k];
+void free_neural_network(NeuralNetwork *nn) {
+    if (nn->mapping) {
+        munmap(nn->mapping, nn->mapping_size);
     }
+    arena_free(&nn->arena);
+    memset(nn, 0, sizeof(*nn));
+}
 
-    for (int i = 0; i < INPUT_SIZE; i++) {
-        for (int j = 0; j < HIDDEN_SIZE; j++) {
-            nn->weights_input_hidden[i][j] += learning_rate * hidden_error[j] * input[i];
+int validate_neural_network_initialization(const NeuralNetwork *nn) {
+    if (nn == NULL || nn->parameters == NULL) return 0;
+
+    for (int l = 0; l + 1 < nn->num_layers; l++) {
+        const double *weights = nn_weights(nn, l);
+        const double *biases = nn_biases(nn, l);
+        size_t count = (size_t)nn->layer_sizes[l] * nn->layer_sizes[l + 1];
+        for (size_t i = 0; i < count; i++) {
+            if (weights[i] == 0 || !isfinite(weights[i])) return 0;
+        }
+        for (int j = 0; j < nn->layer_sizes[l + 1]; j++) {
+            if (!isfinite(biases[j])) return 0;
         }
     }
 
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        nn->biases_hidden[j] += learning_rate * hidden_error[j];
-    }
+    return 1;
 }
 
-void train_neural_network(NeuralNetwork *nn, const char *loss_type, const LossParameters *params, int epochs, double learning_rate, const char *activation_function) {
-    double validation_inputs[5][INPUT_SIZE] = {
-        {1.0, 2.0},
-        {1.5, 2.5},
-        {2.0, 3.0},
-        {2.5, 3.5},
-        {3.0, 4.0}
-    };
-
-    double validation_targets[5] = {1.0, 1.5, 2.0, 2.5, 3.0};
-    int num_validation_samples = 5;
-
-    ActivationFunction activation_func_type;
-    if (strcmp(activation_function, "sigmoid") == 0) {
-        activation_func_type = SIGMOID;
-    } else if (strcmp(activation_function, "tanh") == 0) {
-        activation_func_type = TANH;
-    } else if (strcmp(activation_function, "relu") == 0) {
-        activation_func_type = RELU;
-    } else if (strcmp(activation_function, "leaky_relu") == 0) {
-        activation_func_type = LEAKY_RELU;
+// Hidden layers use the chosen activation; the output layer stays linear
+void forward_pass(NeuralNetwork *nn, const double *input, double *output, ActivationFunction activation_function) {
+    int last = nn->num_layers - 1;
+    if (nn_encoded(nn)) {
+        encode_points(&nn->encoding, nn_encoding_tables(nn), input, 1, nn->activations[0]);
     } else {
-        fprintf(stderr, "Error: Unsupported activation function: %s\n", activation_function);
-        return;
+        memcpy(nn->activations[0], input, nn->layer_sizes[0] * sizeof(double));
+        scale_parameter_columns(&nn->parameter_inputs, nn->activations[0], 1, nn->layer_sizes[0]);
     }
 
-    char log_filename[256];
-    snprintf(log_filename, sizeof(log_filename), "log_%s.txt", loss_type);
-
-    int run_number = 0;
-    while (access(log_filename, F_OK) == 0) {
-        run_number++;
-        snprintf(log_filename, sizeof(log_filename), "log_%s_%d.txt", loss_type, run_number);
+    for (int l = 0; l < last; l++) {
+        int in = nn->layer_sizes[l];
+        int out = nn->layer_sizes[l + 1];
+        const double *weights = nn_weights(nn, l);
+        const double *prev = nn->activations[l];
+        double *next = nn->activations[l + 1];
+
+        memcpy(next, nn_biases(nn, l), out * sizeof(double));
+        for (int i = 0; i < in; i++) {
+            const double *row = weights + (size_t)i * out;
+            double a = prev[i];
+            for (int j = 0; j < out; j++) {
+                next[j] += a * row[j];
+            }
+        }
+        if (l + 1 < last) {
+            for (int j = 0; j < out; j++) {
+                next[j] = activate(next[j], activation_function);
+            }
+        }
     }
 
-    for (int epoch = 0; epoch < epochs; epoch++) {
-        double adjusted_learning_rate = adaptive_learning_rate(learning_rate, epoch, 0.01);
-        double input[INPUT_SIZE] = {1.0, 2.0};
-        double target = 1.0;
-        double output[OUTPUT_SIZE] = {0};
-
-        forward_pass(nn, input, output, activation_func_type);
-
-        double loss = 0.0;
-        if (strcmp(loss_type, "schrodinger") == 0) {
-            loss = schrodinger_equation_loss(output[0], target, params->potential, 0.01);
-        } else if (strcmp(loss_type, "maxwell") == 0) {
-            loss = maxwell_equations_loss(output[0], 0.0, params->charge_density, params->current_density);
-        } else if (strcmp(loss_type, "heat") == 0) {
-            loss = heat_equation_loss(output[0], target, 0.1, 0.01);
-        } else if (strcmp(loss_type, "wave") == 0) {
-            loss = wave_equation_loss(output[0], target, 0.0, 0.1, 0.01);
-        } else if (strcmp(loss_type, "navier_stokes") == 0) {
-            loss = navier_stokes_loss(output[0], output[1], output[2], params->viscosity, 0.01);
-        } else {
-            fprintf(stderr, "Unknown loss type: %s\n", loss_type);
-            return;
-        }
+    memcpy(output, nn->activations[last], nn->layer_sizes[last] * sizeof(double));
+}
 
-        update_weights(nn, adjusted_learning_rate, input, output, target);
+int init_batch_workspace(BatchWorkspace *ws, const NeuralNetwork *nn, int capacity) {
+    memset(ws, 0, sizeof(*ws));
+    size_t total = 0;
+    for (int l = 0; l < nn->num_layers; l++) {
+        total += 3 * arena_aligned_size((size_t)capacity * nn->layer_sizes[l] * sizeof(double));
+    }
+    if (capacity <= 0 || !arena_init(&ws->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate a batch workspace for %d samples\n", capacity);
+        return 0;
+    }
 
-        double validation_loss = calculate_validation_loss(nn, validation_inputs, validation_targets, num_validation_samples, loss_type, params, activation_func_type);
-        log_training_data(loss_type, epoch, loss, validation_loss, run_number);
+    ws->capacity = capacity;
+    for (int l = 0; l < nn->num_layers; l++) {
+        size_t bytes = (size_t)capacity * nn->layer_sizes[l] * sizeof(double);
+        ws->activations[l] = arena_alloc(&ws->arena, bytes);
+        ws->deltas[l] = arena_alloc(&ws->arena, bytes);
+        ws->slopes[l] = arena_alloc(&ws->arena, bytes);
     }
+    return 1;
+}
 
-    //save_model(nn, "model.txt");
+void free_batch_workspace(BatchWorkspace *ws) {
+    arena_free(&ws->arena);
+    memset(ws, 0, sizeof(*ws));
 }
 
-static double calculate_validation_loss(NeuralNetwork *nn, double validation_inputs[][INPUT_SIZE], double validation_targets[], int num_validation_samples, const char *loss_type, const LossParameters *params, ActivationFunction activation_func_type) {
-    double total_validation_loss = 0.0;
-
-    for (int i = 0; i < num_validation_samples; i++) {
-        double output[OUTPUT_SIZE] = {0};
-        forward_pass(nn, validation_inputs[i], output, activation_func_type);
-
-        if (strcmp(loss_type, "schrodinger") == 0) {
-            total_validation_loss += schrodinger_equation_loss(output[0], validation_targets[i], params->potential, 0.01);
-        } else if (strcmp(loss_type, "maxwell") == 0) {
-            total_validation_loss += maxwell_equations_loss(output[0], 0.0, params->charge_density, params->current_density);
-        } else if (strcmp(loss_type, "heat") == 0) {
-            total_validation_loss += heat_equation_loss(output[0], validation_targets[i], 0.1, 0.01);
-        } else if (strcmp(loss_type, "wave") == 0) {
-            total_validation_loss += wave_equation_loss(output[0], validation_targets[i], 0.0, 0.1, 0.01);
-        } else if (strcmp(loss_type, "navier_stokes") == 0) {
-            total_validation_loss += navier_stokes_loss(output[0], output[1], output[2], params->viscosity, 0.01);
+// Row-major inputs[num_samples][in] -> outputs[num_samples][out]; each layer is one GEMM.
+// Batches larger than the workspace go through in capacity-sized chunks; only the last
+// chunk stays on the tape, so backward_pass_batch accepts at most ws->capacity samples.
+void forward_pass_batch(const NeuralNetwork *nn, BatchWorkspace *ws, const double *inputs, int num_samples, double *outputs, ActivationFunction activation_function) {
+    if (num_samples > ws->capacity) {
+        int in = nn_input_size(nn);
+        int out = nn_output_size(nn);
+        for (int start = 0; start < num_samples; start += ws->capacity) {
+            int count = num_samples - start < ws->capacity ? num_samples - start : ws->capacity;
+            forward_pass_batch(nn, ws, inputs + (size_t)start * in, count, outputs ? outputs + (size_t)start * out : NULL, activation_function);
         }
+        return;
+    }
+    PROFILE_SCOPE(PROF_FORWARD);
+    PROFILE_COUNT(PROF_POINTS, num_samples);
+    int last = nn->num_layers - 1;
+    if (nn_encoded(nn)) {
+        encode_points(&nn->encoding, nn_encoding_tables(nn), inputs, num_samples, ws->activations[0]);
+    } else {
+        memcpy(ws->activations[0], inputs, (size_t)num_samples * nn->layer_sizes[0] * sizeof(double));
+        scale_parameter_columns(&nn->parameter_inputs, ws->activations[0], num_samples, nn->layer_sizes[0]);
     }
 
-    return total_validation_loss / num_validation_samples;
-}
+    for (int l = 0; l < last; l++) {
+        int in = nn->layer_sizes[l];
+        int out = nn->layer_sizes[l + 1];
+        const double *biases = nn_biases(nn, l);
+        // Hidden pre-activations go through the (not yet needed) delta buffer so one fused
+        // kernel call can write f(z) and f'(z) for the whole layer
+        double *z = (l + 1 < last) ? ws->deltas[l + 1] : ws->activations[l + 1];
 
-static void log_training_data(const char *loss_type, int epoch, double loss, double validation_loss, int run_number) {
-    char log_filename[256];
-    if (run_number == 0) {
-        snprintf(log_filename, sizeof(log_filename), "log_%s.txt", loss_type);
-    } else {
-        snprintf(log_filename, sizeof(log_filename), "log_%s_%d.txt", loss_type, run_number);
+        for (int s = 0; s < num_samples; s++) {
+            memcpy(z + (size_t)s * out, biases, out * sizeof(double));
+        }
+        gemm_nn(num_samples, out, in, ws->activations[l], in, nn_weights(nn, l), out, z, out, 1);
+        PROFILE_COUNT(PROF_FLOPS, 2.0 * num_samples * in * out);
+
+        if (l + 1 < last) {
+            activate_fused(z, ws->activations[l + 1], ws->slopes[l + 1], NULL, NULL, (size_t)num_samples * out, activation_function);
+        }
     }
 
-    FILE *log_file = fopen(log_filename, "a");
-    if (log_file) {
-        fprintf(log_file, "Epoch %d: Loss:  %.5f, Validation Loss: %.5f\n", epoch, loss, validation_loss);
-        fclose(log_file);
-    } else {
-        fprintf(stderr, "Failed to open log file: %s\n", log_filename);
+    if (outputs) {
+        memcpy(outputs, ws->activations[last], (size_t)num_samples * nn->layer_sizes[last] * sizeof(double));
     }
 }
 
-void save_model(const NeuralNetwork *nn, const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file for saving model: %s\n", filename);
+// Accumulates d(loss)/d(parameters) into gradients given d(loss)/d(outputs) for the last forward_pass_batch
+void backward_pass_batch(const NeuralNetwork *nn, BatchWorkspace *ws, const double *output_gradients, int num_samples, ActivationFunction activation_function, double *gradients) {
+    (void)activation_function; // f'(z) was saved by forward_pass_batch with the same function
+    if (num_samples > ws->capacity) {
+        fprintf(stderr, "Error: backward_pass_batch got %d samples, but the workspace holds %d\n", num_samples, ws->capacity);
         return;
     }
-
-    for (int i = 0; i < INPUT_SIZE; i++) {
-        for (int j = 0; j < HIDDEN_SIZE; j++) {
-            fprintf(file, "%lf\n", nn->weights_input_hidden[i][j]);
+    PROFILE_SCOPE(PROF_BACKWARD);
+    int last = nn->num_layers - 1;
+    memcpy(ws->deltas[last], output_gradients, (size_t)num_samples * nn->layer_sizes[last] * sizeof(double));
+
+    for (int l = last - 1; l >= 0; l--) {
+        int in = nn->layer_sizes[l];
+        int out = nn->layer_sizes[l + 1];
+        const double *delta = ws->deltas[l + 1];
+        double *bias_gradients = gradients + nn->bias_offsets[l];
+
+        gemm_tn(in, out, num_samples, ws->activations[l], in, delta, out, gradients + nn->weight_offsets[l], out, 1);
+        PROFILE_COUNT(PROF_FLOPS, (l > 0 ? 4.0 : 2.0) * num_samples * in * out);
+        for (int s = 0; s < num_samples; s++) {
+            const double *row = delta + (size_t)s * out;
+            for (int j = 0; j < out; j++) {
+                bias_gradients[j] += row[j];
+            }
         }
-    }
 
-    for (int j = 0; j < HIDDEN_SIZE; j++) {
-        for (int k = 0; k < OUTPUT_SIZE; k++) {
-            fprintf(file, "%lf\n", nn->weights_hidden_output[j][k]);
+        if (l > 0) {
+            double *prev = ws->deltas[l];
+            const double *slope = ws->slopes[l];
+            size_t count = (size_t)num_samples * in;
+            gemm_nt(num_samples, in, out, delta, out, nn_weights(nn, l), out, prev, in, 0);
+            for (size_t i = 0; i < count; i++) {
+                prev[i] *= slope[i];
+            }
+        } else if (nn->encoding.num_parameters > 0) {
+            gemm_nt(num_samples, in, out, delta, out, nn_weights(nn, 0), out, ws->deltas[0], in, 0);
+            encode_jets_adjoint(&nn->encoding, ws->activations[0], ws->deltas[0], num_samples, 0, gradients + nn->encoding_offset, NULL);
         }
-        fprintf(file, "%lf\n", nn->biases_hidden[j]);
-    }
-
-    for (int k = 0; k < OUTPUT_SIZE; k++) {
-        fprintf(file, "%lf\n", nn->biases_output[k]);
     }
-
-    fclose(file);
-    printf("Model saved to %s\n", filename);
 }
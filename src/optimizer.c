@@ -0,0 +1,469 @@
+#include "optimizer.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "utils.h"
+
+// Bookkeeping slots in the first cache line of the saved state
+#define SLOT_STEPS 0
+#define SLOT_HISTORY_COUNT 1
+#define SLOT_HISTORY_HEAD 2
+
+int parse_optimizer(const char *name, OptimizerType *type) {
+    static const struct { const char *name; OptimizerType type; } names[] = {
+        {"sgd", OPTIMIZER_SGD}, {"adam", OPTIMIZER_ADAM}, {"adamw", OPTIMIZER_ADAMW}, {"lbfgs", OPTIMIZER_LBFGS},
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i].name) == 0) {
+            *type = names[i].type;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int parse_schedule(const char *name, ScheduleType *type) {
+    static const struct { const char *name; ScheduleType type; } names[] = {
+        {"inverse", SCHEDULE_INVERSE}, {"constant", SCHEDULE_CONSTANT}, {"cosine", SCHEDULE_COSINE}, {"step", SCHEDULE_STEP},
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i].name) == 0) {
+            *type = names[i].type;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void default_optimizer_config(OptimizerConfig *config, OptimizerType type) {
+    config->type = type;
+    config->beta1 = 0.9;
+    config->beta2 = 0.999;
+    config->epsilon = 1e-8;
+    config->weight_decay = type == OPTIMIZER_ADAMW ? 0.01 : 0.0;
+    config->history = 10;
+    config->max_line_search = 20;
+}
+
+void default_learning_rate_schedule(LearningRateSchedule *schedule, double base_rate, int total_epochs) {
+    memset(schedule, 0, sizeof(*schedule));
+    schedule->type = SCHEDULE_INVERSE;
+    schedule->base_rate = base_rate;
+    schedule->decay = 0.01;
+    schedule->min_rate = 0.0;
+    schedule->step_size = 1000;
+    schedule->gamma = 0.5;
+    schedule->total_epochs = total_epochs;
+}
+
+double schedule_learning_rate(const LearningRateSchedule *schedule, int epoch) {
+    double rate = schedule->base_rate;
+    switch (schedule->type) {
+        case SCHEDULE_INVERSE:
+            rate = adaptive_learning_rate(schedule->base_rate, epoch, schedule->decay);
+            break;
+        case SCHEDULE_CONSTANT:
+            break;
+        case SCHEDULE_COSINE: {
+            int span = schedule->total_epochs - schedule->warmup_epochs - 1;
+            double progress = span > 0 ? (double)(epoch - schedule->warmup_epochs) / span : 1.0;
+            progress = progress < 0.0 ? 0.0 : (progress > 1.0 ? 1.0 : progress);
+            rate = schedule->min_rate + 0.5 * (schedule->base_rate - schedule->min_rate) * (1.0 + cos(M_PI * progress));
+            break;
+        }
+        case SCHEDULE_STEP:
+            rate = schedule->base_rate * pow(schedule->gamma, schedule->step_size > 0 ? epoch / schedule->step_size : 0);
+            break;
+    }
+    if (epoch < schedule->warmup_epochs) {
+        rate *= (double)(epoch + 1) / schedule->warmup_epochs;
+    }
+    return rate;
+}
+
+static double dot(const double *a, const double *b, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Block of n doubles rounded up to whole cache lines, so every state array stays aligned
+static size_t block(size_t n) {
+    return arena_aligned_size(n * sizeof(double)) / sizeof(double);
+}
+
+static size_t sgd_state_size(const OptimizerConfig *config, size_t num_parameters) {
+    (void)config;
+    (void)num_parameters;
+    return 0;
+}
+
+// Runs update over every parameter or, with lazy rows, over the dense prefix and each listed row
+typedef void (*RangeUpdate)(void *context, size_t begin, size_t end);
+
+static void update_parameters(const Optimizer *opt, RangeUpdate update, void *context) {
+    const RowSet *rows = opt->sparse;
+    if (rows == NULL) {
+        update(context, 0, opt->num_parameters);
+        return;
+    }
+    update(context, 0, opt->sparse_offset);
+    for (int b = 0; b < rows->num_buckets; b++) {
+        const uint32_t *list = rows->rows + b * rows->bucket_size;
+        for (size_t i = 0; i < rows->counts[b]; i++) {
+            size_t p = opt->sparse_offset + (size_t)list[i] * opt->sparse_width;
+            update(context, p, p + opt->sparse_width);
+        }
+    }
+}
+
+typedef struct {
+    double *parameters;
+    const double *gradients;
+    double learning_rate;
+} SgdPass;
+
+static void sgd_update(void *context, size_t begin, size_t end) {
+    const SgdPass *pass = context;
+    for (size_t p = begin; p < end; p++) {
+        pass->parameters[p] -= pass->learning_rate * pass->gradients[p];
+    }
+}
+
+static double sgd_step(Optimizer *opt, double *parameters, double *gradients, double *loss, double learning_rate, OptimizerObjective objective, void *context) {
+    (void)loss;
+    (void)objective;
+    (void)context;
+    SgdPass pass = {parameters, gradients, learning_rate};
+    update_parameters(opt, sgd_update, &pass);
+    return learning_rate;
+}
+
+// Steps, then the first and second moment estimates
+static size_t adam_state_size(const OptimizerConfig *config, size_t num_parameters) {
+    (void)config;
+    return OPTIMIZER_HEADER_SLOTS + 2 * block(num_parameters);
+}
+
+typedef struct {
+    double *parameters;
+    const double *gradients;
+    double *m;
+    double *v;
+    double step, second, coupled, shrink, b1, b2, eps;
+} AdamPass;
+
+// Both moments and the parameter move in one pass over the range. Adam adds the weight
+// decay to the gradient (L2); AdamW shrinks the parameters directly.
+static void adam_update(void *context, size_t begin, size_t end) {
+    const AdamPass *pass = context;
+    double *restrict m = pass->m;
+    double *restrict v = pass->v;
+    double *restrict x = pass->parameters;
+    const double *restrict g = pass->gradients;
+    double step = pass->step, second = pass->second, coupled = pass->coupled, shrink = pass->shrink;
+    double b1 = pass->b1, b2 = pass->b2, eps = pass->eps;
+
+    for (size_t p = begin; p < end; p++) {
+        double grad = g[p] + coupled * x[p];
+        m[p] = b1 * m[p] + (1.0 - b1) * grad;
+        v[p] = b2 * v[p] + (1.0 - b2) * grad * grad;
+        x[p] = shrink * x[p] - step * m[p] / (sqrt(v[p]) * second + eps);
+    }
+}
+
+static double adam_step(Optimizer *opt, double *parameters, double *gradients, double *loss, double learning_rate, OptimizerObjective objective, void *context) {
+    (void)loss;
+    (void)objective;
+    (void)context;
+    const OptimizerConfig *c = &opt->config;
+    AdamPass pass;
+    pass.parameters = parameters;
+    pass.gradients = gradients;
+    pass.m = opt->state + OPTIMIZER_HEADER_SLOTS;
+    pass.v = pass.m + block(opt->num_parameters);
+
+    double t = ++opt->state[SLOT_STEPS];
+    pass.step = learning_rate / (1.0 - pow(c->beta1, t));
+    pass.second = 1.0 / sqrt(1.0 - pow(c->beta2, t));
+    pass.coupled = opt->method->type == OPTIMIZER_ADAM ? c->weight_decay : 0.0;
+    pass.shrink = opt->method->type == OPTIMIZER_ADAMW ? 1.0 - learning_rate * c->weight_decay : 1.0;
+    pass.b1 = c->beta1;
+    pass.b2 = c->beta2;
+    pass.eps = c->epsilon;
+    update_parameters(opt, adam_update, &pass);
+    return learning_rate;
+}
+
+// Steps, history count and ring head, then rho[history] and the s and y rings
+static size_t lbfgs_state_size(const OptimizerConfig *config, size_t num_parameters) {
+    return OPTIMIZER_HEADER_SLOTS + block(config->history) + 2 * (size_t)config->history * block(num_parameters);
+}
+
+typedef struct {
+    Optimizer *opt;
+    double *parameters;
+    double *gradients;
+    const double *origin;
+    const double *direction;
+    OptimizerObjective objective;
+    void *context;
+    int evaluations;
+} LineSearch;
+
+// phi(alpha) = f(origin + alpha * direction); leaves the gradient there in ls->gradients
+static double line_search_eval(LineSearch *ls, double alpha, double *slope) {
+    size_t n = ls->opt->num_parameters;
+    for (size_t p = 0; p < n; p++) {
+        ls->parameters[p] = ls->origin[p] + alpha * ls->direction[p];
+    }
+    double value = ls->objective(ls->context, ls->gradients);
+    *slope = dot(ls->gradients, ls->direction, n);
+    ls->evaluations++;
+    return value;
+}
+
+// Minimizer of the cubic through (a, fa, da) and (b, fb, db), kept away from the ends
+static double cubic_step(double a, double fa, double da, double b, double fb, double db) {
+    double d1 = da + db - 3.0 * (fa - fb) / (a - b);
+    double radicand = d1 * d1 - da * db;
+    double lo = fmin(a, b), hi = fmax(a, b), margin = 0.1 * (hi - lo);
+    double t = 0.5 * (a + b);
+    if (radicand >= 0.0) {
+        double d2 = copysign(sqrt(radicand), b - a);
+        double denominator = db - da + 2.0 * d2;
+        if (denominator != 0.0) {
+            t = b - (b - a) * (db + d2 - d1) / denominator;
+        }
+    }
+    if (!isfinite(t) || t < lo + margin || t > hi - margin) {
+        t = 0.5 * (a + b);
+    }
+    return t;
+}
+
+// Strong-Wolfe line search (Nocedal & Wright, algorithms 3.5 and 3.6). On success the
+// parameters, gradients and *value are at the accepted step, which is returned; 0 means
+// no acceptable step was found and everything is back at the origin.
+static double strong_wolfe(LineSearch *ls, double f0, double slope0, double alpha, double *value) {
+    int budget = ls->opt->config.max_line_search;
+    double prev = 0.0, f_prev = f0, slope_prev = slope0;
+    double lo = 0.0, hi = 0.0, f_lo = f0, f_hi = f0, slope_lo = slope0, slope_hi = slope0;
+    int bracketed = 0;
+
+    while (ls->evaluations < budget) {
+        double slope, f = line_search_eval(ls, alpha, &slope);
+        if (!isfinite(f)) {
+            alpha = prev + 0.5 * (alpha - prev);
+            continue;
+        }
+        if (f > f0 + WOLFE_C1 * alpha * slope0 || (ls->evaluations > 1 && f >= f_prev)) {
+            lo = prev; f_lo = f_prev; slope_lo = slope_prev;
+            hi = alpha; f_hi = f; slope_hi = slope;
+            bracketed = 1;
+            break;
+        }
+        if (fabs(slope) <= -WOLFE_C2 * slope0) {
+            *value = f;
+            return alpha;
+        }
+        if (slope >= 0.0) {
+            lo = alpha; f_lo = f; slope_lo = slope;
+            hi = prev; f_hi = f_prev; slope_hi = slope_prev;
+            bracketed = 1;
+            break;
+        }
+        prev = alpha; f_prev = f; slope_prev = slope;
+        alpha *= 2.0;
+    }
+    if (!bracketed) {
+        lo = prev; f_lo = f_prev;
+    }
+
+    // Zoom: shrink [lo, hi] (either order) around a point satisfying both conditions
+    while (bracketed && ls->evaluations < budget) {
+        double trial = cubic_step(lo, f_lo, slope_lo, hi, f_hi, slope_hi);
+        double slope, f = line_search_eval(ls, trial, &slope);
+        if (!isfinite(f) || f > f0 + WOLFE_C1 * trial * slope0 || f >= f_lo) {
+            hi = trial; f_hi = isfinite(f) ? f : f_lo + fabs(f_lo) + 1.0; slope_hi = isfinite(slope) ? slope : 0.0;
+            continue;
+        }
+        if (fabs(slope) <= -WOLFE_C2 * slope0) {
+            *value = f;
+            return trial;
+        }
+        if (slope * (hi - lo) >= 0.0) {
+            hi = lo; f_hi = f_lo; slope_hi = slope_lo;
+        }
+        lo = trial; f_lo = f; slope_lo = slope;
+    }
+
+    // Out of budget: settle for the best sufficient-decrease point seen, if any
+    if (lo > 0.0 && f_lo < f0) {
+        double slope;
+        *value = line_search_eval(ls, lo, &slope);
+        return lo;
+    }
+    return 0.0;
+}
+
+// Full-batch L-BFGS: two-loop recursion over the history ring, then a strong-Wolfe line
+// search. The first step (or the first after a reset) is steepest descent scaled by the
+// learning rate; after that the quasi-Newton step of length 1 is tried first.
+static double lbfgs_step(Optimizer *opt, double *parameters, double *gradients, double *loss, double learning_rate, OptimizerObjective objective, void *context) {
+    const OptimizerConfig *c = &opt->config;
+    size_t n = opt->num_parameters;
+    size_t stride = block(n);
+    int history = c->history;
+    double *rho = opt->state + OPTIMIZER_HEADER_SLOTS;
+    double *s = rho + block(history);
+    double *y = s + (size_t)history * stride;
+    double *direction = opt->scratch;
+    double *origin = direction + stride;
+    double *origin_gradients = origin + stride;
+    double *alpha = origin_gradients + stride;
+    int count = (int)opt->state[SLOT_HISTORY_COUNT];
+    int head = (int)opt->state[SLOT_HISTORY_HEAD];
+
+    for (size_t p = 0; p < n; p++) {
+        direction[p] = -gradients[p];
+    }
+    for (int k = 0; k < count; k++) {
+        int i = (head - 1 - k + history) % history;
+        alpha[i] = rho[i] * dot(s + i * stride, direction, n);
+        const double *yi = y + i * stride;
+        for (size_t p = 0; p < n; p++) {
+            direction[p] -= alpha[i] * yi[p];
+        }
+    }
+    if (count > 0) {
+        int newest = (head - 1 + history) % history;
+        const double *yn = y + newest * stride;
+        double gamma = 1.0 / (rho[newest] * dot(yn, yn, n));
+        for (size_t p = 0; p < n; p++) {
+            direction[p] *= gamma;
+        }
+    }
+    for (int k = count - 1; k >= 0; k--) {
+        int i = (head - 1 - k + history) % history;
+        double beta = rho[i] * dot(y + i * stride, direction, n);
+        const double *si = s + i * stride;
+        for (size_t p = 0; p < n; p++) {
+            direction[p] += (alpha[i] - beta) * si[p];
+        }
+    }
+
+    double slope0 = dot(gradients, direction, n);
+    if (!(slope0 < 0.0)) {
+        // Not a descent direction: drop the curvature history and fall back to the gradient
+        count = head = 0;
+        for (size_t p = 0; p < n; p++) {
+            direction[p] = -gradients[p];
+        }
+        slope0 = -dot(gradients, gradients, n);
+        if (slope0 == 0.0) {
+            return 0.0;
+        }
+    }
+
+    memcpy(origin, parameters, n * sizeof(double));
+    memcpy(origin_gradients, gradients, n * sizeof(double));
+    LineSearch ls = {opt, parameters, gradients, origin, direction, objective, context, 0};
+    double value = *loss;
+    double step = strong_wolfe(&ls, *loss, slope0, count > 0 ? 1.0 : learning_rate, &value);
+
+    if (step == 0.0) {
+        memcpy(parameters, origin, n * sizeof(double));
+        memcpy(gradients, origin_gradients, n * sizeof(double));
+        opt->state[SLOT_HISTORY_COUNT] = opt->state[SLOT_HISTORY_HEAD] = 0.0;
+        return 0.0;
+    }
+
+    // Store the new pair s = x1 - x0, y = g1 - g0 unless it has no positive curvature
+    double *s_new = s + head * stride;
+    double *y_new = y + head * stride;
+    for (size_t p = 0; p < n; p++) {
+        s_new[p] = parameters[p] - origin[p];
+        y_new[p] = gradients[p] - origin_gradients[p];
+    }
+    double curvature = dot(s_new, y_new, n);
+    if (curvature > 1e-10 * dot(y_new, y_new, n)) {
+        rho[head] = 1.0 / curvature;
+        head = (head + 1) % history;
+        count = count < history ? count + 1 : history;
+    }
+
+    opt->state[SLOT_STEPS] += 1.0;
+    opt->state[SLOT_HISTORY_COUNT] = count;
+    opt->state[SLOT_HISTORY_HEAD] = head;
+    *loss = value;
+    return step;
+}
+
+static const OptimizerMethod methods[] = {
+    {"sgd", OPTIMIZER_SGD, 0, sgd_state_size, sgd_step},
+    {"adam", OPTIMIZER_ADAM, 0, adam_state_size, adam_step},
+    {"adamw", OPTIMIZER_ADAMW, 0, adam_state_size, adam_step},
+    {"lbfgs", OPTIMIZER_LBFGS, 1, lbfgs_state_size, lbfgs_step},
+};
+
+const OptimizerMethod *find_optimizer_method(OptimizerType type) {
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        if (methods[i].type == type) {
+            return &methods[i];
+        }
+    }
+    return NULL;
+}
+
+int optimizer_init(Optimizer *opt, const OptimizerConfig *config, size_t num_parameters) {
+    memset(opt, 0, sizeof(*opt));
+    opt->method = find_optimizer_method(config->type);
+    if (opt->method == NULL || config->history < 1 || config->max_line_search < 1) {
+        fprintf(stderr, "Error: Invalid optimizer configuration\n");
+        return 0;
+    }
+    opt->config = *config;
+    opt->num_parameters = num_parameters;
+    opt->state_size = opt->method->state_size(config, num_parameters);
+
+    // L-BFGS also needs the search direction, the line-search origin and its gradient
+    size_t scratch_size = opt->method->full_batch ? 3 * block(num_parameters) + block(config->history) : 0;
+    size_t total = arena_aligned_size(opt->state_size * sizeof(double)) + arena_aligned_size(scratch_size * sizeof(double));
+    if (total > 0 && !arena_init(&opt->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate %s optimizer state\n", opt->method->name);
+        return 0;
+    }
+    opt->state = opt->state_size ? arena_alloc(&opt->arena, opt->state_size * sizeof(double)) : NULL;
+    opt->scratch = scratch_size ? arena_alloc(&opt->arena, scratch_size * sizeof(double)) : NULL;
+    optimizer_reset(opt);
+    return 1;
+}
+
+void optimizer_free(Optimizer *opt) {
+    arena_free(&opt->arena);
+    memset(opt, 0, sizeof(*opt));
+}
+
+void optimizer_reset(Optimizer *opt) {
+    if (opt->state) {
+        memset(opt->state, 0, opt->state_size * sizeof(double));
+    }
+}
+
+// Adopt state saved by a run with the same method and parameter count; 0 leaves it fresh
+int optimizer_restore_state(Optimizer *opt, OptimizerType type, const double *state, size_t state_size) {
+    if (type != opt->method->type || state_size != opt->state_size) {
+        return 0;
+    }
+    if (state_size > 0) {
+        memcpy(opt->state, state, state_size * sizeof(double));
+    }
+    return 1;
+}
+
+double optimizer_step(Optimizer *opt, double *parameters, double *gradients, double *loss, double learning_rate, OptimizerObjective objective, void *context) {
+    return opt->method->step(opt, parameters, gradients, loss, learning_rate, objective, context);
+}
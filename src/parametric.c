@@ -0,0 +1,107 @@
+#include "parametric.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const field_names[PARAMETRIC_MAX_INPUTS] = {
+    "potential", "charge_density", "current_density", "thermal_conductivity", "wave_speed", "viscosity"
+};
+
+int parse_loss_parameter(const char *name, LossParameterField *field) {
+    for (int i = 0; i < PARAMETRIC_MAX_INPUTS; i++) {
+        if (strcmp(name, field_names[i]) == 0) {
+            *field = (LossParameterField)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *loss_parameter_name(LossParameterField field) {
+    return field >= 0 && field < PARAMETRIC_MAX_INPUTS ? field_names[field] : "unknown";
+}
+
+double *loss_parameter(LossParameters *params, LossParameterField field) {
+    switch (field) {
+        case LOSS_PARAMETER_POTENTIAL: return &params->potential;
+        case LOSS_PARAMETER_CHARGE_DENSITY: return &params->charge_density;
+        case LOSS_PARAMETER_CURRENT_DENSITY: return &params->current_density;
+        case LOSS_PARAMETER_THERMAL_CONDUCTIVITY: return &params->thermal_conductivity;
+        case LOSS_PARAMETER_WAVE_SPEED: return &params->wave_speed;
+        case LOSS_PARAMETER_VISCOSITY: return &params->viscosity;
+    }
+    return NULL;
+}
+
+// Split "name=rest" into a known field and the text after '='
+static const char *parse_field_prefix(const char *spec, LossParameterField *field) {
+    char name[32];
+    const char *equals = strchr(spec, '=');
+    size_t length = equals ? (size_t)(equals - spec) : 0;
+    if (length == 0 || length >= sizeof(name)) return NULL;
+    memcpy(name, spec, length);
+    name[length] = '\0';
+    return parse_loss_parameter(name, field) ? equals + 1 : NULL;
+}
+
+int parse_parameter_value(const char *spec, LossParameterField *field, double *value) {
+    const char *rest = parse_field_prefix(spec, field);
+    char *end = NULL;
+    if (rest == NULL) return 0;
+    *value = strtod(rest, &end);
+    return end != rest && *end == '\0';
+}
+
+int add_parameter_input(ParameterInputs *inputs, const char *spec) {
+    LossParameterField field;
+    double lower, upper;
+    char extra;
+    const char *range = parse_field_prefix(spec, &field);
+    if (range == NULL || sscanf(range, "%lf:%lf%c", &lower, &upper, &extra) != 2 || !(upper > lower)) {
+        fprintf(stderr, "Error: Invalid parameter range %s (expected name=lo:hi with lo < hi and name a loss parameter)\n", spec);
+        return 0;
+    }
+    if (find_parameter_input(inputs, field) >= 0) {
+        fprintf(stderr, "Error: %s is already a parameter input\n", loss_parameter_name(field));
+        return 0;
+    }
+    int k = inputs->count++;
+    inputs->fields[k] = field;
+    inputs->lower[k] = lower;
+    inputs->upper[k] = upper;
+    return 1;
+}
+
+int find_parameter_input(const ParameterInputs *inputs, LossParameterField field) {
+    for (int k = 0; k < inputs->count; k++) {
+        if (inputs->fields[k] == (int32_t)field) return k;
+    }
+    return -1;
+}
+
+void scale_parameter_columns(const ParameterInputs *inputs, double *rows, int count, int width) {
+    for (int p = 0; p < count; p++) {
+        double *values = rows + (size_t)p * width + width - inputs->count;
+        for (int k = 0; k < inputs->count; k++) {
+            values[k] = scaled_parameter_input(inputs, k, values[k]);
+        }
+    }
+}
+
+void point_loss_parameters(const ParameterInputs *inputs, const LossParameters *base, const double *values, LossParameters *params) {
+    *params = *base;
+    for (int k = 0; k < inputs->count; k++) {
+        *loss_parameter(params, (LossParameterField)inputs->fields[k]) = values[k];
+    }
+}
+
+void append_parameter_inputs(const ParameterInputs *inputs, const Rng *rng, uint64_t position, const double *points, int count, int dims, double *out) {
+    int width = dims + inputs->count;
+    for (int p = 0; p < count; p++) {
+        double *row = out + (size_t)p * width;
+        memcpy(row, points + (size_t)p * dims, dims * sizeof(double));
+        for (int k = 0; k < inputs->count; k++) {
+            rng_fill_uniform(rng, position++, row + dims + k, 1, inputs->lower[k], inputs->upper[k]);
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include "pde.h"
+#include <stdio.h>
+#include <string.h>
+#include "sampler.h"
+
+// Expands to the batch kernel of one operator. The per-point residual is a direct call in
+// the loop body, so resolving the operator costs one indirect call per chunk of points.
+#define PDE_RESIDUAL_KERNEL(kernel, point_residual)                                                    \
+    static double kernel(const JetBatch *jets, int begin, int end, const LossParameters *params,       \
+                         double weight, double *residuals) {                                           \
+        double sum = 0.0;                                                                              \
+        for (int p = begin; p < end; p++) {                                                            \
+            PointDerivatives pd;                                                                       \
+            PointAdjoint adjoint;                                                                      \
+            jet_batch_point(jets, p, &pd);                                                             \
+            if (jets->adjoints) jet_batch_adjoint(jets, p, weight, &adjoint);                          \
+            double loss = point_residual(&pd, params, jets->adjoints ? &adjoint : NULL);               \
+            if (residuals) residuals[p - begin] = loss;                                                \
+            sum += loss;                                                                               \
+        }                                                                                              \
+        return sum;                                                                                    \
+    }
+
+static inline double schrodinger_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    return schrodinger_residual_loss(pd, params->potential, adjoint);
+}
+
+static inline double maxwell_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    return maxwell_residual_loss(pd, params->charge_density, params->current_density, adjoint);
+}
+
+static inline double heat_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    return heat_residual_loss(pd, params->thermal_conductivity, adjoint);
+}
+
+static inline double wave_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    return wave_residual_loss(pd, params->wave_speed, adjoint);
+}
+
+static inline double navier_stokes_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    return navier_stokes_residual_loss(pd, params->viscosity, adjoint);
+}
+
+static inline double schrodinger_conservation_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    (void)params;
+    return schrodinger_conservation_loss(pd, adjoint);
+}
+
+static inline double navier_stokes_conservation_point(const PointDerivatives *pd, const LossParameters *params, PointAdjoint *adjoint) {
+    (void)params;
+    return navier_stokes_conservation_loss(pd, adjoint);
+}
+
+PDE_RESIDUAL_KERNEL(schrodinger_kernel, schrodinger_point)
+PDE_RESIDUAL_KERNEL(maxwell_kernel, maxwell_point)
+PDE_RESIDUAL_KERNEL(heat_kernel, heat_point)
+PDE_RESIDUAL_KERNEL(wave_kernel, wave_point)
+PDE_RESIDUAL_KERNEL(navier_stokes_kernel, navier_stokes_point)
+PDE_RESIDUAL_KERNEL(schrodinger_conservation_kernel, schrodinger_conservation_point)
+PDE_RESIDUAL_KERNEL(navier_stokes_conservation_kernel, navier_stokes_conservation_point)
+
+static void schrodinger_reference(const double *x, int input_dim, const LossParameters *params, double *u) {
+    schrodinger_reference_solution(x, input_dim, params->potential, u);
+}
+
+static void maxwell_reference(const double *x, int input_dim, const LossParameters *params, double *u) {
+    maxwell_reference_solution(x, input_dim, params->charge_density, params->current_density, u);
+}
+
+static void heat_reference(const double *x, int input_dim, const LossParameters *params, double *u) {
+    heat_reference_solution(x, input_dim, params->thermal_conductivity, u);
+}
+
+static void wave_reference(const double *x, int input_dim, const LossParameters *params, double *u) {
+    wave_reference_solution(x, input_dim, params->wave_speed, u);
+}
+
+static void navier_stokes_reference(const double *x, int input_dim, const LossParameters *params, double *u) {
+    navier_stokes_reference_solution(x, input_dim, params->viscosity, u);
+}
+
+// Maxwell is first order in every variable, so its jets skip the second-derivative rows.
+// It and Navier-Stokes model one and at most two spatial dimensions respectively.
+// Schrödinger conserves probability and 2-D Navier-Stokes conserves mass.
+static const PdeOperator builtin_operators[] = {
+    {"schrodinger", 2, 2, SAMPLER_MAX_DIMS, 2, 0, schrodinger_kernel, schrodinger_reference, schrodinger_conservation_kernel},
+    {"maxwell", 2, 2, 2, 1, 0, maxwell_kernel, maxwell_reference, NULL},
+    {"heat", 1, 2, SAMPLER_MAX_DIMS, 2, 0, heat_kernel, heat_reference, NULL},
+    {"wave", 1, 2, SAMPLER_MAX_DIMS, 2, 1, wave_kernel, wave_reference, NULL},
+    {"navier_stokes", 3, 2, 3, 2, 0, navier_stokes_kernel, navier_stokes_reference, navier_stokes_conservation_kernel}
+};
+
+#define NUM_BUILTIN_OPERATORS ((int)(sizeof(builtin_operators) / sizeof(builtin_operators[0])))
+
+static const PdeOperator *registry[PDE_MAX_OPERATORS] = {
+    &builtin_operators[0], &builtin_operators[1], &builtin_operators[2], &builtin_operators[3], &builtin_operators[4]
+};
+static int registry_size = NUM_BUILTIN_OPERATORS;
+
+const PdeOperator *find_pde_operator(const char *name) {
+    for (int i = 0; i < registry_size; i++) {
+        if (strcmp(registry[i]->name, name) == 0) {
+            return registry[i];
+        }
+    }
+    return NULL;
+}
+
+// Add an operator before training starts; the descriptor must outlive the run.
+// Returns 1 on success, 0 if the name is taken, the registry is full or the descriptor is incomplete.
+int register_pde_operator(const PdeOperator *op) {
+    if (op == NULL || op->name == NULL || op->residual == NULL || op->reference == NULL ||
+        op->num_outputs <= 0 || op->num_outputs > PDE_MAX_OUTPUTS || op->min_inputs < 2 ||
+        op->max_inputs < op->min_inputs || op->derivative_order < 1 || op->derivative_order > 2) {
+        fprintf(stderr, "Error: Incomplete PDE operator descriptor\n");
+        return 0;
+    }
+    if (find_pde_operator(op->name) != NULL || registry_size >= PDE_MAX_OPERATORS) {
+        fprintf(stderr, "Error: Cannot register PDE operator %s\n", op->name);
+        return 0;
+    }
+    registry[registry_size++] = op;
+    return 1;
+}
+
+int pde_operator_count(void) {
+    return registry_size;
+}
+
+const PdeOperator *pde_operator_at(int index) {
+    return (index >= 0 && index < registry_size) ? registry[index] : NULL;
+}
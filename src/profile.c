@@ -0,0 +1,230 @@
+#include "profile.h"
+
+#ifdef PINN_PROFILE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_USE_TSC 1
+#endif
+
+#define PROFILE_MAX_THREADS 256
+// Trace events kept per thread; later events are counted but dropped
+#define PROFILE_TRACE_CAPACITY (1 << 16)
+
+static const char *phase_names[PROF_PHASE_COUNT] = {
+    "epoch", "sampler", "forward", "loss", "backward", "reduce", "allreduce", "optimizer", "validation", "refine", "balance", "log", "checkpoint",
+};
+
+static const char *counter_names[PROF_COUNTER_COUNT] = {
+    "flops", "points", "bytes_logged", "allocations", "allocated_bytes",
+};
+
+typedef struct {
+    uint32_t phase;
+    uint64_t start;
+    uint64_t end;
+} TraceEvent;
+
+// One per recording thread; each is written by its owner only
+typedef struct {
+    uint64_t ticks[PROF_PHASE_COUNT];
+    uint64_t calls[PROF_PHASE_COUNT];
+    uint64_t counters[PROF_COUNTER_COUNT];
+    TraceEvent *events;
+    uint64_t num_events;                // May exceed PROFILE_TRACE_CAPACITY
+} ProfileThread;
+
+static ProfileThread *threads[PROFILE_MAX_THREADS];
+static int num_threads;
+static int generation = 1;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t origin;                 // Ticks at the last reset
+static double ns_per_tick = 1.0;
+
+static __thread ProfileThread *current;
+static __thread int current_generation;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t ticks_now(void) {
+#ifdef PROFILE_USE_TSC
+    return __rdtsc();
+#else
+    return monotonic_ns();
+#endif
+}
+
+// Start a new run: forget every thread's numbers and recalibrate the tick length
+void profile_reset(void) {
+    pthread_mutex_lock(&registry_lock);
+    generation++;
+    num_threads = 0;
+#ifdef PROFILE_USE_TSC
+    uint64_t ns0 = monotonic_ns(), tsc0 = __rdtsc(), ns1;
+    do {
+        ns1 = monotonic_ns();
+    } while (ns1 - ns0 < 2000000);
+    ns_per_tick = (double)(ns1 - ns0) / (double)(__rdtsc() - tsc0);
+#endif
+    origin = ticks_now();
+    pthread_mutex_unlock(&registry_lock);
+}
+
+// Slot of the calling thread, claimed on its first event of the run; NULL once full
+static ProfileThread *thread_slot(void) {
+    if (current_generation == generation) {
+        return current;
+    }
+    pthread_mutex_lock(&registry_lock);
+    current = NULL;
+    if (num_threads < PROFILE_MAX_THREADS) {
+        ProfileThread *slot = threads[num_threads];
+        if (slot == NULL) {
+            slot = calloc(1, sizeof(ProfileThread));
+            if (slot) slot->events = malloc(PROFILE_TRACE_CAPACITY * sizeof(TraceEvent));
+            if (slot && slot->events == NULL) {
+                free(slot);
+                slot = NULL;
+            }
+            threads[num_threads] = slot;
+        } else {
+            TraceEvent *events = slot->events;
+            memset(slot, 0, sizeof(*slot));
+            slot->events = events;
+        }
+        if (slot) {
+            current = slot;
+            num_threads++;
+        }
+    }
+    current_generation = generation;
+    pthread_mutex_unlock(&registry_lock);
+    return current;
+}
+
+uint64_t profile_begin(void) {
+    return ticks_now();
+}
+
+void profile_end(ProfilePhase phase, uint64_t start) {
+    uint64_t end = ticks_now();
+    ProfileThread *slot = thread_slot();
+    if (slot == NULL) {
+        return;
+    }
+    slot->ticks[phase] += end - start;
+    slot->calls[phase]++;
+    if (slot->num_events < PROFILE_TRACE_CAPACITY) {
+        slot->events[slot->num_events] = (TraceEvent){phase, start, end};
+    }
+    slot->num_events++;
+}
+
+void profile_count(ProfileCounter counter, uint64_t amount) {
+    ProfileThread *slot = thread_slot();
+    if (slot) {
+        slot->counters[counter] += amount;
+    }
+}
+
+static void write_phases(FILE *file, const uint64_t *ticks, const uint64_t *calls, const char *indent) {
+    fprintf(file, "{\n");
+    for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+        fprintf(file, "%s  \"%s\": {\"calls\": %llu, \"total_ns\": %.0f}%s\n", indent, phase_names[p],
+                (unsigned long long)calls[p], ticks[p] * ns_per_tick, p + 1 < PROF_PHASE_COUNT ? "," : "");
+    }
+    fprintf(file, "%s}", indent);
+}
+
+static void write_counters(FILE *file, const uint64_t *counters, const char *indent) {
+    fprintf(file, "{\n");
+    for (int c = 0; c < PROF_COUNTER_COUNT; c++) {
+        fprintf(file, "%s  \"%s\": %llu%s\n", indent, counter_names[c], (unsigned long long)counters[c], c + 1 < PROF_COUNTER_COUNT ? "," : "");
+    }
+    fprintf(file, "%s}", indent);
+}
+
+// Call once the worker threads are idle (training has finished)
+int profile_write_report(const char *base, int trace) {
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s.json", base);
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot write profile %s\n", filename);
+        return 0;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    uint64_t ticks[PROF_PHASE_COUNT] = {0}, calls[PROF_PHASE_COUNT] = {0}, counters[PROF_COUNTER_COUNT] = {0};
+    double wall_ns = (ticks_now() - origin) * ns_per_tick;
+    fprintf(file, "{\n  \"wall_ns\": %.0f,\n  \"threads\": [\n", wall_ns);
+    for (int t = 0; t < num_threads; t++) {
+        const ProfileThread *slot = threads[t];
+        for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+            ticks[p] += slot->ticks[p];
+            calls[p] += slot->calls[p];
+        }
+        for (int c = 0; c < PROF_COUNTER_COUNT; c++) {
+            counters[c] += slot->counters[c];
+        }
+        fprintf(file, "    {\n      \"thread\": %d,\n      \"phases\": ", t);
+        write_phases(file, slot->ticks, slot->calls, "      ");
+        fprintf(file, ",\n      \"counters\": ");
+        write_counters(file, slot->counters, "      ");
+        fprintf(file, "\n    }%s\n", t + 1 < num_threads ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"phases\": ");
+    write_phases(file, ticks, calls, "  ");
+    fprintf(file, ",\n  \"counters\": ");
+    write_counters(file, counters, "  ");
+    fprintf(file, "\n}\n");
+    fclose(file);
+
+    if (trace) {
+        snprintf(filename, sizeof(filename), "%s.trace.json", base);
+        file = fopen(filename, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Error: Cannot write trace %s\n", filename);
+        } else {
+            int first = 1;
+            fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+            for (int t = 0; t < num_threads; t++) {
+                const ProfileThread *slot = threads[t];
+                uint64_t count = slot->num_events < PROFILE_TRACE_CAPACITY ? slot->num_events : PROFILE_TRACE_CAPACITY;
+                for (uint64_t e = 0; e < count; e++) {
+                    const TraceEvent *event = &slot->events[e];
+                    fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                            first ? "" : ",\n", phase_names[event->phase], t,
+                            (double)(event->start - origin) * ns_per_tick * 1e-3, (double)(event->end - event->start) * ns_per_tick * 1e-3);
+                    first = 0;
+                }
+            }
+            fprintf(file, "\n]}\n");
+            fclose(file);
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return 1;
+}
+
+#else
+
+void profile_reset(void) {
+}
+
+int profile_write_report(const char *base, int trace) {
+    (void)base;
+    (void)trace;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// The 128-bit counter is (block, substream, stream); each block yields two 64-bit words
+static void rng_block(const Rng *rng, uint64_t block, uint64_t words[2]) {
+    uint32_t counter[4] = {(uint32_t)block, (uint32_t)(block >> 32), rng->substream, rng->stream};
+    uint32_t out[4];
+    philox4x32(counter, rng->key, out);
+    words[0] = (uint64_t)out[0] | (uint64_t)out[1] << 32;
+    words[1] = (uint64_t)out[2] | (uint64_t)out[3] << 32;
+}
+
+void rng_init(Rng *rng, uint64_t seed, RngStreamId stream, uint32_t substream) {
+    rng->key[0] = (uint32_t)seed;
+    rng->key[1] = (uint32_t)(seed >> 32);
+    rng->stream = (uint32_t)stream;
+    rng->substream = substream;
+    rng_seek(rng, 0);
+}
+
+uint64_t rng_at(const Rng *rng, uint64_t position) {
+    uint64_t words[2];
+    rng_block(rng, position >> 1, words);
+    return words[position & 1];
+}
+
+void rng_seek(Rng *rng, uint64_t position) {
+    rng->position = position;
+    rng->block = UINT64_MAX;
+}
+
+uint64_t rng_next(Rng *rng) {
+    uint64_t block = rng->position >> 1;
+    if (block != rng->block) {
+        rng_block(rng, block, rng->cache);
+        rng->block = block;
+    }
+    return rng->cache[rng->position++ & 1];
+}
+
+double rng_next_uniform(Rng *rng) {
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+// Multiply-shift: the bias is at most bound / 2^64
+uint64_t rng_next_below(Rng *rng, uint64_t bound) {
+    return (uint64_t)(((unsigned __int128)rng_next(rng) * bound) >> 64);
+}
+
+void rng_fill_uniform(const Rng *rng, uint64_t position, double *out, size_t count, double lower, double upper) {
+    double width = upper - lower;
+    size_t n = 0;
+    uint64_t words[2];
+    if (count > 0 && (position & 1)) {
+        out[n++] = lower + width * ((rng_at(rng, position++) >> 11) * 0x1.0p-53);
+    }
+    for (; n + 1 < count; n += 2, position += 2) {
+        rng_block(rng, position >> 1, words);
+        out[n] = lower + width * ((words[0] >> 11) * 0x1.0p-53);
+        out[n + 1] = lower + width * ((words[1] >> 11) * 0x1.0p-53);
+    }
+    if (n < count) {
+        out[n] = lower + width * ((rng_at(rng, position) >> 11) * 0x1.0p-53);
+    }
+}
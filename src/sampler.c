@@ -0,0 +1,438 @@
+#include "sampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Joe-Kuo primitive polynomials (degree s, coefficients a) and initial direction numbers m
+// for Sobol dimensions 2..10; dimension 1 is the van der Corput sequence.
+static const struct {
+    int s;
+    int a;
+    uint32_t m[5];
+} sobol_table[SAMPLER_MAX_DIMS - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}}
+};
+
+int parse_sampling_method(const char *name, SamplingMethod *method) {
+    if (strcmp(name, "uniform") == 0) {
+        *method = SAMPLE_UNIFORM;
+    } else if (strcmp(name, "lhs") == 0) {
+        *method = SAMPLE_LATIN_HYPERCUBE;
+    } else if (strcmp(name, "sobol") == 0) {
+        *method = SAMPLE_SOBOL;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// Parse "lo:hi,lo:hi,..." with one range per input (time last); returns 1 on success
+int parse_domain(const char *spec, Domain *domain) {
+    const char *p = spec;
+    domain->dims = 0;
+    while (*p != '\0') {
+        char *end = NULL;
+        if (domain->dims >= SAMPLER_MAX_DIMS) return 0;
+        double lower = strtod(p, &end);
+        if (end == p || *end != ':') return 0;
+        p = end + 1;
+        double upper = strtod(p, &end);
+        if (end == p || upper <= lower) return 0;
+        domain->lower[domain->dims] = lower;
+        domain->upper[domain->dims] = upper;
+        domain->dims++;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p != '\0') return 0;
+    }
+    return domain->dims >= 2;
+}
+
+void unit_domain(Domain *domain, int dims) {
+    domain->dims = dims;
+    for (int i = 0; i < dims; i++) {
+        domain->lower[i] = 0.0;
+        domain->upper[i] = 1.0;
+    }
+}
+
+static void sobol_init(SobolSequence *seq, int dims) {
+    memset(seq, 0, sizeof(*seq));
+    seq->dims = dims;
+    for (int k = 0; k < 32; k++) {
+        seq->directions[0][k] = 1u << (31 - k);
+    }
+    for (int j = 1; j < dims; j++) {
+        int s = sobol_table[j - 1].s;
+        int a = sobol_table[j - 1].a;
+        uint32_t *v = seq->directions[j];
+        for (int k = 0; k < s; k++) {
+            v[k] = sobol_table[j - 1].m[k] << (31 - k);
+        }
+        for (int k = s; k < 32; k++) {
+            v[k] = v[k - s] ^ (v[k - s] >> s);
+            for (int i = 1; i < s; i++) {
+                if ((a >> (s - 1 - i)) & 1) {
+                    v[k] ^= v[k - i];
+                }
+            }
+        }
+    }
+}
+
+// Digital shifts depend only on the seed and the pass of the index, so a restored sampler
+// gets them back exactly
+static void sobol_scramble(SobolSequence *seq, uint64_t seed, uint32_t substream) {
+    Rng rng;
+    seq->seed = seed;
+    seq->substream = substream;
+    rng_init(&rng, seed, RNG_STREAM_SCRAMBLE, substream);
+    rng_seek(&rng, (seq->index >> 32) * SAMPLER_MAX_DIMS);
+    for (int j = 0; j < seq->dims; j++) {
+        seq->shift[j] = (uint32_t)(rng_next(&rng) >> 32);
+    }
+}
+
+// Next point in Gray-code order: flip the direction number of the lowest zero bit of the index.
+// The last index of a pass has no zero bit, so the next pass starts over from the origin.
+static void sobol_next(SobolSequence *seq, double *unit) {
+    if ((uint32_t)seq->index == UINT32_MAX) {
+        seq->index++;
+        memset(seq->state, 0, sizeof(seq->state));
+        sobol_scramble(seq, seq->seed, seq->substream);
+    }
+    int c = __builtin_ctz(~(uint32_t)seq->index);
+    seq->index++;
+    for (int j = 0; j < seq->dims; j++) {
+        seq->state[j] ^= seq->directions[j][c];
+        unit[j] = (seq->state[j] ^ seq->shift[j]) * 0x1.0p-32;
+    }
+}
+
+// count points in the unit cube of the given dimension, [count][dims]
+static void unit_points(Sampler *sampler, SobolSequence *seq, int dims, int count, double *out) {
+    switch (sampler->method) {
+        case SAMPLE_SOBOL:
+            for (int n = 0; n < count; n++) {
+                sobol_next(seq, out + (size_t)n * dims);
+            }
+            break;
+        case SAMPLE_LATIN_HYPERCUBE:
+            // One point per stratum on every axis, strata shuffled independently per axis
+            for (int j = 0; j < dims; j++) {
+                int *strata = sampler->strata;
+                for (int n = 0; n < count; n++) strata[n] = n;
+                for (int n = count - 1; n > 0; n--) {
+                    int k = (int)rng_next_below(&sampler->rng, (uint64_t)(n + 1));
+                    int tmp = strata[n];
+                    strata[n] = strata[k];
+                    strata[k] = tmp;
+                }
+                for (int n = 0; n < count; n++) {
+                    out[(size_t)n * dims + j] = (strata[n] + rng_next_uniform(&sampler->rng)) / count;
+                }
+            }
+            break;
+        case SAMPLE_UNIFORM:
+        default:
+            rng_fill_uniform(&sampler->rng, sampler->rng.position, out, (size_t)count * dims, 0.0, 1.0);
+            rng_seek(&sampler->rng, sampler->rng.position + (size_t)count * dims);
+            break;
+    }
+}
+
+static double scale(const Domain *domain, int axis, double unit) {
+    return domain->lower[axis] + (domain->upper[axis] - domain->lower[axis]) * unit;
+}
+
+static void fill_interior(Sampler *sampler, double *points, int count) {
+    const Domain *domain = &sampler->domain;
+    int dims = domain->dims;
+    int refined = 0;
+
+    pthread_mutex_lock(&sampler->pool_lock);
+    if (sampler->pool_size > 0) {
+        refined = (int)(sampler->refinement_fraction * count);
+        for (int n = 0; n < refined; n++) {
+            int k = (int)rng_next_below(&sampler->rng, (uint64_t)sampler->pool_size);
+            memcpy(points + (size_t)n * dims, sampler->pool + (size_t)k * dims, dims * sizeof(double));
+        }
+    }
+    pthread_mutex_unlock(&sampler->pool_lock);
+
+    double *fresh = points + (size_t)refined * dims;
+    unit_points(sampler, &sampler->interior_sequence, dims, count - refined, fresh);
+    for (int n = 0; n < count - refined; n++) {
+        for (int j = 0; j < dims; j++) {
+            fresh[(size_t)n * dims + j] = scale(domain, j, fresh[(size_t)n * dims + j]);
+        }
+    }
+}
+
+// Faces are visited round-robin so every x_i = lower/upper face gets the same share
+static void fill_boundary(Sampler *sampler, double *points, int count, double *scratch) {
+    const Domain *domain = &sampler->domain;
+    int dims = domain->dims;
+    int faces = 2 * (dims - 1);
+    unit_points(sampler, &sampler->surface_sequence, dims - 1, count, scratch);
+    for (int n = 0; n < count; n++) {
+        int axis = (n % faces) / 2;
+        int side = n % 2;
+        const double *unit = scratch + (size_t)n * (dims - 1);
+        double *p = points + (size_t)n * dims;
+        for (int j = 0, o = 0; j < dims; j++) {
+            p[j] = (j == axis) ? (side ? domain->upper[j] : domain->lower[j]) : scale(domain, j, unit[o++]);
+        }
+    }
+}
+
+static void fill_initial(Sampler *sampler, double *points, int count, double *scratch) {
+    const Domain *domain = &sampler->domain;
+    int dims = domain->dims;
+    unit_points(sampler, &sampler->surface_sequence, dims - 1, count, scratch);
+    for (int n = 0; n < count; n++) {
+        double *p = points + (size_t)n * dims;
+        for (int j = 0; j + 1 < dims; j++) {
+            p[j] = scale(domain, j, scratch[(size_t)n * (dims - 1) + j]);
+        }
+        p[dims - 1] = domain->lower[dims - 1];
+    }
+}
+
+// Generate a complete interior/boundary/initial batch in place
+void sampler_fill_batch(Sampler *sampler, CollocationBatch *batch) {
+    int dims = sampler->domain.dims;
+    double *boundary = batch->points + (size_t)batch->num_interior * dims;
+    double *initial = boundary + (size_t)batch->num_boundary * dims;
+
+    fill_interior(sampler, batch->points, batch->num_interior);
+    fill_boundary(sampler, boundary, batch->num_boundary, sampler->scratch);
+    fill_initial(sampler, initial, batch->num_initial, sampler->scratch);
+}
+
+// Plain uniform draws over the domain, e.g. candidates for adaptive refinement.
+// Uses its own stream so it can run while the background thread is filling a batch.
+void sampler_uniform_points(Sampler *sampler, double *points, int count) {
+    const Domain *domain = &sampler->domain;
+    for (int n = 0; n < count; n++) {
+        for (int j = 0; j < domain->dims; j++) {
+            points[(size_t)n * domain->dims + j] = scale(domain, j, rng_next_uniform(&sampler->candidate_rng));
+        }
+    }
+}
+
+// Residual-based adaptive distribution (RAR-D): refill the pool by drawing candidates with
+// probability proportional to residual / mean(residual) + 1, so hot spots dominate without
+// starving the rest of the domain.
+void sampler_refine(Sampler *sampler, const double *candidates, const double *residuals, int num_candidates) {
+    int dims = sampler->domain.dims;
+    double *cumulative = malloc((size_t)num_candidates * sizeof(double));
+    if (cumulative == NULL || num_candidates <= 0) {
+        free(cumulative);
+        return;
+    }
+
+    double mean = 0.0;
+    for (int n = 0; n < num_candidates; n++) {
+        mean += residuals[n];
+    }
+    mean = (mean > 0.0) ? mean / num_candidates : 1.0;
+    double total = 0.0;
+    for (int n = 0; n < num_candidates; n++) {
+        total += residuals[n] / mean + 1.0;
+        cumulative[n] = total;
+    }
+
+    pthread_mutex_lock(&sampler->pool_lock);
+    for (int n = 0; n < sampler->pool_capacity; n++) {
+        double target = rng_next_uniform(&sampler->candidate_rng) * total;
+        int lo = 0, hi = num_candidates - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cumulative[mid] < target) lo = mid + 1;
+            else hi = mid;
+        }
+        memcpy(sampler->pool + (size_t)n * dims, candidates + (size_t)lo * dims, dims * sizeof(double));
+    }
+    sampler->pool_size = sampler->pool_capacity;
+    pthread_mutex_unlock(&sampler->pool_lock);
+
+    free(cumulative);
+}
+
+static void *sampler_thread(void *arg) {
+    Sampler *sampler = arg;
+    pthread_mutex_lock(&sampler->lock);
+    for (;;) {
+        while (!sampler->refill_pending && !sampler->stop) {
+            pthread_cond_wait(&sampler->cond, &sampler->lock);
+        }
+        if (sampler->stop) break;
+        CollocationBatch *target = &sampler->buffers[1 - sampler->front];
+        pthread_mutex_unlock(&sampler->lock);
+
+        sampler_fill_batch(sampler, target);
+
+        pthread_mutex_lock(&sampler->lock);
+        sampler->refill_pending = 0;
+        sampler->back_ready = 1;
+        pthread_cond_broadcast(&sampler->cond);
+    }
+    pthread_mutex_unlock(&sampler->lock);
+    return NULL;
+}
+
+int sampler_init(Sampler *sampler, const Domain *domain, SamplingMethod method, int num_interior, int num_boundary, int num_initial, uint64_t seed, int background) {
+    memset(sampler, 0, sizeof(*sampler));
+    if (domain->dims < 2 || domain->dims > SAMPLER_MAX_DIMS || num_interior <= 0 || num_boundary < 0 || num_initial < 0) {
+        fprintf(stderr, "Error: Invalid sampler configuration\n");
+        return 0;
+    }
+
+    int dims = domain->dims;
+    int total = num_interior + num_boundary + num_initial;
+    int largest = num_interior > num_boundary ? num_interior : num_boundary;
+    largest = largest > num_initial ? largest : num_initial;
+    size_t batch_bytes = arena_aligned_size((size_t)total * dims * sizeof(double));
+    size_t pool_bytes = arena_aligned_size((size_t)num_interior * dims * sizeof(double));
+    size_t scratch_bytes = arena_aligned_size((size_t)largest * dims * sizeof(double));
+    size_t strata_bytes = arena_aligned_size((size_t)largest * sizeof(int));
+    if (!arena_init(&sampler->arena, 2 * batch_bytes + pool_bytes + scratch_bytes + strata_bytes)) {
+        fprintf(stderr, "Error: Failed to allocate the sampler batch arena\n");
+        return 0;
+    }
+
+    sampler->domain = *domain;
+    sampler->method = method;
+    sampler->num_interior = num_interior;
+    sampler->num_boundary = num_boundary;
+    sampler->num_initial = num_initial;
+    sampler->seed = seed;
+    rng_init(&sampler->rng, seed, RNG_STREAM_SAMPLING, 0);
+    rng_init(&sampler->candidate_rng, seed, RNG_STREAM_CANDIDATES, 0);
+    sampler->refinement_fraction = 0.5;
+    sampler->pool_capacity = num_interior;
+    sampler->pool = arena_alloc(&sampler->arena, pool_bytes);
+    sampler->scratch = arena_alloc(&sampler->arena, scratch_bytes);
+    sampler->strata = arena_alloc(&sampler->arena, strata_bytes);
+    sobol_init(&sampler->interior_sequence, dims);
+    sobol_init(&sampler->surface_sequence, dims - 1);
+    sobol_scramble(&sampler->interior_sequence, seed, 0);
+    sobol_scramble(&sampler->surface_sequence, seed, 1);
+    for (int b = 0; b < 2; b++) {
+        sampler->buffers[b].points = arena_alloc(&sampler->arena, batch_bytes);
+        sampler->buffers[b].num_interior = num_interior;
+        sampler->buffers[b].num_boundary = num_boundary;
+        sampler->buffers[b].num_initial = num_initial;
+    }
+
+    pthread_mutex_init(&sampler->pool_lock, NULL);
+    pthread_mutex_init(&sampler->lock, NULL);
+    pthread_cond_init(&sampler->cond, NULL);
+    sampler->front = 1;
+    sampler->background = background;
+    if (background) {
+        // The first batch is produced synchronously; the thread keeps one ready from then on
+        sampler_fill_batch(sampler, &sampler->buffers[0]);
+        sampler->back_ready = 1;
+        if (pthread_create(&sampler->thread, NULL, sampler_thread, sampler) != 0) {
+            sampler->background = 0;
+        }
+    }
+    return 1;
+}
+
+// Wait until the background thread is idle so the generators are not mid-update
+static void wait_for_refill(Sampler *sampler) {
+    while (sampler->background && sampler->refill_pending) {
+        pthread_cond_wait(&sampler->cond, &sampler->lock);
+    }
+}
+
+// The snapshot is taken after the prefetched batch, so a resumed run skips that one batch
+void sampler_save_state(Sampler *sampler, SamplerState *state) {
+    pthread_mutex_lock(&sampler->lock);
+    wait_for_refill(sampler);
+    memset(state, 0, sizeof(*state));
+    state->seed = sampler->seed;
+    state->rng_position = sampler->rng.position;
+    state->candidate_position = sampler->candidate_rng.position;
+    state->interior_index = sampler->interior_sequence.index;
+    state->surface_index = sampler->surface_sequence.index;
+    memcpy(state->interior_state, sampler->interior_sequence.state, sizeof(state->interior_state));
+    memcpy(state->surface_state, sampler->surface_sequence.state, sizeof(state->surface_state));
+    state->pool_size = (uint32_t)sampler->pool_size;
+    pthread_mutex_unlock(&sampler->lock);
+}
+
+// Rewind the generators and the refinement pool to a saved snapshot and refill the
+// prefetched batch from them
+void sampler_restore_state(Sampler *sampler, const SamplerState *state, const double *pool) {
+    pthread_mutex_lock(&sampler->lock);
+    wait_for_refill(sampler);
+    sampler->seed = state->seed;
+    rng_init(&sampler->rng, state->seed, RNG_STREAM_SAMPLING, 0);
+    rng_init(&sampler->candidate_rng, state->seed, RNG_STREAM_CANDIDATES, 0);
+    rng_seek(&sampler->rng, state->rng_position);
+    rng_seek(&sampler->candidate_rng, state->candidate_position);
+    sampler->interior_sequence.index = state->interior_index;
+    sampler->surface_sequence.index = state->surface_index;
+    sobol_scramble(&sampler->interior_sequence, state->seed, 0);
+    sobol_scramble(&sampler->surface_sequence, state->seed, 1);
+    memcpy(sampler->interior_sequence.state, state->interior_state, sizeof(state->interior_state));
+    memcpy(sampler->surface_sequence.state, state->surface_state, sizeof(state->surface_state));
+    pthread_mutex_lock(&sampler->pool_lock);
+    sampler->pool_size = pool && (int)state->pool_size <= sampler->pool_capacity ? (int)state->pool_size : 0;
+    memcpy(sampler->pool, pool ? pool : sampler->pool, (size_t)sampler->pool_size * sampler->domain.dims * sizeof(double));
+    pthread_mutex_unlock(&sampler->pool_lock);
+    if (sampler->background) {
+        sampler_fill_batch(sampler, &sampler->buffers[1 - sampler->front]);
+        sampler->back_ready = 1;
+    }
+    pthread_mutex_unlock(&sampler->lock);
+}
+
+void sampler_free(Sampler *sampler) {
+    if (sampler->background) {
+        pthread_mutex_lock(&sampler->lock);
+        sampler->stop = 1;
+        pthread_cond_broadcast(&sampler->cond);
+        pthread_mutex_unlock(&sampler->lock);
+        pthread_join(sampler->thread, NULL);
+    }
+    if (sampler->arena.base) {
+        pthread_mutex_destroy(&sampler->pool_lock);
+        pthread_mutex_destroy(&sampler->lock);
+        pthread_cond_destroy(&sampler->cond);
+    }
+    arena_free(&sampler->arena);
+    memset(sampler, 0, sizeof(*sampler));
+}
+
+// Hand out the next batch; it stays valid until the following call
+const CollocationBatch *sampler_next_batch(Sampler *sampler) {
+    if (!sampler->background) {
+        sampler->front = 1 - sampler->front;
+        sampler_fill_batch(sampler, &sampler->buffers[sampler->front]);
+        return &sampler->buffers[sampler->front];
+    }
+
+    pthread_mutex_lock(&sampler->lock);
+    while (!sampler->back_ready) {
+        pthread_cond_wait(&sampler->cond, &sampler->lock);
+    }
+    sampler->front = 1 - sampler->front;
+    sampler->back_ready = 0;
+    sampler->refill_pending = 1;
+    pthread_cond_signal(&sampler->cond);
+    pthread_mutex_unlock(&sampler->lock);
+    return &sampler->buffers[sampler->front];
+}
@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    ThreadPool *pool;
+    int worker;
+} WorkerArgs;
+
+static void *worker_main(void *arg) {
+    WorkerArgs args = *(WorkerArgs *)arg;
+    ThreadPool *pool = args.pool;
+    unsigned long seen = 0;
+    free(arg);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) break;
+        seen = pool->generation;
+        ThreadTask task = pool->task;
+        void *context = pool->context;
+        pthread_mutex_unlock(&pool->lock);
+
+        task(context, args.worker, pool->num_threads);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// The cores this process may run on, so a pinned rank counts only its own
+int available_cores(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0) {
+        return CPU_COUNT(&allowed);
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// Spawn num_threads - 1 workers; returns 1 on success, 0 on failure
+int thread_pool_init(ThreadPool *pool, int num_threads) {
+    memset(pool, 0, sizeof(*pool));
+    pool->num_threads = num_threads > 0 ? num_threads : 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    if (pool->num_threads == 1) {
+        return 1;
+    }
+
+    pool->threads = calloc(pool->num_threads - 1, sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        pool->num_threads = 1;
+        return 0;
+    }
+    for (int w = 1; w < pool->num_threads; w++) {
+        WorkerArgs *args = malloc(sizeof(*args));
+        if (args == NULL) {
+            pool->num_threads = w;
+            return 0;
+        }
+        args->pool = pool;
+        args->worker = w;
+        if (pthread_create(&pool->threads[w - 1], NULL, worker_main, args) != 0) {
+            free(args);
+            pool->num_threads = w;
+            fprintf(stderr, "Error: Could only start %d worker threads\n", w);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Run task on every worker and return once all of them have finished
+void thread_pool_run(ThreadPool *pool, ThreadTask task, void *context) {
+    if (pool->num_threads == 1) {
+        task(context, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    task(context, 0, pool->num_threads);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_free(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int w = 1; w < pool->num_threads; w++) {
+        pthread_join(pool->threads[w - 1], NULL);
+    }
+    free(pool->threads);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    memset(pool, 0, sizeof(*pool));
+}
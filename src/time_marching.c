@@ -0,0 +1,423 @@
+#include "time_marching.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "profile.h"
+
+// Validation reports the plain sum of the term means, with every slice weighted alike
+static const double unit_weights[TERM_COUNT] = {1.0, 1.0, 1.0, 1.0};
+
+// Loss sums of a window sweep: the causally weighted terms (indexed by LossTerm) and the
+// plain residual sum of every slice, laid out as the sums of a DataParallel sweep
+typedef struct {
+    double terms[TERM_COUNT];
+    double slices[CAUSAL_MAX_SLICES];
+} WindowSums;
+
+#define WINDOW_SUMS (TERM_COUNT + CAUSAL_MAX_SLICES)
+
+// A batch of the current window: the interior points sorted by time slice (slice i owns
+// points [slice_begin[i], slice_begin[i + 1])), then the boundary and initial points as the
+// sampler drew them, and the targets of the initial points
+typedef struct {
+    CollocationBatch points;
+    int slice_begin[CAUSAL_MAX_SLICES + 1];
+    double *initial_targets;            // [num_initial][values..., d/dt...]
+} WindowBatch;
+
+// Trainer of the current window: the data-parallel engine of training.c, the arena holding
+// the window batches, and the job of the current sweep after arena
+typedef struct {
+    const TimeMarchingConfig *config;
+    const PdeOperator *op;
+    const LossParameters *params;
+    ActivationFunction activation;
+    int dims;
+    DataParallel dp;
+    Arena arena;
+
+    const WindowBatch *batch;
+    const double *weights;              // Term weights (TERM_COUNT)
+    const double *slice_weights;        // Causal weights (config->slices)
+} TimeMarching;
+
+void default_time_marching_config(TimeMarchingConfig *config) {
+    config->num_windows = 1;
+    config->tolerance = 1e-3;
+    config->patience = 10;
+    config->slices = 16;
+    config->epsilon = 1.0;
+}
+
+void causal_weights(const double *slice_losses, int slices, double epsilon, double *weights) {
+    double cumulative = 0.0;
+    for (int i = 0; i < slices; i++) {
+        weights[i] = exp(-epsilon * cumulative);
+        cumulative += slice_losses[i];
+    }
+}
+
+void window_initial_targets(const NeuralNetwork *previous, JetWorkspace *ws, const PdeOperator *op, const LossParameters *params, ActivationFunction activation,
+                            const double *points, int count, double *targets) {
+    int input_dim = ws->input_dim, outputs = op->num_outputs;
+    int time = input_dim - 1;
+    if (previous == NULL) {
+        for (int p = 0; p < count; p++) {
+            double reference[PDE_MAX_OUTPUTS];
+            double *target = targets + (size_t)p * 2 * outputs;
+            op->reference(points + (size_t)p * input_dim, input_dim, params, reference);
+            for (int k = 0; k < outputs; k++) {
+                target[k] = reference[k];
+                target[outputs + k] = 0.0;
+            }
+        }
+        return;
+    }
+    for (int start = 0; start < count; start += ws->capacity) {
+        int chunk = count - start < ws->capacity ? count - start : ws->capacity;
+        JetBatch jets;
+        forward_pass_jet(previous, ws, points + (size_t)start * input_dim, chunk, activation);
+        jet_output_batch(previous, ws, 0, &jets);
+        for (int p = 0; p < chunk; p++) {
+            PointDerivatives pd;
+            double *target = targets + (size_t)(start + p) * 2 * outputs;
+            jet_batch_point(&jets, p, &pd);
+            for (int k = 0; k < outputs; k++) {
+                target[k] = pd_value(&pd, k);
+                target[outputs + k] = pd_first(&pd, time, k);
+            }
+        }
+    }
+}
+
+// Loss terms of the output jets of batch points [start, start + count). As in
+// composite_loss_terms every term accumulates its adjoint weighted by its term weight over
+// the size of its group in the whole batch; a slice's residual is also scaled by its causal
+// weight. Initial points are pulled towards the targets of the batch instead of the reference.
+static void window_loss_terms(const TimeMarching *tm, const JetBatch *jets, int start, int count, WindowSums *sums) {
+    PROFILE_SCOPE(PROF_LOSS);
+    const WindowBatch *wb = tm->batch;
+    const CollocationBatch *batch = &wb->points;
+    const PdeOperator *op = tm->op;
+    const double *weights = tm->weights;
+    int input_dim = jets->input_dim, outputs = op->num_outputs;
+    int end = start + count;
+
+    for (int i = 0; i < tm->config->slices; i++) {
+        int a = wb->slice_begin[i] > start ? wb->slice_begin[i] : start;
+        int b = wb->slice_begin[i + 1] < end ? wb->slice_begin[i + 1] : end;
+        if (a >= b) continue;
+        double causal = tm->slice_weights[i];
+        double sum = op->residual(jets, a - start, b - start, tm->params, weights[TERM_RESIDUAL] * causal / batch->num_interior, NULL);
+        sums->slices[i] += sum;
+        sums->terms[TERM_RESIDUAL] += causal * sum;
+    }
+    int interior = batch->num_interior - start;
+    interior = interior < 0 ? 0 : (interior > count ? count : interior);
+    if (op->conservation) {
+        sums->terms[TERM_CONSERVATION] += op->conservation(jets, 0, interior, tm->params, weights[TERM_CONSERVATION] / batch->num_interior, NULL);
+    }
+
+    int initial_begin = batch->num_interior + batch->num_boundary;
+    for (int s = interior; s < count; s++) {
+        int index = start + s;
+        PointDerivatives pd;
+        PointAdjoint adjoint;
+        PointAdjoint *adj = jets->adjoints ? &adjoint : NULL;
+        int is_boundary = index < initial_begin;
+        int group_size = is_boundary ? batch->num_boundary : batch->num_initial;
+        double weight = is_boundary ? weights[TERM_BOUNDARY] : weights[TERM_INITIAL];
+
+        jet_batch_point(jets, s, &pd);
+        if (adj) jet_batch_adjoint(jets, s, weight / group_size, adj);
+        if (is_boundary) {
+            double reference[PDE_MAX_OUTPUTS];
+            op->reference(batch->points + (size_t)index * input_dim, input_dim, tm->params, reference);
+            sums->terms[TERM_BOUNDARY] += dirichlet_residual_loss(&pd, reference, outputs, adj);
+        } else {
+            const double *target = wb->initial_targets + (size_t)(index - initial_begin) * 2 * outputs;
+            double term = dirichlet_residual_loss(&pd, target, outputs, adj);
+            if (op->second_order_in_time) {
+                term += initial_velocity_residual_loss(&pd, target + outputs, outputs, adj);
+            }
+            sums->terms[TERM_INITIAL] += term;
+        }
+    }
+}
+
+static void window_loss_sweep(void *context, const NeuralNetwork *nn, JetWorkspace *ws, int begin, int end, double *gradients, double *sums) {
+    const TimeMarching *tm = context;
+    const CollocationBatch *batch = &tm->batch->points;
+    for (int start = begin; start < end; start += ws->capacity) {
+        int chunk = end - start < ws->capacity ? end - start : ws->capacity;
+        JetBatch jets;
+        forward_pass_jet(nn, ws, batch->points + (size_t)start * tm->dims, chunk, tm->activation);
+        if (gradients) clear_jet_adjoints(nn, ws, chunk);
+        jet_output_batch(nn, ws, gradients != NULL, &jets);
+        window_loss_terms(tm, &jets, start, chunk, (WindowSums *)sums);
+        if (gradients) backward_pass_jet(nn, ws, chunk, tm->activation, gradients);
+    }
+}
+
+// Weighted loss of a window batch; gradients non-NULL receives its parameter gradient.
+// sums receives the term sums of the whole batch and the plain residual sum of every slice.
+static double window_loss(TimeMarching *tm, const NeuralNetwork *nn, const WindowBatch *batch, const double *weights, const double *slice_weights, double *gradients, WindowSums *sums) {
+    tm->batch = batch;
+    tm->weights = weights;
+    tm->slice_weights = slice_weights;
+    data_parallel_sweep(&tm->dp, nn, window_loss_sweep, tm, 0, collocation_batch_size(&batch->points), gradients, (double *)sums);
+    return combine_loss_terms(sums->terms, &batch->points, weights, NULL);
+}
+
+static int slice_of(const Domain *window, int slices, const double *x) {
+    int time = window->dims - 1;
+    double width = window->upper[time] - window->lower[time];
+    int i = (int)((x[time] - window->lower[time]) / width * slices);
+    return i < 0 ? 0 : (i >= slices ? slices - 1 : i);
+}
+
+// Copy a sampler batch into wb with its interior points counting-sorted by time slice, and
+// work out the targets of its initial points from the previous window's network
+static void load_window_batch(TimeMarching *tm, const NeuralNetwork *previous, const Domain *window, const CollocationBatch *raw, WindowBatch *wb) {
+    int dims = tm->dims, slices = tm->config->slices;
+    size_t row = dims * sizeof(double);
+    int counts[CAUSAL_MAX_SLICES] = {0};
+    for (int n = 0; n < raw->num_interior; n++) {
+        counts[slice_of(window, slices, raw->points + (size_t)n * dims)]++;
+    }
+    int cursor[CAUSAL_MAX_SLICES];
+    wb->slice_begin[0] = 0;
+    for (int i = 0; i < slices; i++) {
+        cursor[i] = wb->slice_begin[i];
+        wb->slice_begin[i + 1] = wb->slice_begin[i] + counts[i];
+    }
+    for (int n = 0; n < raw->num_interior; n++) {
+        const double *x = raw->points + (size_t)n * dims;
+        memcpy(wb->points.points + (size_t)cursor[slice_of(window, slices, x)]++ * dims, x, row);
+    }
+    int surface = raw->num_boundary + raw->num_initial;
+    memcpy(wb->points.points + (size_t)raw->num_interior * dims, raw->points + (size_t)raw->num_interior * dims, surface * row);
+    wb->points.num_interior = raw->num_interior;
+    wb->points.num_boundary = raw->num_boundary;
+    wb->points.num_initial = raw->num_initial;
+
+    const double *initial = wb->points.points + (size_t)(raw->num_interior + raw->num_boundary) * dims;
+    window_initial_targets(previous, &tm->dp.workspaces[0], tm->op, tm->params, tm->activation, initial, raw->num_initial, wb->initial_targets);
+}
+
+// Room for a sampler batch of the given sizes
+static void alloc_window_batch(Arena *arena, WindowBatch *wb, int points, int initial, int dims, int outputs) {
+    memset(wb, 0, sizeof(*wb));
+    wb->points.points = arena_alloc(arena, (size_t)points * dims * sizeof(double));
+    wb->initial_targets = arena_alloc(arena, (size_t)(initial > 0 ? initial : 1) * 2 * outputs * sizeof(double));
+}
+
+static size_t window_batch_bytes(int points, int initial, int dims, int outputs) {
+    return arena_aligned_size((size_t)points * dims * sizeof(double)) + arena_aligned_size((size_t)(initial > 0 ? initial : 1) * 2 * outputs * sizeof(double));
+}
+
+static void free_time_marching(TimeMarching *tm) {
+    free_data_parallel(&tm->dp);
+    arena_free(&tm->arena);
+}
+
+// Workers, tapes and the two window batches. The samplers are opened per window, but
+// their batch sizes never change.
+static int init_time_marching(TimeMarching *tm, const NeuralNetwork *nn, int max_points, size_t batch_bytes, int num_workers) {
+    if (!arena_init(&tm->arena, batch_bytes)) {
+        fprintf(stderr, "Error: Failed to allocate the time-marching buffers\n");
+        return 0;
+    }
+    return init_data_parallel(&tm->dp, nn, num_workers, max_points, WINDOW_SUMS, tm->op->derivative_order, PRECISION_FP64);
+}
+
+static int same_layout(const NeuralNetwork *a, const NeuralNetwork *b) {
+    if (a->num_layers != b->num_layers || a->num_parameters != b->num_parameters) return 0;
+    for (int l = 0; l < a->num_layers; l++) {
+        if (a->layer_sizes[l] != b->layer_sizes[l]) return 0;
+    }
+    return 1;
+}
+
+int train_time_marching(NeuralNetwork *nets, const TimeMarchingConfig *marching, const char *loss_type, const LossParameters *params, const TrainingConfig *config) {
+    int input_size = nn_input_size(&nets[0]);
+    const PdeOperator *op = find_pde_operator(loss_type);
+    if (op == NULL) {
+        fprintf(stderr, "Unknown loss type: %s\n", loss_type);
+        return 0;
+    }
+    if (nn_output_size(&nets[0]) < op->num_outputs || input_size < op->min_inputs || input_size > op->max_inputs) {
+        fprintf(stderr, "Error: A network with %d inputs and %d outputs does not fit %s\n", input_size, nn_output_size(&nets[0]), loss_type);
+        return 0;
+    }
+    if (nn_parametric(&nets[0])) {
+        fprintf(stderr, "Error: Time marching does not support parameter inputs\n");
+        return 0;
+    }
+    if (marching->num_windows < 1 || marching->num_windows > TIME_MARCHING_MAX_WINDOWS || marching->slices < 1 || marching->slices > CAUSAL_MAX_SLICES ||
+        marching->patience < 1 || marching->epsilon < 0.0) {
+        fprintf(stderr, "Error: Time marching takes 1 to %d windows, 1 to %d causal slices, a patience of at least 1 and a non-negative epsilon\n",
+                TIME_MARCHING_MAX_WINDOWS, CAUSAL_MAX_SLICES);
+        return 0;
+    }
+    for (int k = 1; k < marching->num_windows; k++) {
+        if (!same_layout(&nets[k], &nets[0])) {
+            fprintf(stderr, "Error: The network of window %d differs from the first one\n", k);
+            return 0;
+        }
+    }
+    if (config->epochs < marching->num_windows) {
+        fprintf(stderr, "Error: %d epochs cannot cover %d windows\n", config->epochs, marching->num_windows);
+        return 0;
+    }
+    if (config->optimizer.type == OPTIMIZER_LBFGS || config->lbfgs_epochs > 0) {
+        fprintf(stderr, "Error: Time-marching runs train with first-order optimizers only (no L-BFGS)\n");
+        return 0;
+    }
+    Domain domain = config->domain;
+    if (domain.dims == 0) {
+        unit_domain(&domain, input_size);
+    }
+    if (input_size < 2 || domain.dims != input_size) {
+        fprintf(stderr, "Error: The domain has %d axes but the network takes %d inputs (space..., time)\n", domain.dims, input_size);
+        return 0;
+    }
+    if (config->precision != PRECISION_FP64 || config->loss_weighting.method != WEIGHTING_FIXED || config->refine_every > 0 || config->checkpoint_every > 0) {
+        fprintf(stderr, "Error: Time-marching runs train in fp64 with fixed term weights (no --precision, --loss_weighting, --refine_every or --checkpoint_every)\n");
+        return 0;
+    }
+
+    profile_reset();
+    TimeMarching tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.config = marching;
+    tm.op = op;
+    tm.params = params;
+    tm.activation = config->activation;
+    tm.dims = domain.dims;
+    double weights[TERM_COUNT];
+    int active_terms[TERM_COUNT] = {1, config->boundary_points > 0, config->initial_points > 0, op->conservation != NULL};
+    for (int i = 0; i < TERM_COUNT; i++) {
+        weights[i] = active_terms[i] ? config->loss_weighting.weights[i] : 0.0;
+    }
+    double unit_slices[CAUSAL_MAX_SLICES];
+    for (int i = 0; i < CAUSAL_MAX_SLICES; i++) {
+        unit_slices[i] = 1.0;
+    }
+
+    int dims = domain.dims, time = dims - 1, outputs = op->num_outputs;
+    int validation_boundary = config->boundary_points > 0 ? config->validation_points / 4 : 0;
+    int validation_initial = config->initial_points > 0 ? config->validation_points / 4 : 0;
+    int batch_points = config->interior_points + config->boundary_points + config->initial_points;
+    int validation_points = config->validation_points + validation_boundary + validation_initial;
+    size_t batch_bytes = window_batch_bytes(batch_points, config->initial_points, dims, outputs) +
+                         window_batch_bytes(validation_points, validation_initial, dims, outputs);
+
+    Sampler sampler = {0};
+    Sampler validation_sampler = {0};
+    Optimizer optimizer = {0};
+    TrainingLogger logger = {0};
+    int trained = 0;
+    int num_workers = config->threads > 0 ? config->threads : available_cores();
+    if (!init_time_marching(&tm, &nets[0], batch_points > validation_points ? batch_points : validation_points, batch_bytes, num_workers) ||
+        !optimizer_init(&optimizer, &config->optimizer, nets[0].num_parameters) ||
+        !logger_open(&logger, loss_type, config->log_format, config->log_every)) {
+        goto cleanup;
+    }
+    WindowBatch train, validation;
+    alloc_window_batch(&tm.arena, &train, batch_points, config->initial_points, dims, outputs);
+    alloc_window_batch(&tm.arena, &validation, validation_points, validation_initial, dims, outputs);
+    printf("Time marching over t in [%g, %g]: %d window(s) of %d causal slice(s), %d epochs in all, on %d thread(s); logs to %s\n", domain.lower[time],
+           domain.upper[time], marching->num_windows, marching->slices, config->epochs, num_workers, logger.path);
+
+    int epoch = 0;
+    for (int k = 0; k < marching->num_windows; k++) {
+        NeuralNetwork *nn = &nets[k];
+        const NeuralNetwork *previous = k > 0 ? &nets[k - 1] : NULL;
+        Domain window = domain;
+        double span = domain.upper[time] - domain.lower[time];
+        window.lower[time] = domain.lower[time] + span * k / marching->num_windows;
+        window.upper[time] = k + 1 == marching->num_windows ? domain.upper[time] : domain.lower[time] + span * (k + 1) / marching->num_windows;
+
+        // Warm start; the optimizer forgets the moments of the previous window's objective
+        if (previous) {
+            memcpy(nn->parameters, previous->parameters, nn->num_parameters * sizeof(double));
+        }
+        optimizer_reset(&optimizer);
+        if (!sampler_init(&sampler, &window, config->sampling, config->interior_points, config->boundary_points, config->initial_points, config->seed + (uint64_t)k, 1) ||
+            !sampler_init(&validation_sampler, &window, SAMPLE_SOBOL, config->validation_points, validation_boundary, validation_initial, 0xC0FFEEULL, 0)) {
+            goto cleanup;
+        }
+        load_window_batch(&tm, previous, &window, sampler_next_batch(&validation_sampler), &validation);
+
+        // An even share of the epochs left, so that early convergence hands epochs on
+        int remaining = config->epochs - epoch;
+        int budget = k + 1 == marching->num_windows ? remaining : remaining / (marching->num_windows - k);
+        LearningRateSchedule schedule = config->schedule;
+        schedule.base_rate = config->learning_rate;
+        schedule.total_epochs = budget;
+
+        double slice_weights[CAUSAL_MAX_SLICES];
+        memcpy(slice_weights, unit_slices, sizeof(slice_weights));
+        double loss = NAN, residual = NAN, initial = NAN, validation_loss = NAN;
+        int streak = 0, n = 0;
+        while (n < budget && streak < marching->patience) {
+            PROFILE_BEGIN(epoch_start);
+            PROFILE_BEGIN(sampler_start);
+            const CollocationBatch *raw = sampler_next_batch(&sampler);
+            PROFILE_END(PROF_SAMPLER, sampler_start);
+            load_window_batch(&tm, previous, &window, raw, &train);
+
+            WindowSums sums;
+            loss = window_loss(&tm, nn, &train, weights, slice_weights, nn->gradients, &sums);
+            PROFILE_BEGIN(optimizer_start);
+            double next_loss = loss;
+            double learning_rate = schedule_learning_rate(&schedule, n);
+            optimizer_step(&optimizer, nn->parameters, nn->gradients, &next_loss, learning_rate, NULL, NULL);
+            PROFILE_END(PROF_OPTIMIZER, optimizer_start);
+
+            // The next epoch weighs its slices by the residuals of this one
+            double slice_means[CAUSAL_MAX_SLICES], plain = 0.0;
+            for (int i = 0; i < marching->slices; i++) {
+                int count = train.slice_begin[i + 1] - train.slice_begin[i];
+                slice_means[i] = count > 0 ? sums.slices[i] / count : 0.0;
+                plain += sums.slices[i];
+            }
+            causal_weights(slice_means, marching->slices, marching->epsilon, slice_weights);
+            residual = train.points.num_interior > 0 ? plain / train.points.num_interior : 0.0;
+            initial = train.points.num_initial > 0 ? sums.terms[TERM_INITIAL] / train.points.num_initial : 0.0;
+            streak = residual < marching->tolerance && initial < marching->tolerance ? streak + 1 : 0;
+            n++;
+
+            // Validation is synchronous and only runs for the epochs that are logged
+            if (logger_wants_epoch(&logger, epoch, config->epochs) || n == budget || streak == marching->patience) {
+                PROFILE_BEGIN(validation_start);
+                WindowSums validation_sums;
+                validation_loss = window_loss(&tm, nn, &validation, unit_weights, unit_slices, NULL, &validation_sums);
+                PROFILE_END(PROF_VALIDATION, validation_start);
+                PROFILE_BEGIN(log_start);
+                logger_record(&logger, epoch, loss, validation_loss, epoch, learning_rate);
+                PROFILE_END(PROF_LOG, log_start);
+            }
+            epoch++;
+            PROFILE_END(PROF_EPOCH, epoch_start);
+        }
+        sampler_free(&sampler);
+        sampler_free(&validation_sampler);
+        printf("Window %d, t in [%g, %g]: %s after %d epoch(s), residual %.3e, initial %.3e, loss %.5f, validation loss %.5f\n", k, window.lower[time],
+               window.upper[time], streak == marching->patience ? "converged" : "budget spent", n, residual, initial, loss, validation_loss);
+    }
+    printf("Time marching used %d of %d epochs\n", epoch, config->epochs);
+    trained = 1;
+
+cleanup:
+    logger_close(&logger);
+    sampler_free(&sampler);
+    sampler_free(&validation_sampler);
+    optimizer_free(&optimizer);
+    free_time_marching(&tm);
+    logger_write_profile(&logger, config->profile_trace);
+    return trained;
+}
@@ -0,0 +1,929 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "training.h"
+#include "autodiff.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include "checkpoint.h"
+#include "pde.h"
+#include "optimizer.h"
+#include "loss_balance.h"
+#include "validation.h"
+#include "profile.h"
+
+// Points per forward/backward sweep inside a shard. Bounds each worker's tape
+// independently of the batch size and keeps a layer's jets close to L2.
+#define SHARD_CHUNK 1024
+
+// Across ranks the term sums take the first cache line of every allreduce message, so the
+// gradients behind them stay aligned
+#define MESSAGE_HEADER (ARENA_ALIGNMENT / sizeof(double))
+
+// The physics trainer around the data-parallel engine. The fields after message describe
+// the job of the current sweep.
+typedef struct {
+    DataParallel dp;
+    Communicator *comm;                 // Other ranks sharing the batch, or NULL
+    Arena arena;
+    double *message;                    // Term sums, then gradients, as one allreduce
+
+    const NeuralNetwork *nn;
+    const PdeOperator *op;
+    const LossParameters *params;
+    ActivationFunction activation;
+    const CollocationBatch *batch;
+    const double *weights;              // Term weights (TERM_COUNT)
+    const double *points;               // Residual scoring job
+    double *residuals;
+} Trainer;
+
+// Contiguous slice [begin, end) of total items for one worker
+static void shard_range(int total, int worker, int num_workers, int *begin, int *end) {
+    *begin = (int)((long long)total * worker / num_workers);
+    *end = (int)((long long)total * (worker + 1) / num_workers);
+}
+
+// Composite-loss terms of the output jets of batch points [start, start + count), added
+// to sums (indexed by LossTerm). Interior points come first in the batch, so they form a
+// prefix of the range. With jets->adjoints set, every term of a point accumulates its
+// adjoint weighted by its term weight / (size of its group in the whole batch), so the
+// gradients of separate ranges simply add up to the gradient of the full weighted loss.
+// With parameter inputs each point row carries its own equation parameters after the
+// coordinates, so the residuals run one point at a time.
+static void loss_terms(const JetBatch *jets, const CollocationBatch *batch, int start, int count, const PdeOperator *op, const LossParameters *params, const ParameterInputs *inputs, const double *weights, double *sums) {
+    PROFILE_SCOPE(PROF_LOSS);
+    int input_dim = jets->input_dim;
+    int stride = input_dim + (inputs ? inputs->count : 0);
+    int outputs = op->num_outputs;
+    double zero_velocity[PDE_MAX_OUTPUTS] = {0.0};
+    LossParameters point_params = *params;
+
+    int interior = batch->num_interior - start;
+    interior = interior < 0 ? 0 : (interior > count ? count : interior);
+    double residual_weight = weights[TERM_RESIDUAL] / batch->num_interior;
+    double conservation_weight = weights[TERM_CONSERVATION] / batch->num_interior;
+    if (inputs == NULL) {
+        sums[TERM_RESIDUAL] += op->residual(jets, 0, interior, params, residual_weight, NULL);
+        if (op->conservation) {
+            sums[TERM_CONSERVATION] += op->conservation(jets, 0, interior, params, conservation_weight, NULL);
+        }
+    } else {
+        for (int s = 0; s < interior; s++) {
+            point_loss_parameters(inputs, params, batch->points + (size_t)(start + s) * stride + input_dim, &point_params);
+            sums[TERM_RESIDUAL] += op->residual(jets, s, s + 1, &point_params, residual_weight, NULL);
+            if (op->conservation) {
+                sums[TERM_CONSERVATION] += op->conservation(jets, s, s + 1, &point_params, conservation_weight, NULL);
+            }
+        }
+    }
+
+    for (int s = interior; s < count; s++) {
+        int index = start + s;
+        PointDerivatives pd;
+        PointAdjoint adjoint;
+        PointAdjoint *adj = jets->adjoints ? &adjoint : NULL;
+        const double *x = batch->points + (size_t)index * stride;
+        double reference[PDE_MAX_OUTPUTS];
+        int is_boundary = index < batch->num_interior + batch->num_boundary;
+        int group_size = is_boundary ? batch->num_boundary : batch->num_initial;
+        double weight = is_boundary ? weights[TERM_BOUNDARY] : weights[TERM_INITIAL];
+
+        if (inputs) {
+            point_loss_parameters(inputs, params, x + input_dim, &point_params);
+        }
+        jet_batch_point(jets, s, &pd);
+        if (adj) jet_batch_adjoint(jets, s, weight / group_size, adj);
+        op->reference(x, input_dim, &point_params, reference);
+        double term = dirichlet_residual_loss(&pd, reference, outputs, adj);
+        if (!is_boundary && op->second_order_in_time) {
+            term += initial_velocity_residual_loss(&pd, zero_velocity, outputs, adj);
+        }
+        sums[is_boundary ? TERM_BOUNDARY : TERM_INITIAL] += term;
+    }
+}
+
+void composite_loss_terms(const JetBatch *jets, const CollocationBatch *batch, int start, int count, const PdeOperator *op, const LossParameters *params, const double *weights, double *sums) {
+    loss_terms(jets, batch, start, count, op, params, NULL, weights, sums);
+}
+
+// The parameter inputs of nn, or NULL when every input is a coordinate
+static const ParameterInputs *parameter_inputs(const NeuralNetwork *nn) {
+    return nn_parametric(nn) ? &nn->parameter_inputs : NULL;
+}
+
+// Composite-loss terms of batch points [begin, end), swept through the tape SHARD_CHUNK
+// points at a time with every term of a point fused into the same sweep
+static void composite_loss_range(const NeuralNetwork *nn, JetWorkspace *ws, const CollocationBatch *batch, int begin, int end, const PdeOperator *op, const LossParameters *params, const double *weights, ActivationFunction activation_func_type, double *gradients, double *sums) {
+    int input_dim = nn_input_size(nn);
+    for (int start = begin; start < end; start += ws->capacity) {
+        int chunk = (end - start < ws->capacity) ? end - start : ws->capacity;
+        JetBatch jets;
+        forward_pass_jet(nn, ws, batch->points + (size_t)start * input_dim, chunk, activation_func_type);
+        if (gradients) {
+            clear_jet_adjoints(nn, ws, chunk);
+        }
+        jet_output_batch(nn, ws, gradients != NULL, &jets);
+        loss_terms(&jets, batch, start, chunk, op, params, parameter_inputs(nn), weights, sums);
+        if (gradients) {
+            backward_pass_jet(nn, ws, chunk, activation_func_type, gradients);
+        }
+    }
+}
+
+static void composite_loss_sweep(void *context, const NeuralNetwork *nn, JetWorkspace *ws, int begin, int end, double *gradients, double *sums) {
+    const Trainer *trainer = context;
+    composite_loss_range(nn, ws, trainer->batch, begin, end, trainer->op, trainer->params, trainer->weights, trainer->activation, gradients, sums);
+}
+
+// Zero one worker's gradients: the layers in full, the tables only in the rows it wrote last
+static void clear_gradients(DataParallel *dp, int worker) {
+    const NeuralNetwork *nn = dp->nn;
+    double *gradients = dp->gradients[worker];
+    if (dp->touched == NULL) {
+        memset(gradients, 0, nn->num_parameters * sizeof(double));
+        return;
+    }
+    memset(gradients, 0, nn->encoding_offset * sizeof(double));
+    RowSet *set = &dp->touched[worker];
+    int width = nn->encoding.config.features;
+    double *tables = gradients + nn->encoding_offset;
+    for (int b = 0; b < set->num_buckets; b++) {
+        const uint32_t *list = set->rows + b * set->bucket_size;
+        for (size_t i = 0; i < set->counts[b]; i++) {
+            memset(tables + (size_t)list[i] * width, 0, width * sizeof(double));
+            set->marks[list[i]] = 0;
+        }
+        set->counts[b] = 0;
+    }
+}
+
+static void sweep_task(void *context, int worker, int num_workers) {
+    DataParallel *dp = context;
+    int begin, end;
+    double *gradients = dp->output_gradients ? dp->gradients[worker] : NULL;
+    shard_range(dp->range_end - dp->range_begin, worker, num_workers, &begin, &end);
+
+    memset(dp->sums[worker], 0, dp->sum_width * sizeof(double));
+    if (gradients) {
+        clear_gradients(dp, worker);
+    }
+    dp->sweep(dp->context, dp->nn, &dp->workspaces[worker], dp->range_begin + begin, dp->range_begin + end, gradients, dp->sums[worker]);
+}
+
+// Pairwise tree reduction of the worker buffers over one cache-line-aligned slice of the
+// parameters. The pairing depends only on the worker count, so the summation order, and
+// therefore every bit of the result, is fixed for a given --threads.
+// The same tree over the hash-grid tables, row by row: worker b merges bucket b of every
+// worker's rows into worker 0's, so it alone touches those rows and their marks, and then
+// writes them to the output
+static void reduce_table_rows(DataParallel *dp, int bucket, int num_workers) {
+    const NeuralNetwork *nn = dp->nn;
+    int width = nn->encoding.config.features;
+    size_t offset = nn->encoding_offset;
+    for (int stride = 1; stride < num_workers; stride *= 2) {
+        for (int w = 0; w + stride < num_workers; w += 2 * stride) {
+            RowSet *dst_rows = &dp->touched[w];
+            const RowSet *src_rows = &dp->touched[w + stride];
+            double *dst = dp->gradients[w] + offset;
+            const double *src = dp->gradients[w + stride] + offset;
+            const uint32_t *list = src_rows->rows + bucket * src_rows->bucket_size;
+            for (size_t i = 0; i < src_rows->counts[bucket]; i++) {
+                size_t row = list[i];
+                row_set_add(dst_rows, row);
+                for (int j = 0; j < width; j++) {
+                    dst[row * width + j] += src[row * width + j];
+                }
+            }
+        }
+    }
+
+    const RowSet *rows = &dp->touched[0];
+    const double *sum = dp->gradients[0] + offset;
+    double *out = dp->output_gradients + offset;
+    if (!dp->sparse_output) {
+        // The last bucket also clears the padding behind the tables
+        size_t total = nn->encoding.num_parameters;
+        size_t begin = bucket * rows->bucket_size * width;
+        size_t end = begin + rows->bucket_size * width;
+        begin = begin < total ? begin : total;
+        end = bucket == num_workers - 1 ? nn->num_parameters - offset : (end < total ? end : total);
+        memset(out + begin, 0, (end - begin) * sizeof(double));
+    }
+    const uint32_t *list = rows->rows + bucket * rows->bucket_size;
+    for (size_t i = 0; i < rows->counts[bucket]; i++) {
+        memcpy(out + (size_t)list[i] * width, sum + (size_t)list[i] * width, width * sizeof(double));
+    }
+}
+
+static void reduce_gradients_task(void *context, int worker, int num_workers) {
+    PROFILE_SCOPE(PROF_REDUCE);
+    DataParallel *dp = context;
+    const size_t line = ARENA_ALIGNMENT / sizeof(double);
+    size_t lines = (dp->touched ? dp->nn->encoding_offset : dp->nn->num_parameters) / line;
+    size_t begin = lines * worker / num_workers * line;
+    size_t end = lines * (worker + 1) / num_workers * line;
+
+    for (int stride = 1; stride < num_workers; stride *= 2) {
+        for (int w = 0; w + stride < num_workers; w += 2 * stride) {
+            double *dst = dp->gradients[w];
+            const double *src = dp->gradients[w + stride];
+            for (size_t p = begin; p < end; p++) {
+                dst[p] += src[p];
+            }
+        }
+    }
+    memcpy(dp->output_gradients + begin, dp->gradients[0] + begin, (end - begin) * sizeof(double));
+    if (dp->touched) {
+        reduce_table_rows(dp, worker, num_workers);
+    }
+}
+
+void data_parallel_sweep(DataParallel *dp, const NeuralNetwork *nn, ShardSweep sweep, void *context, int begin, int end, double *gradients, double *sums) {
+    dp->nn = nn;
+    dp->sweep = sweep;
+    dp->context = context;
+    dp->range_begin = begin;
+    dp->range_end = end;
+    dp->output_gradients = gradients;
+    if (dp->weights32) {
+        narrow_jet_weights(nn, dp->weights32);
+    }
+    thread_pool_run(&dp->pool, sweep_task, dp);
+    if (gradients) {
+        thread_pool_run(&dp->pool, reduce_gradients_task, dp);
+    }
+    if (sums) {
+        memset(sums, 0, dp->sum_width * sizeof(double));
+        for (int w = 0; w < dp->num_workers; w++) {
+            for (int i = 0; i < dp->sum_width; i++) {
+                sums[i] += dp->sums[w][i];
+            }
+        }
+    }
+}
+
+// Weighted sum of the term means, given the term sums over one whole batch
+double combine_loss_terms(const double *sums, const CollocationBatch *batch, const double *weights, double *means) {
+    double term_means[TERM_COUNT] = {0.0};
+    if (batch->num_interior > 0) {
+        term_means[TERM_RESIDUAL] = sums[TERM_RESIDUAL] / batch->num_interior;
+        term_means[TERM_CONSERVATION] = sums[TERM_CONSERVATION] / batch->num_interior;
+    }
+    if (batch->num_boundary > 0) term_means[TERM_BOUNDARY] = sums[TERM_BOUNDARY] / batch->num_boundary;
+    if (batch->num_initial > 0) term_means[TERM_INITIAL] = sums[TERM_INITIAL] / batch->num_initial;
+
+    double loss = 0.0;
+    for (int i = 0; i < TERM_COUNT; i++) {
+        loss += weights[i] * term_means[i];
+    }
+    if (means) {
+        memcpy(means, term_means, sizeof(term_means));
+    }
+    return loss;
+}
+
+// Weighted composite loss: sum over the terms of weights[i] * (mean of term i over its
+// points in the batch), swept over batch points [begin, end) only. With gradients non-NULL
+// the exact parameter gradient of that loss is written there; with means non-NULL the
+// unweighted term means are stored. Across ranks, each rank sweeps its own slice of the
+// range and one allreduce sums the term sums and gradients of all of them.
+static double weighted_loss(Trainer *trainer, const CollocationBatch *batch, const double *weights, int begin, int end, double *gradients, double *means) {
+    Communicator *comm = trainer->comm;
+    double *message = NULL;
+    if (comm) {
+        int offset = begin;
+        shard_range(end - begin, comm->rank, comm->num_ranks, &begin, &end);
+        begin += offset;
+        end += offset;
+        message = trainer->message;
+    }
+    trainer->batch = batch;
+    trainer->weights = weights;
+    double sums[TERM_COUNT];
+    data_parallel_sweep(&trainer->dp, trainer->nn, composite_loss_sweep, trainer, begin, end, (gradients && message) ? message + MESSAGE_HEADER : gradients, sums);
+
+    if (message) {
+        memset(message, 0, MESSAGE_HEADER * sizeof(double));
+        memcpy(message, sums, sizeof(sums));
+        comm_allreduce(comm, message, MESSAGE_HEADER + (gradients ? trainer->nn->num_parameters : 0));
+        memcpy(sums, message, sizeof(sums));
+        if (gradients) {
+            memcpy(gradients, message + MESSAGE_HEADER, trainer->nn->num_parameters * sizeof(double));
+        }
+    }
+    return combine_loss_terms(sums, batch, weights, means);
+}
+
+// The training objective under the current term weights, over the whole batch
+static double composite_loss(Trainer *trainer, const CollocationBatch *batch, const double *weights, double *gradients) {
+    return weighted_loss(trainer, batch, weights, 0, collocation_batch_size(batch), gradients, NULL);
+}
+
+// Running sums for the statistics of one gradient block
+static void accumulate_stats(const double *values, size_t count, double *sum_squares, double *sum_abs, double *max_abs) {
+    for (size_t p = 0; p < count; p++) {
+        double magnitude = fabs(values[p]);
+        *sum_squares += values[p] * values[p];
+        *sum_abs += magnitude;
+        *max_abs = magnitude > *max_abs ? magnitude : *max_abs;
+    }
+}
+
+// Unweighted mean and parameter-gradient statistics of every active term on one batch.
+// Term i's gradient comes from its own sweep over just the points it is defined on.
+static void term_gradient_stats(Trainer *trainer, const CollocationBatch *batch, const LossBalancer *balancer, double *scratch, TermGradientStats *stats) {
+    const NeuralNetwork *nn = trainer->nn;
+    int interior_end = batch->num_interior;
+    int boundary_end = interior_end + batch->num_boundary;
+    const int begins[TERM_COUNT] = {0, interior_end, boundary_end, 0};
+    const int ends[TERM_COUNT] = {interior_end, boundary_end, collocation_batch_size(batch), interior_end};
+
+    memset(stats, 0, TERM_COUNT * sizeof(*stats));
+    for (int i = 0; i < TERM_COUNT; i++) {
+        if (!balancer->active[i] || ends[i] <= begins[i]) continue;
+        double weights[TERM_COUNT] = {0.0};
+        double means[TERM_COUNT];
+        weights[i] = 1.0;
+        weighted_loss(trainer, batch, weights, begins[i], ends[i], scratch, means);
+
+        // Only real weights and biases count; the padding between layer blocks would dilute the mean
+        double sum_squares = 0.0, sum_abs = 0.0, max_abs = 0.0;
+        size_t count = 0;
+        for (int l = 0; l + 1 < nn->num_layers; l++) {
+            size_t weight_count = (size_t)nn->layer_sizes[l] * nn->layer_sizes[l + 1];
+            accumulate_stats(scratch + nn->weight_offsets[l], weight_count, &sum_squares, &sum_abs, &max_abs);
+            accumulate_stats(scratch + nn->bias_offsets[l], nn->layer_sizes[l + 1], &sum_squares, &sum_abs, &max_abs);
+            count += weight_count + nn->layer_sizes[l + 1];
+        }
+        stats[i].loss = means[i];
+        stats[i].norm = sqrt(sum_squares);
+        stats[i].max_abs = max_abs;
+        stats[i].mean_abs = count > 0 ? sum_abs / count : 0.0;
+    }
+}
+
+// What the optimizer re-evaluates during a line search: the composite loss on a fixed batch
+typedef struct {
+    Trainer *trainer;
+    const CollocationBatch *batch;
+    const double *weights;
+} TrainingObjective;
+
+static double training_objective(void *context, double *gradients) {
+    TrainingObjective *objective = context;
+    return composite_loss(objective->trainer, objective->batch, objective->weights, gradients);
+}
+
+// Validation reports the plain sum of the term means, comparable across weightings
+static const double unit_weights[TERM_COUNT] = {1.0, 1.0, 1.0, 1.0};
+
+// What the validator thread needs to evaluate a snapshot; fixed for the whole run
+typedef struct {
+    const PdeOperator *op;
+    const LossParameters *params;
+    ActivationFunction activation;
+} ValidationObjective;
+
+static double validation_objective(const NeuralNetwork *snapshot, JetWorkspace *ws, const CollocationBatch *set, void *context) {
+    const ValidationObjective *objective = context;
+    double sums[TERM_COUNT] = {0.0};
+    composite_loss_range(snapshot, ws, set, 0, collocation_batch_size(set), objective->op, objective->params, unit_weights, objective->activation, NULL, sums);
+    return combine_loss_terms(sums, set, unit_weights, NULL);
+}
+
+// Squared PDE residual at each point of scoring job points [begin, end)
+static void score_residuals_sweep(void *context, const NeuralNetwork *nn, JetWorkspace *ws, int begin, int end, double *gradients, double *sums) {
+    const Trainer *trainer = context;
+    int input_dim = nn_input_size(nn);
+    (void)gradients;
+    (void)sums;
+
+    for (int start = begin; start < end; start += ws->capacity) {
+        int chunk = (end - start < ws->capacity) ? end - start : ws->capacity;
+        JetBatch jets;
+        forward_pass_jet(nn, ws, trainer->points + (size_t)start * input_dim, chunk, trainer->activation);
+        jet_output_batch(nn, ws, 0, &jets);
+        if (!nn_parametric(nn)) {
+            trainer->op->residual(&jets, 0, chunk, trainer->params, 0.0, trainer->residuals + start);
+            continue;
+        }
+        int coordinates = nn_coordinate_inputs(nn);
+        for (int s = 0; s < chunk; s++) {
+            LossParameters point_params;
+            point_loss_parameters(&nn->parameter_inputs, trainer->params, trainer->points + (size_t)(start + s) * input_dim + coordinates, &point_params);
+            trainer->op->residual(&jets, s, s + 1, &point_params, 0.0, trainer->residuals + start + s);
+        }
+    }
+}
+
+// Across ranks, each rank scores its slice and leaves zeros elsewhere, so the allreduce
+// that completes the vector adds nothing but exact zeros
+static void score_residuals(Trainer *trainer, const double *points, int num_points, double *residuals) {
+    int begin = 0, end = num_points;
+    if (trainer->comm) {
+        shard_range(num_points, trainer->comm->rank, trainer->comm->num_ranks, &begin, &end);
+        memset(residuals, 0, (size_t)num_points * sizeof(double));
+    }
+    trainer->points = points;
+    trainer->residuals = residuals;
+    data_parallel_sweep(&trainer->dp, trainer->nn, score_residuals_sweep, trainer, begin, end, NULL, NULL);
+    if (trainer->comm) {
+        comm_allreduce(trainer->comm, residuals, (size_t)num_points);
+    }
+}
+
+void free_data_parallel(DataParallel *dp) {
+    for (int w = 0; dp->workspaces && w < dp->num_workers; w++) {
+        free_jet_workspace(&dp->workspaces[w]);
+    }
+    if (dp->pool.num_threads > 0) {
+        thread_pool_free(&dp->pool);
+    }
+    arena_free(&dp->arena);
+    memset(dp, 0, sizeof(*dp));
+}
+
+static void free_trainer(Trainer *trainer) {
+    free_data_parallel(&trainer->dp);
+    arena_free(&trainer->arena);
+}
+
+// The batch with every point widened by parameter values drawn from words [position, ...) of
+// rng into points, which has room for the whole batch at dims + inputs->count per point
+static void widen_batch(const ParameterInputs *inputs, const Rng *rng, uint64_t position, const CollocationBatch *batch, int dims, double *points, CollocationBatch *wide) {
+    *wide = *batch;
+    wide->points = points;
+    append_parameter_inputs(inputs, rng, position, batch->points, collocation_batch_size(batch), dims, points);
+}
+
+// Rounded training keeps the double master copy on float values, so the trained model is
+// exactly a float model. Storage, gradients and optimizer state stay double. After a lazy
+// step only the layers and the rows it moved need rounding again.
+static void round_parameters_to_float(NeuralNetwork *nn, const Optimizer *optimizer) {
+    const RowSet *rows = optimizer ? optimizer->sparse : NULL;
+    size_t dense = rows ? optimizer->sparse_offset : nn->num_parameters;
+    for (size_t p = 0; p < dense; p++) {
+        nn->parameters[p] = (float)nn->parameters[p];
+    }
+    for (int b = 0; rows && b < rows->num_buckets; b++) {
+        const uint32_t *list = rows->rows + b * rows->bucket_size;
+        for (size_t i = 0; i < rows->counts[b]; i++) {
+            double *row = nn->parameters + optimizer->sparse_offset + (size_t)list[i] * optimizer->sparse_width;
+            for (int j = 0; j < optimizer->sparse_width; j++) {
+                row[j] = (float)row[j];
+            }
+        }
+    }
+}
+
+// First-order steps on a single rank visit only the hash-grid rows the batch reached, and
+// the gradients leave the other rows stale instead of clearing them. Across ranks every
+// rank has to step the same rows, so the gradients stay dense there, as they do for L-BFGS.
+static void use_lazy_rows(Trainer *trainer, Optimizer *optimizer) {
+    int lazy = trainer->dp.touched != NULL && trainer->comm == NULL && !optimizer->method->full_batch;
+    trainer->dp.sparse_output = lazy;
+    optimizer->sparse = lazy ? &trainer->dp.touched[0] : NULL;
+    optimizer->sparse_offset = trainer->nn->encoding_offset;
+    optimizer->sparse_width = trainer->nn->encoding.config.features;
+}
+
+int init_data_parallel(DataParallel *dp, const NeuralNetwork *nn, int num_workers, int max_points, int sum_width, int derivative_order, Precision precision) {
+    memset(dp, 0, sizeof(*dp));
+    size_t total = arena_aligned_size(num_workers * sizeof(JetWorkspace)) +
+                   2 * arena_aligned_size(num_workers * sizeof(double *)) +
+                   num_workers * arena_aligned_size(sum_width * sizeof(double)) +
+                   num_workers * arena_aligned_size(nn->num_parameters * sizeof(double)) +
+                   (precision != PRECISION_FP64 ? arena_aligned_size(nn->num_parameters * sizeof(float)) : 0);
+    // Hash-grid rows are tracked in one bucket per worker of the reduction
+    size_t table_rows = nn->encoding.num_parameters > 0 ? nn->encoding.num_parameters / nn->encoding.config.features : 0;
+    size_t bucket_size = (table_rows + num_workers - 1) / num_workers;
+    if (table_rows > 0) {
+        total += arena_aligned_size(num_workers * sizeof(RowSet)) +
+                 num_workers * (arena_aligned_size(table_rows) + arena_aligned_size(num_workers * bucket_size * sizeof(uint32_t)) +
+                                arena_aligned_size(num_workers * sizeof(size_t)));
+    }
+    if (!arena_init(&dp->arena, total)) {
+        fprintf(stderr, "Error: Failed to allocate buffers for %d workers\n", num_workers);
+        return 0;
+    }
+    dp->num_workers = num_workers;
+    dp->sum_width = sum_width;
+    dp->workspaces = arena_alloc(&dp->arena, num_workers * sizeof(JetWorkspace));
+    dp->gradients = arena_alloc(&dp->arena, num_workers * sizeof(double *));
+    dp->sums = arena_alloc(&dp->arena, num_workers * sizeof(double *));
+    memset(dp->workspaces, 0, num_workers * sizeof(JetWorkspace));
+    for (int w = 0; w < num_workers; w++) {
+        dp->gradients[w] = arena_alloc(&dp->arena, nn->num_parameters * sizeof(double));
+        dp->sums[w] = arena_alloc(&dp->arena, sum_width * sizeof(double));
+    }
+
+    if (table_rows > 0) {
+        dp->touched = arena_alloc(&dp->arena, num_workers * sizeof(RowSet));
+        for (int w = 0; w < num_workers; w++) {
+            dp->touched[w].marks = arena_alloc(&dp->arena, table_rows);
+            dp->touched[w].rows = arena_alloc(&dp->arena, num_workers * bucket_size * sizeof(uint32_t));
+            dp->touched[w].counts = arena_alloc(&dp->arena, num_workers * sizeof(size_t));
+            dp->touched[w].bucket_size = bucket_size;
+            dp->touched[w].num_buckets = num_workers;
+        }
+    }
+
+    int shard = (max_points + num_workers - 1) / num_workers;
+    int capacity = shard < SHARD_CHUNK ? (shard > 0 ? shard : 1) : SHARD_CHUNK;
+    for (int w = 0; w < num_workers; w++) {
+        if (!init_jet_workspace(&dp->workspaces[w], nn, capacity, derivative_order, precision)) {
+            return 0;
+        }
+        dp->workspaces[w].touched = dp->touched ? &dp->touched[w] : NULL;
+    }
+    if (precision != PRECISION_FP64) {
+        dp->weights32 = arena_alloc(&dp->arena, nn->num_parameters * sizeof(float));
+        for (int w = 0; w < num_workers; w++) {
+            share_jet_weights(&dp->workspaces[w], dp->weights32);
+        }
+    }
+
+    if (!thread_pool_init(&dp->pool, num_workers)) {
+        fprintf(stderr, "Error: Failed to start %d worker threads\n", num_workers);
+        return 0;
+    }
+    return 1;
+}
+
+// Start the workers, size every tape for the largest job and, across ranks, make room for the message
+static int init_trainer(Trainer *trainer, const NeuralNetwork *nn, int num_workers, int max_points, int derivative_order, Precision precision, Communicator *comm) {
+    if (!init_data_parallel(&trainer->dp, nn, num_workers, max_points, TERM_COUNT, derivative_order, precision)) {
+        return 0;
+    }
+    trainer->nn = nn;
+    if (comm) {
+        size_t message_size = (MESSAGE_HEADER + nn->num_parameters) * sizeof(double);
+        if (!arena_init(&trainer->arena, arena_aligned_size(message_size))) {
+            fprintf(stderr, "Error: Failed to allocate the allreduce buffer\n");
+            return 0;
+        }
+        trainer->comm = comm;
+        trainer->message = arena_alloc(&trainer->arena, message_size);
+    }
+    return 1;
+}
+
+size_t training_message_capacity(const NeuralNetwork *nn, const TrainingConfig *config) {
+    size_t message = MESSAGE_HEADER + nn->num_parameters;
+    size_t scores = config->refine_every > 0 ? (size_t)config->refine_candidates : 0;
+    return message > scores ? message : scores;
+}
+
+void default_training_config(TrainingConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->epochs = 1000;
+    config->learning_rate = 0.01;
+    default_learning_rate_schedule(&config->schedule, config->learning_rate, config->epochs);
+    default_optimizer_config(&config->optimizer, OPTIMIZER_SGD);
+    config->lbfgs_epochs = 0;
+    config->activation = TANH;
+    config->precision = PRECISION_FP64;
+    default_loss_weighting_config(&config->loss_weighting);
+    config->verbose = 0;
+    config->sampling = SAMPLE_SOBOL;
+    config->interior_points = 256;
+    config->boundary_points = 64;
+    config->initial_points = 64;
+    config->validation_points = 256;
+    config->validation.every = 0;
+    config->validation.seconds = 0.0;
+    config->validation.subsample = 0;
+    config->validation.best_model_path = NULL;
+    config->refine_every = 100;
+    config->refine_candidates = 1024;
+    config->threads = 1;
+    config->seed = RNG_DEFAULT_SEED;
+    config->log_every = 1;
+    config->log_format = LOG_TEXT;
+    config->checkpoint_every = 0;
+    config->checkpoint_path = NULL;
+    config->resume = NULL;
+    config->comm = NULL;
+}
+
+int train_neural_network(NeuralNetwork *nn, const char *loss_type, const LossParameters *params, const TrainingConfig *config) {
+    // Parameter inputs ride along after the coordinates; the sampler only sees the coordinates
+    int input_size = nn_coordinate_inputs(nn);
+    const ParameterInputs *inputs = parameter_inputs(nn);
+    int output_size = nn_output_size(nn);
+    ActivationFunction activation_func_type = config->activation;
+
+    // The equation is resolved once; the hot loops only ever see its descriptor
+    const PdeOperator *op = find_pde_operator(loss_type);
+    if (op == NULL) {
+        fprintf(stderr, "Unknown loss type: %s\n", loss_type);
+        return 0;
+    }
+    if (output_size < op->num_outputs) {
+        fprintf(stderr, "Error: %s needs at least %d outputs, got %d\n", loss_type, op->num_outputs, output_size);
+        return 0;
+    }
+    if (input_size < op->min_inputs || input_size > op->max_inputs) {
+        fprintf(stderr, "Error: %s takes between %d and %d inputs (space..., time), got %d\n", loss_type, op->min_inputs, op->max_inputs, input_size);
+        return 0;
+    }
+
+    // Across ranks, each sweeps its share of every batch; rank 0 validates, logs and checkpoints
+    Communicator *comm = config->comm;
+    int lead = comm == NULL || comm->rank == 0;
+    if (comm && training_message_capacity(nn, config) > comm->capacity) {
+        fprintf(stderr, "Error: Allreduce messages of %zu values do not fit the %zu the ranks were started with\n", training_message_capacity(nn, config), comm->capacity);
+        return 0;
+    }
+
+    Domain domain = config->domain;
+    if (domain.dims == 0) {
+        unit_domain(&domain, input_size);
+    }
+    if (input_size < 2 || domain.dims != input_size) {
+        fprintf(stderr, "Error: The domain has %d axes but the network takes %d inputs (space..., time)\n", domain.dims, input_size);
+        return 0;
+    }
+
+    // The profile covers setup too, so its allocations show up
+    profile_reset();
+
+    // Training batches stream from a background sampler; validation uses a fixed set drawn once
+    Sampler sampler = {0};
+    Sampler validation_sampler = {0};
+    Validator validator = {0};
+    Trainer trainer = {0};
+    Optimizer optimizer = {0};
+    TrainingLogger logger = {0};
+    CollocationBatch validation_batch = {0};
+    double *candidates = NULL;
+    double *residuals = NULL;
+    double *term_gradients = NULL;
+    double *wide_points = NULL;
+    CollocationBatch wide_batch = {0};
+    Rng parameter_rng;
+    int trained = 0;
+
+    int validation_boundary = config->boundary_points > 0 ? config->validation_points / 4 : 0;
+    int validation_initial = config->initial_points > 0 ? config->validation_points / 4 : 0;
+    if (!sampler_init(&sampler, &domain, config->sampling, config->interior_points, config->boundary_points, config->initial_points, config->seed, 1) ||
+        !sampler_init(&validation_sampler, &domain, SAMPLE_SOBOL, config->validation_points, validation_boundary, validation_initial, 0xC0FFEEULL, 0)) {
+        goto cleanup;
+    }
+    validation_batch = *sampler_next_batch(&validation_sampler);
+
+    // Parametric runs widen every batch by parameter values from their own stream: substream
+    // 0 for training batches, 1 for the validation set, 2 for refinement candidates
+    int batch_size = collocation_batch_size(&sampler.buffers[0]);
+    int validation_points = collocation_batch_size(&validation_batch);
+    int candidate_count = config->refine_every > 0 ? config->refine_candidates : 0;
+    if (inputs) {
+        int width = input_size + inputs->count;
+        wide_points = malloc(((size_t)batch_size + validation_points + candidate_count) * width * sizeof(double));
+        if (wide_points == NULL) {
+            fprintf(stderr, "Error: Failed to allocate the parameter input buffers\n");
+            goto cleanup;
+        }
+        Rng validation_rng;
+        rng_init(&validation_rng, config->seed, RNG_STREAM_PARAMETERS, 1);
+        widen_batch(inputs, &validation_rng, 0, &validation_batch, input_size, wide_points + (size_t)batch_size * width, &validation_batch);
+        rng_init(&parameter_rng, config->seed, RNG_STREAM_PARAMETERS, 0);
+    }
+
+    // A resumed run picks up the epoch counter, point streams and refinement pool where the checkpoint left off
+    int start_epoch = 0;
+    if (config->resume) {
+        if (strcmp(config->resume->loss_type, loss_type) != 0) {
+            fprintf(stderr, "Error: The checkpoint was trained on %s, not %s\n", config->resume->loss_type, loss_type);
+            goto cleanup;
+        }
+        start_epoch = config->resume->epoch;
+        const double *pool = config->resume->refinement_pool;
+        if (pool && config->resume->refinement_pool_size != (size_t)config->resume->sampler.pool_size * input_size) {
+            fprintf(stderr, "Warning: The checkpoint's refinement pool does not fit this domain; refinement starts over\n");
+            pool = NULL;
+        }
+        sampler_restore_state(&sampler, &config->resume->sampler, pool);
+    }
+
+    char checkpoint_filename[256];
+    if (config->checkpoint_path) {
+        snprintf(checkpoint_filename, sizeof(checkpoint_filename), "%s", config->checkpoint_path);
+    } else {
+        snprintf(checkpoint_filename, sizeof(checkpoint_filename), "checkpoint_%s.ckpt", loss_type);
+    }
+
+    // Every batch is sharded across the workers; the tapes are sized once for the largest job
+    int num_workers = config->threads > 0 ? config->threads : available_cores();
+    int max_points = batch_size;
+    if (config->refine_candidates > max_points) max_points = config->refine_candidates;
+    if (!init_trainer(&trainer, nn, num_workers, max_points, op->derivative_order, config->precision, comm)) {
+        goto cleanup;
+    }
+    trainer.op = op;
+    trainer.params = params;
+    trainer.activation = activation_func_type;
+
+    // Validation runs on its own thread and tape against parameter snapshots. Without an
+    // explicit cadence it follows the log cadence, as every logged epoch used to be validated.
+    ValidationConfig validation_config = config->validation;
+    if (validation_config.every <= 0 && validation_config.seconds <= 0.0) {
+        validation_config.every = config->log_every > 0 ? config->log_every : 1;
+    }
+    ValidationObjective validation_objective_context = {op, params, activation_func_type};
+    if (lead && !validator_init(&validator, &validation_config, nn, &validation_batch, validation_points < SHARD_CHUNK ? validation_points : SHARD_CHUNK,
+                        op->derivative_order, config->precision, validation_objective, &validation_objective_context, loss_type, activation_func_type)) {
+        goto cleanup;
+    }
+    ValidationResult validation = {-1, 0.0, NAN, 0.0, 0};
+
+    if (config->refine_every > 0 && config->refine_candidates > 0) {
+        candidates = malloc((size_t)config->refine_candidates * input_size * sizeof(double));
+        residuals = malloc((size_t)config->refine_candidates * sizeof(double));
+        if (!candidates || !residuals) {
+            fprintf(stderr, "Error: Failed to allocate refinement buffers\n");
+            goto cleanup;
+        }
+    }
+
+    // The run ends with lbfgs_epochs of L-BFGS when asked (the usual Adam-then-L-BFGS recipe)
+    LearningRateSchedule schedule = config->schedule;
+    schedule.base_rate = config->learning_rate;
+    schedule.total_epochs = config->epochs;
+    int lbfgs_from = config->lbfgs_epochs > 0 ? config->epochs - config->lbfgs_epochs : config->epochs;
+    OptimizerConfig optimizer_config = config->optimizer;
+    if (start_epoch >= lbfgs_from) {
+        optimizer_config.type = OPTIMIZER_LBFGS;
+    }
+    if (!optimizer_init(&optimizer, &optimizer_config, nn->num_parameters)) {
+        goto cleanup;
+    }
+    use_lazy_rows(&trainer, &optimizer);
+    if (config->resume && optimizer.state_size > 0 && !optimizer_restore_state(&optimizer, (OptimizerType)config->resume->optimizer, config->resume->optimizer_state, config->resume->optimizer_state_size)) {
+        fprintf(stderr, "Warning: The checkpoint holds no %s state; the optimizer starts fresh\n", optimizer.method->name);
+    }
+
+    // Term weights of the composite loss; adaptive methods need a gradient buffer for the per-term sweeps
+    LossBalancer balancer;
+    int active_terms[TERM_COUNT] = {1, config->boundary_points > 0, config->initial_points > 0, op->conservation != NULL};
+    loss_balancer_init(&balancer, &config->loss_weighting, active_terms);
+    if (balancer.config.method != WEIGHTING_FIXED) {
+        term_gradients = malloc(nn->num_parameters * sizeof(double));
+        if (term_gradients == NULL) {
+            fprintf(stderr, "Error: Failed to allocate the loss-balancing buffer\n");
+            goto cleanup;
+        }
+    }
+    // Metrics go through a ring buffer to a background writer instead of one open/close per epoch
+    if (lead && !logger_open(&logger, loss_type, config->log_format, config->log_every)) {
+        goto cleanup;
+    }
+
+    // Full-batch methods keep one batch until refinement changes the objective, and reuse
+    // the loss and gradient their line search ended on
+    const CollocationBatch *batch = NULL;
+    if (config->precision == PRECISION_ROUNDED) {
+        round_parameters_to_float(nn, NULL);
+    }
+    TrainingObjective objective = {&trainer, NULL, balancer.weights};
+    int have_gradient = 0;
+    double next_loss = 0.0;
+
+    for (int epoch = start_epoch; epoch < config->epochs; epoch++) {
+        PROFILE_BEGIN(epoch_start);
+        if (epoch == lbfgs_from && optimizer.method->type != OPTIMIZER_LBFGS) {
+            optimizer_free(&optimizer);
+            optimizer_config.type = OPTIMIZER_LBFGS;
+            if (!optimizer_init(&optimizer, &optimizer_config, nn->num_parameters)) {
+                goto cleanup;
+            }
+            use_lazy_rows(&trainer, &optimizer);
+        }
+        int full_batch = optimizer.method->full_batch;
+        if (!full_batch || batch == NULL) {
+            PROFILE_BEGIN(sampler_start);
+            batch = sampler_next_batch(&sampler);
+            if (inputs) {
+                widen_batch(inputs, &parameter_rng, (uint64_t)epoch * batch_size * inputs->count, batch, input_size, wide_points, &wide_batch);
+                batch = &wide_batch;
+            }
+            PROFILE_END(PROF_SAMPLER, sampler_start);
+            have_gradient = 0;
+        }
+
+        // Rebalance the terms on this batch every K epochs; new weights are a new objective
+        if (loss_balancer_due(&balancer, epoch, start_epoch)) {
+            PROFILE_SCOPE(PROF_BALANCE);
+            TermGradientStats stats[TERM_COUNT];
+            term_gradient_stats(&trainer, batch, &balancer, term_gradients, stats);
+            if (loss_balancer_update(&balancer, stats)) {
+                have_gradient = 0;
+                if (full_batch) {
+                    optimizer_reset(&optimizer);
+                }
+            }
+            if (lead && config->verbose) {
+                printf("Epoch %d: term weights", epoch);
+                for (int i = 0; i < TERM_COUNT; i++) {
+                    if (balancer.active[i]) printf(" %s %.4g", loss_term_name((LossTerm)i), balancer.weights[i]);
+                }
+                printf("\n");
+            }
+        }
+
+        // Descend the weighted composite physics loss itself
+        double learning_rate = schedule_learning_rate(&schedule, epoch);
+        double loss = have_gradient ? next_loss : composite_loss(&trainer, batch, balancer.weights, nn->gradients);
+        next_loss = loss;
+        objective.batch = batch;
+        PROFILE_BEGIN(optimizer_start);
+        optimizer_step(&optimizer, nn->parameters, nn->gradients, &next_loss, learning_rate, training_objective, &objective);
+        if (config->precision == PRECISION_ROUNDED) {
+            round_parameters_to_float(nn, &optimizer);
+        }
+        PROFILE_END(PROF_OPTIMIZER, optimizer_start);
+        have_gradient = full_batch;
+
+        // Periodically steer part of the interior set toward high-residual regions
+        if (candidates && (epoch + 1) % config->refine_every == 0) {
+            PROFILE_SCOPE(PROF_REFINE);
+            sampler_uniform_points(&sampler, candidates, config->refine_candidates);
+            if (inputs) {
+                // Candidates are scored at random parameter values; the pool keeps only their coordinates
+                Rng candidate_rng;
+                double *scored = wide_points + ((size_t)batch_size + validation_points) * (input_size + inputs->count);
+                rng_init(&candidate_rng, config->seed, RNG_STREAM_PARAMETERS, 2);
+                append_parameter_inputs(inputs, &candidate_rng, (uint64_t)epoch * config->refine_candidates * inputs->count, candidates, config->refine_candidates, input_size, scored);
+                score_residuals(&trainer, scored, config->refine_candidates, residuals);
+            } else {
+                score_residuals(&trainer, candidates, config->refine_candidates, residuals);
+            }
+            sampler_refine(&sampler, candidates, residuals, config->refine_candidates);
+            if (full_batch) {
+                // New points, new objective: old curvature pairs no longer describe it
+                batch = NULL;
+                optimizer_reset(&optimizer);
+            }
+        }
+
+        // Due epochs hand a snapshot to the validator unless it is still busy; only the
+        // final model is waited for, and it is always validated on the full set
+        if (lead) {
+            if (epoch + 1 == config->epochs) {
+                validator_submit(&validator, nn, epoch, loss, learning_rate, 1, 1);
+                validator_wait(&validator);
+            } else if (validator_due(&validator, epoch)) {
+                validator_submit(&validator, nn, epoch, loss, learning_rate, 0, 0);
+            }
+            validator_poll(&validator, &validation);
+        }
+
+        // Each record carries the newest finished validation pass and the epoch it measured
+        if (logger_wants_epoch(&logger, epoch, config->epochs)) {
+            PROFILE_BEGIN(log_start);
+            logger_record(&logger, epoch, loss, validation.validation_loss, validation.epoch, learning_rate);
+            PROFILE_END(PROF_LOG, log_start);
+        }
+
+        if (lead && config->checkpoint_every > 0 && ((epoch + 1) % config->checkpoint_every == 0 || epoch + 1 == config->epochs)) {
+            PROFILE_SCOPE(PROF_CHECKPOINT);
+            CheckpointState state;
+            memset(&state, 0, sizeof(state));
+            state.epoch = epoch + 1;
+            state.activation = activation_func_type;
+            snprintf(state.loss_type, sizeof(state.loss_type), "%s", loss_type);
+            sampler_save_state(&sampler, &state.sampler);
+            state.optimizer = optimizer.method->type;
+            state.optimizer_state = optimizer.state;
+            state.optimizer_state_size = optimizer.state_size;
+            state.refinement_pool = sampler.pool;
+            state.refinement_pool_size = (size_t)state.sampler.pool_size * input_size;
+            save_checkpoint(nn, &state, checkpoint_filename);
+        }
+        PROFILE_END(PROF_EPOCH, epoch_start);
+    }
+    trained = 1;
+    if (validator.skipped > 0) {
+        printf("Validation: %d due passes skipped while the previous one was running\n", validator.skipped);
+    }
+    if (lead && validation_config.best_model_path && validator.best_epoch >= 0) {
+        printf("Best validation loss %.5f at epoch %d saved to %s\n", validator.best_loss, validator.best_epoch, validation_config.best_model_path);
+    }
+
+cleanup:
+    validator_free(&validator);
+    logger_close(&logger);
+    sampler_free(&sampler);
+    sampler_free(&validation_sampler);
+    free_trainer(&trainer);
+    optimizer_free(&optimizer);
+    free(candidates);
+    free(residuals);
+    free(term_gradients);
+    free(wide_points);
+
+    logger_write_profile(&logger, config->profile_trace);
+    return trained;
+}
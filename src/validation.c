@@ -0,0 +1,197 @@
+#include "validation.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "checkpoint.h"
+#include "profile.h"
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+// Copy the first `count` points of a group of the full set behind the subset's previous groups
+static double *copy_group(double *dst, const double *src, int count, int dims) {
+    memcpy(dst, src, (size_t)count * dims * sizeof(double));
+    return dst + (size_t)count * dims;
+}
+
+// The leading points of each group of a Sobol set are themselves well spread, so a prefix
+// of every group gives a cheap subset whose loss is comparable from pass to pass
+static int build_subset(Validator *v, int dims) {
+    const CollocationBatch *full = &v->full_set;
+    int interior = v->config.subsample;
+    if (interior <= 0 || interior >= full->num_interior) {
+        v->cadence_set = full;
+        return 1;
+    }
+    int boundary = (int)((long long)full->num_boundary * interior / full->num_interior);
+    int initial = (int)((long long)full->num_initial * interior / full->num_interior);
+    if (full->num_boundary > 0 && boundary == 0) boundary = 1;
+    if (full->num_initial > 0 && initial == 0) initial = 1;
+
+    size_t bytes = (size_t)(interior + boundary + initial) * dims * sizeof(double);
+    if (!arena_init(&v->arena, bytes)) {
+        fprintf(stderr, "Error: Failed to allocate the validation subset\n");
+        return 0;
+    }
+    v->subset.points = arena_alloc(&v->arena, bytes);
+    v->subset.num_interior = interior;
+    v->subset.num_boundary = boundary;
+    v->subset.num_initial = initial;
+    double *dst = copy_group(v->subset.points, full->points, interior, dims);
+    dst = copy_group(dst, full->points + (size_t)full->num_interior * dims, boundary, dims);
+    copy_group(dst, full->points + (size_t)(full->num_interior + full->num_boundary) * dims, initial, dims);
+    v->cadence_set = &v->subset;
+    return 1;
+}
+
+// Passes on the cadence set count toward the best model; the final full pass of a
+// subsampled run is on a different set, so it only reports
+static void record_pass(Validator *v, const ValidationResult *job, const CollocationBatch *set, double validation_loss) {
+    int improved = set == v->cadence_set && isfinite(validation_loss) && validation_loss < v->best_loss;
+    if (improved && v->config.best_model_path) {
+        PROFILE_SCOPE(PROF_CHECKPOINT);
+        CheckpointState state;
+        memset(&state, 0, sizeof(state));
+        state.epoch = job->epoch + 1;   // Epochs completed when the snapshot was taken
+        state.activation = v->activation;
+        snprintf(state.loss_type, sizeof(state.loss_type), "%s", v->loss_type);
+        save_checkpoint(&v->snapshot, &state, v->config.best_model_path);
+    }
+
+    pthread_mutex_lock(&v->lock);
+    if (improved) {
+        v->best_loss = validation_loss;
+        v->best_epoch = job->epoch;
+    }
+    v->result = *job;
+    v->result.validation_loss = validation_loss;
+    v->results++;
+    v->pending = 0;
+    pthread_cond_broadcast(&v->cond);
+    pthread_mutex_unlock(&v->lock);
+}
+
+static void *validator_thread(void *arg) {
+    Validator *v = arg;
+    pthread_mutex_lock(&v->lock);
+    for (;;) {
+        while (!v->pending && !v->stop) {
+            pthread_cond_wait(&v->cond, &v->lock);
+        }
+        if (v->stop) break;
+        ValidationResult job = v->job;
+        pthread_mutex_unlock(&v->lock);
+
+        // The snapshot is not touched by the trainer while a pass is pending
+        const CollocationBatch *set = job.full ? &v->full_set : v->cadence_set;
+        PROFILE_BEGIN(validation_start);
+        double validation_loss = v->evaluate(&v->snapshot, &v->ws, set, v->context);
+        PROFILE_END(PROF_VALIDATION, validation_start);
+        record_pass(v, &job, set, validation_loss);
+
+        pthread_mutex_lock(&v->lock);
+    }
+    pthread_mutex_unlock(&v->lock);
+    return NULL;
+}
+
+int validator_init(Validator *v, const ValidationConfig *config, const NeuralNetwork *nn, const CollocationBatch *full_set, int capacity, int derivative_order, Precision precision, ValidationFunction evaluate, void *context, const char *loss_type, ActivationFunction activation) {
+    memset(v, 0, sizeof(*v));
+    v->config = *config;
+    v->full_set = *full_set;
+    v->evaluate = evaluate;
+    v->context = context;
+    v->activation = activation;
+    v->best_loss = INFINITY;
+    v->best_epoch = -1;
+    snprintf(v->loss_type, sizeof(v->loss_type), "%s", loss_type);
+    if (!build_subset(v, nn_input_size(nn)) ||
+        !allocate_encoded_network(&v->snapshot, nn->layer_sizes, nn->num_layers, &nn->encoding.config, NULL) ||
+        !set_parameter_inputs(&v->snapshot, &nn->parameter_inputs) ||
+        !init_jet_workspace(&v->ws, nn, capacity, derivative_order, precision)) {
+        validator_free(v);
+        return 0;
+    }
+
+    pthread_mutex_init(&v->lock, NULL);
+    pthread_cond_init(&v->cond, NULL);
+    if (pthread_create(&v->thread, NULL, validator_thread, v) != 0) {
+        fprintf(stderr, "Error: Failed to start the validation thread\n");
+        pthread_mutex_destroy(&v->lock);
+        pthread_cond_destroy(&v->cond);
+        validator_free(v);
+        return 0;
+    }
+    v->started = 1;
+    v->last_submit = monotonic_seconds();
+    return 1;
+}
+
+void validator_free(Validator *v) {
+    if (v->started) {
+        pthread_mutex_lock(&v->lock);
+        v->stop = 1;
+        pthread_cond_broadcast(&v->cond);
+        pthread_mutex_unlock(&v->lock);
+        pthread_join(v->thread, NULL);
+        pthread_mutex_destroy(&v->lock);
+        pthread_cond_destroy(&v->cond);
+    }
+    free_jet_workspace(&v->ws);
+    free_neural_network(&v->snapshot);
+    arena_free(&v->arena);
+    memset(v, 0, sizeof(*v));
+}
+
+int validator_due(const Validator *v, int epoch) {
+    if (v->config.every > 0 && epoch % v->config.every == 0) {
+        return 1;
+    }
+    return v->config.seconds > 0.0 && monotonic_seconds() - v->last_submit >= v->config.seconds;
+}
+
+int validator_submit(Validator *v, const NeuralNetwork *nn, int epoch, double loss, double learning_rate, int full, int wait) {
+    pthread_mutex_lock(&v->lock);
+    if (v->pending && !wait) {
+        v->skipped++;
+        pthread_mutex_unlock(&v->lock);
+        return 0;
+    }
+    while (v->pending) {
+        pthread_cond_wait(&v->cond, &v->lock);
+    }
+    memcpy(v->snapshot.parameters, nn->parameters, nn->num_parameters * sizeof(double));
+    v->job.epoch = epoch;
+    v->job.loss = loss;
+    v->job.validation_loss = NAN;
+    v->job.learning_rate = learning_rate;
+    v->job.full = full;
+    v->pending = 1;
+    pthread_cond_signal(&v->cond);
+    pthread_mutex_unlock(&v->lock);
+    v->last_submit = monotonic_seconds();
+    return 1;
+}
+
+int validator_poll(Validator *v, ValidationResult *result) {
+    pthread_mutex_lock(&v->lock);
+    int fresh = v->results != v->results_seen;
+    if (fresh) {
+        *result = v->result;
+        v->results_seen = v->results;
+    }
+    pthread_mutex_unlock(&v->lock);
+    return fresh;
+}
+
+void validator_wait(Validator *v) {
+    pthread_mutex_lock(&v->lock);
+    while (v->pending) {
+        pthread_cond_wait(&v->cond, &v->lock);
+    }
+    pthread_mutex_unlock(&v->lock);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "loss_functions.h"
 
 void test_schrodinger_equation_loss() {
@@ -26,11 +27,74 @@ void test_navier_stokes_loss() {
     printf("Navier-Stokes Loss: %f\n", loss);
 }
 
+void test_heat_residual_loss() {
+    // u = exp(-alpha pi^2 t) sin(pi x) solves the heat equation exactly
+    double alpha = 0.5, x = 0.3, t = 0.2;
+    double decay = exp(-alpha * M_PI * M_PI * t);
+    double u[1] = {decay * sin(M_PI * x)};
+    double du[2] = {decay * M_PI * cos(M_PI * x), -alpha * M_PI * M_PI * u[0]};
+    double d2u[2] = {-M_PI * M_PI * u[0], alpha * alpha * M_PI * M_PI * M_PI * M_PI * u[0]};
+    PointDerivatives pd = {2, 1, u, du, d2u};
+    printf("Heat Residual Loss (exact solution): %e\n", heat_residual_loss(&pd, alpha, NULL));
+}
+
+// Central-difference derivatives of a reference solution, packed like a network jet
+typedef void (*ReferenceSolution)(const double *x, int input_dim, const double *args, double *u);
+
+static double reference_residual(ReferenceSolution solution, const double *args, int input_dim, const double *x, double (*residual)(const PointDerivatives *, const double *)) {
+    double u[3], du[3 * 3], d2u[3 * 3], plus[3], minus[3], h = 1e-4;
+    double point[3];
+    solution(x, input_dim, args, u);
+    for (int i = 0; i < input_dim; i++) {
+        memcpy(point, x, input_dim * sizeof(double));
+        point[i] += h;
+        solution(point, input_dim, args, plus);
+        point[i] -= 2 * h;
+        solution(point, input_dim, args, minus);
+        for (int k = 0; k < 3; k++) {
+            du[i * 3 + k] = (plus[k] - minus[k]) / (2 * h);
+            d2u[i * 3 + k] = (plus[k] - 2 * u[k] + minus[k]) / (h * h);
+        }
+    }
+    PointDerivatives pd = {input_dim, 3, u, du, d2u};
+    return residual(&pd, args);
+}
+
+static void schrodinger_solution(const double *x, int d, const double *a, double *u) { schrodinger_reference_solution(x, d, a[0], u); u[2] = 0.0; }
+static void maxwell_solution(const double *x, int d, const double *a, double *u) { maxwell_reference_solution(x, d, a[0], a[1], u); }
+static void heat_solution(const double *x, int d, const double *a, double *u) { heat_reference_solution(x, d, a[0], u); u[1] = u[2] = 0.0; }
+static void wave_solution(const double *x, int d, const double *a, double *u) { wave_reference_solution(x, d, a[0], u); u[1] = u[2] = 0.0; }
+static void navier_stokes_solution(const double *x, int d, const double *a, double *u) { navier_stokes_reference_solution(x, d, a[0], u); }
+static double schrodinger_residual(const PointDerivatives *pd, const double *a) { return schrodinger_residual_loss(pd, a[0], NULL); }
+static double maxwell_residual(const PointDerivatives *pd, const double *a) { return maxwell_residual_loss(pd, a[0], a[1], NULL); }
+static double heat_residual(const PointDerivatives *pd, const double *a) { return heat_residual_loss(pd, a[0], NULL); }
+static double wave_residual(const PointDerivatives *pd, const double *a) { return wave_residual_loss(pd, a[0], NULL); }
+static double navier_stokes_residual(const PointDerivatives *pd, const double *a) { return navier_stokes_residual_loss(pd, a[0], NULL); }
+static double schrodinger_conservation(const PointDerivatives *pd, const double *a) { (void)a; return schrodinger_conservation_loss(pd, NULL); }
+static double navier_stokes_conservation(const PointDerivatives *pd, const double *a) { (void)a; return navier_stokes_conservation_loss(pd, NULL); }
+
+void test_reference_solutions() {
+    // Boundary and initial values come from these, so each must satisfy its own PDE
+    double x2[2] = {0.3, 0.4}, x3[3] = {0.3, 0.6, 0.4};
+    double potential[1] = {0.1}, maxwell[2] = {1.0, 0.5}, diffusivity[1] = {0.5}, speed[1] = {2.0}, viscosity[1] = {0.01};
+    printf("Schrödinger Reference Residual: %e\n", reference_residual(schrodinger_solution, potential, 2, x2, schrodinger_residual));
+    printf("Maxwell Reference Residual: %e\n", reference_residual(maxwell_solution, maxwell, 2, x2, maxwell_residual));
+    printf("Heat Reference Residual: %e\n", reference_residual(heat_solution, diffusivity, 2, x2, heat_residual));
+    printf("Wave Reference Residual: %e\n", reference_residual(wave_solution, speed, 2, x2, wave_residual));
+    printf("Navier-Stokes 1-D Reference Residual: %e\n", reference_residual(navier_stokes_solution, viscosity, 2, x2, navier_stokes_residual));
+    printf("Navier-Stokes 2-D Reference Residual: %e\n", reference_residual(navier_stokes_solution, viscosity, 3, x3, navier_stokes_residual));
+    // The conservation terms must vanish on the same solutions
+    printf("Schrödinger Probability Conservation: %e\n", reference_residual(schrodinger_solution, potential, 2, x2, schrodinger_conservation));
+    printf("Navier-Stokes 2-D Mass Conservation: %e\n", reference_residual(navier_stokes_solution, viscosity, 3, x3, navier_stokes_conservation));
+}
+
 int main() {
     test_schrodinger_equation_loss();
     test_maxwell_equations_loss();
     test_heat_equation_loss();
     test_wave_equation_loss();
     test_navier_stokes_loss();
+    test_heat_residual_loss();
+    test_reference_solutions();
     return 0;
 }
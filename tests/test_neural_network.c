@@ -1,29 +1,1305 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
 #include "neural_network.h"
+#include "autodiff.h"
+#include "checkpoint.h"
+#include "pde.h"
+#include "optimizer.h"
+#include "inference.h"
+#include "loss_balance.h"
+#include "validation.h"
+#include "ensemble.h"
+#include "decomposition.h"
+#include "time_marching.h"
+#include "export.h"
+#include "distributed.h"
+#include "training.h"
+#include "logger.h"
+
+static const int default_layers[] = {INPUT_SIZE, HIDDEN_SIZE, OUTPUT_SIZE};
 
 void test_initialize_neural_network() {
     // Initialize neural network
     NeuralNetwork nn;
-    initialize_neural_network(&nn);
+    initialize_neural_network(&nn, default_layers, 3);
     if (validate_neural_network_initialization(&nn)) {
         printf("Neural Network Initialized and Validated.\n");
     } else {
         printf("Neural Network Initialization Validation Failed.\n");
     }
+    free_neural_network(&nn);
+}
+
+void test_layer_spec() {
+    // Parse a deep spec and check that every buffer is cache-line aligned
+    int layer_sizes[MAX_LAYERS];
+    int num_layers = parse_layer_spec("3,128,128,128,1", layer_sizes);
+    NeuralNetwork nn;
+    if (num_layers == 5 && initialize_neural_network(&nn, layer_sizes, num_layers)) {
+        int aligned = 1;
+        for (int l = 0; l + 1 < nn.num_layers; l++) {
+            aligned &= ((size_t)nn_weights(&nn, l) % ARENA_ALIGNMENT) == 0;
+            aligned &= ((size_t)nn_biases(&nn, l) % ARENA_ALIGNMENT) == 0;
+        }
+        printf("Layer Spec: %d layers, %zu parameters, aligned: %s\n", nn.num_layers, nn.num_parameters, aligned ? "yes" : "no");
+        free_neural_network(&nn);
+    } else {
+        printf("Layer Spec Parsing Failed.\n");
+    }
+    printf("Invalid Layer Spec Rejected: %s\n", parse_layer_spec("3,,1", layer_sizes) < 0 ? "yes" : "no");
+}
+
+void test_activation_kernels() {
+    // Fused kernels against libm, and their derivatives against central differences, in both modes
+    enum { N = 2001 };
+    static double z[N], a[N], d1[N], d2[N], d3[N];
+    const ActivationFunction functions[4] = {TANH, SIGMOID, SIN, SILU};
+    const char *names[4] = {"tanh", "sigmoid", "sin", "silu"};
+    for (int i = 0; i < N; i++) z[i] = -20.0 + 40.0 * i / (N - 1);
+
+    for (int mode = ACTIVATION_ACCURATE; mode <= ACTIVATION_FAST; mode++) {
+        set_activation_mode((ActivationMode)mode);
+        for (int f = 0; f < 4; f++) {
+            activate_fused(z, a, d1, d2, d3, N, functions[f]);
+            double max_value = 0.0, max_derivative = 0.0, h = 1e-4;
+            for (int i = 0; i < N; i++) {
+                double x = z[i], exact;
+                switch (functions[f]) {
+                    case TANH: exact = tanh(x); break;
+                    case SIGMOID: exact = 1.0 / (1.0 + exp(-x)); break;
+                    case SIN: exact = sin(x); break;
+                    default: exact = x / (1.0 + exp(-x)); break;
+                }
+                max_value = fmax(max_value, fabs(a[i] - exact));
+                // Each derivative against a difference of the one below it
+                double f0[3], fp[3], fm[3];
+                activation_derivatives(x + h, functions[f], &fp[0], &fp[1], &fp[2]);
+                activation_derivatives(x - h, functions[f], &fm[0], &fm[1], &fm[2]);
+                f0[0] = d1[i]; f0[1] = d2[i]; f0[2] = d3[i];
+                double numeric = (activate(x + h, functions[f]) - activate(x - h, functions[f])) / (2 * h);
+                max_derivative = fmax(max_derivative, fabs(f0[0] - numeric));
+                max_derivative = fmax(max_derivative, fabs(f0[1] - (fp[0] - fm[0]) / (2 * h)));
+                max_derivative = fmax(max_derivative, fabs(f0[2] - (fp[1] - fm[1]) / (2 * h)));
+            }
+            printf("Activation %-7s (%s): max value error %e, max derivative error %e\n", names[f], mode == ACTIVATION_FAST ? "fast" : "accurate", max_value, max_derivative);
+        }
+    }
+    set_activation_mode(ACTIVATION_ACCURATE);
 }
 
 void test_forward_pass() {
     // Initialize neural network
     NeuralNetwork nn;
-    initialize_neural_network(&nn);
-    double input[2] = {1.0, 2.0}; // Example input for forward pass
-    double output[1] = {0}; // Output buffer
+    initialize_neural_network(&nn, default_layers, 3);
+    double input[INPUT_SIZE] = {1.0, 2.0}; // Example input for forward pass
+    double output[OUTPUT_SIZE] = {0}; // Output buffer
     forward_pass(&nn, input, output, RELU); // Perform forward pass
     printf("Forward Pass Output: %f\n", output[0]);
+    free_neural_network(&nn);
+}
+
+void test_forward_backward_batch() {
+    // The batched GEMM path must agree with the per-sample path, and its gradients with finite differences
+    enum { SAMPLES = 37 };
+    const int layers[] = {2, 19, 13, 3};
+    NeuralNetwork nn;
+    BatchWorkspace ws;
+    initialize_neural_network(&nn, layers, 4);
+    init_batch_workspace(&ws, &nn, SAMPLES);
+
+    double inputs[SAMPLES * 2], outputs[SAMPLES * 3], single[3], ones[SAMPLES * 3];
+    for (int i = 0; i < SAMPLES * 2; i++) inputs[i] = sin(0.7 * i);
+    for (int i = 0; i < SAMPLES * 3; i++) ones[i] = 1.0;
+
+    forward_pass_batch(&nn, &ws, inputs, SAMPLES, outputs, TANH);
+    double max_forward_error = 0.0;
+    for (int s = 0; s < SAMPLES; s++) {
+        forward_pass(&nn, inputs + 2 * s, single, TANH);
+        for (int k = 0; k < 3; k++) {
+            max_forward_error = fmax(max_forward_error, fabs(single[k] - outputs[3 * s + k]));
+        }
+    }
+    printf("Batched Forward Max Error: %e\n", max_forward_error);
+
+    // d(sum of outputs)/d(first weight) against a central difference
+    memset(nn.gradients, 0, nn.num_parameters * sizeof(double));
+    backward_pass_batch(&nn, &ws, ones, SAMPLES, TANH, nn.gradients);
+    double h = 1e-6, plus = 0.0, minus = 0.0;
+    nn.parameters[0] += h;
+    forward_pass_batch(&nn, &ws, inputs, SAMPLES, outputs, TANH);
+    for (int i = 0; i < SAMPLES * 3; i++) plus += outputs[i];
+    nn.parameters[0] -= 2 * h;
+    forward_pass_batch(&nn, &ws, inputs, SAMPLES, outputs, TANH);
+    for (int i = 0; i < SAMPLES * 3; i++) minus += outputs[i];
+    nn.parameters[0] += h;
+    printf("Batched Backward Gradient Error: %e\n", fabs(nn.gradients[0] - (plus - minus) / (2 * h)));
+
+    // A workspace smaller than the batch runs it in chunks with the same results
+    BatchWorkspace small;
+    double chunked[SAMPLES * 3];
+    init_batch_workspace(&small, &nn, 8);
+    forward_pass_batch(&nn, &ws, inputs, SAMPLES, outputs, TANH);
+    forward_pass_batch(&nn, &small, inputs, SAMPLES, chunked, TANH);
+    printf("Chunked Batch Outputs Match: %s\n", memcmp(outputs, chunked, sizeof(chunked)) == 0 ? "yes" : "no");
+    free_batch_workspace(&small);
+
+    free_batch_workspace(&ws);
+    free_neural_network(&nn);
+}
+
+void test_forward_pass_jet() {
+    // Forward-mode derivatives against central finite differences of forward_pass
+    const int layers[] = {2, 16, 16, 3};
+    NeuralNetwork nn;
+    JetWorkspace ws;
+    initialize_neural_network(&nn, layers, 4);
+    init_jet_workspace(&ws, &nn, 2, 2, PRECISION_FP64);
+
+    double points[4] = {0.3, 0.7, -0.4, 0.2};
+    forward_pass_jet(&nn, &ws, points, 2, TANH);
+
+    double h = 1e-4, max_first = 0.0, max_second = 0.0;
+    for (int s = 0; s < 2; s++) {
+        PointDerivatives pd;
+        jet_point_derivatives(&nn, &ws, s, &pd);
+        for (int i = 0; i < 2; i++) {
+            double x[2], plus[3], minus[3], center[3];
+            memcpy(x, points + 2 * s, sizeof(x));
+            forward_pass(&nn, x, center, TANH);
+            x[i] += h;
+            forward_pass(&nn, x, plus, TANH);
+            x[i] -= 2 * h;
+            forward_pass(&nn, x, minus, TANH);
+            for (int k = 0; k < 3; k++) {
+                max_first = fmax(max_first, fabs(pd_first(&pd, i, k) - (plus[k] - minus[k]) / (2 * h)));
+                max_second = fmax(max_second, fabs(pd_second(&pd, i, k) - (plus[k] - 2 * center[k] + minus[k]) / (h * h)));
+            }
+        }
+    }
+    printf("Jet First Derivative Max Error: %e\n", max_first);
+    printf("Jet Second Derivative Max Error: %e\n", max_second);
+
+    free_jet_workspace(&ws);
+    free_neural_network(&nn);
+}
+
+// Interior residual loss of a registered operator, evaluated through its batch kernel
+static double jet_pde_loss(const NeuralNetwork *nn, JetWorkspace *ws, const PdeOperator *op, const double *points, int n, double *gradients) {
+    LossParameters params = {.potential = 0.3, .charge_density = 1.0, .current_density = 0.5, .thermal_conductivity = 0.5, .wave_speed = 1.0, .viscosity = 0.01};
+    JetBatch jets;
+    forward_pass_jet(nn, ws, points, n, TANH);
+    if (gradients) clear_jet_adjoints(nn, ws, n);
+    jet_output_batch(nn, ws, gradients != NULL, &jets);
+    double loss = op->residual(&jets, 0, n, &params, 1.0, NULL);
+    if (gradients) backward_pass_jet(nn, ws, n, TANH, gradients);
+    return loss;
+}
+
+void test_backward_pass_jet() {
+    // Reverse sweep through the derivative channels against finite differences of the residual
+    // loss, for a second-order (heat) and a first-order (Maxwell) operator
+    const char *names[2] = {"heat", "maxwell"};
+    const int layers[] = {2, 12, 12, 3};
+    double points[6] = {0.1, 0.2, 0.5, 0.9, 0.8, 0.4};
+
+    for (int k = 0; k < 2; k++) {
+        const PdeOperator *op = find_pde_operator(names[k]);
+        NeuralNetwork nn;
+        JetWorkspace ws;
+        initialize_neural_network(&nn, layers, 4);
+        init_jet_workspace(&ws, &nn, 3, op->derivative_order, PRECISION_FP64);
+
+        memset(nn.gradients, 0, nn.num_parameters * sizeof(double));
+        jet_pde_loss(&nn, &ws, op, points, 3, nn.gradients);
+
+        double max_error = 0.0, h = 1e-6;
+        size_t probes[4] = {0, 7, nn.bias_offsets[1] + 3, nn.weight_offsets[2] + 5};
+        for (int p = 0; p < 4; p++) {
+            double saved = nn.parameters[probes[p]];
+            nn.parameters[probes[p]] = saved + h;
+            double plus = jet_pde_loss(&nn, &ws, op, points, 3, NULL);
+            nn.parameters[probes[p]] = saved - h;
+            double minus = jet_pde_loss(&nn, &ws, op, points, 3, NULL);
+            nn.parameters[probes[p]] = saved;
+            double numeric = (plus - minus) / (2 * h);
+            max_error = fmax(max_error, fabs(numeric - nn.gradients[probes[p]]) / fmax(1.0, fabs(numeric)));
+        }
+        printf("Jet Backward Gradient Max Relative Error (%s, order %d): %e\n", names[k], op->derivative_order, max_error);
+
+        free_jet_workspace(&ws);
+        free_neural_network(&nn);
+    }
+}
+
+void test_reduced_precision_jet() {
+    // The float sweep against the double one: output jets and residual-loss gradients
+    const PdeOperator *op = find_pde_operator("heat");
+    const int layers[] = {2, 32, 32, 3};
+    double points[16];
+    for (int i = 0; i < 16; i++) points[i] = 0.05 + 0.06 * i;
+
+    NeuralNetwork nn;
+    JetWorkspace reference, reduced;
+    initialize_neural_network(&nn, layers, 4);
+    init_jet_workspace(&reference, &nn, 8, op->derivative_order, PRECISION_FP64);
+    init_jet_workspace(&reduced, &nn, 8, op->derivative_order, PRECISION_MIXED);
+    double *expected = calloc(nn.num_parameters, sizeof(double));
+    double *actual = calloc(nn.num_parameters, sizeof(double));
+
+    jet_pde_loss(&nn, &reference, op, points, 8, expected);
+    jet_pde_loss(&nn, &reduced, op, points, 8, actual);
+    double max_jet = 0.0, max_gradient = 0.0, scale = 0.0;
+    size_t count = (size_t)8 * reference.channels * 3;
+    for (size_t i = 0; i < count; i++) {
+        max_jet = fmax(max_jet, fabs(reference.jets[3][i] - reduced.jets[3][i]));
+    }
+    for (size_t p = 0; p < nn.num_parameters; p++) {
+        max_gradient = fmax(max_gradient, fabs(expected[p] - actual[p]));
+        scale = fmax(scale, fabs(expected[p]));
+    }
+    printf("Mixed Precision Jet Max Error: %e\n", max_jet);
+    printf("Mixed Precision Gradient Max Relative Error: %e\n", max_gradient / scale);
+
+    free(expected);
+    free(actual);
+    free_jet_workspace(&reference);
+    free_jet_workspace(&reduced);
+    free_neural_network(&nn);
+}
+
+// Shard sweep of the heat residual over points [begin, end), scaled so that shards add up
+static void residual_sweep(void *context, const NeuralNetwork *nn, JetWorkspace *ws, int begin, int end, double *gradients, double *sums) {
+    const double *points = context;
+    LossParameters params = {.thermal_conductivity = 0.5};
+    const PdeOperator *op = find_pde_operator("heat");
+    for (int start = begin; start < end; start += ws->capacity) {
+        int chunk = end - start < ws->capacity ? end - start : ws->capacity;
+        JetBatch jets;
+        forward_pass_jet(nn, ws, points + (size_t)start * 2, chunk, TANH);
+        if (gradients) clear_jet_adjoints(nn, ws, chunk);
+        jet_output_batch(nn, ws, gradients != NULL, &jets);
+        sums[0] += op->residual(&jets, 0, chunk, &params, 1.0 / 3000, NULL);
+        if (gradients) backward_pass_jet(nn, ws, chunk, TANH, gradients);
+    }
+}
+
+void test_data_parallel_gradients() {
+    // Two sweeps on the same thread count agree bit for bit; the sharded gradient matches the
+    // single-thread one up to the summation order
+    const int layers[] = {2, 32, 32, 1};
+    int count = 3000;
+    NeuralNetwork nn;
+    initialize_neural_network(&nn, layers, 4);
+    double *points = malloc((size_t)count * 2 * sizeof(double));
+    for (int i = 0; i < count * 2; i++) points[i] = fmod(0.618034 * (i + 1), 1.0);
+    double *single = calloc(nn.num_parameters, sizeof(double));
+    double *first = calloc(nn.num_parameters, sizeof(double));
+    double *second = calloc(nn.num_parameters, sizeof(double));
+
+    DataParallel dp;
+    double loss_single = 0.0, loss_first = 0.0, loss_second = 0.0;
+    init_data_parallel(&dp, &nn, 1, count, 1, 2, PRECISION_FP64);
+    data_parallel_sweep(&dp, &nn, residual_sweep, points, 0, count, single, &loss_single);
+    free_data_parallel(&dp);
+    init_data_parallel(&dp, &nn, 4, count, 1, 2, PRECISION_FP64);
+    data_parallel_sweep(&dp, &nn, residual_sweep, points, 0, count, first, &loss_first);
+    data_parallel_sweep(&dp, &nn, residual_sweep, points, 0, count, second, &loss_second);
+    free_data_parallel(&dp);
+
+    double max_error = 0.0;
+    for (size_t p = 0; p < nn.num_parameters; p++) {
+        max_error = fmax(max_error, fabs(first[p] - single[p]) / fmax(1e-12, fabs(single[p])));
+    }
+    int identical = memcmp(first, second, nn.num_parameters * sizeof(double)) == 0 && loss_first == loss_second;
+    printf("Sharded Gradient Reproducible (4 threads, 2 runs): %s\n", identical ? "bit-identical" : "DIFFERENT");
+    printf("Sharded vs Single-Thread Gradient Max Relative Difference: %e, loss %e\n", max_error, fabs(loss_first - loss_single) / loss_single);
+
+    free(points);
+    free(single);
+    free(first);
+    free(second);
+    free_neural_network(&nn);
+}
+
+void test_sparse_table_gradients() {
+    // Hash-grid gradients tracked by row. Sharded sweeps of two batches (the second clears only
+    // the rows the first wrote) match a dense single-tape sweep, the rows the reduction lists
+    // cover every nonzero one, and a lazy Adam step leaves every other row alone.
+    EncodingConfig config;
+    default_encoding_config(&config);
+    config.type = ENCODING_HASH_GRID;
+    config.input_dim = 2;
+    config.levels = 6;
+    config.log2_table_size = 8;
+    Encoding layout;
+    encoding_layout(&layout, &config);
+    int layers[4] = {layout.output_dim, 16, 16, 1};
+    NeuralNetwork nn;
+    allocate_encoded_network(&nn, layers, 4, &config, NULL);
+    init_parameters(&nn, INIT_XAVIER, RNG_DEFAULT_SEED, 0);
+    int count = 300, width = config.features;
+    size_t rows = nn.encoding.num_parameters / width;
+
+    // The second batch sits in one corner of the cube, far from most rows the first one hit
+    double *points = malloc((size_t)count * 4 * sizeof(double));
+    for (int i = 0; i < count * 2; i++) {
+        points[i] = fmod(0.618034 * (i + 1), 1.0);
+        points[count * 2 + i] = 0.25 * fmod(0.414214 * (i + 1), 1.0);
+    }
+    double *reference = calloc(nn.num_parameters, sizeof(double));
+    double *dense = calloc(nn.num_parameters, sizeof(double));
+    double *lazy = malloc(nn.num_parameters * sizeof(double));
+    double loss = 0.0;
+    JetWorkspace ws;
+    init_jet_workspace(&ws, &nn, count, 2, PRECISION_FP64);
+    residual_sweep(points + count * 2, &nn, &ws, 0, count, reference, &loss);
+    free_jet_workspace(&ws);
+
+    DataParallel dp;
+    init_data_parallel(&dp, &nn, 3, count, 1, 2, PRECISION_FP64);
+    data_parallel_sweep(&dp, &nn, residual_sweep, points, 0, count, dense, NULL);
+    data_parallel_sweep(&dp, &nn, residual_sweep, points + count * 2, 0, count, dense, NULL);
+    double max_error = 0.0;
+    for (size_t p = 0; p < nn.num_parameters; p++) {
+        max_error = fmax(max_error, fabs(dense[p] - reference[p]) / fmax(1e-12, fabs(reference[p])));
+    }
+
+    // Sparse output writes the listed rows only; the sentinel elsewhere must survive
+    for (size_t p = 0; p < nn.num_parameters; p++) lazy[p] = 7.0;
+    dp.sparse_output = 1;
+    data_parallel_sweep(&dp, &nn, residual_sweep, points + count * 2, 0, count, lazy, NULL);
+    const RowSet *touched = &dp.touched[0];
+    int listed_match = memcmp(lazy, dense, nn.encoding_offset * sizeof(double)) == 0, unlisted_clean = 1;
+    for (size_t r = 0; r < rows; r++) {
+        const double *lazy_row = lazy + nn.encoding_offset + r * width;
+        const double *dense_row = dense + nn.encoding_offset + r * width;
+        for (int j = 0; j < width; j++) {
+            if (touched->marks[r]) listed_match &= lazy_row[j] == dense_row[j];
+            else unlisted_clean &= lazy_row[j] == 7.0 && dense_row[j] == 0.0;
+        }
+    }
+    printf("Sparse Table Gradients (3 threads, second batch): max relative difference %e, %zu of %zu rows listed, listed rows %s, others %s\n", max_error,
+           row_set_count(touched), rows, listed_match ? "match" : "DIFFER", unlisted_clean ? "zero and unwritten" : "WRITTEN");
+
+    // A lazy Adam step reads and moves only the listed rows (the sentinel would blow up the rest)
+    OptimizerConfig adam;
+    default_optimizer_config(&adam, OPTIMIZER_ADAM);
+    Optimizer optimizer;
+    optimizer_init(&optimizer, &adam, nn.num_parameters);
+    optimizer.sparse = touched;
+    optimizer.sparse_offset = nn.encoding_offset;
+    optimizer.sparse_width = width;
+    double *before = malloc(nn.num_parameters * sizeof(double));
+    memcpy(before, nn.parameters, nn.num_parameters * sizeof(double));
+    optimizer_step(&optimizer, nn.parameters, lazy, &loss, 1e-3, NULL, NULL);
+    size_t moved = 0, strays = 0;
+    for (size_t r = 0; r < rows; r++) {
+        int changed = memcmp(nn.parameters + nn.encoding_offset + r * width, before + nn.encoding_offset + r * width, width * sizeof(double)) != 0;
+        moved += changed && touched->marks[r];
+        strays += changed && !touched->marks[r];
+    }
+    printf("Lazy Adam Step: %zu table rows moved, %zu untouched rows moved, layers %s\n", moved, strays,
+           memcmp(nn.parameters, before, nn.encoding_offset * sizeof(double)) != 0 ? "moved" : "UNCHANGED");
+
+    optimizer_free(&optimizer);
+    free_data_parallel(&dp);
+    free(before);
+    free(points);
+    free(reference);
+    free(dense);
+    free(lazy);
+    free_neural_network(&nn);
+}
+
+void test_input_encoding() {
+    // Jets of Fourier-feature and hash-grid networks against finite differences of
+    // forward_pass, and residual-loss gradients of the dense weights and the hash tables
+    const PdeOperator *op = find_pde_operator("heat");
+    const EncodingType types[2] = {ENCODING_FOURIER, ENCODING_HASH_GRID};
+    const char *names[2] = {"Fourier", "Hash Grid"};
+    double points[6] = {-0.61, 0.33, 0.12, 1.47, 0.83, 0.91};
+
+    for (int k = 0; k < 2; k++) {
+        EncodingConfig config;
+        default_encoding_config(&config);
+        config.type = types[k];
+        config.input_dim = 2;
+        config.frequencies = 8;
+        config.scale = 1.0;
+        config.levels = 4;
+        config.log2_table_size = 6;        // The two finer levels are hashed
+        config.lower[0] = -1.0;
+        config.upper[1] = 2.0;
+        Encoding layout;
+        encoding_layout(&layout, &config);
+        int layers[4] = {layout.output_dim, 12, 12, 3};
+
+        NeuralNetwork nn;
+        JetWorkspace ws;
+        allocate_encoded_network(&nn, layers, 4, &config, NULL);
+        init_parameters(&nn, INIT_XAVIER, RNG_DEFAULT_SEED, 0);
+        // Order-one table entries, so the grid features are visible in every derivative
+        for (size_t i = 0; i < nn.encoding.num_parameters; i++) {
+            nn_encoding_tables(&nn)[i] = sin(0.7 * i);
+        }
+        init_jet_workspace(&ws, &nn, 3, op->derivative_order, PRECISION_FP64);
+
+        forward_pass_jet(&nn, &ws, points, 3, TANH);
+        double h = 1e-5, max_first = 0.0, max_second = 0.0;
+        for (int s = 0; s < 3; s++) {
+            PointDerivatives pd;
+            jet_point_derivatives(&nn, &ws, s, &pd);
+            for (int i = 0; i < 2; i++) {
+                double x[2], plus[3], minus[3], center[3];
+                memcpy(x, points + 2 * s, sizeof(x));
+                forward_pass(&nn, x, center, TANH);
+                x[i] += h;
+                forward_pass(&nn, x, plus, TANH);
+                x[i] -= 2 * h;
+                forward_pass(&nn, x, minus, TANH);
+                for (int o = 0; o < 3; o++) {
+                    max_first = fmax(max_first, fabs(pd_first(&pd, i, o) - (plus[o] - minus[o]) / (2 * h)));
+                    max_second = fmax(max_second, fabs(pd_second(&pd, i, o) - (plus[o] - 2 * center[o] + minus[o]) / (h * h)));
+                }
+            }
+        }
+
+        memset(nn.gradients, 0, nn.num_parameters * sizeof(double));
+        jet_pde_loss(&nn, &ws, op, points, 3, nn.gradients);
+        size_t probes[4] = {3, nn.weight_offsets[0] + 17, nn.weight_offsets[2] + 5, nn.weight_offsets[1] + 40};
+        if (nn.encoding.num_parameters > 0) {
+            // The table entries with the largest gradients on the coarsest and the finest level
+            size_t fine = nn.encoding.level_offset[3] * config.features;
+            for (size_t i = 0; i < nn.encoding.num_parameters; i++) {
+                size_t *slot = i < fine ? &probes[2] : &probes[3];
+                size_t index = nn.encoding_offset + i;
+                if (*slot < nn.encoding_offset || fabs(nn.gradients[index]) > fabs(nn.gradients[*slot])) {
+                    *slot = index;
+                }
+            }
+        }
+        double max_error = 0.0, step = 1e-6;
+        for (int p = 0; p < 4; p++) {
+            double saved = nn.parameters[probes[p]];
+            nn.parameters[probes[p]] = saved + step;
+            double plus = jet_pde_loss(&nn, &ws, op, points, 3, NULL);
+            nn.parameters[probes[p]] = saved - step;
+            double minus = jet_pde_loss(&nn, &ws, op, points, 3, NULL);
+            nn.parameters[probes[p]] = saved;
+            double numeric = (plus - minus) / (2 * step);
+            max_error = fmax(max_error, fabs(numeric - nn.gradients[probes[p]]) / fmax(1.0, fabs(numeric)));
+        }
+        // The float sweep starts from the same double encoding and scatters into the same tables
+        JetWorkspace reduced;
+        double *actual = calloc(nn.num_parameters, sizeof(double));
+        init_jet_workspace(&reduced, &nn, 3, op->derivative_order, PRECISION_MIXED);
+        jet_pde_loss(&nn, &reduced, op, points, 3, actual);
+        double max_mixed = 0.0, scale = 0.0;
+        for (size_t p = 0; p < nn.num_parameters; p++) {
+            max_mixed = fmax(max_mixed, fabs(actual[p] - nn.gradients[p]));
+            scale = fmax(scale, fabs(nn.gradients[p]));
+        }
+
+        printf("%s Encoding: %d features, %zu table values\n", names[k], layout.output_dim, nn.encoding.num_parameters);
+        printf("%s Encoding Jet Max Error: first %e, second %e\n", names[k], max_first, max_second);
+        printf("%s Encoding Gradient Max Relative Error: %e (mixed precision %e)\n", names[k], max_error, max_mixed / scale);
+
+        free(actual);
+        free_jet_workspace(&reduced);
+        free_jet_workspace(&ws);
+        free_neural_network(&nn);
+    }
+}
+
+// Rosenbrock in n dimensions, the usual stress test for quasi-Newton steps
+static double rosenbrock(void *context, double *gradients) {
+    const double *x = context;
+    double value = 0.0;
+    memset(gradients, 0, 8 * sizeof(double));
+    for (int i = 0; i + 1 < 8; i++) {
+        double a = x[i + 1] - x[i] * x[i], b = 1.0 - x[i];
+        value += 100.0 * a * a + b * b;
+        gradients[i] += -400.0 * x[i] * a - 2.0 * b;
+        gradients[i + 1] += 200.0 * a;
+    }
+    return value;
+}
+
+void test_optimizers() {
+    // 8 parameters fill exactly one cache line, like a padded parameter blob
+    const OptimizerType types[3] = {OPTIMIZER_ADAM, OPTIMIZER_ADAMW, OPTIMIZER_LBFGS};
+    const char *names[3] = {"adam", "adamw", "lbfgs"};
+    const int steps[3] = {5000, 5000, 100};
+    for (int k = 0; k < 3; k++) {
+        OptimizerConfig config;
+        Optimizer opt;
+        double x[8], g[8];
+        default_optimizer_config(&config, types[k]);
+        config.weight_decay = 0.0;
+        optimizer_init(&opt, &config, 8);
+        for (int i = 0; i < 8; i++) x[i] = -1.2;
+        double loss = rosenbrock(x, g);
+        int wolfe = 0, moved = 0;
+        for (int step = 0; step < steps[k]; step++) {
+            double x0[8], g0[8], loss0 = loss;
+            memcpy(x0, x, sizeof(x));
+            memcpy(g0, g, sizeof(g));
+            double alpha = optimizer_step(&opt, x, g, &loss, 0.01, rosenbrock, x);
+            if (!opt.method->full_batch) {
+                loss = rosenbrock(x, g);
+                continue;
+            }
+            // Every accepted step has to meet both strong-Wolfe conditions along its direction
+            if (alpha == 0.0) continue;
+            double slope0 = 0.0, slope = 0.0;
+            for (int i = 0; i < 8; i++) {
+                double direction = (x[i] - x0[i]) / alpha;
+                slope0 += g0[i] * direction;
+                slope += g[i] * direction;
+            }
+            moved++;
+            wolfe += loss <= loss0 + WOLFE_C1 * alpha * slope0 && fabs(slope) <= WOLFE_C2 * fabs(slope0);
+        }
+        printf("Optimizer %-5s: Rosenbrock after %d steps %e\n", names[k], steps[k], loss);
+        if (opt.method->full_batch) {
+            printf("L-BFGS Steps Meeting Strong Wolfe: %d of %d\n", wolfe, moved);
+        }
+        optimizer_free(&opt);
+    }
+
+    // One AdamW step with decay from zero moments: the bias-corrected moments reduce to g and
+    // |g|, so x1 = (1 - lr wd) x0 - lr g / (|g| + eps); Adam folds the decay into g instead
+    double x0[8], g0[8], adamw[8], adam[8], max_error = 0.0, max_gap = 0.0;
+    double lr = 0.05, wd = 0.2;
+    for (int i = 0; i < 8; i++) {
+        x0[i] = 0.3 * i - 1.0;
+        g0[i] = 0.01 * (i - 3) * (i - 3) - 0.02;
+    }
+    for (int k = 0; k < 2; k++) {
+        OptimizerConfig config;
+        Optimizer opt;
+        double g[8];
+        default_optimizer_config(&config, k == 0 ? OPTIMIZER_ADAMW : OPTIMIZER_ADAM);
+        config.weight_decay = wd;
+        optimizer_init(&opt, &config, 8);
+        double *x = k == 0 ? adamw : adam;
+        memcpy(x, x0, sizeof(x0));
+        memcpy(g, g0, sizeof(g0));
+        optimizer_step(&opt, x, g, NULL, lr, NULL, NULL);
+        for (int i = 0; i < 8; i++) {
+            double grad = k == 0 ? g0[i] : g0[i] + wd * x0[i];
+            double expected = (k == 0 ? 1.0 - lr * wd : 1.0) * x0[i] - lr * grad / (fabs(grad) + config.epsilon);
+            max_error = fmax(max_error, fabs(x[i] - expected));
+        }
+        optimizer_free(&opt);
+    }
+    for (int i = 0; i < 8; i++) {
+        max_gap = fmax(max_gap, fabs(adamw[i] - adam[i]));
+    }
+    printf("AdamW/Adam Step with Weight Decay %.1f vs Hand-Computed: max error %e, AdamW differs from Adam by %.4f\n", wd, max_error, max_gap);
+
+    LearningRateSchedule schedule;
+    default_learning_rate_schedule(&schedule, 0.1, 101);
+    schedule.type = SCHEDULE_COSINE;
+    schedule.warmup_epochs = 10;
+    printf("Cosine Schedule with Warmup: %.4f %.4f %.4f %.4f\n", schedule_learning_rate(&schedule, 0), schedule_learning_rate(&schedule, 9),
+           schedule_learning_rate(&schedule, 55), schedule_learning_rate(&schedule, 100));
+}
+
+void test_checkpoint_round_trip() {
+    const int layers[] = {3, 17, 9, 2};
+    const char *filename = "test_checkpoint.ckpt";
+    NeuralNetwork nn, loaded;
+    initialize_neural_network(&nn, layers, 4);
+
+    CheckpointState state;
+    memset(&state, 0, sizeof(state));
+    state.epoch = 42;
+    state.activation = SIGMOID;
+    snprintf(state.loss_type, sizeof(state.loss_type), "heat");
+    state.sampler.rng_position = 0x123456789ULL;
+    double pool[12];
+    for (int i = 0; i < 12; i++) pool[i] = 0.1 * i;
+    state.sampler.pool_size = 4;
+    state.refinement_pool = pool;
+    state.refinement_pool_size = 12;
+    save_checkpoint(&nn, &state, filename);
+
+    CheckpointState restored;
+    int ok = load_checkpoint(&loaded, filename, &restored);
+    int identical = ok && loaded.num_parameters == nn.num_parameters &&
+                    memcmp(loaded.parameters, nn.parameters, nn.num_parameters * sizeof(double)) == 0 &&
+                    ((size_t)loaded.parameters % ARENA_ALIGNMENT) == 0 &&
+                    restored.epoch == 42 && restored.activation == SIGMOID &&
+                    strcmp(restored.loss_type, "heat") == 0 && restored.sampler.rng_position == 0x123456789ULL &&
+                    restored.sampler.pool_size == 4 && restored.refinement_pool_size == 12 && memcmp(restored.refinement_pool, pool, sizeof(pool)) == 0;
+    printf("Checkpoint Round Trip: %s\n", identical ? "identical" : "MISMATCH");
+    if (ok) free_neural_network(&loaded);
+
+    // Header fields are covered too: a changed epoch must not load
+    FILE *file = fopen(filename, "r+b");
+    fseek(file, (long)offsetof(CheckpointHeader, epoch), SEEK_SET);
+    int byte = fgetc(file);
+    fseek(file, -1, SEEK_CUR);
+    fputc(byte ^ 0x01, file);
+    fclose(file);
+    ok = load_checkpoint(&loaded, filename, NULL);
+    printf("Corrupted Checkpoint Header Rejected: %s\n", ok ? "no" : "yes");
+    if (ok) free_neural_network(&loaded);
+    save_checkpoint(&nn, &state, filename);
+
+    // Flip one parameter byte on disk; the checksum has to catch it
+    file = fopen(filename, "r+b");
+    fseek(file, (long)arena_aligned_size(sizeof(CheckpointHeader)) + 100, SEEK_SET);
+    byte = fgetc(file);
+    fseek(file, -1, SEEK_CUR);
+    fputc(byte ^ 0x40, file);
+    fclose(file);
+    ok = load_checkpoint(&loaded, filename, NULL);
+    printf("Corrupted Checkpoint Rejected: %s\n", ok ? "no" : "yes");
+    if (ok) free_neural_network(&loaded);
+
+    remove(filename);
+    free_neural_network(&nn);
+}
+
+// Largest difference between a result file and forward_pass at the given points
+static double inference_error(NeuralNetwork *nn, const char *filename, const double *points, int num_points, InferenceHeader *header) {
+    FILE *file = fopen(filename, "rb");
+    double max_error = -1.0;
+    if (file == NULL || fread(header, sizeof(*header), 1, file) != 1 || memcmp(header->magic, INFERENCE_MAGIC, 8) != 0 ||
+        header->num_points != (uint64_t)num_points || fseek(file, (long)header->data_offset, SEEK_SET) != 0) {
+        if (file) fclose(file);
+        return max_error;
+    }
+    max_error = 0.0;
+    for (int s = 0; s < num_points; s++) {
+        double stored[3], expected[3];
+        if (fread(stored, sizeof(double), 3, file) != 3) {
+            max_error = -1.0;
+            break;
+        }
+        forward_pass(nn, points + 2 * s, expected, TANH);
+        for (int k = 0; k < 3; k++) {
+            max_error = fmax(max_error, fabs(stored[k] - expected[k]));
+        }
+    }
+    fclose(file);
+    return max_error;
+}
+
+// What the logger test records at epoch e
+static void logger_test_record(int e, LogRecord *record) {
+    record->epoch = e;
+    record->validation_epoch = e - e % 6;
+    record->loss = 1.0 / (e + 1);
+    record->validation_loss = 0.5 * e;
+    record->learning_rate = 1e-3;
+}
+
+// Number of records of path that match what logger_test_record wrote at the logged epochs
+// in order, or -1 at the first mismatch
+static int read_back_log(const char *path, LogFormat format, int num_epochs, int every) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return -1;
+    char line[256];
+    int matched = 0;
+    if (format == LOG_CSV && !fgets(line, sizeof(line), file)) matched = -1;
+    if (format == LOG_BINARY) {
+        LogFileHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, LOG_MAGIC, 8) != 0 || header.record_size != sizeof(LogRecord)) matched = -1;
+    }
+    for (int e = 0; e < num_epochs && matched >= 0; e++) {
+        if (e % every != 0 && e != num_epochs - 1) continue;
+        LogRecord expected, actual;
+        logger_test_record(e, &expected);
+        memset(&actual, 0, sizeof(actual));
+        actual.epoch = -1;
+        // Binary and csv are exact; text keeps five decimals and no learning rate, and names
+        // the validation epoch only when it lags
+        double tolerance = format == LOG_TEXT ? 5e-6 : 0.0;
+        if (format == LOG_BINARY) {
+            if (fread(&actual, sizeof(actual), 1, file) != 1) actual.epoch = -1;
+        } else if (fgets(line, sizeof(line), file) && format == LOG_CSV) {
+            sscanf(line, "%d,%lf,%lf,%lf,%d", &actual.epoch, &actual.loss, &actual.validation_loss, &actual.learning_rate, &actual.validation_epoch);
+        } else if (format == LOG_TEXT) {
+            actual.validation_epoch = -1;
+            actual.learning_rate = expected.learning_rate;
+            sscanf(line, "Epoch %d: Loss: %lf, Validation Loss: %lf (epoch %d)", &actual.epoch, &actual.loss, &actual.validation_loss, &actual.validation_epoch);
+            if (actual.validation_epoch < 0) actual.validation_epoch = actual.epoch;
+        }
+        int same = actual.epoch == expected.epoch && actual.validation_epoch == expected.validation_epoch && fabs(actual.loss - expected.loss) <= tolerance &&
+                   fabs(actual.validation_loss - expected.validation_loss) <= tolerance && actual.learning_rate == expected.learning_rate;
+        matched = same ? matched + 1 : -1;
+    }
+    if (matched >= 0 && fgets(line, sizeof(line), file)) matched = -1;
+    fclose(file);
+    return matched;
+}
+
+void test_logger() {
+    // Every format round-trips more records than the ring holds, at the log_every cadence
+    // plus the last epoch, and each run takes the next free run number
+    const LogFormat formats[3] = {LOG_TEXT, LOG_CSV, LOG_BINARY};
+    const char *expected_paths[3] = {"log_logger_test.txt", "log_logger_test_1.csv", "log_logger_test_2.bin"};
+    int num_epochs = 3 * LOG_RING_CAPACITY + 2, every = 2;
+    for (int f = 0; f < 3; f++) {
+        TrainingLogger logger;
+        int run = next_run_number(".", "logger_test");
+        if (!logger_open(&logger, "logger_test", formats[f], every)) continue;
+        for (int e = 0; e < num_epochs; e++) {
+            if (!logger_wants_epoch(&logger, e, num_epochs)) continue;
+            LogRecord record;
+            logger_test_record(e, &record);
+            logger_record(&logger, record.epoch, record.loss, record.validation_loss, record.validation_epoch, record.learning_rate);
+        }
+        logger_close(&logger);
+        int records = read_back_log(logger.path, formats[f], num_epochs, every);
+        printf("Logger Round Trip (%s): run %d, %d of %d records (ring %d), path %s\n", logger.path, run, records, num_epochs / every + 1, LOG_RING_CAPACITY,
+               strcmp(logger.path, expected_paths[f]) == 0 ? "as expected" : "UNEXPECTED");
+    }
+    for (int f = 0; f < 3; f++) {
+        remove(expected_paths[f]);
+    }
+
+    // A group of logs shares one writer; records interleaved across them land in the right files
+    TrainingLogger group[3];
+    if (logger_open_group(group, 3, "logger_test", LOG_CSV, every)) {
+        for (int e = 0; e < num_epochs; e++) {
+            if (!logger_wants_epoch(&group[0], e, num_epochs)) continue;
+            LogRecord record;
+            logger_test_record(e, &record);
+            for (int k = 0; k < 3; k++) {
+                logger_record(&group[k], record.epoch, record.loss, record.validation_loss, record.validation_epoch, record.learning_rate);
+            }
+        }
+        logger_close_group(group, 3);
+        for (int k = 0; k < 3; k++) {
+            printf("Logger Group (%s): %d of %d records\n", group[k].path, read_back_log(group[k].path, LOG_CSV, num_epochs, every), num_epochs / every + 1);
+            remove(group[k].path);
+        }
+    }
+}
+
+void test_inference() {
+    // Tiled, threaded inference against point-by-point forward passes, on a grid and on a points file
+    const int layers[] = {2, 16, 16, 3};
+    const char *model = "test_inference_model.ckpt", *output = "test_inference.bin", *points_file = "test_inference_points.bin";
+    NeuralNetwork nn;
+    initialize_neural_network(&nn, layers, 4);
+    save_model(&nn, "heat", TANH, model);
+
+    InferenceConfig config;
+    InferenceHeader header;
+    default_inference_config(&config);
+    config.model_path = model;
+    config.output_path = output;
+    config.threads = 3;
+    config.tile = 8;
+    parse_domain("-1:1,0:2", &config.grid);
+    config.resolution[0] = 7;
+    config.resolution[1] = 5;
+    double grid[70];
+    for (int i = 0; i < 7; i++) {
+        for (int j = 0; j < 5; j++) {
+            grid[2 * (i * 5 + j)] = -1.0 + i / 3.0;
+            grid[2 * (i * 5 + j) + 1] = j / 2.0;
+        }
+    }
+    run_inference(&config);
+    printf("Grid Inference Max Error: %e\n", inference_error(&nn, output, grid, 35, &header));
+
+    double points[74];
+    for (int i = 0; i < 74; i++) points[i] = sin(1.3 * i);
+    FILE *file = fopen(points_file, "wb");
+    fwrite(points, sizeof(double), 74, file);
+    fclose(file);
+    config.points_path = points_file;
+    run_inference(&config);
+    printf("Points File Inference Max Error: %e\n", inference_error(&nn, output, points, 37, &header));
+
+    remove(model);
+    remove(output);
+    remove(points_file);
+    free_neural_network(&nn);
+}
+
+void test_loss_balancer() {
+    // Synthetic per-term gradient statistics: the boundary gradient is 100x smaller than the residual's
+    TermGradientStats stats[TERM_COUNT] = {
+        {1.0, 10.0, 5.0, 1.0}, {0.5, 0.1, 0.05, 0.01}, {0.2, 1.0, 0.5, 0.1}, {0.0, 0.0, 0.0, 0.0}};
+    const int active[TERM_COUNT] = {1, 1, 1, 0};
+    LossWeightingConfig config;
+    LossBalancer balancer;
+    default_loss_weighting_config(&config);
+    config.smoothing = 1.0;
+
+    config.method = WEIGHTING_ANNEALING;
+    loss_balancer_init(&balancer, &config, active);
+    loss_balancer_update(&balancer, stats);
+    printf("Annealing Weights: %g %g %g %g (expected 1 500 50 0)\n", balancer.weights[0], balancer.weights[1], balancer.weights[2], balancer.weights[3]);
+
+    // On the first update every training rate is 1, so GradNorm equalises the weighted norms
+    config.method = WEIGHTING_GRADNORM;
+    loss_balancer_init(&balancer, &config, active);
+    loss_balancer_update(&balancer, stats);
+    printf("GradNorm Weighted Norms: %g %g %g (sum of weights %g)\n", balancer.weights[0] * stats[0].norm, balancer.weights[1] * stats[1].norm,
+           balancer.weights[2] * stats[2].norm, balancer.weights[0] + balancer.weights[1] + balancer.weights[2]);
+}
+
+// Stand-in validation loss: the first parameter of the snapshot
+static double first_parameter(const NeuralNetwork *snapshot, JetWorkspace *ws, const CollocationBatch *set, void *context) {
+    (void)ws;
+    (void)set;
+    (void)context;
+    return snapshot->parameters[0];
+}
+
+void test_validator() {
+    // Passes see the parameters as submitted, and the best snapshot is what gets saved
+    const int layers[] = {2, 4, 1};
+    const char *best_path = "test_best_model.ckpt";
+    double points[8] = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8};
+    CollocationBatch set = {points, 2, 1, 1};
+    ValidationConfig config = {1, 0.0, 0, best_path};
+    NeuralNetwork nn, best;
+    Validator validator;
+    ValidationResult result = {0};
+    initialize_neural_network(&nn, layers, 3);
+    validator_init(&validator, &config, &nn, &set, 4, 1, PRECISION_FP64, first_parameter, NULL, "heat", TANH);
+
+    nn.parameters[0] = 3.0;
+    validator_submit(&validator, &nn, 0, 0.0, 0.0, 0, 1);
+    nn.parameters[0] = 100.0;
+    validator_wait(&validator);
+    validator_poll(&validator, &result);
+    printf("Validator Snapshot Loss: %g (expected 3)\n", result.validation_loss);
+
+    const double later[3] = {1.0, 2.0, 1.5};
+    for (int epoch = 1; epoch <= 3; epoch++) {
+        nn.parameters[0] = later[epoch - 1];
+        validator_submit(&validator, &nn, epoch, 0.0, 0.0, 0, 1);
+    }
+    validator_wait(&validator);
+    CheckpointState best_state;
+    int loaded = load_checkpoint(&best, best_path, &best_state);
+    printf("Best Validation Epoch: %d (expected 1), saved parameter %g after %d epochs (expected 2)\n", validator.best_epoch, loaded ? best.parameters[0] : NAN,
+           loaded ? best_state.epoch : -1);
+    if (loaded) free_neural_network(&best);
+
+    validator_free(&validator);
+    remove(best_path);
+    free_neural_network(&nn);
+}
+
+// Composite loss and gradients of one member through the single-network jet path
+static double member_reference(EnsembleMember *member, JetWorkspace *ws, const PdeOperator *op, const CollocationBatch *batch, const double *weights, double *gradients) {
+    int n = collocation_batch_size(batch);
+    double sums[TERM_COUNT] = {0.0};
+    JetBatch jets;
+    forward_pass_jet(&member->nn, ws, batch->points, n, member->activation);
+    clear_jet_adjoints(&member->nn, ws, n);
+    jet_output_batch(&member->nn, ws, 1, &jets);
+    composite_loss_terms(&jets, batch, 0, n, op, &member->params, weights, sums);
+    memset(gradients, 0, member->nn.num_parameters * sizeof(double));
+    backward_pass_jet(&member->nn, ws, n, member->activation, gradients);
+    return combine_loss_terms(sums, batch, weights, NULL);
+}
+
+void test_ensemble() {
+    // Ten heat members in three lane groups (eight tanh, one partial tanh, one sin) against
+    // the same networks run one at a time
+    const int layers[] = {2, 6, 6, 1};
+    const double weights[TERM_COUNT] = {1.0, 2.0, 0.5, 0.0};
+    double points[18] = {0.1, 0.2, 0.5, 0.9, 0.8, 0.4, 0.3, 0.7, 0.6, 0.1, 0.0, 0.3, 1.0, 0.6, 0.2, 0.0, 0.7, 0.0};
+    CollocationBatch batch = {points, 5, 2, 2};
+    const PdeOperator *op = find_pde_operator("heat");
+    EnsembleMember members[10];
+    Ensemble ensemble;
+    JetWorkspace ws;
+    double *gradients;
+
+    memset(members, 0, sizeof(members));
+    for (int k = 0; k < 10; k++) {
+        initialize_neural_network(&members[k].nn, layers, 4);
+        members[k].activation = k == 9 ? SIN : TANH;
+        members[k].params.thermal_conductivity = 0.1 * (k + 1);
+    }
+    ensemble_init(&ensemble, members, 10, op, weights, op->derivative_order, 2);
+    ensemble_composite_loss(&ensemble, &batch, 1);
+    init_jet_workspace(&ws, &members[0].nn, 9, op->derivative_order, PRECISION_FP64);
+    gradients = malloc(members[0].nn.num_parameters * sizeof(double));
+
+    double loss_error = 0.0, gradient_error = 0.0;
+    for (int k = 0; k < 10; k++) {
+        double loss = member_reference(&members[k], &ws, op, &batch, weights, gradients);
+        loss_error = fmax(loss_error, fabs(members[k].loss - loss) / fmax(1.0, fabs(loss)));
+        for (size_t p = 0; p < members[k].nn.num_parameters; p++) {
+            gradient_error = fmax(gradient_error, fabs(members[k].nn.gradients[p] - gradients[p]) / fmax(1.0, fabs(gradients[p])));
+        }
+    }
+    printf("Ensemble Lane Groups: %d (expected 3)\n", ensemble.num_groups);
+    printf("Ensemble Max Relative Error: loss %e, gradients %e\n", loss_error, gradient_error);
+
+    free(gradients);
+    free_jet_workspace(&ws);
+    ensemble_free(&ensemble);
+    for (int k = 0; k < 10; k++) free_neural_network(&members[k].nn);
+}
+
+static double interface_loss(const NeuralNetwork *nn, JetWorkspace *ws, const double *points, const double *targets, const double *weights, double *gradients) {
+    JetBatch jets;
+    double sums[INTERFACE_TERM_COUNT] = {0.0};
+    forward_pass_jet(nn, ws, points, 3, TANH);
+    if (gradients) clear_jet_adjoints(nn, ws, 3);
+    jet_output_batch(nn, ws, gradients != NULL, &jets);
+    interface_loss_terms(&jets, 3, targets, 0, 2, weights, sums);
+    if (gradients) backward_pass_jet(nn, ws, 3, TANH, gradients);
+    return weights[INTERFACE_CONTINUITY] * sums[INTERFACE_CONTINUITY] + weights[INTERFACE_FLUX] * sums[INTERFACE_FLUX];
+}
+
+void test_decomposition() {
+    // A 2x2 layout from a file, its interfaces, a rejected layout with a gap, and the
+    // interface terms' gradients against finite differences
+    const char *filename = "test_decomposition.cfg";
+    FILE *file = fopen(filename, "w");
+    fprintf(file, "# 2x2 boxes\nsubdomain 0:0.5,0:0.5\nsubdomain 0.5:1,0:0.5 2,8,1\nsubdomain 0:0.5,0.5:1\nsubdomain 0.5:1,0.5:1\n");
+    fprintf(file, "overlap 0.1\nexchange_every 5\nflux_weight 0.5\n");
+    fclose(file);
+    DecompositionConfig config;
+    Domain domain;
+    InterfaceFace faces[8];
+    parse_domain("0:1,0:1", &domain);
+    int parsed = parse_decomposition(filename, &config);
+    remove(filename);
+    int num_faces = parsed && validate_decomposition(&config, &domain) ? find_interfaces(&config, faces, 8) : -1;
+    printf("Decomposition Interfaces: %d (expected 4), box 1 layers %d (expected 3)\n", num_faces, config.num_layers[1]);
+    config.boxes[0].upper[0] = 0.4;
+    printf("Gapped Decomposition Rejected: %s\n", validate_decomposition(&config, &domain) ? "no" : "yes");
+
+    const int layers[] = {2, 8, 8, 2};
+    double points[6] = {0.5, 0.1, 0.5, 0.4, 0.5, 0.9};
+    double targets[12] = {0.1, -0.2, 0.3, 0.0, -0.1, 0.2, 0.4, 0.1, 0.0, 0.3, -0.3, 0.2};
+    double weights[INTERFACE_TERM_COUNT] = {1.0, 0.5};
+    NeuralNetwork nn;
+    JetWorkspace ws;
+    initialize_neural_network(&nn, layers, 4);
+    init_jet_workspace(&ws, &nn, 3, 1, PRECISION_FP64);
+    memset(nn.gradients, 0, nn.num_parameters * sizeof(double));
+    interface_loss(&nn, &ws, points, targets, weights, nn.gradients);
+
+    double max_error = 0.0, h = 1e-6;
+    size_t probes[4] = {0, 5, nn.bias_offsets[1] + 2, nn.weight_offsets[2] + 3};
+    for (int p = 0; p < 4; p++) {
+        double saved = nn.parameters[probes[p]];
+        nn.parameters[probes[p]] = saved + h;
+        double plus = interface_loss(&nn, &ws, points, targets, weights, NULL);
+        nn.parameters[probes[p]] = saved - h;
+        double minus = interface_loss(&nn, &ws, points, targets, weights, NULL);
+        nn.parameters[probes[p]] = saved;
+        double numeric = (plus - minus) / (2 * h);
+        max_error = fmax(max_error, fabs(numeric - nn.gradients[probes[p]]) / fmax(1.0, fabs(numeric)));
+    }
+    printf("Interface Gradient Max Relative Error: %e\n", max_error);
+
+    free_jet_workspace(&ws);
+    free_neural_network(&nn);
+}
+
+void test_time_marching() {
+    // Causal weights of a few slice losses, and window initial targets against
+    // forward_pass and a central difference in time
+    const double slice_losses[4] = {0.5, 1.0, 0.0, 2.0};
+    double causal[4];
+    causal_weights(slice_losses, 4, 2.0, causal);
+    printf("Causal Weights: %.4f %.4f %.4f %.4f (expected 1.0000 0.3679 0.0498 0.0498)\n", causal[0], causal[1], causal[2], causal[3]);
+
+    const int layers[] = {2, 8, 8, 1};
+    const PdeOperator *op = find_pde_operator("wave");
+    LossParameters params = {0};
+    params.wave_speed = 1.0;
+    double points[6] = {0.2, 0.25, 0.7, 0.25, 0.4, 0.25};
+    double targets[6];
+    NeuralNetwork nn;
+    JetWorkspace ws;
+    initialize_neural_network(&nn, layers, 4);
+    init_jet_workspace(&ws, &nn, 2, op->derivative_order, PRECISION_FP64);
+    window_initial_targets(&nn, &ws, op, &params, TANH, points, 3, targets);
+
+    double value_error = 0.0, velocity_error = 0.0, h = 1e-5;
+    for (int p = 0; p < 3; p++) {
+        double x[2] = {points[2 * p], points[2 * p + 1]}, u, plus, minus;
+        forward_pass(&nn, x, &u, TANH);
+        x[1] += h;
+        forward_pass(&nn, x, &plus, TANH);
+        x[1] -= 2 * h;
+        forward_pass(&nn, x, &minus, TANH);
+        value_error = fmax(value_error, fabs(targets[2 * p] - u));
+        velocity_error = fmax(velocity_error, fabs(targets[2 * p + 1] - (plus - minus) / (2 * h)));
+    }
+    printf("Window Initial Targets Max Error: value %e, d/dt %e\n", value_error, velocity_error);
+
+    double reference[1];
+    window_initial_targets(NULL, &ws, op, &params, TANH, points, 1, targets);
+    op->reference(points, 2, &params, reference);
+    printf("First Window Targets: %g %g (expected %g 0)\n", targets[0], targets[1], reference[0]);
+
+    free_jet_workspace(&ws);
+    free_neural_network(&nn);
+}
+
+void test_parametric() {
+    // A heat network over (x, t, thermal_conductivity): the jets differentiate along (x, t)
+    // only, and the parameter column goes through the same scaling as in forward_pass
+    ParameterInputs inputs;
+    memset(&inputs, 0, sizeof(inputs));
+    int parsed = add_parameter_input(&inputs, "thermal_conductivity=0.1:0.5");
+    printf("Parameter Inputs: parsed %d, %s on [%g, %g], scaled 0.3 -> %g (expected 0)\n", parsed,
+           loss_parameter_name((LossParameterField)inputs.fields[0]), inputs.lower[0], inputs.upper[0], scaled_parameter_input(&inputs, 0, 0.3));
+
+    const int layers[] = {3, 8, 8, 1};
+    NeuralNetwork nn;
+    JetWorkspace ws;
+    initialize_neural_network(&nn, layers, 4);
+    set_parameter_inputs(&nn, &inputs);
+    init_jet_workspace(&ws, &nn, 2, 2, PRECISION_FP64);
+    printf("Parametric Jet Channels: %d (expected 5)\n", ws.channels);
+
+    double points[6] = {0.3, 0.6, 0.2, 0.7, 0.1, 0.45};
+    forward_pass_jet(&nn, &ws, points, 2, TANH);
+    double value_error = 0.0, slope_error = 0.0, h = 1e-5;
+    for (int p = 0; p < 2; p++) {
+        PointDerivatives pd;
+        double x[3], u, plus, minus;
+        jet_point_derivatives(&nn, &ws, p, &pd);
+        memcpy(x, points + 3 * p, sizeof(x));
+        forward_pass(&nn, x, &u, TANH);
+        x[0] += h;
+        forward_pass(&nn, x, &plus, TANH);
+        x[0] -= 2 * h;
+        forward_pass(&nn, x, &minus, TANH);
+        value_error = fmax(value_error, fabs(pd.u[0] - u));
+        slope_error = fmax(slope_error, fabs(pd.du[0] - (plus - minus) / (2 * h)));
+    }
+    printf("Parametric Jets Max Error: value %e, d/dx %e\n", value_error, slope_error);
+
+    LossParameters base = {0}, point;
+    double value = 0.25;
+    point_loss_parameters(&inputs, &base, &value, &point);
+    printf("Point Loss Parameters: thermal_conductivity %g (expected 0.25)\n", point.thermal_conductivity);
+
+    NeuralNetwork loaded;
+    ActivationFunction activation;
+    save_model(&nn, "heat", TANH, "test_parametric.ckpt");
+    if (load_model(&loaded, "test_parametric.ckpt", &activation)) {
+        printf("Parametric Checkpoint: %d parameter input(s), %d coordinate inputs, range [%g, %g]\n",
+               loaded.parameter_inputs.count, nn_coordinate_inputs(&loaded), loaded.parameter_inputs.lower[0], loaded.parameter_inputs.upper[0]);
+        free_neural_network(&loaded);
+    }
+    remove("test_parametric.ckpt");
+
+    free_jet_workspace(&ws);
+    free_neural_network(&nn);
+}
+
+void test_export_activations() {
+    // Every activation emitted into exported sources, compiled on its own where a compiler is
+    // on the PATH, against activate_fused at the same points (the build flags of the two may
+    // differ in FMA contraction, nothing else)
+    enum { POINTS = 97 };
+    double points[POINTS];
+    for (int i = 0; i < POINTS; i++) {
+        points[i] = (i - POINTS / 2) * 0.4137 + (i % 3 == 0 ? 1e-9 * i : 0.0);
+    }
+    ActivationMode mode = get_activation_mode();
+    set_activation_mode(ACTIVATION_ACCURATE);
+    const ActivationFunction functions[6] = {RELU, SIGMOID, TANH, LEAKY_RELU, SIN, SILU};
+    for (int f = 0; f < 6; f++) {
+        FILE *source = fopen("test_export_activation.c", "w");
+        if (source == NULL) break;
+        fputs("#include <stdint.h>\n#include <stdio.h>\n#include <string.h>\n\n", source);
+        export_activation_source(source, functions[f]);
+        fputs("static const double points[] = {", source);
+        for (int i = 0; i < POINTS; i++) fprintf(source, "%a,", points[i]);
+        fputs("};\n\nint main(void) {\n    for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) printf(\"%a\\n\", activate(points[i]));\n    return 0;\n}\n", source);
+        fclose(source);
+        if (system("cc -O2 -std=c11 -o test_export_activation test_export_activation.c -lm 2>/dev/null && ./test_export_activation > test_export_activation.txt") != 0) {
+            printf("Export Activation %s: not compiled\n", activation_function_name(functions[f]));
+            continue;
+        }
+
+        double expected[POINTS], max_difference = 0.0;
+        int read = 0;
+        activate_fused(points, expected, NULL, NULL, NULL, POINTS, functions[f]);
+        FILE *values = fopen("test_export_activation.txt", "r");
+        char line[64];
+        while (values && read < POINTS && fgets(line, sizeof(line), values)) {
+            max_difference = fmax(max_difference, fabs(strtod(line, NULL) - expected[read]));
+            read++;
+        }
+        if (values) fclose(values);
+        printf("Export Activation %s: %d of %d points, max difference from activate_fused %e\n", activation_function_name(functions[f]), read, POINTS, max_difference);
+    }
+    set_activation_mode(mode);
+    remove("test_export_activation.c");
+    remove("test_export_activation.txt");
+    remove("test_export_activation");
+}
+
+void test_export_c() {
+    // Generate C for a small tanh network and, where a compiler is on the PATH, build and
+    // run the generated self-test (it checks the kernel against forward_pass)
+    const int layers[] = {2, 16, 16, 1};
+    NeuralNetwork nn;
+    ExportConfig config;
+    initialize_neural_network(&nn, layers, 4);
+    default_export_config(&config);
+    config.output_base = "test_export";
+    config.unroll_limit = 32; // Layer 0 straight-line, the others as loops
+    int exported = export_c_network(&nn, TANH, &config);
+    printf("Export C: %s\n", exported ? "written" : "failed");
+    if (exported) {
+        fflush(stdout);
+        int status = system("cc -O2 -std=c11 -o test_export_selftest test_export.c test_export_test.c -lm 2>/dev/null && ./test_export_selftest");
+        printf("Export C Self-Test Exit Status: %d (expected 0)\n", status);
+    }
+    remove("test_export.h");
+    remove("test_export.c");
+    remove("test_export_test.c");
+    remove("test_export_selftest");
+    free_neural_network(&nn);
+}
+
+// Each rank contributes (rank + 1) * (i + 1): every sum is an exact integer in double
+static int check_allreduce(Communicator *comm, void *context) {
+    (void)context;
+    int ok = 1;
+    double data[37];
+    const size_t counts[2] = {37, 3}; // Uneven chunks, then fewer cache lines than ranks
+    for (int c = 0; c < 2; c++) {
+        for (size_t i = 0; i < counts[c]; i++) {
+            data[i] = (comm->rank + 1) * (double)(i + 1);
+        }
+        comm_allreduce(comm, data, counts[c]);
+        double ranks_sum = comm->num_ranks * (comm->num_ranks + 1) / 2.0;
+        for (size_t i = 0; i < counts[c]; i++) {
+            ok &= data[i] == ranks_sum * (i + 1);
+        }
+    }
+    return ok;
+}
+
+void test_distributed() {
+    // Three forked ranks sum vectors through the shared-memory ring; launch_ranks only
+    // succeeds when every rank saw the exact sums
+    Communicator comm;
+    if (!comm_init_shared_memory(&comm, 3, 37)) {
+        printf("Shared Memory Communicator: failed\n");
+        return;
+    }
+    int exact = launch_ranks(&comm, check_allreduce, NULL);
+    printf("Ring Allreduce over %d Ranks: %s\n", comm.num_ranks, exact ? "exact on every rank" : "failed");
+    comm_free(&comm);
+}
+
+// The text log the next heat run writes, so the test can clean it up
+static void next_heat_log(char *path, size_t size) {
+    int run = next_run_number(".", "heat");
+    if (run == 0) {
+        snprintf(path, size, "log_heat.txt");
+    } else {
+        snprintf(path, size, "log_heat_%d.txt", run);
+    }
+}
+
+typedef struct {
+    NeuralNetwork *nn;
+    const TrainingConfig *config;
+    const double *reference;            // Parameters after the same run on --threads 2
+} RankTrainingCheck;
+
+// Train this rank's copy and compare it with the threaded run, bit for bit
+static int check_rank_training(Communicator *comm, void *context) {
+    RankTrainingCheck *check = context;
+    TrainingConfig config = *check->config;
+    config.comm = comm;
+    LossParameters params = {.thermal_conductivity = 0.5};
+    if (!train_neural_network(check->nn, "heat", &params, &config)) {
+        return 0;
+    }
+    return memcmp(check->nn->parameters, check->reference, check->nn->num_parameters * sizeof(double)) == 0;
+}
+
+void test_distributed_training() {
+    // Two ranks on one thread each split every batch where two threads would, and the
+    // allreduce adds the two halves like the two-worker reduction, so the parameters after
+    // Adam steps and a refinement match a --threads 2 run exactly
+    const int layers[] = {2, 16, 16, 1};
+    TrainingConfig config;
+    default_training_config(&config);
+    config.epochs = 12;
+    config.refine_every = 5;
+    config.refine_candidates = 256;
+    config.log_every = config.epochs;
+    default_optimizer_config(&config.optimizer, OPTIMIZER_ADAM);
+    LossParameters params = {.thermal_conductivity = 0.5};
+
+    NeuralNetwork threaded, ranked;
+    initialize_neural_network(&threaded, layers, 4);
+    initialize_neural_network(&ranked, layers, 4);
+    memcpy(ranked.parameters, threaded.parameters, threaded.num_parameters * sizeof(double));
+
+    char log_path[64];
+    next_heat_log(log_path, sizeof(log_path));
+    config.threads = 2;
+    int trained = train_neural_network(&threaded, "heat", &params, &config);
+    remove(log_path);
+
+    config.threads = 1;
+    Communicator comm;
+    int identical = 0;
+    if (trained && comm_init_shared_memory(&comm, 2, training_message_capacity(&ranked, &config))) {
+        next_heat_log(log_path, sizeof(log_path));
+        RankTrainingCheck check = {&ranked, &config, threaded.parameters};
+        fflush(stdout);
+        identical = launch_ranks(&comm, check_rank_training, &check);
+        remove(log_path);
+        comm_free(&comm);
+    }
+    printf("Two Ranks vs Two Threads after %d Epochs: %s\n", config.epochs, identical ? "bit-identical on every rank" : "DIFFERENT");
+
+    free_neural_network(&threaded);
+    free_neural_network(&ranked);
 }
 
 int main() {
     test_initialize_neural_network(); // Test initialization
+    test_layer_spec(); // Test runtime layer specs
+    test_activation_kernels(); // Test fused activation kernels
     test_forward_pass(); // Test forward pass
+    test_forward_backward_batch(); // Test batched GEMM passes
+    test_forward_pass_jet(); // Test forward-mode input derivatives
+    test_backward_pass_jet(); // Test reverse-mode gradients of a residual loss
+    test_reduced_precision_jet(); // Test the float jet sweep against fp64
+    test_data_parallel_gradients(); // Test sharded gradients against one thread and across runs
+    test_sparse_table_gradients(); // Test row-tracked hash-grid gradients and the lazy Adam step
+    test_input_encoding(); // Test Fourier-feature and hash-grid encodings
+    test_optimizers(); // Test Adam, AdamW and L-BFGS
+    test_checkpoint_round_trip(); // Test binary checkpoints
+    test_logger(); // Test the log writer in every format
+    test_inference(); // Test batch inference on grids and point files
+    test_loss_balancer(); // Test adaptive loss-term weights
+    test_validator(); // Test background validation on snapshots
+    test_ensemble(); // Test lane-packed ensemble passes against single networks
+    test_decomposition(); // Test subdomain layouts and interface terms
+    test_time_marching(); // Test causal weights and window initial targets
+    test_parametric(); // Test parameter inputs through the jets and checkpoints
+    test_export_c(); // Test generated C inference kernels
+    test_export_activations(); // Test every exported activation against the training kernels
+    test_distributed(); // Test the multi-process ring allreduce
+    test_distributed_training(); // Test two ranks against two threads
     return 0;
 }
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "sampler.h"
+
+static int batch_in_domain(const CollocationBatch *batch, const Domain *domain) {
+    int dims = domain->dims;
+    int total = collocation_batch_size(batch);
+    for (int n = 0; n < total; n++) {
+        for (int j = 0; j < dims; j++) {
+            double x = batch->points[n * dims + j];
+            if (x < domain->lower[j] || x > domain->upper[j]) return 0;
+        }
+    }
+    return 1;
+}
+
+void test_sampling_methods() {
+    // Every method must stay inside the box and pin boundary/initial points to their faces
+    const char *names[] = {"uniform", "lhs", "sobol"};
+    Domain domain;
+    parse_domain("-1:1,0:2", &domain);
+    for (int m = 0; m < 3; m++) {
+        SamplingMethod method;
+        Sampler sampler;
+        parse_sampling_method(names[m], &method);
+        sampler_init(&sampler, &domain, method, 64, 16, 16, 42, 1);
+        const CollocationBatch *batch = sampler_next_batch(&sampler);
+        batch = sampler_next_batch(&sampler); // Second batch comes from the background thread
+
+        int on_faces = 1;
+        for (int n = 0; n < batch->num_boundary; n++) {
+            double x = batch->points[(batch->num_interior + n) * 2];
+            on_faces &= (x == -1.0 || x == 1.0);
+        }
+        int at_start = 1;
+        for (int n = 0; n < batch->num_initial; n++) {
+            at_start &= batch->points[(batch->num_interior + batch->num_boundary + n) * 2 + 1] == 0.0;
+        }
+        printf("Sampler %s: in domain: %s, boundary on faces: %s, initial at t0: %s\n", names[m],
+               batch_in_domain(batch, &domain) ? "yes" : "no", on_faces ? "yes" : "no", at_start ? "yes" : "no");
+        sampler_free(&sampler);
+    }
+}
+
+void test_latin_hypercube_strata() {
+    // Each of the n strata on each axis holds exactly one point
+    Domain domain;
+    Sampler sampler;
+    unit_domain(&domain, 2);
+    sampler_init(&sampler, &domain, SAMPLE_LATIN_HYPERCUBE, 50, 0, 0, 7, 0);
+    const CollocationBatch *batch = sampler_next_batch(&sampler);
+    int counts[2][50] = {{0}};
+    int stratified = 1;
+    for (int n = 0; n < 50; n++) {
+        for (int j = 0; j < 2; j++) counts[j][(int)(batch->points[n * 2 + j] * 50)]++;
+    }
+    for (int j = 0; j < 2; j++) {
+        for (int k = 0; k < 50; k++) stratified &= counts[j][k] == 1;
+    }
+    printf("Latin Hypercube Stratified: %s\n", stratified ? "yes" : "no");
+    sampler_free(&sampler);
+}
+
+void test_sobol_discrepancy() {
+    // Sobol points should fill the square more evenly than uniform draws: compare the worst
+    // deviation of anchored-box counts from their area over a coarse grid of boxes
+    Domain domain;
+    unit_domain(&domain, 2);
+    double worst[2];
+    SamplingMethod methods[2] = {SAMPLE_SOBOL, SAMPLE_UNIFORM};
+    for (int m = 0; m < 2; m++) {
+        Sampler sampler;
+        sampler_init(&sampler, &domain, methods[m], 1024, 0, 0, 3, 0);
+        const CollocationBatch *batch = sampler_next_batch(&sampler);
+        worst[m] = 0.0;
+        for (int a = 1; a <= 16; a++) {
+            for (int b = 1; b <= 16; b++) {
+                int inside = 0;
+                for (int n = 0; n < 1024; n++) {
+                    inside += batch->points[n * 2] < a / 16.0 && batch->points[n * 2 + 1] < b / 16.0;
+                }
+                worst[m] = fmax(worst[m], fabs(inside / 1024.0 - a * b / 256.0));
+            }
+        }
+        sampler_free(&sampler);
+    }
+    printf("Star Discrepancy Estimate: sobol %.4f, uniform %.4f\n", worst[0], worst[1]);
+}
+
+void test_sobol_pass_wrap() {
+    // The last index of a 32-bit pass has no zero bit to flip. Start three steps before it,
+    // so the batch runs into the second pass, which replays the sequence under a new shift.
+    Domain domain;
+    Sampler sampler, fresh;
+    unit_domain(&domain, 2);
+    sampler_init(&sampler, &domain, SAMPLE_SOBOL, 8, 0, 0, 5, 0);
+    sampler_init(&fresh, &domain, SAMPLE_SOBOL, 5, 0, 0, 5, 0);
+    SobolSequence *seq = &sampler.interior_sequence;
+    seq->index = UINT32_MAX - 3;
+    uint32_t gray = (uint32_t)seq->index ^ (uint32_t)(seq->index >> 1);
+    for (int j = 0; j < seq->dims; j++) {
+        seq->state[j] = 0;
+        for (int k = 0; k < 32; k++) {
+            if ((gray >> k) & 1) seq->state[j] ^= seq->directions[j][k];
+        }
+    }
+    uint32_t first_shift = seq->shift[0];
+    const CollocationBatch *batch = sampler_next_batch(&sampler);
+    sampler_next_batch(&fresh);
+    int replayed = seq->index == (1ULL << 32) + 5 && memcmp(seq->state, fresh.interior_sequence.state, sizeof(seq->state)) == 0;
+    printf("Sobol Pass Wrap: in domain: %s, second pass replays the sequence: %s, new shift: %s\n",
+           batch_in_domain(batch, &domain) ? "yes" : "no", replayed ? "yes" : "no", seq->shift[0] != first_shift ? "yes" : "no");
+    sampler_free(&sampler);
+    sampler_free(&fresh);
+}
+
+void test_residual_refinement() {
+    // The high-residual strip x > 0.9 covers 10% of the box but should be oversampled after refinement
+    Domain domain;
+    Sampler sampler;
+    unit_domain(&domain, 2);
+    sampler_init(&sampler, &domain, SAMPLE_SOBOL, 200, 0, 0, 11, 0);
+    double candidates[2000 * 2], residuals[2000];
+    sampler_uniform_points(&sampler, candidates, 2000);
+    for (int n = 0; n < 2000; n++) residuals[n] = candidates[n * 2] > 0.9 ? 1000.0 : 0.0;
+    sampler_refine(&sampler, candidates, residuals, 2000);
+
+    const CollocationBatch *batch = sampler_next_batch(&sampler);
+    int hot = 0;
+    for (int n = 0; n < batch->num_interior; n++) hot += batch->points[n * 2] > 0.9;
+    printf("Refined Interior Share in Hot Region: %.2f\n", (double)hot / batch->num_interior);
+    sampler_free(&sampler);
+}
+
+void test_counter_rng() {
+    // Philox4x32-10 known-answer vectors (Random123), random access against sequential draws,
+    // and a sampler restored from a snapshot continuing the same batches
+    const uint32_t zero[4] = {0, 0, 0, 0}, ones[4] = {~0u, ~0u, ~0u, ~0u};
+    const uint32_t expected_zero[4] = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    const uint32_t expected_ones[4] = {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+    uint32_t out_zero[4], out_ones[4];
+    philox4x32(zero, zero, out_zero);
+    philox4x32(ones, ones, out_ones);
+    int known = memcmp(out_zero, expected_zero, sizeof(out_zero)) == 0 && memcmp(out_ones, expected_ones, sizeof(out_ones)) == 0;
+    printf("Philox Known-Answer Vectors: %s\n", known ? "match" : "MISMATCH");
+
+    // Ranges filled out of order, as workers would, equal one sequential pass
+    Rng rng, other;
+    rng_init(&rng, 42, RNG_STREAM_SAMPLING, 3);
+    double sequential[101], pieces[101];
+    for (int n = 0; n < 101; n++) sequential[n] = rng_next_uniform(&rng);
+    rng_fill_uniform(&rng, 37, pieces + 37, 64, 0.0, 1.0);
+    rng_fill_uniform(&rng, 0, pieces, 37, 0.0, 1.0);
+    int same = memcmp(sequential, pieces, sizeof(pieces)) == 0;
+    rng_init(&other, 42, RNG_STREAM_SAMPLING, 4);
+    printf("Random Access Matches Sequential: %s, neighbouring substreams differ: %s\n", same ? "yes" : "no", rng_at(&rng, 0) != rng_at(&other, 0) ? "yes" : "no");
+
+    Domain domain;
+    Sampler sampler, restored;
+    SamplerState state;
+    unit_domain(&domain, 3);
+    sampler_init(&sampler, &domain, SAMPLE_LATIN_HYPERCUBE, 50, 20, 10, 7, 0);
+    sampler_init(&restored, &domain, SAMPLE_LATIN_HYPERCUBE, 50, 20, 10, 99, 0);
+    sampler_next_batch(&sampler);
+    // A refined sampler draws half of its interior points from the pool, so the pool has to come along
+    double candidates[64 * 3], residuals[64];
+    for (int n = 0; n < 64 * 3; n++) candidates[n] = rng_next_uniform(&rng);
+    for (int n = 0; n < 64; n++) residuals[n] = candidates[3 * n];
+    sampler_refine(&sampler, candidates, residuals, 64);
+    sampler_save_state(&sampler, &state);
+    sampler_restore_state(&restored, &state, sampler.pool);
+    const CollocationBatch *a = sampler_next_batch(&sampler);
+    const CollocationBatch *b = sampler_next_batch(&restored);
+    printf("Restored Sampler Continues the Stream: %s (pool of %u points)\n", memcmp(a->points, b->points, 80 * 3 * sizeof(double)) == 0 ? "yes" : "no", state.pool_size);
+    sampler_free(&sampler);
+    sampler_free(&restored);
+}
+
+int main() {
+    test_sampling_methods();
+    test_latin_hypercube_strata();
+    test_sobol_discrepancy();
+    test_sobol_pass_wrap();
+    test_residual_refinement();
+    test_counter_rng();
+    return 0;
+}
@@ -12,11 +12,14 @@ def visualize_training_logs(filename):
         for line in file:
             try:
                 # Match and extract epoch, loss, and validation loss using regex
-                match = re.match(r'Epoch (\d+): Loss:\s*([\d.]+), Validation Loss:\s*([\d.]+)', line)
+                # (validation runs in the background, so the first records may still read nan)
+                match = re.match(r'Epoch (\d+): Loss:\s*([\d.]+), Validation Loss:\s*([\d.]+|nan)', line)
                 if match:
                     epoch = int(match.group(1))
                     loss = float(match.group(2))
                     val_loss = float(match.group(3))
+                    if np.isnan(val_loss):
+                        continue
 
                     epochs.append(epoch)
                     losses.append(loss)